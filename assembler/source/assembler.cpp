@@ -1,112 +1,167 @@
 #include "assembler/source/assembler.hpp"
-#include "assembler/source/conversions.hpp"
 
 #include "shared/source/assembly.hpp"
 
+#include <algorithm>
 #include <fstream>
 #include <sstream>
 #include <iomanip>
 #include <bitset>
 
 Assembler::Assembler() :
-    m_address(0u),
     m_metalMaskLength(0u),
-    m_mnemonics({ // TODO: Make it constexpr
-        { "NOP", { +AsmIns::NOP, InsType::Simple } },
-        { "HLT", { +AsmIns::HLT, InsType::Simple } },
-        { "BBS", { +AsmIns::BBS, InsType::Simple } },
-        { "LCR", { +AsmIns::LCR, InsType::Simple } },
-        { "OR4", { +AsmIns::OR4, InsType::Simple } },
-        { "OR5", { +AsmIns::OR5, InsType::Simple } },
-        { "AN6", { +AsmIns::AN6, InsType::Simple } },
-        { "AN7", { +AsmIns::AN7, InsType::Simple } },
-        { "DB0", { +AsmIns::DB0, InsType::Simple } },
-        { "DB1", { +AsmIns::DB1, InsType::Simple } },
-        { "SB0", { +AsmIns::SB0, InsType::Simple } },
-        { "SB1", { +AsmIns::SB1, InsType::Simple } },
-        { "EIN", { +AsmIns::EIN, InsType::Simple } },
-        { "DIN", { +AsmIns::DIN, InsType::Simple } },
-        { "RPM", { +AsmIns::DIN, InsType::Simple } },
-        { "JCN", { +AsmIns::JCN, InsType::TwoByte } },
-        { "FIM", { +AsmIns::FIM, InsType::TwoByte } },
-        { "SRC", { +AsmIns::SRC, InsType::Complex } },
-        { "FIN", { +AsmIns::FIN, InsType::Complex } },
-        { "JIN", { +AsmIns::JIN, InsType::Complex } },
-        { "JUN", { +AsmIns::JUN, InsType::TwoByte } },
-        { "JMS", { +AsmIns::JMS, InsType::TwoByte } },
-        { "INC", { +AsmIns::INC, InsType::Complex } },
-        { "ISZ", { +AsmIns::ISZ, InsType::TwoByte } },
-        { "ADD", { +AsmIns::ADD, InsType::Complex } },
-        { "SUB", { +AsmIns::SUB, InsType::Complex } },
-        { "LD",  { +AsmIns::LD,  InsType::Complex } },
-        { "XCH", { +AsmIns::XCH, InsType::Complex } },
-        { "BBL", { +AsmIns::BBL, InsType::Complex } },
-        { "LDM", { +AsmIns::LDM, InsType::Complex } },
-        { "WRM", { +AsmIns::WRM, InsType::Simple } },
-        { "WMP", { +AsmIns::WMP, InsType::Simple } },
-        { "WRR", { +AsmIns::WRR, InsType::Simple } },
-        { "WPM", { +AsmIns::WPM, InsType::Simple } },
-        { "WR0", { +AsmIns::WR0, InsType::Simple } },
-        { "WR1", { +AsmIns::WR1, InsType::Simple } },
-        { "WR2", { +AsmIns::WR2, InsType::Simple } },
-        { "WR3", { +AsmIns::WR3, InsType::Simple } },
-        { "SBM", { +AsmIns::SBM, InsType::Simple } },
-        { "RDM", { +AsmIns::RDM, InsType::Simple } },
-        { "RDR", { +AsmIns::RDR, InsType::Simple } },
-        { "ADM", { +AsmIns::ADM, InsType::Simple } },
-        { "RD0", { +AsmIns::RD0, InsType::Simple } },
-        { "RD1", { +AsmIns::RD1, InsType::Simple } },
-        { "RD2", { +AsmIns::RD2, InsType::Simple } },
-        { "RD3", { +AsmIns::RD3, InsType::Simple } },
-        { "CLB", { +AsmIns::CLB, InsType::Simple } },
-        { "CLC", { +AsmIns::CLC, InsType::Simple } },
-        { "IAC", { +AsmIns::IAC, InsType::Simple } },
-        { "CMC", { +AsmIns::CMC, InsType::Simple } },
-        { "CMA", { +AsmIns::CMA, InsType::Simple } },
-        { "RAL", { +AsmIns::RAL, InsType::Simple } },
-        { "RAR", { +AsmIns::RAR, InsType::Simple } },
-        { "TCC", { +AsmIns::TCC, InsType::Simple } },
-        { "DAC", { +AsmIns::DAC, InsType::Simple } },
-        { "TCS", { +AsmIns::TCS, InsType::Simple } },
-        { "STC", { +AsmIns::STC, InsType::Simple } },
-        { "DAA", { +AsmIns::DAA, InsType::Simple } },
-        { "KBP", { +AsmIns::KBP, InsType::Simple } },
-        { "DCL", { +AsmIns::DCL, InsType::Simple } },
-    }) {}
+    m_tokenizer(nullptr),
+    m_object(nullptr),
+    m_code(nullptr),
+    m_section(0u),
+    m_relocatable(false),
+    m_base(0u),
+    m_relaxBranches(true),
+    m_branchCount(0u),
+    m_optimize(false),
+    m_tailCallCount(0u) {}
 
 bool Assembler::assemble(const char* filename, std::vector<uint8_t>& output, bool i4004ModeEnabled)
 {
-    std::fstream file(filename);
-    if (!file.is_open())
-        return false;
+    std::string source;
+    return readSource(filename, source, m_error) && assemble(std::string_view(source), output, i4004ModeEnabled);
+}
 
-    m_symbolTable.clear();
-    m_address = 0u;
-    m_metalMaskLength = 2u;
+bool Assembler::assemble(std::string_view source, std::vector<uint8_t>& output, bool)
+{
+    return run(source, output, nullptr);
+}
 
-    std::stringstream ss;
-    std::string line;
-    while (std::getline(file, line)) {
-        if (trimComments(line)) continue;
-        if (trimWhiteSpaces(line)) continue;
-        if (checkForSymbols(line)) continue;
-        ss << line << '\n';
-    }
-    file.close();
+bool Assembler::assembleObject(const char* filename, ObjectModule& object)
+{
+    std::string source;
+    return readSource(filename, source, m_error) && assembleObject(std::string_view(source), object);
+}
 
-    output.reserve(m_address + m_metalMaskLength);
-    output.push_back(0xFE);
-    while (std::getline(ss, line)) {
-        if (m_metalMaskLength-- == 2u)
-            output.push_back(0xFF);
+bool Assembler::assembleObject(std::string_view source, ObjectModule& object)
+{
+    object.clear();
+    std::vector<uint8_t> unused;
+    return run(source, unused, &object);
+}
 
-        if (!parseLine(line, output))
-            return false;
+bool Assembler::readSource(const char* filename, std::string& source, std::string& error)
+{
+    std::ifstream file(filename, std::ios_base::binary);
+    if (!file.is_open()) {
+        error = std::string("cannot open ") + filename;
+        return false;
     }
 
+    // Whole file in one buffer, tokens and symbols are views into it
+    file.seekg(0, std::ios_base::end);
+    source.assign(static_cast<size_t>(file.tellg()), '\0');
+    file.seekg(0, std::ios_base::beg);
+    file.read(source.data(), static_cast<std::streamsize>(source.size()));
     return true;
 }
 
+bool Assembler::run(std::string_view source, std::vector<uint8_t>& output, ObjectModule* object)
+{
+    // Every pass assembles the whole source again with the short branches
+    // found leaving their page so far relaxed. Relaxing only ever adds bytes,
+    // so this ends once a pass finds no new one. Tail calls found unsafe are
+    // kept as calls the same way.
+    m_object = object;
+    m_relaxed.clear();
+    m_keptCalls.clear();
+    bool ok;
+    do {
+        ok = runPass(source, output);
+        for (size_t branch : m_crossing)
+            m_relaxed[branch] = true;
+        for (size_t call : m_unsafeCalls)
+            m_keptCalls[call] = true;
+    } while (ok && (!m_crossing.empty() || !m_unsafeCalls.empty()));
+
+    m_object = nullptr;
+    m_relaxed.clear();
+    m_crossing.clear();
+    m_keptCalls.clear();
+    m_unsafeCalls.clear();
+    m_tailCalls.clear();
+    return ok;
+}
+
+bool Assembler::runPass(std::string_view source, std::vector<uint8_t>& output)
+{
+    // Single pass: code is emitted as lines are read, operands naming symbols
+    // not defined yet (or in a relocatable section) leave a fixup that is
+    // patched at the end or becomes a relocation of the object
+    Tokenizer tokenizer(source);
+    m_tokenizer = &tokenizer;
+    m_symbolTable.clear();
+    m_fixups.clear();
+    m_globals.clear();
+    m_crossing.clear();
+    m_relaxations.clear();
+    m_window.clear();
+    m_windowPlaces.clear();
+    m_unsafeCalls.clear();
+    m_tailCalls.clear();
+    m_optimizations.clear();
+    m_listing.clear();
+    m_symbols.clear();
+    m_error.clear();
+    m_branchCount = 0u;
+    m_tailCallCount = 0u;
+    m_base = 0u;
+
+    if (m_object != nullptr) {
+        m_object->clear();
+        m_metalMaskLength = 0u;
+        startSection("CODE", false, 0u);
+    }
+    else {
+        m_metalMaskLength = 2u;
+        m_code = &output;
+        m_section = 0u;
+        m_relocatable = false;
+        output.reserve(output.size() + m_metalMaskLength + MAX_PROGRAM_SIZE);
+        output.clear();
+        output.push_back(0xFE);
+        output.push_back(0xFF);
+    }
+
+    bool ok = true;
+    bool end = false;
+    next();
+    while (ok && !end && m_token.type != TokenType::Invalid)
+        ok = parseLine(end);
+    if (ok && !end && !m_token.text.empty())
+        ok = fail(m_token.line, "unexpected", m_token.text);
+    if (ok && m_object == nullptr && getAddress() > MAX_PROGRAM_SIZE)
+        ok = fail(findOverflowLine(), "program does not fit in 4 KiB");
+    if (ok && m_object != nullptr) {
+        for (const ObjectModule::Section& section : m_object->sections)
+            if ((section.absolute ? section.origin : 0u) + section.code.size() > MAX_PROGRAM_SIZE)
+                ok = fail(0u, "section does not fit in 4 KiB", section.name);
+    }
+    if (ok)
+        ok = resolveFixups();
+    if (ok && m_object != nullptr)
+        ok = exportGlobals();
+    if (ok && m_object == nullptr)
+        checkTailCalls();
+    if (ok && m_object == nullptr)
+        finishListing();
+    m_relaxed.resize(m_branchCount, false);
+    m_keptCalls.resize(m_tailCallCount, false);
+
+    m_tokenizer = nullptr;
+    m_token = Token();
+    m_code = nullptr;
+    m_symbolTable.clear();
+    m_fixups.clear();
+    m_globals.clear();
+    return ok;
+}
+
 bool Assembler::disassemble(const std::vector<uint8_t>& bytecode, std::vector<std::string>& output)
 {
     m_metalMaskLength = 1u;
@@ -124,38 +179,8 @@ bool Assembler::disassemble(const std::vector<uint8_t>& bytecode, std::vector<st
     bool twoByte = false;
     for (size_t i = m_metalMaskLength; i < bytecode.size(); ++i) {
         uint8_t opcode = getOpcodeFromByte(bytecode[i]);
-        // TODO: Refactor
+        // Names from the instruction table, operands formatted per instruction
         switch (opcode) {
-        case +AsmIns::NOP: ss << "NOP"; break;
-        case +AsmIns::WRM: ss << "WRM"; break;
-        case +AsmIns::WMP: ss << "WMP"; break;
-        case +AsmIns::WRR: ss << "WRR"; break;
-        case +AsmIns::WR0: ss << "WR0"; break;
-        case +AsmIns::WR1: ss << "WR1"; break;
-        case +AsmIns::WR2: ss << "WR2"; break;
-        case +AsmIns::WR3: ss << "WR3"; break;
-        case +AsmIns::SBM: ss << "SBM"; break;
-        case +AsmIns::RDM: ss << "RDM"; break;
-        case +AsmIns::RDR: ss << "RDR"; break;
-        case +AsmIns::ADM: ss << "ADM"; break;
-        case +AsmIns::RD0: ss << "RD0"; break;
-        case +AsmIns::RD1: ss << "RD1"; break;
-        case +AsmIns::RD2: ss << "RD2"; break;
-        case +AsmIns::RD3: ss << "RD3"; break;
-        case +AsmIns::CLB: ss << "CLB"; break;
-        case +AsmIns::CLC: ss << "CLC"; break;
-        case +AsmIns::IAC: ss << "IAC"; break;
-        case +AsmIns::CMC: ss << "CMC"; break;
-        case +AsmIns::CMA: ss << "CMA"; break;
-        case +AsmIns::RAL: ss << "RAL"; break;
-        case +AsmIns::RAR: ss << "RAR"; break;
-        case +AsmIns::TCC: ss << "TCC"; break;
-        case +AsmIns::DAC: ss << "DAC"; break;
-        case +AsmIns::TCS: ss << "TCS"; break;
-        case +AsmIns::STC: ss << "STC"; break;
-        case +AsmIns::DAA: ss << "DAA"; break;
-        case +AsmIns::KBP: ss << "KBP"; break;
-        case +AsmIns::DCL: ss << "DCL"; break;
         case +AsmIns::JCN: {
             twoByte = true;
             ss << "JCN %";
@@ -240,7 +265,8 @@ bool Assembler::disassemble(const std::vector<uint8_t>& bytecode, std::vector<st
             ss << +ch;
         } break;
         default: {
-            ss << "???";
+            const AsmInsDesc* desc = findAsmInstruction(opcode);
+            ss << (desc != nullptr ? desc->name : "???");
         } break;
         }
         output.push_back(ss.str());
@@ -254,225 +280,485 @@ bool Assembler::disassemble(const std::vector<uint8_t>& bytecode, std::vector<st
     return true;
 }
 
-bool Assembler::trimComments(std::string& line)
+bool Assembler::parseLine(bool& end)
 {
-    line = line.substr(0, line.find_first_of(';'));
-    return line.empty();
-}
+    // [label] [instruction | .BYTE value] | name = value | * = address |
+    // .SECTION name | .GLOBAL name[, name]... | .END
+    if (m_token.type == TokenType::Label) {
+        Token label = m_token;
+        next();
+        if (m_token.type == TokenType::Equal) {
+            next();
+            Operand operand;
+            if (!parseOperand(operand))
+                return false;
+            if (!operand.symbol.empty())
+                return fail(label.line, "value of symbol must be known", label.text);
+            if (m_object == nullptr)
+                m_symbols.push_back({ std::string(label.text), operand.value, false, label.line });
+            return defineSymbol(label.text, operand.value, ObjectModule::NO_SECTION, label.line) && expectLineEnd();
+        }
 
-bool Assembler::trimWhiteSpaces(std::string& line)
-{
-    size_t off = line.find_first_not_of(" \t");
-    if (off == line.npos) off = 0;
-    size_t count = line.find_last_not_of(" \t") - off + 1;
-    line = line.substr(off, count);
-    return line.empty();
+        uint16_t section = m_relocatable ? m_section : ObjectModule::NO_SECTION;
+        if (!defineSymbol(label.text, static_cast<uint16_t>(getAddress()), section, label.line))
+            return false;
+        if (m_object == nullptr)
+            m_symbols.push_back({ std::string(label.text), static_cast<uint16_t>(getAddress()), true, label.line });
+        // Code may jump here, nothing before it can be rewritten together with what follows
+        m_window.clear();
+        m_windowPlaces.clear();
+    }
+
+    size_t line = m_token.line;
+    switch (m_token.type) {
+    case TokenType::NewLine:
+        next();
+        return true;
+    case TokenType::Invalid:
+        return m_token.text.empty() || fail(line, "unexpected", m_token.text);
+    case TokenType::Star: {
+        next();
+        if (m_token.type != TokenType::Equal)
+            return fail(line, "expected '=' after '*'");
+        next();
+        Operand operand;
+        if (!parseOperand(operand))
+            return false;
+        if (!operand.symbol.empty())
+            return fail(line, "origin must be known", operand.symbol);
+        if (operand.value > MAX_PROGRAM_SIZE || (m_object == nullptr && operand.value < getAddress()))
+            return fail(line, "origin out of range");
+        m_window.clear();
+        m_windowPlaces.clear();
+        if (m_object != nullptr)
+            startSection({}, true, operand.value);
+        list(m_code->size(), line, ListingKind::Fill);
+        if (m_object == nullptr)
+            m_code->resize(m_metalMaskLength + operand.value, 0u);
+        return expectLineEnd();
+    }
+    case TokenType::BytePragma: {
+        next();
+        m_window.clear();
+        m_windowPlaces.clear();
+        Operand operand;
+        list(m_code->size(), line, ListingKind::Data);
+        m_code->push_back(0u);
+        return parseOperand(operand) && place(operand, FixupKind::Byte, m_code->size() - 1u) && expectLineEnd();
+    }
+    case TokenType::SectionPragma:
+        next();
+        m_window.clear();
+        m_windowPlaces.clear();
+        return parseSection(line) && expectLineEnd();
+    case TokenType::GlobalPragma:
+        next();
+        return parseGlobals() && expectLineEnd();
+    case TokenType::EndPragma:
+        end = true;
+        return true;
+    case TokenType::Mnemonic: {
+        Tokenizer::MnemonicDesc desc;
+        Tokenizer::findMnemonic(m_token.text, desc);
+        next();
+        size_t offset = m_code->size(), fixups = m_fixups.size(), relaxations = m_relaxations.size();
+        list(offset, line, ListingKind::Code);
+        if (!parseInstruction(desc) || !expectLineEnd())
+            return false;
+        if (m_relaxations.size() != relaxations) {
+            // The skip lands inside the rewritten branch
+            m_window.clear();
+            m_windowPlaces.clear();
+        }
+        else if (m_optimize) {
+            optimize(offset, m_fixups.size() == fixups, line);
+        }
+        return true;
+    }
+    default:
+        return fail(line, "unexpected", m_token.text);
+    }
 }
 
-bool Assembler::checkForSymbols(std::string& line)
+bool Assembler::parseInstruction(const Tokenizer::MnemonicDesc& desc)
 {
-    size_t token1End = line.find_first_of(' ');
-    std::string token = line.substr(0, token1End);
-    
-    if (token[0] == '$')
+    size_t offset = m_code->size();
+    m_code->push_back(desc.byte);
+
+    Operand first;
+    switch (desc.type) {
+    case Tokenizer::InsType::Simple:
         return true;
+    case Tokenizer::InsType::Complex:
+        return parseOperand(first) && place(first, FixupKind::Nibble, offset);
+    case Tokenizer::InsType::TwoByte: {
+        m_code->push_back(0u);
+        if (!parseOperand(first))
+            return false;
 
-    if (token[0] == '*') {
-        token = token.substr(2);
-        uint16_t newAddress = std::strtol(token.c_str(), nullptr, 0);
-        uint16_t addressDiff = newAddress - m_address;
-        m_address = newAddress;
-        line = line.substr(0, 2) + std::to_string(addressDiff);
-        return false;
-    }
+        // Condition, register or pair and an 8-bit value, else a 12-bit address
+        if (m_token.type != TokenType::Comma)
+            return place(first, FixupKind::Address, offset);
+
+        next();
+        Operand second;
+        if (desc.byte != +AsmIns::JCN && desc.byte != +AsmIns::ISZ)
+            return place(first, FixupKind::Nibble, offset) &&
+                   parseOperand(second) &&
+                   place(second, FixupKind::Byte, offset + 1u);
 
-    if (token[0] == '.') {
-        if (token == ".BYTE") {
-            line = '.' + line.substr(5);
-            ++m_address;
+        size_t branch = m_branchCount++;
+        if (!parseOperand(second))
             return false;
+        if (branch < m_relaxed.size() && m_relaxed[branch]) {
+            m_code->resize(offset);
+            return emitRelaxedBranch(desc, first, second);
         }
+        return place(first, FixupKind::Nibble, offset) &&
+               place(second, FixupKind::Branch, offset + 1u, branch);
+    }
+    }
 
-        if (token == ".END")
-            return true;
+    return true;
+}
 
-        return true; // Error
+bool Assembler::emitRelaxedBranch(const Tokenizer::MnemonicDesc& desc, const Operand& first, const Operand& second)
+{
+    // The short jump over the JUN must stay in the page it is taken in, a
+    // JCN/ISZ ending on the last byte of a page already jumps in the next one
+    size_t address = getAddress();
+    size_t padding = (address & 0xFFu) == 0xFCu ? 2u : (address & 0xFFu) == 0xFDu ? 1u : 0u;
+    m_code->insert(m_code->end(), padding, +AsmIns::NOP);
+
+    size_t offset = m_code->size();
+    size_t skip = address + padding + 4u;
+    m_code->push_back(desc.byte);
+    m_code->push_back(0u);
+    bool ok;
+    if (desc.byte == +AsmIns::JCN) {
+        ok = place(first, FixupKind::InvertedNibble, offset);
     }
+    else {
+        // Taken to the JUN to the target, else over it
+        ok = place(first, FixupKind::Nibble, offset);
+        m_code->push_back(static_cast<uint8_t>(+AsmIns::JUN | ((skip + 2u) >> 8)));
+        m_code->push_back(static_cast<uint8_t>((skip + 2u) & 0xFFu));
+    }
+    (*m_code)[offset + 1u] = static_cast<uint8_t>(skip & 0xFFu);
 
-    MnemonicDesc desc;
-    if (!isMnemonic(token, desc)) {
-        size_t hasEqualSign = token.find('=');
-        if (hasEqualSign == token.npos) {
-            m_symbolTable.insert(std::make_pair<>(token, static_cast<uint16_t>(m_address)));
-            if (token1End != line.npos) {
-                size_t token2Start = line.find_first_not_of(' ', token1End);
-                line = line.substr(token2Start);
-                return checkForSymbols(line);
-            }
-            
-            return true;
-        }
+    m_code->push_back(+AsmIns::JUN);
+    m_code->push_back(0u);
+    m_relaxations.push_back({ second.line, static_cast<uint16_t>(address), desc.byte, getAddress() - address - 2u });
+    return ok && place(second, FixupKind::Address, m_code->size() - 2u);
+}
 
-        uint16_t value = std::atoi(token.c_str() + hasEqualSign + 1);
-        token = token.substr(0, hasEqualSign);
-        m_symbolTable.insert(std::make_pair<>(token, value));
-        return true;
+void Assembler::optimize(size_t offset, bool known, size_t line)
+{
+    Peephole::Instruction emitted{ { (*m_code)[offset], 0u }, static_cast<uint8_t>(m_code->size() - offset), known };
+    if (emitted.size == 2u)
+        emitted.bytes[1] = (*m_code)[offset + 1u];
+    if (m_window.size() == Peephole::WINDOW_SIZE) {
+        m_window.erase(m_window.begin());
+        m_windowPlaces.erase(m_windowPlaces.begin());
     }
+    m_window.push_back(emitted);
+    m_windowPlaces.push_back({ offset, line });
+
+    // The replacement goes back into the window, so rules can apply to it again
+    Peephole::Rewrite rewrite;
+    while (m_peephole.match(m_window.data(), m_window.size(), rewrite)) {
+        size_t first = m_window.size() - rewrite.count;
+        Emitted start = m_windowPlaces[first];
+        if (rewrite.rule == Peephole::Rule::TailCall) {
+            // The linker may still place code that returns something else
+            size_t number = m_tailCallCount++;
+            if (m_object != nullptr || (number < m_keptCalls.size() && m_keptCalls[number]))
+                return;
+            m_tailCalls.push_back({ number, start.offset, static_cast<uint8_t>(m_window.back().bytes[0] & 0x0Fu) });
+        }
 
-    m_address += desc.type == InsType::TwoByte ? 2 : 1;
-    return false;
+        std::vector<Peephole::Instruction> replaced(m_window.begin() + first, m_window.end());
+        std::vector<Emitted> places(m_windowPlaces.begin() + first, m_windowPlaces.end());
+        m_code->resize(start.offset);
+        while (!m_listing.empty() && m_listing.back().address + m_metalMaskLength >= start.offset)
+            m_listing.pop_back();
+        m_window.resize(first);
+        m_windowPlaces.resize(first);
+        for (size_t i = 0u; i < rewrite.size;) {
+            const AsmInsDesc* desc = findAsmInstruction(getOpcodeFromByte(rewrite.bytes[i]));
+            uint8_t size = desc->type == AsmInsType::TwoByte ? 2u : 1u;
+            Peephole::Instruction replacement{ { rewrite.bytes[i], size == 2u ? rewrite.bytes[i + 1u] : uint8_t(0u) }, size,
+                                               rewrite.rule != Peephole::Rule::TailCall };
+            // An instruction kept from the original keeps its line
+            size_t line = start.line;
+            for (size_t j = 0u; j < replaced.size(); ++j)
+                if (replaced[j].size == 1u && size == 1u && replaced[j].bytes[0] == rewrite.bytes[i])
+                    line = places[j].line;
+            m_window.push_back(replacement);
+            m_windowPlaces.push_back({ m_code->size(), line });
+            list(m_code->size(), line, ListingKind::Code);
+            m_code->insert(m_code->end(), rewrite.bytes + i, rewrite.bytes + i + size);
+            i += size;
+        }
+        m_optimizations.push_back({ start.line, rewrite.rule, rewrite.bytesSaved, rewrite.cyclesSaved });
+    }
 }
 
-bool Assembler::parseLine(const std::string& line, std::vector<uint8_t>& output)
+void Assembler::checkTailCalls()
 {
-    // TODO: change line into string_view
-    if (line[0] == '*') {
-        uint16_t diff = std::atoi(line.c_str() + 2);
-        for (uint16_t i = 0; i < diff; ++i)
-            output.push_back(0u);
-        return true;
+    // On the whole program, a routine may end in a jump to code further on
+    const uint8_t* image = m_code->data() + m_metalMaskLength;
+    size_t size = m_code->size() - m_metalMaskLength;
+    for (const TailCall& call : m_tailCalls) {
+        const uint8_t* jump = m_code->data() + call.offset;
+        uint16_t target = static_cast<uint16_t>(((jump[0] & 0x0Fu) << 8) | jump[1]);
+        if (!Peephole::returnsValue(image, size, target, call.value))
+            m_unsafeCalls.push_back(call.number);
     }
+}
 
-    std::string token;
+void Assembler::list(size_t offset, size_t line, ListingKind kind)
+{
+    if (m_object == nullptr)
+        m_listing.push_back({ static_cast<uint16_t>(offset - m_metalMaskLength), 0u, line, kind });
+}
 
-    if (line[0] == '.') {
-        token = line.substr(1);
-        trimWhiteSpaces(token);
-        output.push_back(parseOperand(token));
-        return true;
+size_t Assembler::findOverflowLine() const
+{
+    // Listed lines are in address order, the first one whose bytes run past the end
+    size_t end = m_code->size() - m_metalMaskLength;
+    for (size_t i = 0u; i < m_listing.size(); ++i) {
+        size_t next = i + 1u < m_listing.size() ? m_listing[i + 1u].address : end;
+        if (next > MAX_PROGRAM_SIZE)
+            return m_listing[i].line;
     }
+    return 0u;
+}
 
-    size_t token2Beg, token2End, token1End = line.find_first_of(' ');
-    token = line.substr(0, token1End); // TODO: change token to string_view
-
-    MnemonicDesc desc;
-    if (isMnemonic(token, desc)) {
-        switch (desc.type) {
-        case InsType::Simple:
-            if (token1End != line.npos) {
-                return false; // Error: More than one instruction in line
-            }
-            output.push_back(desc.byte);
-            break;
-        case InsType::Complex:
-            if (token1End == line.npos) {
-                return false; // Error: Missing instruction operand
-            }
-            token2Beg = line.find_first_not_of(' ', token1End);
-            token2End = line.find_first_of(' ', token2Beg);
-            token = line.substr(token2Beg, token2End - token2Beg + 1);
-            output.push_back(desc.byte | parseOperand(token));
-            break;
-        case InsType::TwoByte:
-            if (token1End == line.npos) {
-                return false; // Error: Missing instruction operand
-            }
-            token2Beg = line.find_first_not_of(' ', token1End);
-            token2End = line.find_first_of(' ', token2Beg);
-            token = line.substr(token2Beg, token2End - token2Beg);
-            if (token[token.size() - 1] == ',') {
-                // Should be 2 operands
-                token = token.substr(0, token.size() - 1);
-                auto ret = m_symbolTable.find(token);
-                output.push_back(desc.byte | (ret != m_symbolTable.end() ? ret->second : parseOperand(token)));
-                token = line.substr(token2End + 1);
-                ret = m_symbolTable.find(token);
-                output.push_back(ret != m_symbolTable.end() ? ret->second : parseOperand(token));
-            }
-            else {
-                // TODO: not sure if this could only be address for here
-                auto ret = m_symbolTable.find(token);
-                std::uint16_t addr = ret != m_symbolTable.end() ? ret->second : parseOperand(token);
-                uint16_t addrHP = addr & 0x0F00u;
-                addrHP >>= 8u;
-                output.push_back(desc.byte | addrHP);
-                output.push_back(addr & 0x00FFu);
-            }
-            break;
-        }
-    }
-    else {
-        return false; // Error
+void Assembler::finishListing()
+{
+    // Each entry runs up to the next one, lines left without bytes are dropped
+    size_t end = m_code->size() - m_metalMaskLength;
+    for (size_t i = m_listing.size(); i-- > 0u;) {
+        m_listing[i].size = static_cast<uint16_t>(end - m_listing[i].address);
+        end = m_listing[i].address;
     }
-
-    return true;
+    m_listing.erase(std::remove_if(m_listing.begin(), m_listing.end(), [](const ListingEntry& entry) { return entry.size == 0u; }),
+                    m_listing.end());
 }
 
-std::uint16_t Assembler::parseOperand(const std::string& token)
+bool Assembler::parseOperand(Operand& operand)
 {
-    std::uint16_t word = 0u;
-    switch (token[0]) {
-    case 'R':
-        parseRegister(token, word);
-        return word;
-    case 'P':
-        parseRegisterPair(token, word);
-        return word;
-    case '$':
-        return textToHex(token.substr(1));
-    case '0':
-        if (token.size() == 1)
+    // term [(+|-) term]..., at most one symbol not known yet and only added.
+    // Summed wide, a term or sum past 16 bits fails instead of wrapping.
+    operand = Operand{ 0u, {}, m_token.line, true };
+    int64_t value = 0;
+    bool negative = false;
+    do {
+        int64_t term = 0;
+        switch (m_token.type) {
+        case TokenType::Number:
+        case TokenType::Register:
+        case TokenType::RegisterPair:
+            term = m_token.value;
             break;
+        case TokenType::Label: {
+            operand.literal = false;
+            auto symbol = m_symbolTable.find(m_token.text);
+            if (symbol != m_symbolTable.end() && symbol->second.section == ObjectModule::NO_SECTION)
+                term = symbol->second.value;
+            else if (negative || !operand.symbol.empty())
+                return fail(m_token.line, "forward reference must be added once", m_token.text);
+            else
+                operand.symbol = m_token.text;
+        } break;
+        case TokenType::NewLine:
+        case TokenType::Invalid:
+            return fail(operand.line, "missing operand");
+        default:
+            return fail(m_token.line, "unexpected", m_token.text);
+        }
 
-        return textToOct(token.substr(1));
-    case '%':
-        return textToBin(token.substr(1));
-    }
+        value += negative ? -term : term;
+        if (term > 0xFFFF || value > 0xFFFF || value < -0xFFFF)
+            return fail(m_token.line, "operand does not fit in 16 bits", m_token.text);
+        // Negative sums wrap, the addend of a symbol may subtract
+        operand.value = static_cast<uint16_t>(value);
 
-    return textToDec(token);
+        next();
+        negative = m_token.type == TokenType::Minus;
+        if (m_token.type != TokenType::Plus && !negative)
+            return true;
+        next();
+    } while (true);
 }
 
-bool Assembler::parseRegister(const std::string_view& str, uint16_t& value)
+bool Assembler::parseSection(size_t line)
 {
-    if (str.size() < 2 || str.size() > 3)
-        return false;
+    if (m_token.type != TokenType::Label)
+        return fail(line, "expected section name");
+    // Flat output has a single address space, the name only matters to the linker
+    if (m_object != nullptr)
+        startSection(m_token.text, false, 0u);
+    next();
+    return true;
+}
 
-    if (str[1] >= '0' && str[1] <= '9') {
-        if (str.size() > 2)
-            if (str[2] >= '0' && str[2] <= '9')
-                value = (str[1] - '0') * 10 + (str[2] - '0');
-            else
-                return false;
-        else 
-            value = str[1] - '0';
+bool Assembler::parseGlobals()
+{
+    do {
+        if (m_token.type != TokenType::Label)
+            return fail(m_token.line, "expected symbol name", m_token.text);
+        m_globals.push_back(m_token);
+        next();
+        if (m_token.type != TokenType::Comma)
+            return true;
+        next();
+    } while (true);
+}
+
+bool Assembler::expectLineEnd()
+{
+    if (m_token.type == TokenType::NewLine) {
+        next();
+        return true;
     }
+    if (m_token.type == TokenType::Invalid && m_token.text.empty())
+        return true;
+    return fail(m_token.line, "unexpected", m_token.text);
+}
 
-    if (str[1] >= 'A' && str[1] <= 'F')
-        value = str[1] - 'A' + 10;
-    else if (str[1] >= 'a' && str[1] <= 'f')
-        value = str[1] - 'a' + 10;
-    else
-        return false;
-    
-    return true;
+void Assembler::startSection(std::string_view name, bool absolute, uint16_t origin)
+{
+    // An empty current section is taken over, its labels then name the new start
+    std::vector<ObjectModule::Section>& sections = m_object->sections;
+    if (sections.empty() || !sections.back().code.empty())
+        sections.emplace_back();
+
+    ObjectModule::Section& section = sections.back();
+    section.name = absolute ? "*=" + std::to_string(origin) : std::string(name);
+    section.absolute = absolute;
+    section.origin = origin;
+    m_section = static_cast<uint16_t>(sections.size() - 1u);
+    m_code = &section.code;
+    m_relocatable = !absolute;
+    m_base = absolute ? origin : 0u;
 }
 
-bool Assembler::parseRegisterPair(const std::string_view& str, uint16_t& value)
+bool Assembler::defineSymbol(std::string_view name, uint16_t value, uint16_t section, size_t line)
 {
-    if (str.size() != 2)
-        return false;
+    Symbol symbol{ value, section, 0u };
+    if (m_object != nullptr)
+        symbol.index = static_cast<uint16_t>(m_object->symbols.size());
+
+    if (!m_symbolTable.emplace(name, symbol).second)
+        return fail(line, "symbol defined twice", name);
+    if (m_object != nullptr)
+        m_object->symbols.push_back({ std::string(name), symbol.section, value, false, true });
+    return true;
+}
 
-    if (str[1] < '0' || str[1] > '7')
-        return false;
+bool Assembler::place(const Operand& operand, FixupKind kind, size_t offset, size_t branch)
+{
+    // A symbol in a byte is taken as an address, of which the low 8 bits are kept
+    if (kind == FixupKind::Byte && operand.literal && operand.value > 0xFFu)
+        return fail(operand.line, "operand does not fit in 8 bits");
 
+    Fixup fixup{ m_section, offset, operand.symbol, operand.value, kind, operand.line, branch };
+    if (operand.symbol.empty())
+        return patch(operand.value, fixup, *m_code);
 
-    value = 2 * (str[1] - '0');
+    m_fixups.push_back(fixup);
     return true;
 }
 
-bool Assembler::isMnemonic(std::string& token, MnemonicDesc& desc)
+bool Assembler::patch(uint16_t value, const Fixup& fixup, std::vector<uint8_t>& code)
 {
-    if (token.size() > 3) return false;
+    switch (fixup.kind) {
+    case FixupKind::Nibble:
+    case FixupKind::InvertedNibble:
+        if (value > 0x0Fu)
+            return fail(fixup.line, "operand does not fit in 4 bits");
+        code[fixup.offset] |= static_cast<uint8_t>(fixup.kind == FixupKind::InvertedNibble ? value ^ 0x08u : value);
+        break;
+    case FixupKind::Branch: {
+        size_t address = fixup.offset - m_metalMaskLength;
+        bool placed = false;  // By the linker, which alone knows the page
+        if (value >= MAX_PROGRAM_SIZE)
+            return fail(fixup.line, "address out of range");
+        if (m_object != nullptr) {
+            const ObjectModule::Section& section = m_object->sections[fixup.section];
+            address += section.origin;
+            placed = !section.absolute;
+        }
 
-    for (auto& ch : token)
-        if (ch >= 'a' && ch <= 'z')
-            ch -= 'a' - 'A';
+        // PC is past the operand when the jump is taken
+        if (!placed && (value & 0x0F00u) != ((address + 1u) & 0x0F00u)) {
+            if (!m_relaxBranches)
+                return fail(fixup.line, "short branch leaves its page", fixup.symbol);
+            m_crossing.push_back(fixup.branch);
+        }
+        code[fixup.offset] = static_cast<uint8_t>(value & 0xFFu);
+    } break;
+    case FixupKind::Byte:
+        code[fixup.offset] = static_cast<uint8_t>(value & 0xFFu);
+        break;
+    case FixupKind::Address:
+        if (value >= MAX_PROGRAM_SIZE)
+            return fail(fixup.line, "address out of range");
+        code[fixup.offset] |= static_cast<uint8_t>(value >> 8);
+        code[fixup.offset + 1u] = static_cast<uint8_t>(value & 0xFFu);
+        break;
+    }
+    return true;
+}
 
-    auto x = m_mnemonics.find(token);
-    if (x != m_mnemonics.end()) {
-        desc = x->second;
-        return true;
+bool Assembler::resolveFixups()
+{
+    for (const Fixup& fixup : m_fixups) {
+        std::vector<uint8_t>& code = m_object != nullptr ? m_object->sections[fixup.section].code : *m_code;
+        auto symbol = m_symbolTable.find(fixup.symbol);
+        bool known = symbol != m_symbolTable.end() && symbol->second.section == ObjectModule::NO_SECTION &&
+                     (m_object == nullptr || m_object->symbols[symbol->second.index].defined);
+        if (known) {
+            uint16_t value = static_cast<uint16_t>(symbol->second.value + fixup.addend);
+            if (!patch(value, fixup, code))
+                return false;
+            continue;
+        }
+        if (m_object == nullptr)
+            return fail(fixup.line, "undefined symbol", fixup.symbol);
+
+        // Relocatable or in another module, the linker fills it in
+        if (symbol == m_symbolTable.end()) {
+            Symbol external{ 0u, ObjectModule::NO_SECTION, static_cast<uint16_t>(m_object->symbols.size()) };
+            symbol = m_symbolTable.emplace(fixup.symbol, external).first;
+            m_object->symbols.push_back({ std::string(fixup.symbol), ObjectModule::NO_SECTION, 0u, true, false });
+        }
+        m_object->relocations.push_back({ fixup.section, static_cast<uint16_t>(fixup.offset), symbol->second.index,
+                                          fixup.addend, fixup.kind, static_cast<uint32_t>(fixup.line) });
     }
+    return true;
+}
 
+bool Assembler::exportGlobals()
+{
+    for (const Token& global : m_globals) {
+        auto symbol = m_symbolTable.find(global.text);
+        if (symbol == m_symbolTable.end() || !m_object->symbols[symbol->second.index].defined)
+            return fail(global.line, "global symbol not defined", global.text);
+        m_object->symbols[symbol->second.index].global = true;
+    }
+    return true;
+}
+
+bool Assembler::fail(size_t line, std::string_view message, std::string_view text)
+{
+    m_error.clear();
+    if (line > 0u)
+        m_error = "line " + std::to_string(line) + ": ";
+    m_error += std::string(message);
+    if (!text.empty())
+        m_error += " '" + std::string(text) + "'";
     return false;
 }
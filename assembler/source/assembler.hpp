@@ -1,38 +1,185 @@
 #pragma once
+#include "assembler/source/object.hpp"
+#include "assembler/source/peephole.hpp"
+#include "assembler/source/tokenizer.hpp"
+
 #include <cstdint>
 #include <string>
+#include <string_view>
 #include <vector>
 #include <unordered_map>
 
 class Assembler
 {
 public:
+    static constexpr size_t MAX_PROGRAM_SIZE = 4096u;
+
     Assembler();
     bool assemble(const char* filename, std::vector<uint8_t>& output, bool i4004ModeEnabled = false);
+    // Assembles source text held in memory, output is replaced with the object code
+    bool assemble(std::string_view source, std::vector<uint8_t>& output, bool i4004ModeEnabled = false);
     bool disassemble(const std::vector<uint8_t>& bytecode, std::vector<std::string>& output);
+
+    // Assembles one module of a larger program into a relocatable object for
+    // the Linker. .SECTION name starts code the linker places, *= address code
+    // at a fixed address. Labels stay local unless named by .GLOBAL, symbols the
+    // module does not define are left for the linker to find.
+    bool assembleObject(const char* filename, ObjectModule& object);
+    bool assembleObject(std::string_view source, ObjectModule& object);
+
+    // Short branch rewritten to reach another page: JCN with the condition
+    // inverted over a JUN, or ISZ to a JUN next to a JUN past both
+    struct Relaxation {
+        size_t line;
+        uint16_t address;   // Of the rewritten code
+        uint8_t opcode;     // JCN or ISZ
+        size_t addedBytes;  // Over the 2-byte form, NOPs keeping the skip in the page included
+    };
+
+    // On by default, else a short branch to another page is an error. Code in
+    // sections the linker places is left to its trampolines.
+    void setBranchRelaxation(bool enabled) { m_relaxBranches = enabled; }
+    // Of the last assemble(), in source order
+    const std::vector<Relaxation>& getRelaxations() const { return m_relaxations; }
+
+    // Instructions replaced by shorter or faster ones with the same effect
+    struct Optimization {
+        size_t line;          // Of the first instruction replaced
+        Peephole::Rule rule;
+        size_t bytesSaved;
+        size_t cyclesSaved;
+    };
+
+    // Off by default. Rewrites never cross a label, code reaching into the
+    // middle of a sequence by a numeric address or JIN must not be optimized.
+    // A JMS; BBL becomes a JUN only in flat output, once every return of the
+    // routine is checked to give the same value.
+    void setOptimization(bool enabled) { m_optimize = enabled; }
+    // Its rules, superoptimizer templates are loaded into it
+    Peephole& getPeephole() { return m_peephole; }
+    // Of the last assemble(), in source order
+    const std::vector<Optimization>& getOptimizations() const { return m_optimizations; }
+
+    enum class ListingKind { Code, Data, Fill };
+
+    // Bytes of flat output coming from a source line. Code rewritten by the
+    // optimizer is listed under the line of each new instruction, see
+    // Optimization; a relaxed branch stays one entry.
+    struct ListingEntry {
+        uint16_t address;
+        uint16_t size;
+        size_t line;
+        ListingKind kind;   // Instructions, .BYTE data or *= fill
+    };
+
+    struct ListedSymbol {
+        std::string name;
+        uint16_t value;
+        bool label;         // Else defined by name = value
+        size_t line;
+    };
+
+    // Of the last assemble(), in address order. Empty for objects.
+    const std::vector<ListingEntry>& getListing() const { return m_listing; }
+    // Of the last assemble(), in source order. Empty for objects.
+    const std::vector<ListedSymbol>& getSymbols() const { return m_symbols; }
+
+    // First problem found by the last assemble(), "line N: message"
+    const std::string& getError() const { return m_error; }
 private:
-    enum class InsType {
-        Simple,
-        Complex,
-        TwoByte
+    using Token = Tokenizer::Token;
+    using TokenType = Tokenizer::TokenType;
+    using FixupKind = RelocationKind;
+
+    struct Symbol {
+        uint16_t value;    // Address, or offset into a relocatable section
+        uint16_t section;  // ObjectModule::NO_SECTION when value is final
+        uint16_t index;    // Into the object symbols
+    };
+
+    struct Fixup {
+        uint16_t section;
+        size_t offset;            // Into the section code or output
+        std::string_view symbol;
+        uint16_t addend;
+        FixupKind kind;
+        size_t line;
+        size_t branch;            // Short branch number, NO_BRANCH for other operands
+    };
+
+    static constexpr size_t NO_BRANCH = ~size_t(0u);
+
+    // Instruction in the optimizer window
+    struct Emitted {
+        size_t offset;
+        size_t line;
+    };
+
+    // JMS; BBL rewritten to a JUN in this pass
+    struct TailCall {
+        size_t number;   // In source order, of every JMS; BBL found
+        size_t offset;   // Of the JUN
+        uint8_t value;   // Returned by the BBL
     };
 
-    struct MnemonicDesc {
-        uint8_t byte = 0;
-        InsType type = InsType::Simple;
+    struct Operand {
+        uint16_t value;           // Whole value, or the addend to symbol
+        std::string_view symbol;  // Forward reference or relocatable, empty when value is final
+        size_t line;
+        bool literal;             // Numbers only, no symbol
     };
 
-    bool trimComments(std::string& line);
-    bool trimWhiteSpaces(std::string& line);
-    bool checkForSymbols(std::string& line);
-    bool parseLine(const std::string& line, std::vector<uint8_t>& output);
-    uint16_t parseOperand(const std::string& token);
-    bool parseRegister(const std::string_view& str, uint16_t& value);
-    bool parseRegisterPair(const std::string_view& str, uint16_t& value);
-    bool isMnemonic(std::string& token, MnemonicDesc& desc);
+    static bool readSource(const char* filename, std::string& source, std::string& error);
+    bool run(std::string_view source, std::vector<uint8_t>& output, ObjectModule* object);
+    bool runPass(std::string_view source, std::vector<uint8_t>& output);
+    bool parseLine(bool& end);
+    bool parseInstruction(const Tokenizer::MnemonicDesc& desc);
+    bool emitRelaxedBranch(const Tokenizer::MnemonicDesc& desc, const Operand& first, const Operand& second);
+    void optimize(size_t offset, bool known, size_t line);
+    void checkTailCalls();
+    void list(size_t offset, size_t line, ListingKind kind);
+    size_t findOverflowLine() const;
+    void finishListing();
+    bool parseOperand(Operand& operand);
+    bool parseSection(size_t line);
+    bool parseGlobals();
+    bool expectLineEnd();
+    void startSection(std::string_view name, bool absolute, uint16_t origin);
+    bool defineSymbol(std::string_view name, uint16_t value, uint16_t section, size_t line);
+    bool place(const Operand& operand, FixupKind kind, size_t offset, size_t branch = NO_BRANCH);
+    bool patch(uint16_t value, const Fixup& fixup, std::vector<uint8_t>& code);
+    bool resolveFixups();
+    bool exportGlobals();
+    bool fail(size_t line, std::string_view message, std::string_view text = {});
+    void next() { m_token = m_tokenizer->getNext(); }
+    size_t getAddress() const { return m_base + m_code->size() - m_metalMaskLength; }
 
-    size_t m_address;
     size_t m_metalMaskLength;
-    std::unordered_map<std::string, uint16_t> m_symbolTable;
-    std::unordered_map<std::string, MnemonicDesc> m_mnemonics;
+    Tokenizer* m_tokenizer;  // Of the source being assembled
+    Token m_token;           // Current token
+    ObjectModule* m_object;  // Being built by assembleObject(), else null
+    std::vector<uint8_t>* m_code;  // Output, or code of the current section
+    uint16_t m_section;      // Current section of m_object
+    bool m_relocatable;      // Current section is placed by the linker
+    size_t m_base;           // Address of the first byte of m_code after the metal mask
+    std::unordered_map<std::string_view, Symbol> m_symbolTable;  // Views into the source
+    std::vector<Fixup> m_fixups;
+    std::vector<Token> m_globals;
+    bool m_relaxBranches;
+    size_t m_branchCount;         // Short branches parsed in this pass
+    std::vector<bool> m_relaxed;  // Per short branch, once relaxed it stays so
+    std::vector<size_t> m_crossing;  // Short branches found leaving their page in this pass
+    std::vector<Relaxation> m_relaxations;
+    bool m_optimize;
+    Peephole m_peephole;
+    std::vector<Peephole::Instruction> m_window;  // Emitted since the last label, at most WINDOW_SIZE
+    std::vector<Emitted> m_windowPlaces;          // Of the m_window instructions
+    size_t m_tailCallCount;       // JMS; BBL found in this pass
+    std::vector<bool> m_keptCalls;  // Per JMS; BBL, once found unsafe it stays a call
+    std::vector<size_t> m_unsafeCalls;  // Tail calls found unsafe in this pass
+    std::vector<TailCall> m_tailCalls;
+    std::vector<Optimization> m_optimizations;
+    std::vector<ListingEntry> m_listing;  // Addresses, sizes are filled in at the end of the pass
+    std::vector<ListedSymbol> m_symbols;
+    std::string m_error;
 };
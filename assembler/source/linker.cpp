@@ -0,0 +1,489 @@
+#include "assembler/source/linker.hpp"
+
+#include <algorithm>
+#include <fstream>
+#include <numeric>
+#include <sstream>
+
+void Linker::addModule(std::string name, ObjectModule module)
+{
+    m_modules.push_back({ std::move(name), std::move(module) });
+}
+
+bool Linker::addModule(const char* filename)
+{
+    ObjectModule module;
+    if (!module.load(filename)) {
+        m_error = std::string("cannot read object ") + filename;
+        return false;
+    }
+
+    addModule(filename, std::move(module));
+    return true;
+}
+
+void Linker::setBranchWeight(std::string symbol, uint64_t weight)
+{
+    m_branchWeights[std::move(symbol)] = weight;
+}
+
+bool Linker::loadProfile(const char* filename)
+{
+    std::ifstream file(filename);
+    if (!file.is_open()) {
+        m_error = std::string("cannot open ") + filename;
+        return false;
+    }
+
+    std::string line;
+    for (size_t number = 1u; std::getline(file, line); ++number) {
+        std::istringstream fields(line);
+        std::string symbol;
+        uint64_t weight;
+        if (!(fields >> symbol))
+            continue;
+        if (!(fields >> weight)) {
+            m_error = std::string(filename) + ": line " + std::to_string(number) + ": expected count";
+            return false;
+        }
+        setBranchWeight(std::move(symbol), weight);
+    }
+    return true;
+}
+
+void Linker::clear()
+{
+    m_modules.clear();
+    m_nodes.clear();
+    m_firstNode.clear();
+    m_branches.clear();
+    m_trampolines.clear();
+    m_placements.clear();
+    m_sectionAddresses.clear();
+    m_globals.clear();
+    m_branchWeights.clear();
+    m_report = PlacementReport{};
+    m_error.clear();
+}
+
+bool Linker::link(std::vector<uint8_t>& output)
+{
+    m_error.clear();
+    m_report = PlacementReport{};
+    if (!collectGlobals())
+        return false;
+    collectBranches();
+
+    // Module order alone only tells what grouping saved, it may not even fit
+    size_t baselineTrampolines = 0u;
+    uint64_t baselineCycles = 0u;
+    bool baseline = placeSections(false, baselineTrampolines, baselineCycles);
+
+    uint64_t cycles = 0u;
+    m_error.clear();
+    if (!placeSections(true, m_report.trampolines, cycles))
+        return false;
+
+    m_report.branches = m_branches.size();
+    m_report.baselineTrampolines = baseline ? baselineTrampolines : m_report.trampolines;
+    m_report.bytesSaved = static_cast<int64_t>(TRAMPOLINE_SIZE * m_report.baselineTrampolines) -
+                          static_cast<int64_t>(TRAMPOLINE_SIZE * m_report.trampolines);
+    m_report.cyclesSaved = baseline ? static_cast<int64_t>(baselineCycles) - static_cast<int64_t>(cycles) : 0;
+
+    // Metal mask header then the image up to its last used byte, gaps are zero
+    size_t end = 0u;
+    for (const Placement& placement : m_placements) {
+        size_t size = m_modules[placement.module].object.sections[placement.section].code.size();
+        end = std::max(end, placement.address + size + TRAMPOLINE_SIZE * placement.trampolines);
+    }
+
+    output.assign(METAL_MASK_LENGTH + end, 0u);
+    output[0] = 0xFE;
+    output[1] = 0xFF;
+
+    for (const Placement& placement : m_placements) {
+        const std::vector<uint8_t>& code = m_modules[placement.module].object.sections[placement.section].code;
+        auto at = output.begin() + METAL_MASK_LENGTH + placement.address;
+        at = std::copy(code.begin(), code.end(), at);
+        for (uint16_t target : m_trampolines[m_firstNode[placement.module] + placement.section]) {
+            *at++ = static_cast<uint8_t>(0x40u | (target >> 8));
+            *at++ = static_cast<uint8_t>(target & 0xFFu);
+        }
+    }
+
+    for (size_t module = 0u; module < m_modules.size(); ++module)
+        for (const ObjectModule::Relocation& relocation : m_modules[module].object.relocations)
+            if (!relocate(module, relocation, output))
+                return false;
+
+    return true;
+}
+
+bool Linker::collectGlobals()
+{
+    m_globals.clear();
+    for (size_t module = 0u; module < m_modules.size(); ++module) {
+        const std::vector<ObjectModule::Symbol>& symbols = m_modules[module].object.symbols;
+        for (size_t symbol = 0u; symbol < symbols.size(); ++symbol) {
+            if (!symbols[symbol].global || !symbols[symbol].defined)
+                continue;
+            if (!m_globals.emplace(symbols[symbol].name, GlobalSymbol{ module, symbol }).second)
+                return fail(module, 0u, "global symbol defined twice", symbols[symbol].name);
+        }
+    }
+    return true;
+}
+
+void Linker::collectBranches()
+{
+    m_nodes.clear();
+    m_firstNode.clear();
+    m_branches.clear();
+    for (size_t module = 0u; module < m_modules.size(); ++module) {
+        m_firstNode.push_back(m_nodes.size());
+        for (size_t section = 0u; section < m_modules[module].object.sections.size(); ++section)
+            m_nodes.push_back({ module, section });
+    }
+
+    // Undefined targets are left for relocate() to report
+    for (size_t module = 0u; module < m_modules.size(); ++module) {
+        const std::vector<ObjectModule::Relocation>& relocations = m_modules[module].object.relocations;
+        for (size_t i = 0u; i < relocations.size(); ++i) {
+            const ObjectModule::Relocation& relocation = relocations[i];
+            size_t targetModule = module;
+            const ObjectModule::Symbol* symbol = findSymbol(targetModule, relocation.symbol);
+            if (relocation.kind != RelocationKind::Branch || symbol == nullptr)
+                continue;
+
+            Branch branch{ module, i, m_firstNode[module] + relocation.section, NO_NODE,
+                           static_cast<uint16_t>(symbol->value + relocation.addend), 1u };
+            if (symbol->section != ObjectModule::NO_SECTION)
+                branch.to = m_firstNode[targetModule] + symbol->section;
+            if (branch.to == branch.from)
+                continue;
+
+            auto weight = m_branchWeights.find(m_modules[module].object.symbols[relocation.symbol].name);
+            if (weight != m_branchWeights.end())
+                branch.weight = weight->second;
+            m_branches.push_back(branch);
+        }
+    }
+}
+
+bool Linker::placeSections(bool group, size_t& trampolines, uint64_t& cycles)
+{
+    std::vector<std::vector<size_t>> groups;
+    if (group)
+        groups = groupSections();
+    else {
+        for (size_t node = 0u; node < m_nodes.size(); ++node)
+            groups.push_back({ node });
+    }
+
+    // Room for a trampoline to every target outside the group first, then only
+    // for those the placement needed, unless that moved sections so others do
+    std::vector<size_t> groupOf(m_nodes.size());
+    for (size_t i = 0u; i < groups.size(); ++i)
+        for (size_t node : groups[i])
+            groupOf[node] = i;
+    std::vector<size_t> reserved(m_nodes.size());
+    for (size_t node = 0u; node < m_nodes.size(); ++node)
+        reserved[node] = countTrampolines(node, groupOf);
+
+    if (!placeGroups(groups, reserved))
+        return false;
+    cycles = 0u;
+    m_trampolines = findTrampolines(cycles);
+
+    std::vector<size_t> needed(m_nodes.size());
+    for (size_t node = 0u; node < m_nodes.size(); ++node)
+        needed[node] = m_trampolines[node].size();
+    const std::vector<size_t>* room = &reserved;
+    if (needed != reserved) {
+        uint64_t tighterCycles = 0u;
+        bool fits = placeGroups(groups, needed);
+        std::vector<std::vector<uint16_t>> tighter = findTrampolines(tighterCycles);
+        for (size_t node = 0u; fits && node < m_nodes.size(); ++node)
+            fits = tighter[node].size() <= needed[node];
+
+        if (fits) {
+            m_trampolines = std::move(tighter);
+            cycles = tighterCycles;
+            room = &needed;
+        }
+        else {
+            placeGroups(groups, reserved);
+        }
+    }
+
+    // Branches left without room for their trampoline fail in relocate()
+    trampolines = 0u;
+    for (Placement& placement : m_placements) {
+        size_t node = m_firstNode[placement.module] + placement.section;
+        std::vector<uint16_t>& targets = m_trampolines[node];
+        targets.resize(std::min(targets.size(), (*room)[node]));
+        placement.trampolines = static_cast<uint16_t>(targets.size());
+        trampolines += targets.size();
+    }
+    return true;
+}
+
+std::vector<std::vector<size_t>> Linker::groupSections() const
+{
+    // Heaviest pairs first, each merge must leave the group one page long
+    // counting the trampolines it still needs
+    std::vector<size_t> groupOf(m_nodes.size());
+    std::iota(groupOf.begin(), groupOf.end(), 0u);
+
+    struct Edge {
+        size_t a, b;
+        uint64_t weight;
+    };
+    std::vector<Edge> edges;
+    for (const Branch& branch : m_branches) {
+        if (branch.to == NO_NODE || !canHaveTrampolines(branch.from) || !canHaveTrampolines(branch.to))
+            continue;
+        size_t a = std::min(branch.from, branch.to), b = std::max(branch.from, branch.to);
+        auto edge = std::find_if(edges.begin(), edges.end(), [a, b](const Edge& e) { return e.a == a && e.b == b; });
+        if (edge != edges.end())
+            edge->weight += branch.weight;
+        else
+            edges.push_back({ a, b, branch.weight });
+    }
+    std::stable_sort(edges.begin(), edges.end(), [](const Edge& x, const Edge& y) { return x.weight > y.weight; });
+
+    for (const Edge& edge : edges) {
+        size_t keep = groupOf[edge.a], merged = groupOf[edge.b];
+        if (keep == merged)
+            continue;
+
+        std::vector<size_t> candidate = groupOf;
+        std::replace(candidate.begin(), candidate.end(), merged, keep);
+        size_t size = 0u;
+        for (size_t node = 0u; node < m_nodes.size(); ++node) {
+            if (candidate[node] != keep)
+                continue;
+            size += m_modules[m_nodes[node].module].object.sections[m_nodes[node].section].code.size();
+            size += TRAMPOLINE_SIZE * countTrampolines(node, candidate);
+        }
+        if (size <= PAGE_SIZE)
+            groupOf = std::move(candidate);
+    }
+
+    // In the order of their first section, which keeps module order when nothing was grouped
+    std::vector<std::vector<size_t>> groups;
+    std::vector<size_t> index(m_nodes.size(), NO_NODE);
+    for (size_t node = 0u; node < m_nodes.size(); ++node) {
+        if (index[groupOf[node]] == NO_NODE) {
+            index[groupOf[node]] = groups.size();
+            groups.emplace_back();
+        }
+        groups[index[groupOf[node]]].push_back(node);
+    }
+    return groups;
+}
+
+size_t Linker::countTrampolines(size_t node, const std::vector<size_t>& groupOf) const
+{
+    if (!canHaveTrampolines(node))
+        return 0u;
+
+    // Distinct targets outside the group, by section and offset or by address
+    std::vector<std::pair<size_t, uint16_t>> targets;
+    for (const Branch& branch : m_branches) {
+        if (branch.from != node || (branch.to != NO_NODE && groupOf[branch.to] == groupOf[node]))
+            continue;
+        std::pair<size_t, uint16_t> target(branch.to, branch.target);
+        if (std::find(targets.begin(), targets.end(), target) == targets.end())
+            targets.push_back(target);
+    }
+    return targets.size();
+}
+
+bool Linker::placeGroups(const std::vector<std::vector<size_t>>& groups, const std::vector<size_t>& reserved)
+{
+    m_used.reset();
+    m_placements.clear();
+    m_sectionAddresses.assign(m_modules.size(), {});
+    for (size_t module = 0u; module < m_modules.size(); ++module)
+        m_sectionAddresses[module].assign(m_modules[module].object.sections.size(), 0u);
+
+    auto sizeOf = [this, &reserved](size_t node) {
+        return m_modules[m_nodes[node].module].object.sections[m_nodes[node].section].code.size() +
+               TRAMPOLINE_SIZE * reserved[node];
+    };
+
+    // Fixed sections claim their space before any other is placed
+    for (size_t node = 0u; node < m_nodes.size(); ++node) {
+        const ObjectModule::Section& section = m_modules[m_nodes[node].module].object.sections[m_nodes[node].section];
+        if (section.absolute && !reserve({ m_nodes[node].module, m_nodes[node].section, section.origin, 0u }, section.code.size()))
+            return false;
+    }
+
+    for (const std::vector<size_t>& group : groups) {
+        const Node& first = m_nodes[group.front()];
+        if (m_modules[first.module].object.sections[first.section].absolute)
+            continue;
+
+        size_t size = 0u;
+        for (size_t node : group)
+            size += sizeOf(node);
+
+        uint16_t address;
+        if (!findFreeAddress(size, address))
+            return fail(first.module, 0u, "no room for section", m_modules[first.module].object.sections[first.section].name);
+        for (size_t node : group) {
+            reserve({ m_nodes[node].module, m_nodes[node].section, address, 0u }, sizeOf(node));
+            address = static_cast<uint16_t>(address + sizeOf(node));
+        }
+    }
+
+    std::sort(m_placements.begin(), m_placements.end(), [](const Placement& a, const Placement& b) {
+        return a.module != b.module ? a.module < b.module : a.section < b.section;
+    });
+    return true;
+}
+
+std::vector<std::vector<uint16_t>> Linker::findTrampolines(uint64_t& cycles) const
+{
+    // Targets of short branches that left their page, for the current addresses
+    std::vector<std::vector<uint16_t>> trampolines(m_nodes.size());
+    for (const Branch& branch : m_branches) {
+        const ObjectModule::Relocation& relocation = m_modules[branch.module].object.relocations[branch.relocation];
+        uint16_t value;
+        if (!canHaveTrampolines(branch.from) || !resolveSymbol(branch.module, relocation.symbol, value))
+            continue;
+
+        value = static_cast<uint16_t>(value + relocation.addend);
+        size_t address = m_sectionAddresses[branch.module][relocation.section] + relocation.offset;
+        if ((value & 0x0F00u) == ((address + 1u) & 0x0F00u))
+            continue;
+
+        std::vector<uint16_t>& targets = trampolines[branch.from];
+        if (std::find(targets.begin(), targets.end(), value) == targets.end())
+            targets.push_back(value);
+        cycles += TRAMPOLINE_CYCLES * branch.weight;
+    }
+    return trampolines;
+}
+
+bool Linker::findFreeAddress(size_t size, uint16_t& address) const
+{
+    // Within one page when it fits in one, else from a page start
+    size_t step = size > PAGE_SIZE ? PAGE_SIZE : 1u;
+    for (size_t start = 0u; start + size <= MAX_PROGRAM_SIZE; start += step) {
+        if (size <= PAGE_SIZE && size > 0u && start / PAGE_SIZE != (start + size - 1u) / PAGE_SIZE)
+            continue;
+
+        size_t i = 0u;
+        while (i < size && !m_used[start + i])
+            ++i;
+        if (i == size) {
+            address = static_cast<uint16_t>(start);
+            return true;
+        }
+    }
+    return false;
+}
+
+bool Linker::reserve(const Placement& placement, size_t size)
+{
+    const ObjectModule::Section& section = m_modules[placement.module].object.sections[placement.section];
+    if (placement.address + size > MAX_PROGRAM_SIZE)
+        return fail(placement.module, 0u, "section does not fit in 4 KiB", section.name);
+    for (size_t i = 0u; i < size; ++i) {
+        if (m_used[placement.address + i])
+            return fail(placement.module, 0u, "section overlaps another", section.name);
+        m_used.set(placement.address + i);
+    }
+
+    m_placements.push_back(placement);
+    m_sectionAddresses[placement.module][placement.section] = placement.address;
+    return true;
+}
+
+bool Linker::canHaveTrampolines(size_t node) const
+{
+    // Only a placed section within one page has room right after it on the same page
+    const ObjectModule::Section& section = m_modules[m_nodes[node].module].object.sections[m_nodes[node].section];
+    return !section.absolute && section.code.size() <= PAGE_SIZE;
+}
+
+const ObjectModule::Symbol* Linker::findSymbol(size_t& module, size_t symbol) const
+{
+    const ObjectModule::Symbol* found = &m_modules[module].object.symbols[symbol];
+    if (found->defined)
+        return found;
+
+    auto global = m_globals.find(found->name);
+    if (global == m_globals.end())
+        return nullptr;
+    module = global->second.module;
+    return &m_modules[module].object.symbols[global->second.symbol];
+}
+
+bool Linker::resolveSymbol(size_t module, size_t symbol, uint16_t& value) const
+{
+    const ObjectModule::Symbol* found = findSymbol(module, symbol);
+    if (found == nullptr)
+        return false;
+
+    value = found->value;
+    if (found->section != ObjectModule::NO_SECTION)
+        value = static_cast<uint16_t>(value + m_sectionAddresses[module][found->section]);
+    return true;
+}
+
+bool Linker::relocate(size_t module, const ObjectModule::Relocation& relocation, std::vector<uint8_t>& output)
+{
+    const std::string& name = m_modules[module].object.symbols[relocation.symbol].name;
+    uint16_t value;
+    if (!resolveSymbol(module, relocation.symbol, value))
+        return fail(module, relocation.line, "undefined symbol", name);
+    value = static_cast<uint16_t>(value + relocation.addend);
+
+    uint16_t sectionAddress = m_sectionAddresses[module][relocation.section];
+    size_t address = sectionAddress + relocation.offset;
+    uint8_t* code = output.data() + METAL_MASK_LENGTH + address;
+    switch (relocation.kind) {
+    case RelocationKind::Nibble:
+    case RelocationKind::InvertedNibble:
+        if (value > 0x0Fu)
+            return fail(module, relocation.line, "operand does not fit in 4 bits", name);
+        *code |= static_cast<uint8_t>(relocation.kind == RelocationKind::InvertedNibble ? value ^ 0x08u : value);
+        break;
+    case RelocationKind::Branch:
+        // PC is past the operand when the jump is taken
+        if ((value & 0x0F00u) != ((address + 1u) & 0x0F00u)) {
+            const std::vector<uint16_t>& targets = m_trampolines[m_firstNode[module] + relocation.section];
+            auto trampoline = std::find(targets.begin(), targets.end(), value);
+            size_t size = m_modules[module].object.sections[relocation.section].code.size();
+            uint16_t jump = static_cast<uint16_t>(sectionAddress + size + TRAMPOLINE_SIZE * (trampoline - targets.begin()));
+            if (trampoline == targets.end() || (jump & 0x0F00u) != ((address + 1u) & 0x0F00u))
+                return fail(module, relocation.line, "short branch leaves its page", name);
+            value = jump;
+        }
+        [[fallthrough]];
+    case RelocationKind::Byte:
+        *code = static_cast<uint8_t>(value & 0xFFu);
+        break;
+    case RelocationKind::Address:
+        if (value >= MAX_PROGRAM_SIZE)
+            return fail(module, relocation.line, "address out of range", name);
+        code[0] |= static_cast<uint8_t>(value >> 8);
+        code[1] = static_cast<uint8_t>(value & 0xFFu);
+        break;
+    }
+    return true;
+}
+
+bool Linker::fail(size_t module, size_t line, std::string_view message, std::string_view text)
+{
+    m_error = m_modules[module].name + ": ";
+    if (line > 0u)
+        m_error += "line " + std::to_string(line) + ": ";
+    m_error += std::string(message);
+    if (!text.empty())
+        m_error += " '" + std::string(text) + "'";
+    return false;
+}
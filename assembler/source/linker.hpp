@@ -0,0 +1,117 @@
+#pragma once
+#include "assembler/source/object.hpp"
+
+#include <bitset>
+#include <cstdint>
+#include <string>
+#include <string_view>
+#include <unordered_map>
+#include <vector>
+
+// Places the sections of relocatable objects into ROM and resolves their
+// relocations into one program image, laid out like Assembler::assemble output.
+//
+// Absolute sections go to their origin. JCN and ISZ only reach their own
+// 256-byte page (JMS and JUN reach all of ROM), so the other sections are
+// grouped along the short branches between them, heaviest first, as long as
+// a group fits in one page. Groups are placed in module order at the lowest
+// free address where they do not cross a page, or from the start of a free
+// run of pages when a section is longer than one page. A short branch whose
+// target still lands on another page goes through a JUN trampoline placed
+// after the branching section.
+class Linker
+{
+public:
+    static constexpr size_t MAX_PROGRAM_SIZE = 4096u;
+    static constexpr size_t PAGE_SIZE = 256u;
+    static constexpr size_t METAL_MASK_LENGTH = 2u;
+    static constexpr size_t TRAMPOLINE_SIZE = 2u;     // JUN
+    static constexpr uint64_t TRAMPOLINE_CYCLES = 2u;  // Added to every branch taken through one
+
+    struct Placement {
+        size_t module;
+        size_t section;
+        uint16_t address;
+        uint16_t trampolines;  // JUNs right after the section code
+    };
+
+    // Of the last link(), against placing every section alone in module order
+    struct PlacementReport {
+        size_t branches;             // Short branches between sections
+        size_t trampolines;
+        size_t baselineTrampolines;
+        int64_t bytesSaved;
+        int64_t cyclesSaved;         // Weighted by setBranchWeight(), else each branch taken once
+    };
+
+    void addModule(std::string name, ObjectModule module);
+    bool addModule(const char* filename);  // Named after the file
+    // Times branches to symbol are taken, from a profile. Unprofiled branches weigh 1.
+    void setBranchWeight(std::string symbol, uint64_t weight);
+    bool loadProfile(const char* filename);  // "symbol count" per line
+    void clear();
+
+    bool link(std::vector<uint8_t>& output);
+
+    // Of the last link(), in module and section order
+    const std::vector<Placement>& getPlacements() const { return m_placements; }
+    const PlacementReport& getReport() const { return m_report; }
+    // First problem found by the last link() or addModule(), "module: line N: message"
+    const std::string& getError() const { return m_error; }
+private:
+    static constexpr size_t NO_NODE = ~size_t(0u);
+
+    struct Module {
+        std::string name;
+        ObjectModule object;
+    };
+
+    struct GlobalSymbol {
+        size_t module;
+        size_t symbol;
+    };
+
+    // Every section is a node, numbered in module and section order
+    struct Node {
+        size_t module;
+        size_t section;
+    };
+
+    // Short branch from one section into another
+    struct Branch {
+        size_t module;
+        size_t relocation;
+        size_t from;       // Node
+        size_t to;         // Node, NO_NODE when the target address is fixed
+        uint16_t target;   // Offset into to, or the address
+        uint64_t weight;
+    };
+
+    bool collectGlobals();
+    void collectBranches();
+    bool placeSections(bool group, size_t& trampolines, uint64_t& cycles);
+    std::vector<std::vector<size_t>> groupSections() const;
+    size_t countTrampolines(size_t node, const std::vector<size_t>& groupOf) const;
+    bool placeGroups(const std::vector<std::vector<size_t>>& groups, const std::vector<size_t>& reserved);
+    std::vector<std::vector<uint16_t>> findTrampolines(uint64_t& cycles) const;
+    bool findFreeAddress(size_t size, uint16_t& address) const;
+    bool reserve(const Placement& placement, size_t size);
+    bool canHaveTrampolines(size_t node) const;
+    const ObjectModule::Symbol* findSymbol(size_t& module, size_t symbol) const;
+    bool resolveSymbol(size_t module, size_t symbol, uint16_t& value) const;
+    bool relocate(size_t module, const ObjectModule::Relocation& relocation, std::vector<uint8_t>& output);
+    bool fail(size_t module, size_t line, std::string_view message, std::string_view text = {});
+
+    std::vector<Module> m_modules;
+    std::vector<Node> m_nodes;
+    std::vector<size_t> m_firstNode;  // Per module
+    std::vector<Branch> m_branches;
+    std::vector<std::vector<uint16_t>> m_trampolines;  // Targets per node
+    std::vector<Placement> m_placements;
+    std::vector<std::vector<uint16_t>> m_sectionAddresses;  // Per module and section
+    std::unordered_map<std::string_view, GlobalSymbol> m_globals;  // Views into m_modules
+    std::unordered_map<std::string, uint64_t> m_branchWeights;
+    std::bitset<MAX_PROGRAM_SIZE> m_used;
+    PlacementReport m_report{};
+    std::string m_error;
+};
@@ -0,0 +1,175 @@
+#include "assembler/source/listing.hpp"
+
+#include "shared/source/assembly.hpp"
+
+#include <algorithm>
+#include <iomanip>
+#include <string>
+
+namespace {
+
+constexpr size_t METAL_MASK_LENGTH = 2u;
+constexpr size_t PAGE_SIZE = 256u;
+
+std::string hex(unsigned value, size_t digits)
+{
+    static const char DIGITS[] = "0123456789ABCDEF";
+    std::string text(digits, '0');
+    for (size_t i = digits; i-- > 0u; value >>= 4)
+        text[i] = DIGITS[value & 0x0Fu];
+    return text;
+}
+
+std::vector<std::string_view> splitLines(std::string_view source)
+{
+    std::vector<std::string_view> lines;
+    while (!source.empty()) {
+        size_t end = source.find('\n');
+        std::string_view line = source.substr(0u, end);
+        if (!line.empty() && line.back() == '\r')
+            line.remove_suffix(1u);
+        lines.push_back(line);
+        if (end == std::string_view::npos)
+            break;
+        source.remove_prefix(end + 1u);
+    }
+    return lines;
+}
+
+bool endsBlock(uint8_t opcode)
+{
+    switch (opcode) {
+    case +AsmIns::JUN:
+    case +AsmIns::JCN:
+    case +AsmIns::ISZ:
+    case +AsmIns::JIN:
+    case +AsmIns::BBL:
+    case +AsmIns::BBS:
+    case +AsmIns::HLT:
+        return true;
+    default:
+        return false;
+    }
+}
+
+// Addresses where a basic block starts
+std::vector<bool> findLeaders(const uint8_t* image, size_t size, const Assembler& assembler)
+{
+    std::vector<bool> leaders(size + 1u, false);
+    auto mark = [&](size_t address) {
+        if (address <= size)
+            leaders[address] = true;
+    };
+
+    for (const Assembler::ListedSymbol& symbol : assembler.getSymbols())
+        if (symbol.label)
+            mark(symbol.value);
+    for (const Assembler::ListingEntry& entry : assembler.getListing()) {
+        size_t end = size_t(entry.address) + entry.size;
+        if (entry.kind != Assembler::ListingKind::Code) {
+            mark(end);
+            continue;
+        }
+
+        for (size_t address = entry.address; address < end;) {
+            uint8_t byte = image[address];
+            uint8_t opcode = getOpcodeFromByte(byte);
+            bool twoByte = findAsmInstruction(opcode)->type == AsmInsType::TwoByte;
+            uint8_t operand = twoByte && address + 1u < size ? image[address + 1u] : 0u;
+            size_t next = address + (twoByte ? 2u : 1u);
+            if (opcode == +AsmIns::JUN || opcode == +AsmIns::JMS)
+                mark(((byte & 0x0Fu) << 8) | operand);
+            else if (opcode == +AsmIns::JCN || opcode == +AsmIns::ISZ)
+                mark(((next & 0x0FFFu) & ~(PAGE_SIZE - 1u)) | operand);
+            if (endsBlock(opcode))
+                mark(next);
+            address = next;
+        }
+    }
+    return leaders;
+}
+
+void writeRow(std::ostream& out, const std::string& address, const std::string& bytes, const std::string& cycles,
+              const std::string& total, size_t line, std::string_view text)
+{
+    out << std::left << std::setw(9) << address << std::setw(7) << bytes << std::right << std::setw(3) << cycles
+        << std::setw(7) << total;
+    if (line != 0u)
+        out << std::setw(7) << line << "  " << text;
+    out << '\n';
+}
+
+} // namespace
+
+void writeListing(std::ostream& out, std::string_view source, const std::vector<uint8_t>& output,
+                  const Assembler& assembler)
+{
+    const uint8_t* image = output.data() + METAL_MASK_LENGTH;
+    size_t size = output.size() - METAL_MASK_LENGTH;
+    std::vector<std::string_view> lines = splitLines(source);
+    std::vector<bool> leaders = findLeaders(image, size, assembler);
+    auto textOf = [&](size_t line) { return line - 1u < lines.size() ? lines[line - 1u] : std::string_view(); };
+
+    out << std::setfill(' ');
+    writeRow(out, "ADDR", "BYTES", "CYC", "BLOCK", 0u, {});
+    size_t listed = 0u;  // Source lines up to here are written
+    auto listUpTo = [&](size_t line) {
+        for (; listed + 1u < line && listed < lines.size(); ++listed)
+            writeRow(out, {}, {}, {}, {}, listed + 1u, lines[listed]);
+    };
+
+    size_t page = ~size_t(0u);
+    auto markPage = [&](size_t address) {
+        if (address / PAGE_SIZE == page)
+            return;
+        page = address / PAGE_SIZE;
+        out << "; page $" << hex(static_cast<unsigned>(page * PAGE_SIZE), 3u) << '\n';
+    };
+
+    uint64_t total = 0u;
+    for (const Assembler::ListingEntry& entry : assembler.getListing()) {
+        listUpTo(entry.line);
+        listed = std::max(listed, entry.line);
+        size_t line = entry.line;
+        size_t end = size_t(entry.address) + entry.size;
+
+        if (entry.kind == Assembler::ListingKind::Fill) {
+            writeRow(out, hex(entry.address, 3u) + '-' + hex(static_cast<unsigned>(end - 1u), 3u), {}, {}, {}, line,
+                     textOf(line));
+            total = 0u;
+            continue;
+        }
+
+        for (size_t address = entry.address; address < end; line = 0u) {
+            markPage(address);
+            if (entry.kind == Assembler::ListingKind::Data) {
+                writeRow(out, hex(static_cast<unsigned>(address), 3u), hex(image[address], 2u), {}, {}, line,
+                         textOf(line));
+                total = 0u;
+                ++address;
+                continue;
+            }
+
+            const AsmInsDesc* desc = findAsmInstruction(getOpcodeFromByte(image[address]));
+            size_t length = desc->type == AsmInsType::TwoByte ? 2u : 1u;
+            std::string bytes = hex(image[address], 2u);
+            if (length == 2u)
+                bytes += ' ' + hex(image[address + 1u], 2u);
+            if (leaders[address])
+                total = 0u;
+            total += desc->cycles;
+            writeRow(out, hex(static_cast<unsigned>(address), 3u), bytes, std::to_string(desc->cycles),
+                     std::to_string(total), line, textOf(line));
+            address += length;
+        }
+    }
+    listUpTo(lines.size() + 1u);
+
+    std::vector<Assembler::ListedSymbol> symbols = assembler.getSymbols();
+    std::stable_sort(symbols.begin(), symbols.end(),
+                     [](const Assembler::ListedSymbol& a, const Assembler::ListedSymbol& b) { return a.value < b.value; });
+    out << "; symbols\n";
+    for (const Assembler::ListedSymbol& symbol : symbols)
+        out << '$' << hex(symbol.value, symbol.value > 0x0FFFu ? 4u : 3u) << (symbol.label ? " label    " : " constant ")
+            << symbol.name << '\n';
+}
@@ -0,0 +1,22 @@
+#pragma once
+#include "assembler/source/assembler.hpp"
+
+#include <cstdint>
+#include <ostream>
+#include <string_view>
+#include <vector>
+
+// Listing of a flat Assembler::assemble(): every source line with the
+// address, bytes and cycles of its code, then the symbol map. output is the
+// program as assemble() left it, with the metal mask header.
+//
+// Cycles add up within a basic block, so the last instruction of a block
+// shows what running all of it takes. A block starts at a label, a JUN, JMS,
+// JCN or ISZ target, after data and after a JUN, JCN, ISZ, JIN, BBL, BBS or
+// HLT. A JMS stays in its block, the callee's cycles are not counted. The
+// first code of each 256-byte page, the reach of JCN and ISZ, is marked.
+//
+// The symbol map lists labels and constants by value, "$ADR label NAME", for
+// tools that need to tell which routine an address is in.
+void writeListing(std::ostream& out, std::string_view source, const std::vector<uint8_t>& output,
+                  const Assembler& assembler);
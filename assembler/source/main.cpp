@@ -1,8 +1,12 @@
 #include "assembler/source/assembler.hpp"
+#include "assembler/source/linker.hpp"
+#include "assembler/source/listing.hpp"
 
 #include <cstring>
+#include <iomanip>
 #include <iostream>
 #include <fstream>
+#include <sstream>
 
 const char* helpMessage =
 R"=(Kostu96 Intel 4004 and 4040 assembler.
@@ -10,14 +14,28 @@ R"=(Kostu96 Intel 4004 and 4040 assembler.
 Usage:
 assembler [-h|--help]
 or
-assembler <command> [-device <device>] <input_file> <output_file>
+assembler <command> [-device <device>] [-O] [-rewrites <file>] [-listing <file>] <input_file> <output_file>
+or
+assembler link [-profile <profile_file>] <output_file> <object_file>...
 
 Commands:
 asm    - assembles <file> into <device> binary code.
+obj    - assembles <file> into a relocatable object for link.
+link   - places and links objects into one binary.
 disasm - disassembles <file>.
 
--device - can be either i4004 or i4040.
-          Default value is i4040.
+-device  - can be either i4004 or i4040.
+           Default value is i4040.
+-O       - replaces instruction sequences by shorter or faster ones with
+           the same effect, asm and obj only. Code reached by a numeric
+           address or JIN inside such a sequence must not use it.
+-rewrites - adds the rewrites of a superoptimizer database to -O and
+           turns it on.
+-listing - writes address, bytes, source line and cycles of every
+           instruction to <file>, asm only. Cycles add up per basic
+           block. Pages are marked and the symbol map follows.
+-profile - "symbol count" lines, how often branches to each symbol are
+           taken. Sections are grouped into pages by the heaviest branches.
 )=";
 
 const char* errorMessage = "Insufficient number of arguments. Use -h or --help to see usage hints.\n";
@@ -26,23 +44,64 @@ int main(int argc, const char* argv[])
 {
     int retVal = 0;
     Assembler assembler;
-    std::string inputFile, outputFile;
+    std::string inputFile, outputFile, listingFile;
     bool i4004ModeEnabled = false;
     bool assemble = true;
+    bool object = false;
+    bool link = false;
+    Linker linker;
     std::vector<uint8_t> bytecode;
     std::vector<std::string> disassembly;
 
     if (argc > 1 && (strcmp(argv[1], "-h") == 0 || strcmp(argv[1], "--help") == 0))
         std::cout << helpMessage;
-    else if (argc > 3 && (strcmp(argv[1], "asm") == 0)) {
-        if (argc > 5 && strcmp(argv[2], "-device") == 0) {
-            i4004ModeEnabled = strcmp(argv[3], "i4004") == 0;
-            inputFile = argv[4];
-            outputFile = argv[5];
+    else if (argc > 3 && (strcmp(argv[1], "asm") == 0 || strcmp(argv[1], "obj") == 0)) {
+        object = strcmp(argv[1], "obj") == 0;
+        int first = 2;
+        while (argc > first + 2) {
+            if (argc > first + 3 && strcmp(argv[first], "-device") == 0) {
+                i4004ModeEnabled = strcmp(argv[first + 1], "i4004") == 0;
+                first += 2;
+            }
+            else if (strcmp(argv[first], "-O") == 0) {
+                assembler.setOptimization(true);
+                ++first;
+            }
+            else if (argc > first + 3 && strcmp(argv[first], "-rewrites") == 0) {
+                std::string error;
+                if (!assembler.getPeephole().loadTemplates(argv[first + 1], error)) {
+                    std::cerr << error << '\n';
+                    retVal = -1;
+                }
+                assembler.setOptimization(true);
+                first += 2;
+            }
+            else if (argc > first + 3 && strcmp(argv[first], "-listing") == 0) {
+                listingFile = argv[first + 1];
+                first += 2;
+            }
+            else
+                break;
         }
-        else {
-            inputFile = argv[2];
-            outputFile = argv[3];
+        inputFile = argv[first];
+        outputFile = argv[first + 1];
+    }
+    else if (argc > 3 && (strcmp(argv[1], "link") == 0)) {
+        link = true;
+        int first = 2;
+        if (argc > 5 && strcmp(argv[2], "-profile") == 0) {
+            if (!linker.loadProfile(argv[3])) {
+                std::cerr << linker.getError() << '\n';
+                retVal = -1;
+            }
+            first = 4;
+        }
+        outputFile = argv[first];
+        for (int i = first + 1; i < argc && retVal == 0; ++i) {
+            if (!linker.addModule(argv[i])) {
+                std::cerr << linker.getError() << '\n';
+                retVal = -1;
+            }
         }
     }
     else if (argc > 3 && (strcmp(argv[1], "disasm") == 0)) {
@@ -57,8 +116,51 @@ int main(int argc, const char* argv[])
 
     bool success = false;
     if (retVal == 0) {
-        if (assemble) {
+        if (object) {
+            ObjectModule module;
+            success = assembler.assembleObject(inputFile.c_str(), module);
+            if (!success)
+                std::cerr << inputFile << ": " << assembler.getError() << '\n';
+            else if (!module.save(outputFile.c_str())) {
+                std::cerr << outputFile << ": cannot write object\n";
+                success = false;
+            }
+            outputFile.clear();
+        }
+        else if (link) {
+            success = linker.link(bytecode);
+            if (!success)
+                std::cerr << linker.getError() << '\n';
+            else {
+                const Linker::PlacementReport& report = linker.getReport();
+                std::cout << report.branches << " short branches between sections, " << report.trampolines
+                          << " trampolines (" << report.baselineTrampolines << " in module order), saved "
+                          << report.bytesSaved << " bytes and " << report.cyclesSaved << " cycles\n";
+            }
+        }
+        else if (assemble) {
             success = assembler.assemble(inputFile.c_str(), bytecode, i4004ModeEnabled);
+            if (!success)
+                std::cerr << inputFile << ": " << assembler.getError() << '\n';
+            for (const Assembler::Relaxation& relaxation : assembler.getRelaxations())
+                std::cout << inputFile << ": line " << relaxation.line << ": "
+                          << (relaxation.opcode == +AsmIns::JCN ? "JCN" : "ISZ") << " at $" << std::hex
+                          << std::uppercase << std::setw(3) << std::setfill('0') << relaxation.address << std::dec
+                          << " relaxed to reach another page, " << relaxation.addedBytes << " more bytes\n";
+            for (const Assembler::Optimization& optimization : assembler.getOptimizations())
+                std::cout << inputFile << ": line " << optimization.line << ": " << Peephole::getRuleName(optimization.rule)
+                          << ", saved " << optimization.bytesSaved << " bytes and " << optimization.cyclesSaved << " cycles\n";
+            if (success && !listingFile.empty()) {
+                std::ifstream fin(inputFile, std::ios_base::binary);
+                std::stringstream source;
+                source << fin.rdbuf();
+                std::ofstream fout(listingFile);
+                writeListing(fout, source.str(), bytecode, assembler);
+                if (!fout) {
+                    std::cerr << listingFile << ": cannot write listing\n";
+                    success = false;
+                }
+            }
         }
         else {
             std::ifstream fin(inputFile, std::ios_base::binary);
@@ -73,7 +175,7 @@ int main(int argc, const char* argv[])
     if (!success)
         retVal = -1;
 
-    if (retVal == 0) {
+    if (retVal == 0 && !outputFile.empty()) {
         if (assemble) {
             std::ofstream fout(outputFile, std::ios_base::binary);
             for (auto byte : bytecode)
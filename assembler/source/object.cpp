@@ -0,0 +1,189 @@
+#include "assembler/source/object.hpp"
+
+#include <algorithm>
+#include <fstream>
+#include <iterator>
+
+namespace {
+
+// "K4O" and the format version, all numbers are little-endian
+constexpr uint8_t OBJECT_MAGIC[] = { 'K', '4', 'O', 1u };
+
+void putWord(std::vector<uint8_t>& output, uint32_t value, size_t bytes)
+{
+    for (size_t i = 0u; i < bytes; ++i)
+        output.push_back(static_cast<uint8_t>(value >> (8u * i)));
+}
+
+bool putString(std::vector<uint8_t>& output, const std::string& text)
+{
+    if (text.size() > 0xFFu)
+        return false;
+    output.push_back(static_cast<uint8_t>(text.size()));
+    output.insert(output.end(), text.begin(), text.end());
+    return true;
+}
+
+class ObjectReader
+{
+public:
+    ObjectReader(const uint8_t* data, size_t size) :
+        m_data(data), m_size(size), m_pos(0u), m_ok(true) {}
+
+    bool isOk() const { return m_ok; }
+    bool atEnd() const { return m_pos == m_size; }
+
+    uint32_t word(size_t bytes) {
+        if (!take(bytes))
+            return 0u;
+        uint32_t value = 0u;
+        for (size_t i = 0u; i < bytes; ++i)
+            value |= static_cast<uint32_t>(m_data[m_pos - bytes + i]) << (8u * i);
+        return value;
+    }
+
+    void bytes(uint8_t* out, size_t count) {
+        if (take(count))
+            std::copy(m_data + m_pos - count, m_data + m_pos, out);
+    }
+
+    std::string string() {
+        size_t length = word(1u);
+        if (!take(length))
+            return {};
+        return std::string(reinterpret_cast<const char*>(m_data + m_pos - length), length);
+    }
+private:
+    bool take(size_t count) {
+        if (!m_ok || m_size - m_pos < count)
+            return m_ok = false;
+        m_pos += count;
+        return true;
+    }
+
+    const uint8_t* m_data;
+    size_t m_size;
+    size_t m_pos;
+    bool m_ok;
+};
+
+} // namespace
+
+void ObjectModule::clear()
+{
+    sections.clear();
+    symbols.clear();
+    relocations.clear();
+}
+
+bool ObjectModule::write(std::vector<uint8_t>& output) const
+{
+    // Assigned rather than inserted into the cleared vector, which GCC 12 flags in release builds
+    output.assign(std::begin(OBJECT_MAGIC), std::end(OBJECT_MAGIC));
+
+    putWord(output, static_cast<uint32_t>(sections.size()), 2u);
+    for (const Section& section : sections) {
+        if (!putString(output, section.name))
+            return false;
+        output.push_back(section.absolute ? 1u : 0u);
+        putWord(output, section.origin, 2u);
+        putWord(output, static_cast<uint32_t>(section.code.size()), 2u);
+        output.insert(output.end(), section.code.begin(), section.code.end());
+    }
+
+    putWord(output, static_cast<uint32_t>(symbols.size()), 2u);
+    for (const Symbol& symbol : symbols) {
+        if (!putString(output, symbol.name))
+            return false;
+        putWord(output, symbol.section, 2u);
+        putWord(output, symbol.value, 2u);
+        output.push_back(static_cast<uint8_t>((symbol.global ? 1u : 0u) | (symbol.defined ? 2u : 0u)));
+    }
+
+    putWord(output, static_cast<uint32_t>(relocations.size()), 2u);
+    for (const Relocation& relocation : relocations) {
+        putWord(output, relocation.section, 2u);
+        putWord(output, relocation.offset, 2u);
+        putWord(output, relocation.symbol, 2u);
+        putWord(output, relocation.addend, 2u);
+        output.push_back(static_cast<uint8_t>(relocation.kind));
+        putWord(output, relocation.line, 4u);
+    }
+
+    return true;
+}
+
+bool ObjectModule::read(const uint8_t* data, size_t size)
+{
+    clear();
+    ObjectReader reader(data, size);
+    uint8_t magic[sizeof(OBJECT_MAGIC)] = {};
+    reader.bytes(magic, sizeof(magic));
+    if (!std::equal(std::begin(magic), std::end(magic), std::begin(OBJECT_MAGIC)))
+        return false;
+
+    sections.resize(reader.word(2u));
+    for (Section& section : sections) {
+        section.name = reader.string();
+        section.absolute = reader.word(1u) != 0u;
+        section.origin = static_cast<uint16_t>(reader.word(2u));
+        section.code.resize(reader.word(2u));
+        reader.bytes(section.code.data(), section.code.size());
+        if (!reader.isOk())
+            break;
+    }
+
+    symbols.resize(reader.word(2u));
+    for (Symbol& symbol : symbols) {
+        symbol.name = reader.string();
+        symbol.section = static_cast<uint16_t>(reader.word(2u));
+        symbol.value = static_cast<uint16_t>(reader.word(2u));
+        uint32_t flags = reader.word(1u);
+        symbol.global = (flags & 1u) != 0u;
+        symbol.defined = (flags & 2u) != 0u;
+        if (symbol.section != NO_SECTION && symbol.section >= sections.size())
+            return false;
+    }
+
+    relocations.resize(reader.word(2u));
+    for (Relocation& relocation : relocations) {
+        relocation.section = static_cast<uint16_t>(reader.word(2u));
+        relocation.offset = static_cast<uint16_t>(reader.word(2u));
+        relocation.symbol = static_cast<uint16_t>(reader.word(2u));
+        relocation.addend = static_cast<uint16_t>(reader.word(2u));
+        uint32_t kind = reader.word(1u);
+        relocation.kind = static_cast<RelocationKind>(kind);
+        relocation.line = reader.word(4u);
+        if (!reader.isOk())
+            break;
+
+        size_t length = relocation.kind == RelocationKind::Address ? 2u : 1u;
+        if (kind > static_cast<uint32_t>(RelocationKind::InvertedNibble) ||
+            relocation.section >= sections.size() || relocation.symbol >= symbols.size() ||
+            relocation.offset + length > sections[relocation.section].code.size())
+            return false;
+    }
+
+    return reader.isOk() && reader.atEnd();
+}
+
+bool ObjectModule::save(const char* filename) const
+{
+    std::vector<uint8_t> data;
+    if (!write(data))
+        return false;
+
+    std::ofstream file(filename, std::ios_base::binary);
+    file.write(reinterpret_cast<const char*>(data.data()), static_cast<std::streamsize>(data.size()));
+    return file.good();
+}
+
+bool ObjectModule::load(const char* filename)
+{
+    std::ifstream file(filename, std::ios_base::binary);
+    if (!file.is_open())
+        return false;
+
+    std::vector<uint8_t> data((std::istreambuf_iterator<char>(file)), std::istreambuf_iterator<char>());
+    return read(data.data(), data.size());
+}
@@ -0,0 +1,55 @@
+#pragma once
+#include <cstdint>
+#include <string>
+#include <vector>
+
+// How a value is stored into code, shared by assembler fixups and object relocations
+enum class RelocationKind : uint8_t {
+    Nibble,          // Low 4 bits of the byte, 0-15
+    Byte,            // Whole byte, low 8 bits of the value
+    Branch,          // Low 8 bits of a JCN/ISZ target, which must be in the page after the instruction
+    Address,         // Low 4 bits of the byte get bits 8-11, the next byte bits 0-7
+    InvertedNibble,  // Like Nibble with bit 3 flipped, the condition of a relaxed JCN
+};
+
+// Relocatable object of one source module, written by Assembler::assembleObject
+// and placed into ROM by the Linker
+struct ObjectModule {
+    static constexpr uint16_t NO_SECTION = 0xFFFFu;  // Symbol is an absolute value or external
+
+    struct Section {
+        std::string name;
+        bool absolute;       // Must be placed at origin, else the linker picks the address
+        uint16_t origin;
+        std::vector<uint8_t> code;
+    };
+
+    struct Symbol {
+        std::string name;
+        uint16_t section;    // Value is an offset into this section unless NO_SECTION
+        uint16_t value;
+        bool global;         // Visible to other modules
+        bool defined;        // False for references to another module's global
+    };
+
+    struct Relocation {
+        uint16_t section;
+        uint16_t offset;     // Into the section code
+        uint16_t symbol;     // Index into symbols
+        uint16_t addend;
+        RelocationKind kind;
+        uint32_t line;       // Of the source, for errors
+    };
+
+    std::vector<Section> sections;
+    std::vector<Symbol> symbols;
+    std::vector<Relocation> relocations;
+
+    void clear();
+
+    // Binary form of an object file, read() checks every index it loads
+    bool write(std::vector<uint8_t>& output) const;
+    bool read(const uint8_t* data, size_t size);
+    bool save(const char* filename) const;
+    bool load(const char* filename);
+};
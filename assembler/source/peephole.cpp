@@ -0,0 +1,437 @@
+#include "assembler/source/peephole.hpp"
+
+#include "shared/source/assembly.hpp"
+
+#include <algorithm>
+#include <bitset>
+#include <fstream>
+#include <initializer_list>
+#include <sstream>
+
+namespace {
+
+uint8_t opcodeOf(const Peephole::Instruction& ins)
+{
+    return getOpcodeFromByte(ins.bytes[0]);
+}
+
+uint8_t operandOf(const Peephole::Instruction& ins)
+{
+    return ins.bytes[0] & 0x0Fu;
+}
+
+size_t cyclesOf(const Peephole::Instruction* window, size_t count)
+{
+    size_t cycles = 0u;
+    for (size_t i = 0u; i < count; ++i) {
+        const AsmInsDesc* desc = findAsmInstruction(opcodeOf(window[i]));
+        cycles += desc != nullptr ? desc->cycles : 1u;
+    }
+    return cycles;
+}
+
+size_t cyclesOf(const uint8_t* bytes, size_t size)
+{
+    size_t cycles = 0u;
+    for (size_t i = 0u; i < size; ++i) {
+        const AsmInsDesc* desc = findAsmInstruction(getOpcodeFromByte(bytes[i]));
+        cycles += desc != nullptr ? desc->cycles : 1u;
+        if (desc != nullptr && desc->type == AsmInsType::TwoByte)
+            ++i;
+    }
+    return cycles;
+}
+
+// Only reads registers, ACC and CY and only writes ACC and CY
+bool writesOnlyAccAndCarry(uint8_t opcode)
+{
+    switch (opcode) {
+    case +AsmIns::LDM: case +AsmIns::LD:
+    case +AsmIns::CLB: case +AsmIns::CLC: case +AsmIns::IAC: case +AsmIns::CMC:
+    case +AsmIns::CMA: case +AsmIns::RAL: case +AsmIns::RAR: case +AsmIns::TCC:
+    case +AsmIns::DAC: case +AsmIns::TCS: case +AsmIns::STC: case +AsmIns::DAA:
+    case +AsmIns::KBP:
+        return true;
+    default:
+        return false;
+    }
+}
+
+// Sets ACC without reading it or CY, and leaves CY alone
+bool overwritesAcc(uint8_t opcode)
+{
+    return opcode == +AsmIns::LDM || opcode == +AsmIns::LD || opcode == +AsmIns::BBL;
+}
+
+bool allKnown(const Peephole::Instruction* window, size_t count)
+{
+    for (size_t i = 0u; i < count; ++i)
+        if (!window[i].known)
+            return false;
+    return true;
+}
+
+void setRewrite(Peephole::Rewrite& rewrite, Peephole::Rule rule, const Peephole::Instruction* window, size_t count,
+                const uint8_t* bytes, size_t length)
+{
+    rewrite.rule = rule;
+    rewrite.count = count;
+    rewrite.size = length;
+    std::copy(bytes, bytes + length, rewrite.bytes);
+
+    size_t size = 0u;
+    for (size_t i = 0u; i < count; ++i)
+        size += window[i].size;
+    rewrite.bytesSaved = size - rewrite.size;
+    rewrite.cyclesSaved = cyclesOf(window, count) - cyclesOf(bytes, length);
+}
+
+void setRewrite(Peephole::Rewrite& rewrite, Peephole::Rule rule, const Peephole::Instruction* window, size_t count,
+                std::initializer_list<uint8_t> bytes)
+{
+    setRewrite(rewrite, rule, window, count, bytes.begin(), bytes.size());
+}
+
+std::string_view trim(std::string_view text)
+{
+    while (!text.empty() && (text.front() == ' ' || text.front() == '\t' || text.front() == '\r'))
+        text.remove_prefix(1u);
+    while (!text.empty() && (text.back() == ' ' || text.back() == '\t' || text.back() == '\r'))
+        text.remove_suffix(1u);
+    return text;
+}
+
+bool parseNumber(std::string_view text, uint8_t& value)
+{
+    int base = 10;
+    if (!text.empty() && text.front() == '$') {
+        base = 16;
+        text.remove_prefix(1u);
+    }
+    if (text.empty())
+        return false;
+
+    unsigned number = 0u;
+    for (char ch : text) {
+        unsigned digit = ch >= '0' && ch <= '9' ? unsigned(ch - '0')
+                       : ch >= 'A' && ch <= 'F' ? unsigned(ch - 'A' + 10)
+                       : ch >= 'a' && ch <= 'f' ? unsigned(ch - 'a' + 10) : 16u;
+        if (digit >= unsigned(base))
+            return false;
+        number = number * unsigned(base) + digit;
+        if (number > 0x0Fu)
+            return false;
+    }
+    value = static_cast<uint8_t>(number);
+    return true;
+}
+
+// Variables used by register operands, one bit each
+uint16_t variablesOf(const std::vector<uint8_t>& bytes)
+{
+    uint16_t variables = 0u;
+    for (uint8_t byte : bytes)
+        if (Peephole::hasRegisterOperand(byte))
+            variables |= static_cast<uint16_t>(1u << (byte & 0x0Fu));
+    return variables;
+}
+
+} // namespace
+
+bool Peephole::match(const Instruction* window, size_t count, Rewrite& rewrite) const
+{
+    if (matchRule(window, count, rewrite))
+        return true;
+    if (count == 0u || !window[count - 1u].known || window[count - 1u].size != 1u)
+        return false;
+    for (uint32_t index : m_templatesByLastOpcode[opcodeOf(window[count - 1u])])
+        if (matchTemplate(m_templates[index], window, count, rewrite))
+            return true;
+    return false;
+}
+
+bool Peephole::matchRule(const Instruction* window, size_t count, Rewrite& rewrite)
+{
+    if (count >= 5u) {
+        const Instruction* w = window + count - 5u;
+        uint8_t first = operandOf(w[1]), second = operandOf(w[3]);
+        if (allKnown(w, 5u) &&
+            opcodeOf(w[0]) == +AsmIns::LDM && opcodeOf(w[1]) == +AsmIns::XCH &&
+            opcodeOf(w[2]) == +AsmIns::LDM && opcodeOf(w[3]) == +AsmIns::XCH &&
+            (first ^ second) == 1u && overwritesAcc(opcodeOf(w[4]))) {
+            // Even registers hold the high nibble of a pair
+            uint8_t high = first % 2u == 0u ? operandOf(w[0]) : operandOf(w[2]);
+            uint8_t low = first % 2u == 0u ? operandOf(w[2]) : operandOf(w[0]);
+            setRewrite(rewrite, Rule::PairLoad, w, 5u,
+                       { static_cast<uint8_t>(+AsmIns::FIM | (first & 0x0Eu)), static_cast<uint8_t>((high << 4) | low), w[4].bytes[0] });
+            return true;
+        }
+    }
+
+    if (count < 2u)
+        return false;
+    const Instruction& prev = window[count - 2u];
+    const Instruction& last = window[count - 1u];
+    const Instruction* w = window + count - 2u;
+    uint8_t prevOpcode = opcodeOf(prev), lastOpcode = opcodeOf(last);
+
+    if (prevOpcode == +AsmIns::JMS && lastOpcode == +AsmIns::BBL && last.known) {
+        setRewrite(rewrite, Rule::TailCall, w, 2u,
+                   { static_cast<uint8_t>(+AsmIns::JUN | (prev.bytes[0] & 0x0Fu)), prev.bytes[1] });
+        return true;
+    }
+    if (allKnown(w, 2u)) {
+        if (prevOpcode == +AsmIns::LD && lastOpcode == +AsmIns::XCH && operandOf(prev) == operandOf(last)) {
+            setRewrite(rewrite, Rule::LoadExchange, w, 2u, { prev.bytes[0] });
+            return true;
+        }
+        if (prevOpcode == +AsmIns::XCH && lastOpcode == +AsmIns::XCH && operandOf(prev) == operandOf(last)) {
+            setRewrite(rewrite, Rule::DoubleExchange, w, 2u, {});
+            return true;
+        }
+        if (lastOpcode == +AsmIns::CLB && writesOnlyAccAndCarry(prevOpcode)) {
+            setRewrite(rewrite, Rule::DeadBeforeClear, w, 2u, { last.bytes[0] });
+            return true;
+        }
+        if ((prevOpcode == +AsmIns::LDM || prevOpcode == +AsmIns::LD) && overwritesAcc(lastOpcode)) {
+            setRewrite(rewrite, Rule::DeadLoad, w, 2u, { last.bytes[0] });
+            return true;
+        }
+    }
+    return false;
+}
+
+bool Peephole::matchTemplate(const Template& rule, const Instruction* window, size_t count, Rewrite& rewrite) const
+{
+    size_t length = rule.pattern.size();
+    if (length > count)
+        return false;
+
+    // Variables bound to registers in the order they are met
+    const Instruction* w = window + count - length;
+    int registerOf[16], variableOf[16];
+    std::fill(std::begin(registerOf), std::end(registerOf), -1);
+    std::fill(std::begin(variableOf), std::end(variableOf), -1);
+    for (size_t i = 0u; i < length; ++i) {
+        uint8_t byte = w[i].bytes[0], expected = rule.pattern[i];
+        if (!w[i].known || w[i].size != 1u)
+            return false;
+        if (!hasRegisterOperand(expected)) {
+            if (byte != expected)
+                return false;
+            continue;
+        }
+
+        int variable = expected & 0x0F, reg = byte & 0x0F;
+        if ((byte & 0xF0u) != (expected & 0xF0u))
+            return false;
+        if (registerOf[variable] < 0 && variableOf[reg] < 0) {
+            registerOf[variable] = reg;
+            variableOf[reg] = variable;
+        }
+        else if (registerOf[variable] != reg) {
+            return false;
+        }
+    }
+
+    uint8_t bytes[MAX_REWRITE_SIZE];
+    for (size_t i = 0u; i < rule.replacement.size(); ++i) {
+        uint8_t byte = rule.replacement[i];
+        bytes[i] = hasRegisterOperand(byte) ? static_cast<uint8_t>((byte & 0xF0u) | registerOf[byte & 0x0Fu]) : byte;
+    }
+    setRewrite(rewrite, Rule::Template, w, length, bytes, rule.replacement.size());
+    return true;
+}
+
+std::string_view Peephole::getRuleName(Rule rule)
+{
+    switch (rule) {
+    case Rule::PairLoad: return "paired load into FIM";
+    case Rule::TailCall: return "tail call";
+    case Rule::LoadExchange: return "LD before XCH of the same register";
+    case Rule::DoubleExchange: return "XCH twice";
+    case Rule::DeadBeforeClear: return "dead ACC/CY write before CLB";
+    case Rule::DeadLoad: return "dead load into ACC";
+    case Rule::Template: return "superoptimizer template";
+    }
+    return {};
+}
+
+bool Peephole::addTemplates(std::string_view text, std::string& error)
+{
+    size_t line = 0u;
+    while (!text.empty()) {
+        ++line;
+        size_t end = text.find('\n');
+        std::string_view current = trim(text.substr(0u, end));
+        text.remove_prefix(end == std::string_view::npos ? text.size() : end + 1u);
+        if (current.empty() || current.front() == ';')
+            continue;
+
+        auto fail = [&](std::string_view message) {
+            error = "line " + std::to_string(line) + ": " + std::string(message);
+            return false;
+        };
+        size_t arrow = current.find("->");
+        if (arrow == std::string_view::npos)
+            return fail("expected '->'");
+
+        Template rule;
+        std::string sequenceError;
+        if (!parseSequence(current.substr(0u, arrow), rule.pattern, sequenceError) ||
+            !parseSequence(current.substr(arrow + 2u), rule.replacement, sequenceError))
+            return fail(sequenceError);
+        if (rule.pattern.empty() || rule.pattern.size() > WINDOW_SIZE || rule.replacement.size() > MAX_REWRITE_SIZE)
+            return fail("template too long or empty");
+        if ((variablesOf(rule.replacement) & ~variablesOf(rule.pattern)) != 0u)
+            return fail("replacement uses a register the pattern does not");
+        if (cyclesOf(rule.replacement.data(), rule.replacement.size()) >= cyclesOf(rule.pattern.data(), rule.pattern.size()) &&
+            rule.replacement.size() >= rule.pattern.size())
+            return fail("replacement saves nothing");
+        m_templatesByLastOpcode[getOpcodeFromByte(rule.pattern.back())].push_back(static_cast<uint32_t>(m_templates.size()));
+        m_templates.push_back(std::move(rule));
+    }
+    return true;
+}
+
+void Peephole::clearTemplates()
+{
+    m_templates.clear();
+    for (std::vector<uint32_t>& bucket : m_templatesByLastOpcode)
+        bucket.clear();
+}
+
+bool Peephole::loadTemplates(const char* filename, std::string& error)
+{
+    std::ifstream file(filename, std::ios_base::binary);
+    if (!file.is_open()) {
+        error = std::string("cannot open ") + filename;
+        return false;
+    }
+
+    std::stringstream text;
+    text << file.rdbuf();
+    if (!addTemplates(text.str(), error)) {
+        error = std::string(filename) + ": " + error;
+        return false;
+    }
+    return true;
+}
+
+bool Peephole::parseSequence(std::string_view text, std::vector<uint8_t>& bytes, std::string& error)
+{
+    // mnemonic [operand] [/ mnemonic [operand]]...
+    bytes.clear();
+    text = trim(text);
+    while (!text.empty()) {
+        size_t end = text.find('/');
+        std::string_view instruction = trim(text.substr(0u, end));
+        text = end == std::string_view::npos ? std::string_view() : trim(text.substr(end + 1u));
+
+        size_t space = instruction.find_first_of(" \t");
+        std::string_view name = instruction.substr(0u, space);
+        std::string_view operand = space == std::string_view::npos ? std::string_view() : trim(instruction.substr(space));
+        const AsmInsDesc* desc = findAsmMnemonic(name);
+        if (desc == nullptr || desc->type == AsmInsType::TwoByte ||
+            (desc->type == AsmInsType::Complex && !hasRegisterOperand(desc->byte) && desc->byte != +AsmIns::LDM)) {
+            error = "not an instruction of one byte without a jump or pair '" + std::string(instruction) + "'";
+            return false;
+        }
+
+        uint8_t value = 0u;
+        if (hasRegisterOperand(desc->byte)) {
+            // Ra-Rp, upper case would be a register of its own
+            if (operand.size() != 2u || (operand[0] != 'R' && operand[0] != 'r') || operand[1] < 'a' || operand[1] > 'p') {
+                error = "expected register variable Ra-Rp '" + std::string(instruction) + "'";
+                return false;
+            }
+            value = static_cast<uint8_t>(operand[1] - 'a');
+        }
+        else if (desc->byte == +AsmIns::LDM) {
+            if (!parseNumber(operand, value)) {
+                error = "expected value 0-15 '" + std::string(instruction) + "'";
+                return false;
+            }
+        }
+        else if (!operand.empty()) {
+            error = "unexpected operand '" + std::string(instruction) + "'";
+            return false;
+        }
+        bytes.push_back(static_cast<uint8_t>(desc->byte | value));
+    }
+    return true;
+}
+
+std::string Peephole::formatSequence(const std::vector<uint8_t>& bytes)
+{
+    std::string text;
+    for (uint8_t byte : bytes) {
+        if (!text.empty())
+            text += " / ";
+        const AsmInsDesc* desc = findAsmInstruction(getOpcodeFromByte(byte));
+        text += desc != nullptr ? desc->name : "???";
+        if (hasRegisterOperand(byte)) {
+            text += " R";
+            text += static_cast<char>('a' + (byte & 0x0Fu));
+        }
+        else if (getOpcodeFromByte(byte) == +AsmIns::LDM) {
+            text += ' ';
+            text += std::to_string(byte & 0x0Fu);
+        }
+    }
+    return text;
+}
+
+bool Peephole::hasRegisterOperand(uint8_t byte)
+{
+    switch (getOpcodeFromByte(byte)) {
+    case +AsmIns::INC: case +AsmIns::ADD: case +AsmIns::SUB: case +AsmIns::LD: case +AsmIns::XCH:
+        return true;
+    default:
+        return false;
+    }
+}
+
+bool Peephole::returnsValue(const uint8_t* image, size_t size, uint16_t start, uint8_t value)
+{
+    std::bitset<4096> visited;
+    std::vector<uint16_t> pending{ static_cast<uint16_t>(start & 0x0FFFu) };
+    while (!pending.empty()) {
+        uint16_t address = pending.back();
+        pending.pop_back();
+        if (visited[address])
+            continue;
+        visited.set(address);
+
+        const AsmInsDesc* desc = address < size ? findAsmInstruction(getOpcodeFromByte(image[address])) : nullptr;
+        if (desc == nullptr)
+            return false;
+        uint8_t byte = image[address];
+        uint16_t next = static_cast<uint16_t>((address + (desc->type == AsmInsType::TwoByte ? 2u : 1u)) & 0x0FFFu);
+        if (desc->type == AsmInsType::TwoByte && address + 1u >= size)
+            return false;
+
+        switch (desc->byte) {
+        case +AsmIns::BBL:
+            if ((byte & 0x0Fu) != value)
+                return false;
+            break;
+        case +AsmIns::BBS:
+        case +AsmIns::JIN:
+            return false;
+        case +AsmIns::JUN:
+            pending.push_back(static_cast<uint16_t>(((byte & 0x0Fu) << 8) | image[address + 1u]));
+            break;
+        case +AsmIns::JCN:
+        case +AsmIns::ISZ:
+            pending.push_back(next);
+            pending.push_back(static_cast<uint16_t>((next & 0x0F00u) | image[address + 1u]));
+            break;
+        default:
+            // A JMS is taken to return to the next instruction
+            pending.push_back(next);
+            break;
+        }
+    }
+    return true;
+}
@@ -0,0 +1,87 @@
+#pragma once
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <string_view>
+#include <vector>
+
+// Cycle-saving rewrites of the instructions just emitted, used by the
+// Assembler when optimization is on. Rules only see a window of consecutive
+// instructions that no label splits, so nothing can jump between them, and
+// every rule keeps registers, ACC, CY, RAM and I/O as the original leaves
+// them wherever the result can be observed.
+//
+// Besides the rules written here, templates found by the superoptimizer tool
+// can be loaded. A template is a sequence of one-byte instructions proven to
+// leave ACC, CY and registers like a shorter one for every input.
+class Peephole
+{
+public:
+    static constexpr size_t WINDOW_SIZE = 5u;
+    static constexpr size_t MAX_REWRITE_SIZE = 4u;
+
+    struct Instruction {
+        uint8_t bytes[2];
+        uint8_t size;
+        bool known;  // No operand waits for a symbol
+    };
+
+    enum class Rule {
+        PairLoad,         // LDM a; XCH r; LDM b; XCH r^1; x -> FIM p, ab; x when x overwrites ACC
+        TailCall,         // JMS x; BBL n -> JUN x when every return of x is BBL n
+        LoadExchange,     // LD r; XCH r -> LD r
+        DoubleExchange,   // XCH r; XCH r -> nothing
+        DeadBeforeClear,  // ACC/CY-only instruction; CLB -> CLB
+        DeadLoad,         // LDM/LD; LDM/LD/BBL -> LDM/LD/BBL
+        Template,         // Loaded from a rewrite database
+    };
+
+    struct Rewrite {
+        Rule rule;
+        size_t count;  // Instructions at the end of the window replaced
+        uint8_t bytes[MAX_REWRITE_SIZE];
+        size_t size;
+        size_t bytesSaved;
+        size_t cyclesSaved;
+    };
+
+    // One-byte instructions. The low nibble of LD, XCH, ADD, SUB and INC is a
+    // variable, any registers that differ from each other may stand for
+    // different variables.
+    struct Template {
+        std::vector<uint8_t> pattern;
+        std::vector<uint8_t> replacement;
+    };
+
+    // First rule matching the end of the window, templates after the rules
+    // above. A TailCall keeps the JMS bytes in place, its address may still
+    // wait for a symbol; every other rule needs its instructions known.
+    bool match(const Instruction* window, size_t count, Rewrite& rewrite) const;
+    static std::string_view getRuleName(Rule rule);
+
+    // "pattern -> replacement" per line, instructions split by '/' and
+    // registers named Ra-Rp for variables, e.g. "LD Ra / XCH Ra -> LD Ra".
+    // Lines starting with ';' are comments. Errors are "line N: message".
+    bool addTemplates(std::string_view text, std::string& error);
+    bool loadTemplates(const char* filename, std::string& error);
+    void clearTemplates();
+    const std::vector<Template>& getTemplates() const { return m_templates; }
+
+    // Instructions of a template, in the form addTemplates() reads
+    static bool parseSequence(std::string_view text, std::vector<uint8_t>& bytes, std::string& error);
+    static std::string formatSequence(const std::vector<uint8_t>& bytes);
+    static bool hasRegisterOperand(uint8_t byte);
+
+    // Whether every BBL reachable from start returns value. Unknown bytes,
+    // JIN, BBS or leaving the image make the answer no.
+    static bool returnsValue(const uint8_t* image, size_t size, uint16_t start, uint8_t value);
+private:
+    static bool matchRule(const Instruction* window, size_t count, Rewrite& rewrite);
+    bool matchTemplate(const Template& rule, const Instruction* window, size_t count, Rewrite& rewrite) const;
+
+    std::vector<Template> m_templates;
+    // Indices into m_templates by the opcode of the last pattern instruction,
+    // in load order. The window is matched at its end, so only the templates
+    // ending in the opcode just emitted are tried.
+    std::vector<uint32_t> m_templatesByLastOpcode[256];
+};
@@ -1,13 +1,17 @@
 #pragma once
+#include "shared/source/assembly.hpp"
+
 #include <cstdint>
 #include <iostream>
-#include <functional>
-#include <variant>
+#include <string>
+#include <string_view>
 
+// Splits assembly source into tokens. Token texts are views into the source,
+// which must outlive them (the stream constructor keeps its own copy).
 class Tokenizer {
 public:
     enum class TokenType {
-        Invalid = -1,
+        Invalid = -1,  // End of source (empty text) or unexpected input (its text)
         NewLine,
         Comma,
         Minus,
@@ -19,58 +23,50 @@ public:
         RegisterPair,
         Mnemonic,
         Label,
-        BytePragma
+        BytePragma,
+        EndPragma,
+        SectionPragma,
+        GlobalPragma
     };
 
     struct Token {
         TokenType type;
-        std::string text;
+        std::string_view text;
         size_t line;
         unsigned int value;
 
         Token();
-        Token(TokenType type, std::string&& text, size_t line, unsigned int value = 0u) noexcept;
-        Token(const Token& other) = default;
-        Token(Token&& other) noexcept;
-        Token& operator=(Token&& other) noexcept;
-        Token& operator=(const Token& other) = default;
-    };
-
-    enum class InsType {
-        Simple,
-        Complex,
-        TwoByte
+        Token(TokenType type, std::string_view text, size_t line, unsigned int value = 0u) noexcept;
     };
 
-    struct MnemonicDesc {
-        uint8_t byte;
-        InsType type;
-    };
+    using InsType = AsmInsType;
+    using MnemonicDesc = AsmInsDesc;
 
-    Tokenizer(std::istream& stream);
+    explicit Tokenizer(std::string_view source);
+    explicit Tokenizer(std::istream& stream);
     Token getNext();
+
+    size_t getColumn() const { return m_column; }
+
+    // Mnemonics are matched case-insensitively
+    static bool findMnemonic(std::string_view text, MnemonicDesc& desc);
 private:
-    char peekChar();
-    bool getChar();
-    bool getCharIfMatch(char ch);
-    bool getCharIfNotMatch(char ch);
-    Token pragma();
-    Token hexNumber();
-    Token octNumber();
-    Token binNumber();
-    Token decNumber();
-    Token identifier();
-    bool isLetter(char ch);
-    bool isAlphaNumeric(char ch);
-    bool isDecDigit(char ch);
-    bool isHexDigit(char ch);
-    bool isOctDigit(char ch);
+    char peekChar() const { return m_pos < m_source.size() ? m_source[m_pos] : '\0'; }
+    Token pragma(size_t start);
+    Token number(size_t start, size_t prefix, size_t maxDigits,
+                 unsigned int (*convert)(const std::string_view&), bool (*isDigit)(char));
+    Token identifier(size_t start);
+    static bool isLetter(char ch);
+    static bool isAlphaNumeric(char ch);
+    static bool isDecDigit(char ch);
+    static bool isHexDigit(char ch);
+    static bool isOctDigit(char ch);
+    static bool isBinDigit(char ch);
 
-    std::istream& m_stream;
-    char m_currentCh;
+    std::string m_buffer;  // Source read from a stream
+    std::string_view m_source;
+    size_t m_pos;
     size_t m_line;
-    int m_col;
-
-    static const std::unordered_map<std::string, MnemonicDesc> m_mnemonics;
-    static const std::unordered_map<std::string, uint8_t> m_registers;
+    size_t m_lineStart;
+    size_t m_column;       // Of the last token, from 0
 };
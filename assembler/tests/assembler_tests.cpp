@@ -1,7 +1,12 @@
 #include "assembler/source/assembler.hpp"
+#include "assembler/source/listing.hpp"
 
 #include <gtest/gtest.h>
 
+#include <fstream>
+#include <iterator>
+#include <sstream>
+
 struct AssemblerTestParam {
     const char* sourceFilename;
     std::vector<std::uint8_t> refByteCode;
@@ -89,3 +94,310 @@ INSTANTIATE_TEST_SUITE_P(Parametrized, AssemblerTests,
         })
     )
 );
+
+struct AssemblerSourceTests : public testing::Test {
+    bool assembleText(std::string_view text, std::vector<uint8_t>& byteCode) {
+        return assembler.assemble(text, byteCode);
+    }
+
+    Assembler assembler;
+};
+
+TEST_F(AssemblerSourceTests, givenForwardReferencesWhenAssemblingThenTheyArePatched) {
+    std::vector<uint8_t> byteCode;
+    ASSERT_TRUE(assembleText(
+        "      jcn C, NEXT+1 ; lower case mnemonics\n"
+        "      fim p1, TABLE\n"
+        "      ld R11\n"
+        "NEXT  jms SUBR\n"
+        "      ldm C\n"
+        "*=$105\n"
+        "SUBR  bbl 0\n"
+        "TABLE=$3C\n"
+        "C=%1010\n", byteCode)) << assembler.getError();
+
+    ASSERT_EQ(byteCode.size(), 0x108u);
+    EXPECT_EQ(byteCode[2], 0x1Au);
+    EXPECT_EQ(byteCode[3], 0x06u);
+    EXPECT_EQ(byteCode[4], 0x22u);
+    EXPECT_EQ(byteCode[5], 0x3Cu);
+    EXPECT_EQ(byteCode[6], 0xABu);
+    EXPECT_EQ(byteCode[7], 0x51u);
+    EXPECT_EQ(byteCode[8], 0x05u);
+    EXPECT_EQ(byteCode[9], 0xDAu);
+    EXPECT_EQ(byteCode[0x107], 0xC0u);
+}
+
+TEST_F(AssemblerSourceTests, givenBadSourceWhenAssemblingThenLineOfErrorIsReported) {
+    std::vector<uint8_t> byteCode;
+    EXPECT_FALSE(assembleText("  NOP\n  JCN Z, 0\n", byteCode));
+    EXPECT_EQ(assembler.getError(), "line 2: undefined symbol 'Z'");
+
+    EXPECT_FALSE(assembleText("X NOP\nX NOP\n", byteCode));
+    EXPECT_EQ(assembler.getError(), "line 2: symbol defined twice 'X'");
+
+    EXPECT_FALSE(assembleText("  LDM 16\n", byteCode));
+    EXPECT_EQ(assembler.getError(), "line 1: operand does not fit in 4 bits");
+
+    EXPECT_FALSE(assembleText("  CLB R0\n", byteCode));
+    EXPECT_EQ(assembler.getError(), "line 1: unexpected 'R0'");
+
+    EXPECT_FALSE(assembleText("*=$FFE\n  nop\n  jun 0\n  nop\n", byteCode));
+    EXPECT_EQ(assembler.getError(), "line 3: program does not fit in 4 KiB");
+}
+
+TEST_F(AssemblerSourceTests, givenOperandTooWideWhenAssemblingThenItIsRejectedNotTruncated) {
+    std::vector<uint8_t> byteCode;
+    EXPECT_FALSE(assembleText("  .BYTE 300\n", byteCode));
+    EXPECT_EQ(assembler.getError(), "line 1: operand does not fit in 8 bits");
+
+    EXPECT_FALSE(assembleText("  FIM P0,$1FF\n", byteCode));
+    EXPECT_EQ(assembler.getError(), "line 1: operand does not fit in 8 bits");
+
+    EXPECT_FALSE(assembleText("  LDM $10005\n", byteCode));
+    EXPECT_EQ(assembler.getError(), "line 1: operand does not fit in 16 bits '$10005'");
+
+    EXPECT_FALSE(assembleText("  JUN $10100\n", byteCode));
+    EXPECT_EQ(assembler.getError(), "line 1: operand does not fit in 16 bits '$10100'");
+
+    EXPECT_FALSE(assembleText("  JUN $FFFF+2\n", byteCode));
+    EXPECT_EQ(assembler.getError(), "line 1: operand does not fit in 16 bits '2'");
+
+    // A symbol less a constant still wraps to the intended addend
+    ASSERT_TRUE(assembleText("  FIM P0,X-1\n  .BYTE $FF\nX=$10\n", byteCode)) << assembler.getError();
+    EXPECT_EQ(byteCode[3], 0x0Fu);
+    EXPECT_EQ(byteCode[4], 0xFFu);
+}
+
+TEST_F(AssemblerSourceTests, givenSourceTextWhenAssemblingThenFileResultIsMatched) {
+    std::ifstream file("programs/4bit_and_subroutine.asm");
+    std::string text((std::istreambuf_iterator<char>(file)), std::istreambuf_iterator<char>());
+    ASSERT_FALSE(text.empty());
+
+    std::vector<uint8_t> fromFile, fromText{ 0x12, 0x34 };
+    ASSERT_TRUE(assembler.assemble("programs/4bit_and_subroutine.asm", fromFile));
+    ASSERT_TRUE(assembleText(text, fromText));
+    EXPECT_EQ(fromText, fromFile);
+}
+
+TEST_F(AssemblerSourceTests, givenMnemonicsInAnyCaseWhenAssemblingThenInstructionTableIsUsed) {
+    std::vector<uint8_t> byteCode;
+    ASSERT_TRUE(assembleText("  nop\n  Rpm\n  ld r10\n  HLT\n", byteCode));
+    ASSERT_EQ(byteCode.size(), 6u);  // After the two I/O mask bytes
+    EXPECT_EQ(byteCode[2], 0x00u);
+    EXPECT_EQ(byteCode[3], 0x0Eu);
+    EXPECT_EQ(byteCode[4], 0xAAu);
+    EXPECT_EQ(byteCode[5], 0x01u);
+}
+
+TEST_F(AssemblerSourceTests, givenShortBranchToAnotherPageWhenAssemblingThenItIsRelaxed) {
+    std::vector<uint8_t> byteCode;
+    ASSERT_TRUE(assembleText(
+        "      jcn %0100, FAR\n"
+        "      isz r3, FAR\n"
+        "      nop\n"
+        "*=$FC\n"
+        "      jcn %0010, FAR\n"
+        "*=$180\n"
+        "FAR   nop\n", byteCode)) << assembler.getError();
+
+    const std::vector<uint8_t> start = {
+        0x1C, 0x04, 0x41, 0x80,              // 000: jcn %1100, $04; jun FAR
+        0x73, 0x08, 0x40, 0x0A, 0x41, 0x80,  // 004: isz r3, $08; jun $00A; jun FAR
+        0x00,                                // 00A: nop
+    };
+    EXPECT_TRUE(std::equal(start.begin(), start.end(), byteCode.begin() + 2));
+
+    // The skip would land on the next page, NOPs move the JCN to where it jumps there
+    const std::vector<uint8_t> end = { 0x00, 0x00, 0x1A, 0x02, 0x41, 0x80 };
+    EXPECT_TRUE(std::equal(end.begin(), end.end(), byteCode.begin() + 2 + 0xFC));
+
+    const std::vector<Assembler::Relaxation>& relaxations = assembler.getRelaxations();
+    ASSERT_EQ(relaxations.size(), 3u);
+    EXPECT_EQ(relaxations[0].line, 1u);
+    EXPECT_EQ(relaxations[0].addedBytes, 2u);
+    EXPECT_EQ(relaxations[1].opcode, +AsmIns::ISZ);
+    EXPECT_EQ(relaxations[1].addedBytes, 4u);
+    EXPECT_EQ(relaxations[2].address, 0xFCu);
+    EXPECT_EQ(relaxations[2].addedBytes, 4u);
+
+    assembler.setBranchRelaxation(false);
+    EXPECT_FALSE(assembleText("  jcn %0100, FAR\n*=$100\nFAR nop\n", byteCode));
+    EXPECT_EQ(assembler.getError(), "line 1: short branch leaves its page 'FAR'");
+}
+
+TEST_F(AssemblerSourceTests, givenRelaxationMovingCodeWhenAssemblingThenItIsRepeatedUntilStable) {
+    // Relaxing the first JCN pushes the second one's target onto the next page
+    std::string text = "  jcn %0100, FAR\n";
+    for (int i = 0; i < 0xEE; ++i)
+        text += "  nop\n";
+    text += "  jcn %0001, END\n";
+    for (int i = 0; i < 13; ++i)
+        text += "  nop\n";
+    text += "END nop\n*=$300\nFAR nop\n";
+
+    std::vector<uint8_t> byteCode;
+    ASSERT_TRUE(assembleText(text, byteCode)) << assembler.getError();
+    ASSERT_EQ(assembler.getRelaxations().size(), 2u);
+    EXPECT_EQ(assembler.getRelaxations()[1].address, 0xF2u);
+    EXPECT_EQ(byteCode[2 + 0xF2], 0x19u);
+    EXPECT_EQ(byteCode[2 + 0xF3], 0xF6u);
+    EXPECT_EQ(byteCode[2 + 0xF4], 0x41u);
+    EXPECT_EQ(byteCode[2 + 0xF5], 0x03u);
+}
+
+TEST_F(AssemblerSourceTests, givenDeadAndPairedLoadsWhenOptimizingThenShorterCodeIsEmitted) {
+    assembler.setOptimization(true);
+    std::vector<uint8_t> byteCode;
+    ASSERT_TRUE(assembleText(
+        "      ldm 1\n"
+        "      xch r5\n"
+        "      ldm 2\n"
+        "      xch r4\n"
+        "      ld r4\n"
+        "      xch r4\n"
+        "      iac\n"
+        "      clb\n"
+        "LOOP  xch r3\n"
+        "      xch r3\n"
+        "      jun LOOP\n", byteCode)) << assembler.getError();
+
+    const std::vector<uint8_t> expected = {
+        0xFE, 0xFF,
+        0x24, 0x21,  // fim p2, $21
+        0xF0,        // clb
+        0x40, 0x03,  // LOOP: jun LOOP
+    };
+    EXPECT_EQ(byteCode, expected);
+
+    const std::vector<Assembler::Optimization>& optimizations = assembler.getOptimizations();
+    // The LD left by the XCH rewrite is dead before CLB as well
+    ASSERT_EQ(optimizations.size(), 5u);
+    EXPECT_EQ(optimizations[0].rule, Peephole::Rule::PairLoad);
+    EXPECT_EQ(optimizations[0].line, 1u);
+    EXPECT_EQ(optimizations[0].cyclesSaved, 2u);
+    EXPECT_EQ(optimizations[1].rule, Peephole::Rule::LoadExchange);
+    EXPECT_EQ(optimizations[2].rule, Peephole::Rule::DeadBeforeClear);
+    EXPECT_EQ(optimizations[3].rule, Peephole::Rule::DeadBeforeClear);
+    EXPECT_EQ(optimizations[3].line, 5u);
+    EXPECT_EQ(optimizations[4].rule, Peephole::Rule::DoubleExchange);
+    EXPECT_EQ(optimizations[4].bytesSaved, 2u);
+
+    // Code after a label may be reached from elsewhere
+    ASSERT_TRUE(assembleText("  ldm 1\nNEXT ldm 2\n  jun NEXT\n", byteCode)) << assembler.getError();
+    EXPECT_TRUE(assembler.getOptimizations().empty());
+}
+
+TEST_F(AssemblerSourceTests, givenCallBeforeReturnWhenOptimizingThenItBecomesAJumpOnlyIfReturnsMatch) {
+    assembler.setOptimization(true);
+    std::vector<uint8_t> byteCode;
+    ASSERT_TRUE(assembleText(
+        "      jms SAME\n"
+        "      bbl 1\n"
+        "      jms OTHER\n"
+        "      bbl 1\n"
+        "SAME  jcn %0010, ONE\n"
+        "      bbl 1\n"
+        "ONE   bbl 1\n"
+        "OTHER jcn %0010, ZERO\n"
+        "      bbl 1\n"
+        "ZERO  bbl 0\n", byteCode)) << assembler.getError();
+
+    const std::vector<uint8_t> expected = {
+        0xFE, 0xFF,
+        0x40, 0x05,  // jun SAME
+        0x50, 0x09,  // jms OTHER
+        0xC1,        // bbl 1
+        0x12, 0x08,  // SAME: jcn %0010, ONE
+        0xC1, 0xC1,
+        0x12, 0x0C,  // OTHER: jcn %0010, ZERO
+        0xC1, 0xC0,
+    };
+    EXPECT_EQ(byteCode, expected);
+    ASSERT_EQ(assembler.getOptimizations().size(), 1u);
+    EXPECT_EQ(assembler.getOptimizations()[0].rule, Peephole::Rule::TailCall);
+
+    // Where the linker places the routine is not known yet
+    ObjectModule object;
+    ASSERT_TRUE(assembler.assembleObject(std::string_view("  jms ROUTINE\n  bbl 0\n"), object)) << assembler.getError();
+    EXPECT_EQ(object.sections[0].code.size(), 3u);
+}
+
+TEST_F(AssemblerSourceTests, givenSuperoptimizerTemplatesWhenOptimizingThenMatchingRegistersAreRewritten) {
+    std::string error;
+    ASSERT_TRUE(assembler.getPeephole().addTemplates(
+        "; found by superoptimizer\n"
+        "LDM 14 / STC / LDM 7 -> LDM 8 / DAC\n"
+        "ADD Ra / SUB Rb -> INC Ra\n", error)) << error;  // Taken as given, not a real equivalence
+    assembler.setOptimization(true);
+
+    std::vector<uint8_t> byteCode;
+    ASSERT_TRUE(assembleText(
+        "      ldm 14\n"
+        "      stc\n"
+        "      ldm 7\n"
+        "LOOP  add r3\n"
+        "      sub r3\n"
+        "      add r2\n"
+        "      sub r5\n", byteCode)) << assembler.getError();
+
+    // Ra and Rb stand for different registers
+    const std::vector<uint8_t> expected = { 0xFE, 0xFF, 0xD8, 0xF8, 0x83, 0x93, 0x62 };
+    EXPECT_EQ(byteCode, expected);
+    ASSERT_EQ(assembler.getOptimizations().size(), 2u);
+    EXPECT_EQ(assembler.getOptimizations()[0].rule, Peephole::Rule::Template);
+    EXPECT_EQ(assembler.getOptimizations()[0].cyclesSaved, 1u);
+    EXPECT_EQ(assembler.getOptimizations()[1].line, 6u);
+
+    Peephole peephole;
+    EXPECT_FALSE(peephole.addTemplates("LD Ra -> LD Rb\n", error));
+    EXPECT_EQ(error, "line 1: replacement uses a register the pattern does not");
+    EXPECT_FALSE(peephole.addTemplates("\nLD Ra -> LD Ra\n", error));
+    EXPECT_EQ(error, "line 2: replacement saves nothing");
+    EXPECT_FALSE(peephole.addTemplates("LD RA -> \n", error));
+    EXPECT_EQ(error, "line 1: expected register variable Ra-Rp 'LD RA'");
+}
+
+TEST_F(AssemblerSourceTests, givenOptimizedProgramWhenListingThenLinesBytesAndBlockCyclesAreWritten) {
+    assembler.setOptimization(true);
+    std::vector<uint8_t> byteCode;
+    const std::string_view source =
+        "COUNT = 12\n"
+        "      fim p0, COUNT\n"
+        "LOOP  ldm 1\n"
+        "      xch r2\n"
+        "      ldm 2\n"
+        "      xch r3\n"
+        "      ldm 0\n"
+        "      isz r0, LOOP\n"
+        "      .BYTE $3F\n"
+        "*=$100\n"
+        "DONE  bbl 0\n";
+    ASSERT_TRUE(assembleText(source, byteCode)) << assembler.getError();
+
+    // The pair load replacing lines 3-6 is listed under line 3, the LDM kept keeps its line
+    const std::vector<Assembler::ListingEntry>& listing = assembler.getListing();
+    ASSERT_EQ(listing.size(), 7u);
+    EXPECT_EQ(listing[1].address, 0x002u);
+    EXPECT_EQ(listing[1].size, 2u);
+    EXPECT_EQ(listing[1].line, 3u);
+    EXPECT_EQ(listing[2].line, 7u);
+    EXPECT_EQ(listing[4].kind, Assembler::ListingKind::Data);
+    EXPECT_EQ(listing[5].kind, Assembler::ListingKind::Fill);
+    EXPECT_EQ(listing[5].size, 0xF8u);
+    EXPECT_EQ(listing[6].address, 0x100u);
+
+    std::ostringstream out;
+    writeListing(out, source, byteCode, assembler);
+    const std::string text = out.str();
+    EXPECT_NE(text.find("000      20 0C    2      2      2        fim p0, COUNT\n"), std::string::npos) << text;
+    // LOOP starts a block
+    EXPECT_NE(text.find("002      22 12    2      2      3  LOOP  ldm 1\n"), std::string::npos) << text;
+    EXPECT_NE(text.find("      4        xch r2\n"), std::string::npos) << text;
+    EXPECT_NE(text.find("004      D0       1      3      7        ldm 0\n"), std::string::npos) << text;
+    EXPECT_NE(text.find("005      70 02    2      5      8        isz r0, LOOP\n"), std::string::npos) << text;
+    EXPECT_NE(text.find("008-0FF                        10  *=$100\n; page $100\n100      C0       1      1"),
+              std::string::npos) << text;
+    EXPECT_NE(text.find("; symbols\n$002 label    LOOP\n$00C constant COUNT\n$100 label    DONE\n"), std::string::npos)
+        << text;
+}
@@ -0,0 +1,198 @@
+#include <gtest/gtest.h>
+#include "assembler/source/assembler.hpp"
+#include "assembler/source/linker.hpp"
+
+#include <fstream>
+#include <iterator>
+#include <string>
+
+struct LinkerTests : public testing::Test {
+    void addModule(std::string name, std::string_view source) {
+        ObjectModule module;
+        ASSERT_TRUE(assembler.assembleObject(source, module)) << assembler.getError();
+        linker.addModule(std::move(name), std::move(module));
+    }
+
+    Assembler assembler;
+    Linker linker;
+};
+
+TEST_F(LinkerTests, givenModulesWhenLinkingThenSectionsArePlacedAndSymbolsResolved) {
+    addModule("main",
+        "      .GLOBAL START\n"
+        "START jms ADD2\n"
+        "LOOP  jcn %0001, LOOP\n"
+        "      fim p0, TABLE+1\n"
+        "      jun START\n"
+        "*=$200\n"
+        "TABLE .BYTE 7\n");
+    addModule("math",
+        "      .GLOBAL ADD2, ONE\n"
+        "ONE=1\n"
+        "ADD2  iac\n"
+        "      iac\n"
+        "      bbl ONE\n");
+
+    std::vector<uint8_t> image;
+    ASSERT_TRUE(linker.link(image)) << linker.getError();
+    ASSERT_EQ(image.size(), 2u + 0x201u);
+    const std::vector<uint8_t> code = {
+        0x50, 0x08,        // 000: jms $008
+        0x11, 0x02,        // 002: jcn %0001, $02
+        0x20, 0x01,        // 004: fim p0, $01
+        0x40, 0x00,        // 006: jun $000
+        0xF2, 0xF2, 0xC1,  // 008: ADD2 in the next free bytes
+    };
+    EXPECT_TRUE(std::equal(code.begin(), code.end(), image.begin() + 2));
+    EXPECT_EQ(image[2u + 0x200u], 7u);
+
+    ASSERT_EQ(linker.getPlacements().size(), 3u);
+    EXPECT_EQ(linker.getPlacements()[1].address, 0x200u);
+    EXPECT_EQ(linker.getPlacements()[2].address, 0x008u);
+}
+
+TEST_F(LinkerTests, givenSectionsWhenPlacingThenPagesAreNotCrossed) {
+    std::string fill;
+    for (int i = 0; i < 250; ++i)
+        fill += "  nop\n";
+    addModule("big", ".SECTION FIRST\nTOP" + fill + ".SECTION SECOND\n  jun TOP\n" + fill + "  bbl 0\n");
+
+    std::vector<uint8_t> image;
+    ASSERT_TRUE(linker.link(image)) << linker.getError();
+    ASSERT_EQ(linker.getPlacements().size(), 2u);
+    EXPECT_EQ(linker.getPlacements()[0].address, 0x000u);
+    EXPECT_EQ(linker.getPlacements()[1].address, 0x100u);  // 253 bytes did not fit after the first 250
+    EXPECT_EQ(image[2u + 0x100u], 0x40u);
+    EXPECT_EQ(image[2u + 0x101u], 0x00u);
+}
+
+TEST_F(LinkerTests, givenObjectWhenWrittenAndReadThenItIsUnchanged) {
+    ObjectModule module;
+    ASSERT_TRUE(assembler.assembleObject(std::string_view("  .GLOBAL X\nX jun EXT+2\n  isz r1, X\n*=$300\n  .BYTE X\n"), module));
+    ASSERT_EQ(module.sections.size(), 2u);
+    ASSERT_EQ(module.relocations.size(), 3u);
+    EXPECT_EQ(module.relocations[0].kind, RelocationKind::Address);
+    EXPECT_EQ(module.relocations[0].addend, 2u);
+    EXPECT_EQ(module.relocations[1].kind, RelocationKind::Branch);
+
+    std::vector<uint8_t> data;
+    ASSERT_TRUE(module.write(data));
+    ObjectModule copy;
+    ASSERT_TRUE(copy.read(data.data(), data.size()));
+    std::vector<uint8_t> again;
+    ASSERT_TRUE(copy.write(again));
+    EXPECT_EQ(again, data);
+    EXPECT_FALSE(copy.read(data.data(), data.size() - 1u));
+}
+
+TEST_F(LinkerTests, givenExternalReferencedTwiceWhenAssemblingThenBothAreRelocated) {
+    ObjectModule module;
+    ASSERT_TRUE(assembler.assembleObject(std::string_view("  jms EXT\n  jun EXT+1\n"), module));
+    ASSERT_EQ(module.relocations.size(), 2u);
+    EXPECT_EQ(module.relocations[0].symbol, module.relocations[1].symbol);
+    EXPECT_EQ(module.relocations[1].addend, 1u);
+
+    addModule("a", "  jms EXT\n  jun EXT+1\n");
+    addModule("b", "  .GLOBAL EXT\nEXT nop\n  bbl 0\n");
+    std::vector<uint8_t> image;
+    ASSERT_TRUE(linker.link(image)) << linker.getError();
+    EXPECT_EQ(image[2u + 0u], 0x50u);  // jms $004
+    EXPECT_EQ(image[2u + 1u], 0x04u);
+    EXPECT_EQ(image[2u + 2u], 0x40u);  // jun $005
+    EXPECT_EQ(image[2u + 3u], 0x05u);
+}
+
+TEST_F(LinkerTests, givenProgramWhenLinkedAloneThenFlatAssemblyIsMatched) {
+    std::ifstream file("programs/4bit_and_subroutine.asm");
+    std::string text((std::istreambuf_iterator<char>(file)), std::istreambuf_iterator<char>());
+    ASSERT_FALSE(text.empty());
+
+    std::vector<uint8_t> flat, linked;
+    ASSERT_TRUE(assembler.assemble(std::string_view(text), flat));
+    addModule("4bit_and_subroutine", text);
+    ASSERT_TRUE(linker.link(linked)) << linker.getError();
+    EXPECT_EQ(linked, flat);
+}
+
+TEST_F(LinkerTests, givenBadModulesWhenLinkingThenErrorIsReported) {
+    std::vector<uint8_t> image;
+    addModule("a", "  jms MISSING\n");
+    EXPECT_FALSE(linker.link(image));
+    EXPECT_EQ(linker.getError(), "a: line 1: undefined symbol 'MISSING'");
+
+    linker.clear();
+    addModule("a", "  .GLOBAL X\nX nop\n");
+    addModule("b", "  .GLOBAL X\nX nop\n");
+    EXPECT_FALSE(linker.link(image));
+    EXPECT_EQ(linker.getError(), "b: global symbol defined twice 'X'");
+
+    linker.clear();
+    addModule("a", "*=$FE\n  jcn %0100, THERE\n");
+    addModule("b", "  .GLOBAL THERE\nTHERE nop\n");
+    EXPECT_FALSE(linker.link(image));
+    EXPECT_EQ(linker.getError(), "a: line 2: short branch leaves its page 'THERE'");
+
+    linker.clear();
+    addModule("a", "*=0\n  nop\n");
+    addModule("b", "*=0\n  nop\n");
+    EXPECT_FALSE(linker.link(image));
+    EXPECT_EQ(linker.getError(), "b: section overlaps another '*=0'");
+
+    ObjectModule module;
+    EXPECT_FALSE(assembler.assembleObject(std::string_view("  .GLOBAL NOPE\n"), module));
+    EXPECT_EQ(assembler.getError(), "line 1: global symbol not defined 'NOPE'");
+
+    EXPECT_FALSE(assembler.assembleObject(std::string_view("*=$FFF\n  jun 0\n"), module));
+    EXPECT_EQ(assembler.getError(), "section does not fit in 4 KiB '*=4095'");
+}
+
+namespace {
+
+std::string nops(int count)
+{
+    std::string text;
+    for (int i = 0; i < count; ++i)
+        text += "  nop\n";
+    return text;
+}
+
+} // namespace
+
+TEST_F(LinkerTests, givenShortBranchesWhenPlacingThenSectionsShareAPage) {
+    // In module order B lands on the next page and A needs a trampoline
+    addModule("a", ".SECTION A\n  jcn %0100, B\n" + nops(198) + ".SECTION FILL\n" + nops(50));
+    addModule("b", "  .GLOBAL B\nB bbl 0\n" + nops(39));
+    linker.setBranchWeight("B", 10u);
+
+    std::vector<uint8_t> image;
+    ASSERT_TRUE(linker.link(image)) << linker.getError();
+    ASSERT_EQ(linker.getPlacements().size(), 3u);
+    EXPECT_EQ(linker.getPlacements()[0].address, 0x000u);
+    EXPECT_EQ(linker.getPlacements()[1].address, 0x100u);
+    EXPECT_EQ(linker.getPlacements()[2].address, 0x0C8u);
+    EXPECT_EQ(image[2u + 1u], 0xC8u);
+
+    const Linker::PlacementReport& report = linker.getReport();
+    EXPECT_EQ(report.branches, 1u);
+    EXPECT_EQ(report.trampolines, 0u);
+    EXPECT_EQ(report.baselineTrampolines, 1u);
+    EXPECT_EQ(report.bytesSaved, 2);
+    EXPECT_EQ(report.cyclesSaved, 20);
+}
+
+TEST_F(LinkerTests, givenBranchToAnotherPageWhenLinkingThenTrampolineIsUsed) {
+    addModule("a", "  jcn %0100, B\n  isz r0, B\n" + nops(196));
+    addModule("b", "  .GLOBAL B\nB bbl 0\n" + nops(99));
+
+    std::vector<uint8_t> image;
+    ASSERT_TRUE(linker.link(image)) << linker.getError();
+    ASSERT_EQ(linker.getPlacements().size(), 2u);
+    EXPECT_EQ(linker.getPlacements()[0].trampolines, 1u);
+    EXPECT_EQ(linker.getPlacements()[1].address, 0x100u);
+    EXPECT_EQ(image[2u + 1u], 0xC8u);  // Both go through the JUN after the code
+    EXPECT_EQ(image[2u + 3u], 0xC8u);
+    EXPECT_EQ(image[2u + 0xC8u], 0x41u);
+    EXPECT_EQ(image[2u + 0xC9u], 0x00u);
+    EXPECT_EQ(linker.getReport().trampolines, 1u);
+    EXPECT_EQ(linker.getReport().bytesSaved, 0);
+}
@@ -0,0 +1,233 @@
+#include <emulator_core/source/busicom_calculator.hpp>
+
+#include "busicom_boot_snapshot.hpp"
+
+#include <algorithm>
+#include <atomic>
+#include <cstdlib>
+#include <cstring>
+#include <fstream>
+#include <iostream>
+#include <memory>
+#include <string>
+#include <thread>
+#include <vector>
+
+const char* helpMessage =
+R"=(Busicom 141-PF batch calculator.
+
+Usage:
+busicom_batch [-h|--help]
+or
+busicom_batch [options] [script_file]
+
+Reads one calculation per line from script_file, or stdin when it is missing
+or "-", types it on an emulated Busicom 141-PF and writes one result line per
+input line, in input order:
+
+<script><TAB><printed line>; <printed line>; ...
+
+Printed lines are the digits followed by the column 17/18 symbols, lines
+printed in red are prefixed with '-'. Blank lines and lines starting with '#'
+are copied unchanged. Failed calculations print ERROR and the reason.
+
+Script keys (whitespace separated, numbers may be typed as one token):
+0-9 . 00 000 + - * x / = % SQRT <> C CE S EX CM RM M+ M- M=+ M=-
+The adding machine totals with "=" after "+"/"-" entries: 2 + 3 + =
+
+Every calculation starts from the state of a freshly booted calculator,
+restored from a snapshot taken at build time.
+
+Options:
+-rom <file>  - boot this ASCII hex object file instead of the built-in ROM.
+-jobs <n>    - worker threads. Default: number of hardware threads.
+-last        - print only the last printed line of each calculation.
+-o <file>    - write results to <file> instead of stdout.
+-hle <mode>  - number register routines: off (default), native, or validate
+               (run both, count differences on stderr, exit with 1 on any).
+)=";
+
+const char* errorMessage = "Invalid arguments. Use -h or --help to see usage hints.\n";
+
+struct Options {
+    std::string romFile;
+    std::string scriptFile;
+    std::string outputFile;
+    unsigned jobs = 0u;
+    bool lastOnly = false;
+    HLEHookTable::Mode hleMode = HLEHookTable::Mode::Off;
+};
+
+// Calculations handed to the workers at once, results are written after each chunk
+constexpr size_t CHUNK_LINES_PER_JOB = 64u;
+
+bool parseArguments(int argc, const char* argv[], Options& options)
+{
+    for (int i = 1; i < argc; ++i) {
+        bool hasValue = i + 1 < argc;
+        if (strcmp(argv[i], "-rom") == 0 && hasValue)
+            options.romFile = argv[++i];
+        else if (strcmp(argv[i], "-jobs") == 0 && hasValue)
+            options.jobs = static_cast<unsigned>(std::strtoul(argv[++i], nullptr, 10));
+        else if (strcmp(argv[i], "-o") == 0 && hasValue)
+            options.outputFile = argv[++i];
+        else if (strcmp(argv[i], "-hle") == 0 && hasValue) {
+            ++i;
+            if (strcmp(argv[i], "off") == 0)
+                options.hleMode = HLEHookTable::Mode::Off;
+            else if (strcmp(argv[i], "native") == 0)
+                options.hleMode = HLEHookTable::Mode::Native;
+            else if (strcmp(argv[i], "validate") == 0)
+                options.hleMode = HLEHookTable::Mode::Validate;
+            else
+                return false;
+        }
+        else if (strcmp(argv[i], "-last") == 0)
+            options.lastOnly = true;
+        else if ((argv[i][0] != '-' || strcmp(argv[i], "-") == 0) && options.scriptFile.empty())
+            options.scriptFile = argv[i];
+        else
+            return false;
+    }
+
+    if (options.jobs == 0u)
+        options.jobs = std::max(1u, std::thread::hardware_concurrency());
+    return true;
+}
+
+std::string calculate(BusicomCalculator& calculator, const BusicomCalculator::Snapshot& boot,
+                      const std::string& script, bool lastOnly)
+{
+    size_t start = script.find_first_not_of(" \t\r");
+    if (start == std::string::npos || script[start] == '#')
+        return script;
+
+    std::vector<uint8_t> scanCodes;
+    if (!BusicomCalculator::parseKeys(script, scanCodes))
+        return script + "\tERROR unknown key";
+
+    calculator.loadSnapshot(boot);
+
+    for (uint8_t scanCode : scanCodes) {
+        if (!calculator.typeKey(scanCode))
+            return script + "\tERROR timeout";
+    }
+
+    const PrinterRingSink& lines = calculator.getPrintedLines();
+    std::string result = script + '\t';
+    char text[PrinterLine::MAX_TEXT];
+    for (size_t i = lastOnly && !lines.empty() ? lines.size() - 1u : 0u; i < lines.size(); ++i) {
+        if (i > 0u && !lastOnly)
+            result += "; ";
+        result.append(text, formatPrinterLine(lines[i], text, sizeof(text)));
+    }
+    return result;
+}
+
+// Runs a chunk of scripts on all calculators, results keep the input order
+void calculateChunk(std::vector<std::unique_ptr<BusicomCalculator>>& calculators, const BusicomCalculator::Snapshot& boot,
+                    const std::vector<std::string>& scripts, std::vector<std::string>& results, bool lastOnly)
+{
+    results.assign(scripts.size(), {});
+    std::atomic<size_t> next{ 0u };
+
+    auto worker = [&](BusicomCalculator& calculator) {
+        for (size_t i = next++; i < scripts.size(); i = next++)
+            results[i] = calculate(calculator, boot, scripts[i], lastOnly);
+    };
+
+    std::vector<std::thread> threads;
+    for (size_t job = 1u; job < calculators.size() && job < scripts.size(); ++job)
+        threads.emplace_back(worker, std::ref(*calculators[job]));
+    worker(*calculators[0]);
+
+    for (std::thread& thread : threads)
+        thread.join();
+}
+
+int main(int argc, const char* argv[])
+{
+    if (argc > 1 && (strcmp(argv[1], "-h") == 0 || strcmp(argv[1], "--help") == 0)) {
+        std::cout << helpMessage;
+        return 0;
+    }
+
+    Options options;
+    if (!parseArguments(argc, argv, options)) {
+        std::cout << errorMessage;
+        return -1;
+    }
+
+    std::vector<std::unique_ptr<BusicomCalculator>> calculators;
+    for (unsigned job = 0u; job < options.jobs; ++job) {
+        calculators.push_back(std::make_unique<BusicomCalculator>());
+        calculators.back()->setHLEMode(options.hleMode);
+    }
+
+    auto boot = std::make_unique<BusicomCalculator::Snapshot>();
+    if (options.romFile.empty()) {
+        if (!calculators[0]->loadSnapshot(BUSICOM_BOOT_SNAPSHOT, sizeof(BUSICOM_BOOT_SNAPSHOT))) {
+            std::cerr << "Built-in snapshot does not match this build\n";
+            return -1;
+        }
+    }
+    else if (!calculators[0]->loadROMFile(options.romFile) || !calculators[0]->boot()) {
+        std::cerr << "Failed to boot " << options.romFile << '\n';
+        return -1;
+    }
+    calculators[0]->saveSnapshot(*boot);
+
+    std::ifstream scriptFile;
+    if (!options.scriptFile.empty() && options.scriptFile != "-") {
+        scriptFile.open(options.scriptFile);
+        if (!scriptFile) {
+            std::cerr << "Failed to open " << options.scriptFile << '\n';
+            return -1;
+        }
+    }
+    std::istream& in = scriptFile.is_open() ? scriptFile : std::cin;
+
+    std::ofstream outputFile;
+    if (!options.outputFile.empty()) {
+        outputFile.open(options.outputFile);
+        if (!outputFile) {
+            std::cerr << "Failed to open " << options.outputFile << '\n';
+            return -1;
+        }
+    }
+    std::ostream& out = outputFile.is_open() ? outputFile : std::cout;
+
+    std::vector<std::string> scripts;
+    std::vector<std::string> results;
+    std::string line;
+    bool endOfInput = false;
+    while (!endOfInput) {
+        scripts.clear();
+        while (scripts.size() < CHUNK_LINES_PER_JOB * calculators.size()) {
+            if (!std::getline(in, line)) {
+                endOfInput = true;
+                break;
+            }
+            scripts.push_back(line);
+        }
+
+        calculateChunk(calculators, *boot, scripts, results, options.lastOnly);
+        for (const std::string& result : results)
+            out << result << '\n';
+        out.flush();
+    }
+
+    if (options.hleMode == HLEHookTable::Mode::Validate) {
+        uint64_t validated = 0u;
+        uint64_t mismatches = 0u;
+        for (const auto& calculator : calculators) {
+            validated += calculator->getHooks().getValidatedCalls();
+            mismatches += calculator->getHooks().getMismatches();
+        }
+        std::cerr << "HLE: " << validated << " calls validated, " << mismatches << " mismatches\n";
+        if (mismatches > 0u)
+            return 1;
+    }
+
+    return 0;
+}
@@ -0,0 +1,71 @@
+#include <emulator_core/source/busicom_calculator.hpp>
+
+#include <cstdio>
+#include <cstring>
+#include <fstream>
+#include <iostream>
+#include <memory>
+
+const char* helpMessage =
+R"=(Busicom 141-PF post-boot snapshot generator.
+
+Usage:
+busicom_snapshot [-h|--help]
+or
+busicom_snapshot <rom_file> <output_file>
+
+Boots the ROM (ASCII hex object file) until it waits in its idle keyboard loop
+and writes the machine state as a C++ header defining
+BUSICOM_BOOT_SNAPSHOT, a constexpr byte array that
+BusicomCalculator::loadSnapshot restores. The build runs this tool, so the
+array always matches the Snapshot layout of the binary embedding it.
+)=";
+
+const char* errorMessage = "Invalid arguments. Use -h or --help to see usage hints.\n";
+
+int main(int argc, const char* argv[])
+{
+    if (argc > 1 && (strcmp(argv[1], "-h") == 0 || strcmp(argv[1], "--help") == 0)) {
+        std::cout << helpMessage;
+        return 0;
+    }
+
+    if (argc != 3) {
+        std::cout << errorMessage;
+        return -1;
+    }
+
+    auto calculator = std::make_unique<BusicomCalculator>();
+    if (!calculator->loadROMFile(argv[1])) {
+        std::cerr << "Failed to load " << argv[1] << '\n';
+        return -1;
+    }
+    if (!calculator->boot()) {
+        std::cerr << "ROM did not reach its idle loop\n";
+        return -1;
+    }
+
+    // Value-initialised so padding bytes are zero and the output is reproducible
+    auto snapshot = std::make_unique<BusicomCalculator::Snapshot>();
+    calculator->saveSnapshot(*snapshot);
+    const uint8_t* bytes = reinterpret_cast<const uint8_t*>(snapshot.get());
+
+    std::ofstream fout(argv[2]);
+    if (!fout) {
+        std::cerr << "Failed to open " << argv[2] << '\n';
+        return -1;
+    }
+
+    fout << "// Generated by busicom_snapshot from " << argv[1] << ", do not edit\n"
+         << "#pragma once\n"
+         << "#include <cstdint>\n\n"
+         << "inline constexpr uint8_t BUSICOM_BOOT_SNAPSHOT[" << sizeof(BusicomCalculator::Snapshot) << "] = {";
+    for (size_t i = 0u; i < sizeof(BusicomCalculator::Snapshot); ++i) {
+        char hex[8];
+        std::snprintf(hex, sizeof(hex), "0x%02X,", bytes[i]);
+        fout << (i % 16u == 0u ? "\n    " : " ") << hex;
+    }
+    fout << "\n};\n";
+
+    return fout.good() ? 0 : -1;
+}
@@ -0,0 +1,135 @@
+#include <emulator_core/source/ascii_hex_parser.hpp>
+#include <emulator_core/source/cycle_analyzer.hpp>
+
+#include <cstdlib>
+#include <cstring>
+#include <fstream>
+#include <iomanip>
+#include <iostream>
+#include <iterator>
+#include <string>
+#include <vector>
+
+const char* helpMessage =
+R"=(Static best and worst case cycle counts of 4004 and 4040 routines.
+
+Usage:
+cycle_analyzer [-h|--help]
+or
+cycle_analyzer [options] <rom_file>
+
+Follows every path of the routines in <rom_file>, as assembled (binary) or as
+ASCII hex (.obj), from the entries and every JMS target, and prints the
+fewest and most instruction cycles each takes to return, in total and per
+BBL/BBS. A routine whose worst case cannot be proven says why.
+
+Options:
+-entry <address>  - a routine entry, may be repeated. Default: $000.
+-bounds <file>    - "address iterations" per line: the most times the loop
+                    headed at address runs each time it is entered. Addresses
+                    are $hex, 0xhex or decimal, lines starting with ';' are
+                    comments. Loops closed by ISZ on a register nothing else
+                    in the loop writes need none.
+)=";
+
+const char* errorMessage = "Invalid arguments. Use -h or --help to see usage hints.\n";
+
+struct Options {
+    std::string romFile;
+    std::string boundsFile;
+    std::vector<uint16_t> entries;
+};
+
+bool parseArguments(int argc, const char* argv[], Options& options)
+{
+    for (int i = 1; i < argc; ++i) {
+        bool hasValue = i + 1 < argc;
+        if (strcmp(argv[i], "-entry") == 0 && hasValue) {
+            const char* text = argv[++i];
+            int base = 0;
+            if (text[0] == '$')
+                ++text, base = 16;
+            char* end = nullptr;
+            unsigned long address = std::strtoul(text, &end, base);
+            if (*text == '\0' || *end != '\0' || address > 0x0FFFu)
+                return false;
+            options.entries.push_back(static_cast<uint16_t>(address));
+        }
+        else if (strcmp(argv[i], "-bounds") == 0 && hasValue)
+            options.boundsFile = argv[++i];
+        else if (argv[i][0] != '-' && options.romFile.empty())
+            options.romFile = argv[i];
+        else
+            return false;
+    }
+    return !options.romFile.empty();
+}
+
+// The program without the metal mask header, empty when the file is not a ROM image
+std::vector<uint8_t> readImage(const std::string& filename)
+{
+    std::vector<uint8_t> bytes;
+    std::ifstream file(filename, std::ios_base::binary);
+    if (file)
+        bytes.assign(std::istreambuf_iterator<char>(file), std::istreambuf_iterator<char>());
+    if (!bytes.empty() && bytes[0] != 0xFEu)
+        bytes = parseAsciiHexFile(filename);
+
+    size_t i = 1u;
+    while (i < bytes.size() && bytes[i] != 0xFFu)
+        i += 2u;
+    if (bytes.empty() || bytes[0] != 0xFEu || i >= bytes.size())
+        return {};
+    return std::vector<uint8_t>(bytes.begin() + i + 1, bytes.end());
+}
+
+std::string formatCycles(uint64_t cycles)
+{
+    return cycles == CycleAnalyzer::UNBOUNDED ? "-" : std::to_string(cycles);
+}
+
+int main(int argc, const char* argv[])
+{
+    if (argc > 1 && (strcmp(argv[1], "-h") == 0 || strcmp(argv[1], "--help") == 0)) {
+        std::cout << helpMessage;
+        return 0;
+    }
+
+    Options options;
+    if (!parseArguments(argc, argv, options)) {
+        std::cout << errorMessage;
+        return -1;
+    }
+
+    std::vector<uint8_t> image = readImage(options.romFile);
+    if (image.empty()) {
+        std::cerr << "Failed to open " << options.romFile << '\n';
+        return -1;
+    }
+
+    CycleAnalyzer analyzer;
+    for (uint16_t entry : options.entries)
+        analyzer.addEntry(entry);
+    std::string error;
+    if (!options.boundsFile.empty() && !analyzer.loadLoopBounds(options.boundsFile.c_str(), error)) {
+        std::cerr << options.boundsFile << ": " << error << '\n';
+        return -1;
+    }
+    analyzer.analyze(image.data(), image.size());
+
+    int retVal = 0;
+    std::cout << std::hex << std::uppercase << std::setfill('0');
+    for (const CycleAnalyzer::Routine& routine : analyzer.getRoutines()) {
+        std::cout << '$' << std::setw(3) << routine.entry << ": best " << formatCycles(routine.best) << ", worst "
+                  << formatCycles(routine.worst);
+        if (!routine.problem.empty()) {
+            std::cout << " (" << routine.problem << ')';
+            retVal = 1;
+        }
+        std::cout << '\n';
+        for (const CycleAnalyzer::Exit& exit : routine.exits)
+            std::cout << "  return at $" << std::setw(3) << exit.address << ": best " << formatCycles(exit.best)
+                      << ", worst " << formatCycles(exit.worst) << '\n';
+    }
+    return retVal;
+}
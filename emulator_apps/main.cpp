@@ -1,26 +1,304 @@
+#include <assembler/source/assembler.hpp>
 #include <emulator_core/source/rom.hpp>
 #include <emulator_core/source/ram.hpp>
 #include <emulator_core/source/K4004.hpp>
+#include <emulator_core/source/K4040.hpp>
+#include <emulator_core/source/K4201A.hpp>
+#include <emulator_core/source/ascii_hex_parser.hpp>
+#include <emulator_core/source/realtime_pacer.hpp>
+
+#include <cctype>
+#include <cerrno>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <fstream>
+#include <iostream>
+#include <iterator>
+#include <memory>
+#include <string>
+#include <vector>
+
+const char* helpMessage =
+R"=(Kostu96 Intel 4004 and 4040 emulator.
+
+Usage:
+mcs4_emulator [-h|--help]
+or
+mcs4_emulator [options] <program_file>
+
+Program file:
+.asm      - assembled for the selected device before loading.
+.obj/.hex - ASCII hex object code, one byte per line (Busicom format).
+other     - binary object code as written by the assembler.
+
+Options:
+-device <device> - i4004 or i4040. Default value is i4004.
+-cycles <n>      - stop after n instruction cycles.
+-until-pc <addr> - stop when execution reaches hex address <addr>.
+-realtime        - pace execution at the K4201A clock rate (5.185 MHz / 7).
+-turbo           - run as fast as possible (default).
+-stats           - print cycles, instructions, elapsed time and MIPS.
+-dump-ram        - print RAM characters, status characters and output ports.
+-dump-ports      - print ROM I/O ports.
+
+Execution always stops when a 4040 halts, nothing in this machine raises INT.
+Without -cycles or -until-pc the program runs until HLT or forever.
+)=";
+
+const char* errorMessage = "Invalid arguments. Use -h or --help to see usage hints.\n";
+
+struct Options {
+    std::string programFile;
+    bool i4040 = false;
+    bool realTime = false;
+    bool stats = false;
+    bool dumpRAM = false;
+    bool dumpPorts = false;
+    uint64_t maxCycles = UINT64_MAX;
+    int untilPC = -1;
+};
 
 class MCS4 {
 public:
-    MCS4() : m_cpu{ m_ROM, m_RAM } {}
+    explicit MCS4(bool i4040) {
+        if (i4040)
+            m_cpu4040 = std::make_unique<K4040>(m_ROM, m_RAM);
+        else
+            m_cpu4004 = std::make_unique<K4004>(m_ROM, m_RAM);
+    }
+
+    bool load(const std::string& filename) {
+        std::vector<uint8_t> bytecode;
+        std::string extension = filename.substr(filename.find_last_of('.') + 1);
+
+        if (extension == "asm") {
+            Assembler assembler;
+            if (!assembler.assemble(filename.c_str(), bytecode, m_cpu4004 != nullptr))
+                return false;
+        }
+        else if (extension == "obj" || extension == "hex") {
+            bytecode = parseAsciiHexFile(filename);
+        }
+        else {
+            std::ifstream fin(filename, std::ios_base::binary);
+            bytecode.assign(std::istreambuf_iterator<char>(fin), std::istreambuf_iterator<char>());
+        }
 
-    void clock() {
-        m_cpu.clock();
+        return m_ROM.load(bytecode.data(), bytecode.size());
     }
+
+    // Executes one instruction, returns its cycles (0 when halted)
+    uint8_t step() {
+        return m_cpu4004 ? m_cpu4004->clock() : m_cpu4040->step();
+    }
+
+    uint64_t getCycleCount() const { return m_cpu4004 ? m_cpu4004->getCycleCount() : m_cpu4040->getCycleCount(); }
+    uint16_t getPC() const { return m_cpu4004 ? m_cpu4004->getPC() : m_cpu4040->getPC(); }
+    bool isHalted() const { return m_cpu4040 && m_cpu4040->isWaitingForInterrupt(); }
+
+    const ROM& getROM() const { return m_ROM; }
+    const RAM& getRAM() const { return m_RAM; }
+    const K4201A& getClockGen() const { return m_clockGen; }
+
 private:
     ROM m_ROM;
     RAM m_RAM;
-    K4004 m_cpu;
+    K4201A m_clockGen;
+    std::unique_ptr<K4004> m_cpu4004;
+    std::unique_ptr<K4040> m_cpu4040;
 };
 
-int main()
+class Runner {
+public:
+    Runner(MCS4& machine, const Options& options) :
+        m_machine(machine),
+        m_options(options) {}
+
+    bool shouldStop() const {
+        return m_machine.getCycleCount() >= m_options.maxCycles ||
+            (m_instructions > 0u && m_machine.getPC() == m_options.untilPC) ||
+            m_machine.isHalted();
+    }
+
+    // Run until targetCycle or a stop condition, returns the cycle count reached
+    uint64_t runTo(uint64_t targetCycle) {
+        while (m_machine.getCycleCount() < targetCycle && !shouldStop()) {
+            m_machine.step();
+            ++m_instructions;
+        }
+        return m_machine.getCycleCount();
+    }
+
+    void run() {
+        if (m_options.realTime) {
+            RealTimePacer pacer(m_machine.getClockGen());
+            pacer.run([this](uint64_t targetCycle) { return runTo(targetCycle); },
+                      [this] { return !shouldStop(); });
+            m_pacerStats = pacer.getStats();
+        }
+        else {
+            runTo(UINT64_MAX);
+        }
+    }
+
+    uint64_t getInstructions() const { return m_instructions; }
+    const RealTimePacer::Stats& getPacerStats() const { return m_pacerStats; }
+
+private:
+    MCS4& m_machine;
+    const Options& m_options;
+    uint64_t m_instructions = 0u;
+    RealTimePacer::Stats m_pacerStats;
+};
+
+// Whole argument as an unsigned number in base up to max, no sign or spaces
+bool parseNumber(const char* text, int base, uint64_t max, uint64_t& value)
 {
-    MCS4 app;
+    if (!std::isxdigit(static_cast<unsigned char>(text[0])))
+        return false;
+    char* end = nullptr;
+    errno = 0;
+    unsigned long long number = std::strtoull(text, &end, base);
+    if (*end != '\0' || errno == ERANGE || number > max)
+        return false;
+    value = number;
+    return true;
+}
+
+bool parseArguments(int argc, const char* argv[], Options& options)
+{
+    for (int i = 1; i < argc; ++i) {
+        bool hasValue = i + 1 < argc;
+        if (strcmp(argv[i], "-device") == 0 && hasValue) {
+            const char* device = argv[++i];
+            if (strcmp(device, "i4040") == 0)
+                options.i4040 = true;
+            else if (strcmp(device, "i4004") != 0)
+                return false;
+        }
+        else if (strcmp(argv[i], "-cycles") == 0 && hasValue) {
+            if (!parseNumber(argv[++i], 10, UINT64_MAX, options.maxCycles))
+                return false;
+        }
+        else if (strcmp(argv[i], "-until-pc") == 0 && hasValue) {
+            uint64_t address;
+            if (!parseNumber(argv[++i], 16, 0x0FFFu, address))
+                return false;
+            options.untilPC = static_cast<int>(address);
+        }
+        else if (strcmp(argv[i], "-realtime") == 0)
+            options.realTime = true;
+        else if (strcmp(argv[i], "-turbo") == 0)
+            options.realTime = false;
+        else if (strcmp(argv[i], "-stats") == 0)
+            options.stats = true;
+        else if (strcmp(argv[i], "-dump-ram") == 0)
+            options.dumpRAM = true;
+        else if (strcmp(argv[i], "-dump-ports") == 0)
+            options.dumpPorts = true;
+        else if (argv[i][0] != '-' && options.programFile.empty())
+            options.programFile = argv[i];
+        else
+            return false;
+    }
+
+    return !options.programFile.empty();
+}
+
+void printStats(const MCS4& machine, const Runner& runner, bool realTime, double seconds)
+{
+    uint64_t cycles = machine.getCycleCount();
+    uint64_t instructions = runner.getInstructions();
+    double emulatedSeconds = cycles * 8.0 / machine.getClockGen().getOutputFrequency();
+
+    std::printf("Stopped at PC:   %03X%s\n", machine.getPC(), machine.isHalted() ? " (halted)" : "");
+    std::printf("Cycles:          %llu\n", static_cast<unsigned long long>(cycles));
+    std::printf("Instructions:    %llu\n", static_cast<unsigned long long>(instructions));
+    std::printf("Host time:       %.3f s\n", seconds);
+    std::printf("Emulated time:   %.3f s\n", emulatedSeconds);
+    if (seconds > 0.0) {
+        std::printf("MIPS:            %.3f\n", instructions / seconds / 1e6);
+        std::printf("Speed:           %.2fx real hardware\n", emulatedSeconds / seconds);
+    }
+
+    if (realTime) {
+        const auto& pacer = runner.getPacerStats();
+        std::printf("Slices:          %llu (%llu late, %llu resyncs)\n",
+            static_cast<unsigned long long>(pacer.slices),
+            static_cast<unsigned long long>(pacer.lateSlices),
+            static_cast<unsigned long long>(pacer.resyncs));
+        std::printf("Drift:           avg %lld ns, max %lld ns\n",
+            static_cast<long long>(pacer.getAverageDriftNs()), static_cast<long long>(pacer.maxDriftNs));
+    }
+}
+
+void dumpRAM(const RAM& ram)
+{
+    const uint8_t* chars = ram.getRamContents();
+    const uint8_t* status = ram.getStatusContents();
+    const uint8_t* outputs = ram.getOutputContents();
+
+    for (uint16_t bank = 0u; bank < RAM::NUM_RAM_BANKS; ++bank) {
+        for (uint16_t chip = 0u; chip < RAM::NUM_RAM_CHIPS; ++chip) {
+            for (uint16_t reg = 0u; reg < RAM::NUM_RAM_REGS; ++reg) {
+                uint16_t index = (bank * RAM::NUM_RAM_CHIPS + chip) * RAM::NUM_RAM_REGS + reg;
+                std::printf("RAM B%u C%u R%u: ", bank, chip, reg);
+                for (uint16_t c = 0u; c < RAM::NUM_REG_CHARS; ++c)
+                    std::printf("%X", chars[index * RAM::NUM_REG_CHARS + c]);
+                std::printf(" S:");
+                for (uint16_t s = 0u; s < RAM::NUM_STAUS_CHARS; ++s)
+                    std::printf("%X", status[index * RAM::NUM_STAUS_CHARS + s]);
+                std::printf("\n");
+            }
+        }
+    }
+
+    std::printf("RAM output ports:");
+    for (uint16_t port = 0u; port < RAM::OUTPUT_SIZE; ++port)
+        std::printf(" %X", outputs[port]);
+    std::printf("\n");
+}
+
+void dumpPorts(const ROM& rom)
+{
+    std::printf("ROM I/O ports:   ");
+    for (uint8_t chip = 0u; chip < ROM::NUM_ROM_CHIPS; ++chip)
+        std::printf(" %X", rom.getIOPort(chip));
+    std::printf("\n");
+}
+
+int main(int argc, const char* argv[])
+{
+    if (argc > 1 && (strcmp(argv[1], "-h") == 0 || strcmp(argv[1], "--help") == 0)) {
+        std::cout << helpMessage;
+        return 0;
+    }
+
+    Options options;
+    if (!parseArguments(argc, argv, options)) {
+        std::cout << errorMessage;
+        return -1;
+    }
+
+    MCS4 app(options.i4040);
+    if (!app.load(options.programFile)) {
+        std::cerr << "Failed to load " << options.programFile << '\n';
+        return -1;
+    }
+
+    Runner runner(app, options);
+    auto start = std::chrono::steady_clock::now();
+    runner.run();
+    double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
 
-    while (true)
-        app.clock();
+    if (options.stats)
+        printStats(app, runner, options.realTime, seconds);
+    if (options.dumpRAM)
+        dumpRAM(app.getRAM());
+    if (options.dumpPorts)
+        dumpPorts(app.getROM());
 
     return 0;
 }
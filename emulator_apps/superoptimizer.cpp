@@ -0,0 +1,389 @@
+#include <assembler/source/peephole.hpp>
+#include <emulator_core/source/instructions.hpp>
+#include <shared/source/assembly.hpp>
+
+#include <algorithm>
+#include <array>
+#include <atomic>
+#include <cstdlib>
+#include <cstring>
+#include <fstream>
+#include <iostream>
+#include <set>
+#include <string>
+#include <thread>
+#include <vector>
+
+const char* helpMessage =
+R"=(Superoptimizer for short 4004 instruction sequences.
+
+Usage:
+superoptimizer [-h|--help]
+or
+superoptimizer [options] <database_file>
+
+Looks for the cheapest sequence of one-byte instructions that leaves ACC, CY
+and every register as a target sequence does, for every possible input, and
+writes each one found as a rewrite for assembler -rewrites:
+
+LD Ra / XCH Ra -> LD Ra
+
+Candidates are tried from the shortest up and checked on a few inputs first,
+the ones passing are run on all of them using the emulator's instruction
+implementations. They use LDM, LD, XCH, ADD, SUB, INC and the accumulator
+group except NOP, which programs keep for timing.
+
+Options:
+-targets <file>  - one sequence of up to 5 instructions per line, in the form
+                   above, registers Ra-Re. Lines starting with ';' are skipped.
+-enumerate <n>   - every sequence of up to n instructions (at most 3) over
+                   Ra-Rc, except ones holding a shorter sequence already
+                   rewritten. Used when -targets is not given, n defaults to 2.
+-jobs <n>        - worker threads. Default: number of hardware threads.
+)=";
+
+const char* errorMessage = "Invalid arguments. Use -h or --help to see usage hints.\n";
+
+struct Options {
+    std::string targetsFile;
+    std::string databaseFile;
+    size_t enumerateLength = 2u;
+    unsigned jobs = 0u;
+};
+
+constexpr size_t MAX_TARGET_LENGTH = Peephole::WINDOW_SIZE;
+constexpr size_t MAX_ENUMERATE_LENGTH = 3u;
+constexpr uint8_t MAX_VARIABLES = 5u;  // Registers R0-R4 stand for Ra-Re
+constexpr size_t QUICK_INPUTS = 24u;
+
+// Inputs to the sequences, ACC holds CY in bit 4 as in K4004
+struct State {
+    uint8_t acc;
+    uint8_t registers[(MAX_VARIABLES + 1u) / 2u];
+
+    bool operator==(const State& other) const
+    {
+        return acc == other.acc && std::equal(registers, registers + std::size(registers), other.registers);
+    }
+};
+
+struct Target {
+    std::vector<uint8_t> pattern;
+    std::vector<uint8_t> replacement;
+    bool found = false;
+};
+
+bool parseArguments(int argc, const char* argv[], Options& options)
+{
+    for (int i = 1; i < argc; ++i) {
+        bool hasValue = i + 1 < argc;
+        if (strcmp(argv[i], "-targets") == 0 && hasValue)
+            options.targetsFile = argv[++i];
+        else if (strcmp(argv[i], "-enumerate") == 0 && hasValue)
+            options.enumerateLength = static_cast<size_t>(std::strtoul(argv[++i], nullptr, 10));
+        else if (strcmp(argv[i], "-jobs") == 0 && hasValue)
+            options.jobs = static_cast<unsigned>(std::strtoul(argv[++i], nullptr, 10));
+        else if (argv[i][0] != '-' && options.databaseFile.empty())
+            options.databaseFile = argv[i];
+        else
+            return false;
+    }
+
+    if (options.jobs == 0u)
+        options.jobs = std::max(1u, std::thread::hardware_concurrency());
+    return !options.databaseFile.empty() && options.enumerateLength >= 1u &&
+           options.enumerateLength <= MAX_ENUMERATE_LENGTH;
+}
+
+void execute(uint8_t byte, State& state)
+{
+    uint8_t* registers = state.registers;
+    switch (getOpcodeFromByte(byte)) {
+    case +AsmIns::LDM: LDM(state.acc, byte); break;
+    case +AsmIns::LD: LD(state.acc, registers, byte); break;
+    case +AsmIns::XCH: XCH(state.acc, registers, byte); break;
+    case +AsmIns::ADD: ADD(state.acc, registers, byte); break;
+    case +AsmIns::SUB: SUB(state.acc, registers, byte); break;
+    case +AsmIns::INC: INC(registers, byte); break;
+    case +AsmIns::CLB: CLB(state.acc); break;
+    case +AsmIns::CLC: CLC(state.acc); break;
+    case +AsmIns::IAC: IAC(state.acc); break;
+    case +AsmIns::CMC: CMC(state.acc); break;
+    case +AsmIns::CMA: CMA(state.acc); break;
+    case +AsmIns::RAL: RAL(state.acc); break;
+    case +AsmIns::RAR: RAR(state.acc); break;
+    case +AsmIns::TCC: TCC(state.acc); break;
+    case +AsmIns::DAC: DAC(state.acc); break;
+    case +AsmIns::TCS: TCS(state.acc); break;
+    case +AsmIns::STC: STC(state.acc); break;
+    case +AsmIns::DAA: DAA(state.acc); break;
+    case +AsmIns::KBP: KBP(state.acc); break;
+    default: break;
+    }
+}
+
+State run(const uint8_t* bytes, size_t size, State state)
+{
+    for (size_t i = 0u; i < size; ++i)
+        execute(bytes[i], state);
+    return state;
+}
+
+// Input number index of the 32 << 4 * variables there are
+State makeInput(uint64_t index, uint8_t variables)
+{
+    State state{ static_cast<uint8_t>(index & 0x1Fu), {} };
+    index >>= 5;
+    for (uint8_t reg = 0u; reg < variables; ++reg, index >>= 4)
+        setRegisterValue(state.registers, reg, static_cast<uint8_t>(index & 0x0Fu));
+    return state;
+}
+
+bool isSupported(uint8_t byte)
+{
+    uint8_t opcode = getOpcodeFromByte(byte);
+    if (Peephole::hasRegisterOperand(byte) || opcode == +AsmIns::LDM)
+        return true;
+    return opcode >= +AsmIns::CLB && opcode <= +AsmIns::KBP;
+}
+
+uint8_t countVariables(const std::vector<uint8_t>& bytes)
+{
+    uint8_t variables = 0u;
+    for (uint8_t byte : bytes)
+        if (Peephole::hasRegisterOperand(byte))
+            variables = std::max<uint8_t>(variables, static_cast<uint8_t>((byte & 0x0Fu) + 1u));
+    return variables;
+}
+
+// Instructions a sequence over variables registers may be built from
+std::vector<uint8_t> makeAlphabet(uint8_t variables)
+{
+    std::vector<uint8_t> alphabet;
+    for (uint8_t opcode = +AsmIns::CLB; opcode <= +AsmIns::KBP; ++opcode)
+        alphabet.push_back(opcode);
+    for (uint8_t value = 0u; value < 16u; ++value)
+        alphabet.push_back(static_cast<uint8_t>(+AsmIns::LDM | value));
+    for (uint8_t opcode : { +AsmIns::LD, +AsmIns::XCH, +AsmIns::ADD, +AsmIns::SUB, +AsmIns::INC })
+        for (uint8_t reg = 0u; reg < variables; ++reg)
+            alphabet.push_back(static_cast<uint8_t>(opcode | reg));
+    return alphabet;
+}
+
+bool isEquivalent(const std::vector<uint8_t>& target, const uint8_t* candidate, size_t size, uint8_t variables)
+{
+    uint64_t inputs = uint64_t(32u) << (4u * variables);
+    for (uint64_t index = 0u; index < inputs; ++index) {
+        State input = makeInput(index, variables);
+        if (!(run(target.data(), target.size(), input) == run(candidate, size, input)))
+            return false;
+    }
+    return true;
+}
+
+// Cheapest equivalent of target, every candidate instruction takes one byte
+// and one cycle so the first length with one is the best
+bool search(Target& target)
+{
+    uint8_t variables = countVariables(target.pattern);
+    std::vector<uint8_t> alphabet = makeAlphabet(variables);
+
+    State inputs[QUICK_INPUTS], outputs[QUICK_INPUTS];
+    uint64_t seed = 0x2545F4914F6CDD1Du;
+    for (size_t i = 0u; i < QUICK_INPUTS; ++i) {
+        seed = seed * 6364136223846793005u + 1442695040888963407u;
+        inputs[i] = makeInput(i < 2u ? (i == 0u ? 0u : ~uint64_t(0u)) : seed >> 24, variables);
+        outputs[i] = run(target.pattern.data(), target.pattern.size(), inputs[i]);
+    }
+
+    uint8_t candidate[MAX_TARGET_LENGTH];
+    size_t digits[MAX_TARGET_LENGTH];
+    for (size_t length = 0u; length < target.pattern.size(); ++length) {
+        std::fill(digits, digits + length, 0u);
+        do {
+            for (size_t i = 0u; i < length; ++i)
+                candidate[i] = alphabet[digits[i]];
+
+            bool passes = true;
+            for (size_t i = 0u; i < QUICK_INPUTS && passes; ++i)
+                passes = run(candidate, length, inputs[i]) == outputs[i];
+            if (passes && isEquivalent(target.pattern, candidate, length, variables)) {
+                target.replacement.assign(candidate, candidate + length);
+                target.found = true;
+                return true;
+            }
+
+            size_t digit = 0u;
+            while (digit < length && ++digits[digit] == alphabet.size())
+                digits[digit++] = 0u;
+            if (digit == length)
+                break;
+        } while (true);
+    }
+    return false;
+}
+
+void searchAll(std::vector<Target>& targets, unsigned jobs)
+{
+    std::atomic<size_t> next{ 0u };
+    auto worker = [&]() {
+        for (size_t i = next++; i < targets.size(); i = next++)
+            search(targets[i]);
+    };
+
+    std::vector<std::thread> threads;
+    for (unsigned job = 1u; job < jobs && job < targets.size(); ++job)
+        threads.emplace_back(worker);
+    worker();
+
+    for (std::thread& thread : threads)
+        thread.join();
+}
+
+// Registers renumbered in the order they are first used, so each sequence is
+// only tried under one naming
+std::vector<uint8_t> canonical(const uint8_t* bytes, size_t size)
+{
+    int variableOf[16];
+    std::fill(std::begin(variableOf), std::end(variableOf), -1);
+    int variables = 0;
+    std::vector<uint8_t> result(bytes, bytes + size);
+    for (uint8_t& byte : result) {
+        if (!Peephole::hasRegisterOperand(byte))
+            continue;
+        int& variable = variableOf[byte & 0x0Fu];
+        if (variable < 0)
+            variable = variables++;
+        byte = static_cast<uint8_t>((byte & 0xF0u) | variable);
+    }
+    return result;
+}
+
+// Fixed-size set key of a sequence, its length then the bytes
+using SequenceKey = std::array<uint8_t, MAX_TARGET_LENGTH + 1u>;
+
+SequenceKey makeKey(const std::vector<uint8_t>& sequence)
+{
+    SequenceKey key{};
+    size_t length = std::min(sequence.size(), MAX_TARGET_LENGTH);
+    key[0] = static_cast<uint8_t>(length);
+    std::copy_n(sequence.begin(), length, key.begin() + 1);
+    return key;
+}
+
+bool holdsRewritten(const std::vector<uint8_t>& sequence, const std::set<SequenceKey>& rewritten)
+{
+    for (size_t length = 1u; length < sequence.size(); ++length)
+        for (size_t start = 0u; start + length <= sequence.size(); ++start)
+            if (rewritten.count(makeKey(canonical(sequence.data() + start, length))) != 0u)
+                return true;
+    return false;
+}
+
+std::vector<Target> enumerate(size_t maxLength, unsigned jobs)
+{
+    std::vector<Target> found;
+    std::set<SequenceKey> rewritten;
+    std::vector<uint8_t> alphabet = makeAlphabet(static_cast<uint8_t>(maxLength));
+    for (size_t length = 1u; length <= maxLength; ++length) {
+        std::vector<Target> targets;
+        std::vector<size_t> digits(length, 0u);
+        do {
+            std::vector<uint8_t> sequence(length);
+            for (size_t i = 0u; i < length; ++i)
+                sequence[i] = alphabet[digits[i]];
+            if (canonical(sequence.data(), length) == sequence && !holdsRewritten(sequence, rewritten))
+                targets.push_back({ std::move(sequence), {}, false });
+
+            size_t digit = 0u;
+            while (digit < length && ++digits[digit] == alphabet.size())
+                digits[digit++] = 0u;
+            if (digit == length)
+                break;
+        } while (true);
+
+        searchAll(targets, jobs);
+        for (Target& target : targets) {
+            if (target.found) {
+                rewritten.insert(makeKey(target.pattern));
+                found.push_back(std::move(target));
+            }
+        }
+    }
+    return found;
+}
+
+bool readTargets(const std::string& filename, std::vector<Target>& targets)
+{
+    std::ifstream file(filename);
+    if (!file) {
+        std::cerr << "Failed to open " << filename << '\n';
+        return false;
+    }
+
+    std::string line, error;
+    for (size_t number = 1u; std::getline(file, line); ++number) {
+        size_t start = line.find_first_not_of(" \t\r");
+        if (start == std::string::npos || line[start] == ';')
+            continue;
+
+        Target target;
+        bool ok = Peephole::parseSequence(line, target.pattern, error);
+        if (ok && (target.pattern.empty() || target.pattern.size() > MAX_TARGET_LENGTH))
+            ok = false, error = "expected 1 to 5 instructions";
+        if (ok && !std::all_of(target.pattern.begin(), target.pattern.end(), isSupported))
+            ok = false, error = "only LDM, LD, XCH, ADD, SUB, INC and CLB-KBP are searched";
+        if (ok && countVariables(target.pattern) > MAX_VARIABLES)
+            ok = false, error = "registers Ra-Re only";
+        if (!ok) {
+            std::cerr << filename << ": line " << number << ": " << error << '\n';
+            return false;
+        }
+        target.pattern = canonical(target.pattern.data(), target.pattern.size());
+        targets.push_back(std::move(target));
+    }
+    return true;
+}
+
+int main(int argc, const char* argv[])
+{
+    if (argc > 1 && (strcmp(argv[1], "-h") == 0 || strcmp(argv[1], "--help") == 0)) {
+        std::cout << helpMessage;
+        return 0;
+    }
+
+    Options options;
+    if (!parseArguments(argc, argv, options)) {
+        std::cout << errorMessage;
+        return -1;
+    }
+
+    std::vector<Target> targets;
+    if (!options.targetsFile.empty()) {
+        if (!readTargets(options.targetsFile, targets))
+            return -1;
+        searchAll(targets, options.jobs);
+        for (const Target& target : targets)
+            if (!target.found)
+                std::cout << Peephole::formatSequence(target.pattern) << ": nothing cheaper\n";
+    }
+    else {
+        targets = enumerate(options.enumerateLength, options.jobs);
+    }
+
+    std::ofstream database(options.databaseFile);
+    if (!database) {
+        std::cerr << "Failed to open " << options.databaseFile << '\n';
+        return -1;
+    }
+    database << "; Rewrites proven on every ACC, CY and register input by superoptimizer\n";
+    size_t count = 0u;
+    for (const Target& target : targets) {
+        if (!target.found)
+            continue;
+        database << Peephole::formatSequence(target.pattern) << " -> " << Peephole::formatSequence(target.replacement) << '\n';
+        ++count;
+    }
+    std::cout << count << " rewrites written to " << options.databaseFile << '\n';
+    return 0;
+}
@@ -1,17 +1,94 @@
 #include "emulator_core/source/K4004.hpp"
+#include "emulator_core/source/event_scheduler.hpp"
+#include "emulator_core/source/hle_hooks.hpp"
 #include "emulator_core/source/ram.hpp"
 #include "emulator_core/source/rom.hpp"
 #include "emulator_core/source/instructions.hpp"
 
 #include "shared/source/assembly.hpp"
 
+#include <algorithm>
 #include <cstring>
+#include <string>
+
+namespace {
+
+// First field where a hooked routine's native result differs from the real one, empty when equal
+std::string describeDifference(const K4004::State& native, const K4004::State& real,
+                               const RAM::State& nativeRam, const RAM::State& realRam,
+                               uint8_t nativeRomSrc, uint8_t realRomSrc)
+{
+    auto field = [](const std::string& name, uint64_t nativeValue, uint64_t realValue) {
+        return name + " " + std::to_string(nativeValue) + " != " + std::to_string(realValue);
+    };
+
+    for (uint8_t i = 0u; i < K4004::REGISTERS_SIZE; ++i) {
+        if (native.registers[i] != real.registers[i])
+            return field("pair " + std::to_string(i), native.registers[i], real.registers[i]);
+    }
+    if (native.ACC != real.ACC)
+        return field("ACC", native.ACC, real.ACC);
+    if (native.cycleCount != real.cycleCount)
+        return field("cycles", native.cycleCount, real.cycleCount);
+    if (native.SP != real.SP)
+        return field("SP", native.SP, real.SP);
+    for (uint8_t i = 0u; i < K4004::STACK_SIZE; ++i) {
+        if (native.stack[i] != real.stack[i])
+            return field("stack " + std::to_string(i), native.stack[i], real.stack[i]);
+    }
+    if (native.IR != real.IR)
+        return field("IR", native.IR, real.IR);
+    if (native.CM_RAM != real.CM_RAM)
+        return field("CM-RAM", native.CM_RAM, real.CM_RAM);
+    if (nativeRam.srcAddress != realRam.srcAddress)
+        return field("RAM SRC", nativeRam.srcAddress, realRam.srcAddress);
+    if (nativeRomSrc != realRomSrc)
+        return field("ROM SRC", nativeRomSrc, realRomSrc);
+    for (uint16_t i = 0u; i < RAM::RAM_SIZE; ++i) {
+        if (nativeRam.ram[i] != realRam.ram[i])
+            return field("RAM " + std::to_string(i), nativeRam.ram[i], realRam.ram[i]);
+    }
+    for (uint16_t i = 0u; i < RAM::STATUS_SIZE; ++i) {
+        if (nativeRam.status[i] != realRam.status[i])
+            return field("status " + std::to_string(i), nativeRam.status[i], realRam.status[i]);
+    }
+    for (uint16_t i = 0u; i < RAM::OUTPUT_SIZE; ++i) {
+        if (nativeRam.oPorts[i] != realRam.oPorts[i])
+            return field("output port " + std::to_string(i), nativeRam.oPorts[i], realRam.oPorts[i]);
+    }
+    return {};
+}
+
+} // namespace
 
 K4004::K4004(ROM& rom, RAM& ram) :
     m_rom(rom),
-    m_ram(ram)
+    m_ram(ram),
+    m_scheduler(nullptr),
+    m_hooks(nullptr),
+    m_validatingHook(false),
+    m_fusedPairAt(PROGRAM_SIZE, FusedPair::None),
+    m_decodeAll(true),
+    m_seenCodeWrites(0u),
+    m_fusedPairs(0u),
+    m_traceAt(PROGRAM_SIZE, NO_TRACE),
+    m_headCounts(PROGRAM_SIZE, 0u),
+    m_traceRuns(0u),
+    m_tracedInstructions(0u)
 {
     reset();
+
+    // I/O port change notifications are stamped with this CPU's cycle count
+    m_rom.setCycleCounter(&m_cycleCount);
+    m_ram.setCycleCounter(&m_cycleCount);
+}
+
+K4004::~K4004()
+{
+    if (m_rom.getCycleCounter() == &m_cycleCount)
+        m_rom.setCycleCounter(nullptr);
+    if (m_ram.getCycleCounter() == &m_cycleCount)
+        m_ram.setCycleCounter(nullptr);
 }
 
 void K4004::reset()
@@ -23,17 +100,67 @@ void K4004::reset()
     m_test = 0u;
     m_CM_RAM = 0u;
     m_cycleCount = 0;
+    m_skippedCycles = 0;
+    m_fusedPairs = 0;
+    m_traceRuns = 0;
+    m_tracedInstructions = 0;
     m_ram.reset();
 }
 
+void K4004::saveState(State& state) const
+{
+    std::memcpy(state.registers, m_registers, REGISTERS_SIZE);
+    std::memcpy(state.stack, m_stack, sizeof(m_stack));
+    state.SP = m_SP;
+    state.IR = m_IR;
+    state.ACC = m_ACC;
+    state.test = m_test;
+    state.CM_RAM = m_CM_RAM;
+    state.cycleCount = m_cycleCount;
+}
+
+void K4004::loadState(const State& state)
+{
+    std::memcpy(m_registers, state.registers, REGISTERS_SIZE);
+    std::memcpy(m_stack, state.stack, sizeof(m_stack));
+    m_SP = state.SP % STACK_SIZE;
+    m_IR = state.IR;
+    m_ACC = state.ACC & 0x1Fu;
+    m_test = state.test & 1u;
+    m_CM_RAM = state.CM_RAM;
+    m_cycleCount = state.cycleCount;
+}
+
 uint8_t K4004::clock()
 {
-    uint8_t cycles = 0u;
+    uint8_t cycles = execute();
+
+    // Accumulate instruction cycles for cycle-accurate timing
+    // Each instruction cycle represents 8 clock cycles at 740kHz
+    m_cycleCount += cycles;
+    if (m_scheduler != nullptr)
+        m_scheduler->advanceTo(m_cycleCount);
 
+    return cycles;
+}
+
+uint8_t K4004::fetch()
+{
     m_IR = m_rom.readByte(getPC());
     incPC();
+    return m_IR;
+}
+
+uint8_t K4004::execute()
+{
+    fetch();
+    return dispatch(getOpcodeFromByte(m_IR));
+}
+
+uint8_t K4004::dispatch(uint8_t opcode)
+{
+    uint8_t cycles = 0u;
 
-    uint8_t opcode = getOpcodeFromByte(m_IR);
     switch (opcode) {
     case +AsmIns::NOP: cycles = 1u; NOP(); break;
     case +AsmIns::WRM: cycles = 1u; WRM(m_ram, m_ACC); break;
@@ -71,21 +198,445 @@ uint8_t K4004::clock()
     case +AsmIns::FIN: cycles = 2u; FIN(m_registers, getPC(), m_IR, m_rom); break;
     case +AsmIns::JIN: cycles = 1u; JIN(m_stack, m_SP, m_registers, m_IR); break;
     case +AsmIns::JUN: cycles = 2u; JUN(m_stack, m_SP, m_IR, m_rom); break;
-    case +AsmIns::JMS: cycles = 2u; JMS(m_stack, m_SP, m_IR, m_rom, STACK_SIZE); break;
-    case +AsmIns::WPM: cycles = 1u; WPM(); break;
+    case +AsmIns::JMS: cycles = 2u; callSubroutine(); break;
+    case +AsmIns::WPM: cycles = 1u; WPM(m_rom, m_ACC); break;
     case +AsmIns::INC: cycles = 1u; INC(m_registers, m_IR); break;
     case +AsmIns::ISZ: cycles = 2u; ISZ(m_stack, m_SP, m_registers, m_IR, m_rom); break;
     case +AsmIns::ADD: cycles = 1u; ADD(m_ACC, m_registers, m_IR); break;
     case +AsmIns::SUB: cycles = 1u; SUB(m_ACC, m_registers, m_IR); break;
     case +AsmIns::LD:  cycles = 1u; LD(m_ACC, m_registers, m_IR);  break;
     case +AsmIns::XCH: cycles = 1u; XCH(m_ACC, m_registers, m_IR); break;
-    case +AsmIns::BBL: cycles = 1u; BBL(m_stack, m_SP, m_ACC, m_registers, m_IR); break;
+    case +AsmIns::BBL: cycles = 1u; popStack(m_stack, m_SP, STACK_SIZE); LDM(m_ACC, m_IR); break;
     case +AsmIns::LDM: cycles = 1u; LDM(m_ACC, m_IR); break;
     }
 
-    // Accumulate instruction cycles for cycle-accurate timing
-    // Each instruction cycle represents 8 clock cycles at 740kHz
+    return cycles;
+}
+
+uint8_t K4004::clockFused(uint64_t limit)
+{
+    syncDecoded();
+
+    // Fusing skips the scheduler advance after the first instruction, which is
+    // only exact when nothing is due there and the run would not stop there
+    FusedPair pair = m_fusedPairAt[getPC()];
+    uint64_t firstEnd = m_cycleCount + (pair == FusedPair::FimSrc ? 2u : 1u);
+    if (pair == FusedPair::None || firstEnd >= limit)
+        return clock();
+    if (m_scheduler != nullptr && m_scheduler->getNextEventCycle() <= firstEnd)
+        return clock();
+
+    uint8_t first = fetch();
+    uint8_t cycles = 2u;
+    switch (pair) {
+    case FusedPair::FimSrc:
+        FIM(m_stack, m_SP, m_registers, first, m_rom);
+        SRC(m_ram, m_rom, m_registers, fetch());
+        cycles = 3u;
+        break;
+    case FusedPair::SrcRdm:
+        SRC(m_ram, m_rom, m_registers, first);
+        fetch();
+        RDM(m_ACC, m_ram);
+        break;
+    case FusedPair::LdAdd:
+        LD(m_ACC, m_registers, first);
+        ADD(m_ACC, m_registers, fetch());
+        break;
+    case FusedPair::XchXch:
+        XCH(m_ACC, m_registers, first);
+        XCH(m_ACC, m_registers, fetch());
+        break;
+    case FusedPair::ClbXch:
+        CLB(m_ACC);
+        XCH(m_ACC, m_registers, fetch());
+        break;
+    case FusedPair::None:
+        break;
+    }
+
+    ++m_fusedPairs;
     m_cycleCount += cycles;
+    if (m_scheduler != nullptr)
+        m_scheduler->advanceTo(m_cycleCount);
 
     return cycles;
 }
+
+void K4004::predecode()
+{
+    decodePairs(0u, PROGRAM_SIZE - 1u);
+
+    // Traces recorded from the old program are gone too
+    m_traces.clear();
+    std::fill(m_traceAt.begin(), m_traceAt.end(), NO_TRACE);
+    std::fill(m_headCounts.begin(), m_headCounts.end(), uint16_t{ 0u });
+
+    m_decodeAll = false;
+    m_seenCodeWrites = m_rom.getCodeWriteCount();
+}
+
+void K4004::syncDecoded()
+{
+    if (m_decodeAll) {
+        predecode();
+        return;
+    }
+    if (m_seenCodeWrites == m_rom.getCodeWriteCount())
+        return;
+
+    // Only pages and blocks stamped after the last look, a pair starts up to
+    // 2 bytes before its second instruction
+    std::bitset<ROM::NUM_CODE_BLOCKS> written;
+    constexpr uint16_t BLOCKS_PER_PAGE = ROM::PAGE_SIZE / ROM::CODE_BLOCK_SIZE;
+    for (uint8_t page = 0u; page < ROM::NUM_ROM_CHIPS; ++page) {
+        if (m_rom.getPageWriteStamp(page) <= m_seenCodeWrites)
+            continue;
+
+        for (uint16_t block = page * BLOCKS_PER_PAGE; block < (page + 1u) * BLOCKS_PER_PAGE; ++block) {
+            if (m_rom.getBlockWriteStamp(block) <= m_seenCodeWrites)
+                continue;
+
+            uint16_t first = block * ROM::CODE_BLOCK_SIZE;
+            decodePairs(first >= 2u ? first - 2u : 0u, first + ROM::CODE_BLOCK_SIZE - 1u);
+            written.set(block);
+        }
+    }
+
+    dropTraces(written);
+    m_seenCodeWrites = m_rom.getCodeWriteCount();
+}
+
+void K4004::decodePairs(uint16_t first, uint16_t last)
+{
+    for (uint16_t address = first; address <= last; ++address) {
+        uint8_t opcode = m_rom.readByte(address);
+        bool isFIM = (opcode & 0xF1u) == 0x20u;
+        uint8_t second = m_rom.readByte((address + (isFIM ? 2u : 1u)) & 0x0FFFu);
+
+        FusedPair pair = FusedPair::None;
+        if (isFIM && second == (opcode | 0x01u))
+            pair = FusedPair::FimSrc;
+        else if ((opcode & 0xF1u) == 0x21u && second == 0xE9u)
+            pair = FusedPair::SrcRdm;
+        else if ((opcode & 0xF0u) == 0xA0u && (second & 0xF0u) == 0x80u)
+            pair = FusedPair::LdAdd;
+        else if ((opcode & 0xF0u) == 0xB0u && (second & 0xF0u) == 0xB0u)
+            pair = FusedPair::XchXch;
+        else if (opcode == 0xF0u && (second & 0xF0u) == 0xB0u)
+            pair = FusedPair::ClbXch;
+        m_fusedPairAt[address] = pair;
+    }
+}
+
+void K4004::dropTraces(const std::bitset<PROGRAM_SIZE / 16u>& blocks)
+{
+    static_assert(PROGRAM_SIZE / 16u == ROM::NUM_CODE_BLOCKS, "one bit per ROM code block");
+
+    // Any trace with an instruction byte in a written block was recorded from
+    // old code, the rest are kept and renumbered
+    auto written = [&blocks](uint16_t address) { return blocks[(address & 0x0FFFu) / ROM::CODE_BLOCK_SIZE]; };
+    auto touches = [&written](const TraceEntry& entry) {
+        return written(entry.address) || written(entry.address + 1u);  // Second byte of FIM/JUN/JMS/JCN/ISZ
+    };
+
+    std::vector<int32_t> renumbered(m_traces.size(), NO_TRACE);
+    size_t kept = 0u;
+    for (size_t index = 0u; index < m_traces.size(); ++index) {
+        const std::vector<TraceEntry>& entries = m_traces[index].entries;
+        if (std::any_of(entries.begin(), entries.end(), touches))
+            continue;
+
+        renumbered[index] = static_cast<int32_t>(kept);
+        if (kept != index)
+            m_traces[kept] = std::move(m_traces[index]);
+        ++kept;
+    }
+    m_traces.resize(kept);
+
+    for (uint16_t head = 0u; head < PROGRAM_SIZE; ++head) {
+        int32_t& index = m_traceAt[head];
+        if (index >= 0)
+            index = renumbered[index];
+        else if (index == UNTRACEABLE && written(head))
+            index = NO_TRACE;
+        if (index == NO_TRACE && written(head))
+            m_headCounts[head] = 0u;
+    }
+}
+
+uint64_t K4004::runTrace(uint64_t limit)
+{
+    syncDecoded();
+
+    uint16_t head = getPC();
+    int32_t index = m_traceAt[head];
+    if (index == NO_TRACE) {
+        if (++m_headCounts[head] < TRACE_HOT_COUNT)
+            return 0u;
+        return recordTrace(limit);
+    }
+    if (index == UNTRACEABLE)
+        return 0u;
+
+    // Events and the limit are only checked after the trace, which is exact
+    // when none of them falls before its last instruction
+    const Trace& trace = m_traces[index];
+    uint64_t end = m_cycleCount + trace.cycles;
+    if (end > limit)
+        return 0u;
+    if (m_scheduler != nullptr && m_scheduler->getNextEventCycle() < end)
+        return 0u;
+
+    uint64_t startCycle = m_cycleCount;
+    for (const TraceEntry& entry : trace.entries) {
+        // Side exit: a branch or return went elsewhere than when it was recorded
+        if (getPC() != entry.address)
+            break;
+
+        m_IR = entry.IR;
+        incPC();
+        m_cycleCount += dispatch(entry.opcode);
+        ++m_tracedInstructions;
+    }
+
+    ++m_traceRuns;
+    if (m_scheduler != nullptr)
+        m_scheduler->advanceTo(m_cycleCount);
+    return m_cycleCount - startCycle;
+}
+
+uint64_t K4004::recordTrace(uint64_t limit)
+{
+    // Step from the head and keep the path taken, following JUN, JMS and BBL,
+    // until it comes back to an address already on it
+    uint16_t head = getPC();
+    uint64_t startCycle = m_cycleCount;
+    Trace trace{};
+
+    while (m_cycleCount < limit && trace.entries.size() < MAX_TRACE_LENGTH) {
+        uint16_t address = getPC();
+        uint8_t IR = m_rom.readByte(address);
+        uint8_t opcode = getOpcodeFromByte(IR);
+
+        // Hooked routines run through callSubroutine() outside of traces
+        if (opcode == +AsmIns::JMS && m_hooks != nullptr) {
+            uint16_t target = static_cast<uint16_t>(((IR & 0x0Fu) << 8) | m_rom.readByte((address + 1u) & 0x0FFFu));
+            if (m_hooks->hasHook(target))
+                break;
+        }
+
+        trace.entries.push_back({ address, IR, opcode });
+        trace.cycles += clock();
+
+        // Output ports notify listeners, which may schedule events, and WPM may
+        // rewrite the code being recorded, so stop after them
+        if (opcode == +AsmIns::WRR || opcode == +AsmIns::WMP || opcode == +AsmIns::WPM)
+            break;
+
+        uint16_t next = getPC();
+        auto visited = [next](const TraceEntry& entry) { return entry.address == next; };
+        if (std::any_of(trace.entries.begin(), trace.entries.end(), visited))
+            break;
+    }
+
+    if (trace.entries.empty()) {
+        m_traceAt[head] = UNTRACEABLE;
+    }
+    else {
+        m_traceAt[head] = static_cast<int32_t>(m_traces.size());
+        m_traces.push_back(std::move(trace));
+    }
+    return m_cycleCount - startCycle;
+}
+
+uint64_t K4004::runUntil(uint64_t cycle)
+{
+    uint64_t startCycle = m_cycleCount;
+
+    while (m_cycleCount < cycle) {
+        if (skipTestWait(cycle) == 0u && skipCounterLoop(cycle) == 0u && runTrace(cycle) == 0u)
+            clockFused(cycle);
+    }
+
+    return m_cycleCount - startCycle;
+}
+
+bool K4004::isWaitingForTest() const
+{
+    // JCN with only the TEST condition, jumping to itself while the jump is taken
+    uint16_t pc = getPC();
+    uint8_t opcode = m_rom.readByte(pc);
+    if ((opcode & 0xF0u) != 0x10u || (opcode & 0b0111u) != 0b0001u)
+        return false;
+
+    uint16_t next = (pc + 2u) & 0x0FFFu;
+    if (((next & 0x0F00u) | m_rom.readByte((pc + 1u) & 0x0FFFu)) != pc)
+        return false;
+
+    bool invert = (opcode & 0b1000u) != 0u;
+    return (m_test == 0u) != invert;
+}
+
+uint64_t K4004::skipTestWait(uint64_t limit)
+{
+    if (m_scheduler == nullptr || !isWaitingForTest())
+        return 0u;
+
+    uint64_t target = std::min(m_scheduler->getNextEventCycle(), limit);
+    if (target == EventScheduler::NO_EVENT || target <= m_cycleCount)
+        return 0u;
+
+    // Whole 2-cycle JCN iterations, the last one reaches or crosses the target
+    // exactly like stepping would, so events fire at the same instruction
+    constexpr uint64_t JCN_CYCLES = 2u;
+    uint64_t iterations = (target - m_cycleCount + JCN_CYCLES - 1u) / JCN_CYCLES;
+    uint64_t cycles = iterations * JCN_CYCLES;
+
+    m_IR = m_rom.readByte(getPC());
+    m_cycleCount += cycles;
+    m_skippedCycles += cycles;
+    m_scheduler->advanceTo(m_cycleCount);
+    return cycles;
+}
+
+bool K4004::findCounterLoop(uint8_t& nops) const
+{
+    // NOP* ISZ, the ISZ target (on the page after it) is the loop start at the PC
+    uint16_t pc = getPC();
+    uint16_t address = pc;
+    nops = 0u;
+    while (m_rom.readByte(address) == 0x00u) {
+        if (++nops > MAX_COUNTER_LOOP_NOPS)
+            return false;
+        address = (address + 1u) & 0x0FFFu;
+    }
+
+    if ((m_rom.readByte(address) & 0xF0u) != 0x70u)
+        return false;
+
+    uint16_t next = (address + 2u) & 0x0FFFu;
+    return ((next & 0x0F00u) | m_rom.readByte((address + 1u) & 0x0FFFu)) == pc;
+}
+
+bool K4004::isCounterLoop() const
+{
+    uint8_t nops;
+    return findCounterLoop(nops);
+}
+
+uint64_t K4004::skipCounterLoop(uint64_t limit)
+{
+    uint8_t nops;
+    if (limit <= m_cycleCount || !findCounterLoop(nops))
+        return 0u;
+
+    // Every iteration is the NOPs plus a 2-cycle ISZ, the register counts up to 0
+    uint16_t isz = (getPC() + nops) & 0x0FFFu;
+    uint8_t opcode = m_rom.readByte(isz);
+    uint8_t reg = opcode & 0x0Fu;
+    uint8_t value = getRegisterValue(m_registers, reg);
+    uint64_t iterationCycles = nops + 2u;
+    uint64_t iterations = 16u - value;
+
+    // Stop before the iteration reaching the limit or the next event, the
+    // rest is stepped so events fire after the same instruction as before
+    iterations = std::min(iterations, (limit - m_cycleCount) / iterationCycles);
+    if (m_scheduler != nullptr) {
+        uint64_t next = m_scheduler->getNextEventCycle();
+        if (next != EventScheduler::NO_EVENT)
+            iterations = next > m_cycleCount ? std::min(iterations, (next - m_cycleCount - 1u) / iterationCycles) : 0u;
+    }
+    if (iterations == 0u)
+        return 0u;
+
+    setRegisterValue(m_registers, reg, static_cast<uint8_t>(value + iterations));
+    if (getRegisterValue(m_registers, reg) == 0u)
+        m_stack[m_SP] = (isz + 2u) & 0x0FFFu;  // Fell through the last ISZ
+
+    uint64_t cycles = iterations * iterationCycles;
+    m_IR = opcode;
+    m_cycleCount += cycles;
+    m_skippedCycles += cycles;
+    if (m_scheduler != nullptr)
+        m_scheduler->advanceTo(m_cycleCount);
+    return cycles;
+}
+
+void K4004::callSubroutine()
+{
+    // JMS: the current level keeps the return address, the pushed level holds the target
+    uint16_t address = (m_IR & 0x0Fu) << 8;
+    address |= m_rom.readByte(getPC());
+    incPC();
+
+    if (m_hooks != nullptr && !m_validatingHook && m_hooks->hasHook(address) && runHook(address))
+        return;
+
+    pushStack(m_stack, m_SP, address, STACK_SIZE);
+}
+
+bool K4004::runHook(uint16_t address)
+{
+    HLEHookTable::Mode mode = m_hooks->getMode();
+    const HLEHookTable::Hook* hook = m_hooks->findHook(address);
+    if (mode == HLEHookTable::Mode::Off || hook == nullptr)
+        return false;
+
+    State native;
+    saveState(native);
+
+    if (mode == HLEHookTable::Mode::Native) {
+        if (!(*hook)(native, m_ram, m_rom))
+            return false;
+        loadState(native);
+        m_hooks->countNativeCall();
+        return true;
+    }
+
+    // Validate: run the hook on the live machine, keep its result aside and
+    // restore the memory, then step the real routine from the same state
+    const State before = native;
+    RAM::State ramBefore;
+    m_ram.saveState(ramBefore);
+    uint8_t romSrcBefore = m_rom.getSrcAddress();
+    auto restoreMemory = [&]() {
+        m_ram.loadState(ramBefore);
+        m_rom.writeSrcAddress(static_cast<uint8_t>(romSrcBefore << 4));
+    };
+
+    // A declining hook may already have written memory, the routine must not see it
+    if (!(*hook)(native, m_ram, m_rom)) {
+        restoreMemory();
+        return false;
+    }
+
+    RAM::State ramNative;
+    m_ram.saveState(ramNative);
+    uint8_t romSrcNative = m_rom.getSrcAddress();
+    restoreMemory();
+
+    // Stepping counts the JMS before the routine, scheduled events see the same cycles.
+    // Nested calls inside the routine are stepped too.
+    constexpr uint64_t JMS_CYCLES = 2u;
+    uint16_t returnAddress = before.stack[before.SP];
+    uint64_t limit = m_cycleCount + JMS_CYCLES + HLEHookTable::VALIDATE_CYCLE_LIMIT;
+    m_cycleCount += JMS_CYCLES;
+    m_validatingHook = true;
+    pushStack(m_stack, m_SP, address, STACK_SIZE);
+    while ((m_SP != before.SP || getPC() != returnAddress) && m_cycleCount < limit)
+        clock();
+    m_validatingHook = false;
+    m_cycleCount -= JMS_CYCLES;
+
+    State real;
+    saveState(real);
+    RAM::State ramReal;
+    m_ram.saveState(ramReal);
+
+    m_hooks->countValidatedCall();
+    std::string details = describeDifference(native, real, ramNative, ramReal, romSrcNative, m_rom.getSrcAddress());
+    if (!details.empty())
+        m_hooks->reportMismatch({ address, before.cycleCount, std::move(details) });
+    return true;
+}
@@ -1,6 +1,11 @@
 #pragma once
+#include <bitset>
+#include <cstddef>
 #include <cstdint>
+#include <vector>
 
+class EventScheduler;
+class HLEHookTable;
 class ROM;
 class RAM;
 
@@ -8,13 +13,83 @@ class K4004
 {
 public:
     static constexpr uint8_t REGISTERS_SIZE = 8u;
-    static constexpr uint8_t STACK_SIZE = 3u;  // Intel 4004 has 3-level stack
+    static constexpr uint8_t STACK_SIZE = 4u;  // PC + 3-level return stack, circular
+
+    // Register file, stack and cycle count, plain data for snapshots
+    struct State {
+        uint8_t registers[REGISTERS_SIZE];
+        uint16_t stack[STACK_SIZE];
+        uint8_t SP;
+        uint8_t IR;
+        uint8_t ACC;
+        uint8_t test;
+        uint8_t CM_RAM;
+        uint64_t cycleCount;
+    };
 
     K4004(ROM& rom, RAM& ram);
+    ~K4004();
 
     void reset();
     uint8_t clock();
 
+    // Like clock(), but when the instruction at the PC starts a common pair
+    // (FIM Pn/SRC Pn, SRC/RDM, LD/ADD, XCH/XCH, CLB/XCH) both run as one
+    // superinstruction, unless the limit or a scheduled event falls between
+    // them. Pairs are found by predecoding the ROM, so a jump to the second
+    // instruction just runs it alone. Returns the cycles executed.
+    // Code blocks the ROM stamped as written since the last fast run (see
+    // ROM::getCodeWriteCount) are decoded again and only the traces running
+    // through them dropped.
+    uint8_t clockFused(uint64_t limit);
+    uint64_t getFusedPairs() const { return m_fusedPairs; }
+
+    // Hot paths run as superblocks. An address executed TRACE_HOT_COUNT times
+    // outside a trace becomes a trace head: the next run from it is stepped and
+    // the path taken recorded, across JUN, JMS and BBL, until it revisits an
+    // address. Later runs replay the predecoded path while every instruction
+    // lands where it was recorded and leave at the first one that does not
+    // (a JCN, ISZ, JIN or BBL going elsewhere). A trace only runs when the
+    // limit and the next scheduled event are not before its end. Returns the
+    // cycles executed or recorded, 0 when nothing ran.
+    uint64_t runTrace(uint64_t limit);
+    size_t getTraceCount() const { return m_traces.size(); }
+    uint64_t getTraceRuns() const { return m_traceRuns; }
+    uint64_t getTracedInstructions() const { return m_tracedInstructions; }
+
+    void saveState(State& state) const;
+    void loadState(const State& state);
+
+    // Run until the cycle count reaches cycle. TEST wait loops (a JCN on TEST
+    // jumping to itself) are skipped up to the next scheduled event, which is
+    // the only thing that can change TEST. Counter loops are computed in closed
+    // form and common pairs run fused. Returns the cycles elapsed.
+    uint64_t runUntil(uint64_t cycle);
+
+    // Fast-forward whole iterations of a TEST wait loop up to the next scheduled
+    // event or limit, whichever comes first. Returns the cycles skipped, 0 when
+    // the CPU is not spinning on TEST or no event is pending.
+    uint64_t skipTestWait(uint64_t limit);
+    bool isWaitingForTest() const;
+
+    // Pure counting loops, ISZ Rn jumping to itself or to a run of NOPs right
+    // before it, are computed in closed form: whole iterations up to the loop
+    // exit, limit or the next scheduled event are added in one step. Returns
+    // the cycles skipped, 0 when the PC is not at the start of such a loop.
+    uint64_t skipCounterLoop(uint64_t limit);
+    bool isCounterLoop() const;
+
+    // Peripherals driving TEST (printer drum, timers) post their edges on this timeline.
+    // The scheduler is advanced to the CPU cycle count after every instruction.
+    void setScheduler(EventScheduler* scheduler) { m_scheduler = scheduler; }
+    EventScheduler* getScheduler() const { return m_scheduler; }
+
+    // JMS to an address with a hook runs or validates its native implementation
+    // depending on the table's mode (see hle_hooks.hpp)
+    // Traces are recorded around the hooks present at the time, setting a table drops them
+    void setHooks(HLEHookTable* hooks) { m_hooks = hooks; m_decodeAll = true; }
+    HLEHookTable* getHooks() const { return m_hooks; }
+
     const uint16_t* getStack() const { return m_stack; }
     const uint8_t* getRegisters() const { return m_registers; }
     uint16_t getPC() const { return m_stack[m_SP]; }
@@ -27,8 +102,42 @@ public:
     // Cycle-accurate timing support
     uint64_t getCycleCount() const { return m_cycleCount; }
     void resetCycleCount() { m_cycleCount = 0; }
+    uint64_t getSkippedCycles() const { return m_skippedCycles; }  // Cycles fast-forwarded in TEST waits and counter loops
 private:
+    static constexpr uint8_t MAX_COUNTER_LOOP_NOPS = 16u;
+    static constexpr uint16_t PROGRAM_SIZE = 4096u;
+
+    static constexpr uint16_t TRACE_HOT_COUNT = 32u;
+    static constexpr size_t MAX_TRACE_LENGTH = 64u;
+    static constexpr int32_t NO_TRACE = -1;
+    static constexpr int32_t UNTRACEABLE = -2;  // Starts with a hooked JMS
+
+    enum class FusedPair : uint8_t { None, FimSrc, SrcRdm, LdAdd, XchXch, ClbXch };
+
+    struct TraceEntry {
+        uint16_t address;
+        uint8_t IR;
+        uint8_t opcode;
+    };
+
+    struct Trace {
+        std::vector<TraceEntry> entries;
+        uint64_t cycles;  // Whole path without side exits
+    };
+
+    uint8_t execute();
+    uint8_t dispatch(uint8_t opcode);
+    uint64_t recordTrace(uint64_t limit);
+    uint8_t fetch();
+    void predecode();
+    void syncDecoded();
+    void decodePairs(uint16_t first, uint16_t last);
+    void dropTraces(const std::bitset<PROGRAM_SIZE / 16u>& blocks);
+
+    bool findCounterLoop(uint8_t& nops) const;
     void incPC() { m_stack[m_SP] = ++m_stack[m_SP] & 0x0FFFu; }  // 12-bit PC (4KB ROM)
+    void callSubroutine();
+    bool runHook(uint16_t address);
 
     uint8_t m_registers[REGISTERS_SIZE];
     uint16_t m_stack[STACK_SIZE];
@@ -41,4 +150,19 @@ private:
 
     uint8_t m_CM_RAM;
     uint64_t m_cycleCount;  // Total instruction cycles executed
+    uint64_t m_skippedCycles;
+    EventScheduler* m_scheduler;  // Optional cycle timeline (not owned)
+    HLEHookTable* m_hooks;        // Optional native routines (not owned)
+    bool m_validatingHook;        // Stepping a hooked routine, nested hooks are not run
+
+    std::vector<FusedPair> m_fusedPairAt;  // Pair starting at each ROM address
+    bool m_decodeAll;                      // Everything is decoded again and all traces dropped
+    uint64_t m_seenCodeWrites;             // ROM code write count the decoded copies match
+    uint64_t m_fusedPairs;
+
+    std::vector<Trace> m_traces;
+    std::vector<int32_t> m_traceAt;      // Trace starting at each ROM address, NO_TRACE or UNTRACEABLE
+    std::vector<uint16_t> m_headCounts;  // Executions outside traces, for picking heads
+    uint64_t m_traceRuns;
+    uint64_t m_tracedInstructions;
 };
@@ -1,10 +1,12 @@
 #include "emulator_core/source/K4040.hpp"
+#include "emulator_core/source/event_scheduler.hpp"
 #include "emulator_core/source/instructions.hpp"
 #include "emulator_core/source/ram.hpp"
 #include "emulator_core/source/rom.hpp"
 
 #include "shared/source/assembly.hpp"
 
+#include <algorithm>
 #include <cstring>
 
 K4040::K4040(ROM& rom, RAM& ram) :
@@ -15,9 +17,23 @@ K4040::K4040(ROM& rom, RAM& ram) :
     m_currentROMBank(0),
     m_interruptEnabled(false),
     m_halted(false),
-    m_interruptPending(false)
+    m_interruptPending(false),
+    m_scheduler(nullptr)
 {
     reset();
+
+    // I/O port and command register changes are stamped with this CPU's cycle count
+    m_rom.setCycleCounter(&m_cycleCount);
+    m_ram.setCycleCounter(&m_cycleCount);
+    m_commandNotifier.setCycleCounter(&m_cycleCount);
+}
+
+K4040::~K4040()
+{
+    if (m_rom.getCycleCounter() == &m_cycleCount)
+        m_rom.setCycleCounter(nullptr);
+    if (m_ram.getCycleCounter() == &m_cycleCount)
+        m_ram.setCycleCounter(nullptr);
 }
 
 void K4040::reset()
@@ -33,27 +49,35 @@ void K4040::reset()
     m_ACC = 0u;
     m_test = 0u;
     m_commandRegister = 0u;
+    m_srcRegister = 0u;
     m_srcBackup = 0u;
     m_interruptEnabled = false;
     m_halted = false;
     m_interruptPending = false;
+    m_cycleCount = 0;
+    m_haltedCycles = 0;
 
     m_ram.reset();
 }
 
-void K4040::step()
+uint8_t K4040::step()
 {
-    // Check if halted
+    uint8_t cycles = 0u;
+
+    // INT is sampled at the instruction boundary, a pending request also ends HLT
+    if (m_interruptPending && m_interruptEnabled) {
+        m_halted = false;
+        acknowledgeInterrupt();
+        cycles = INTERRUPT_CYCLES;
+        advanceTime(cycles);
+        return cycles;
+    }
+
     if (m_halted) {
-        // Check for interrupt to wake up
-        if (m_interruptPending && m_interruptEnabled) {
-            m_halted = false;
-            // Handle interrupt (simplified - would need full interrupt vector logic)
-            // For now, just clear the interrupt
-            m_interruptPending = false;
-        } else {
-            return;  // Stay halted
-        }
+        // Jump straight to the next event that could raise INT
+        if (m_scheduler != nullptr && m_scheduler->hasPendingEvents())
+            idleUntil(std::max(m_scheduler->getNextEventCycle(), m_cycleCount));
+        return 0u;  // Stay halted
     }
 
     m_IR = m_rom.readByte(getPC() | (m_currentROMBank << 12));  // 13-bit addressing with bank
@@ -61,66 +85,153 @@ void K4040::step()
 
     uint8_t opcode = getOpcodeFromByte(m_IR);
     switch (opcode) {
-    case +AsmIns::NOP: NOP(); break;
+    case +AsmIns::NOP: cycles = 1u; NOP(); break;
     // 4040 new instructions
-    case +AsmIns::HLT: HLT(m_halted); break;
-    case +AsmIns::BBS: BBS(m_stack, m_SP, m_ram, m_rom, m_srcBackup, m_interruptEnabled); break;
-    case +AsmIns::LCR: LCR(m_ACC, m_commandRegister); break;
-    case +AsmIns::OR4: OR4(m_ACC, m_registers); break;
-    case +AsmIns::OR5: OR5(m_ACC, m_registers); break;
-    case +AsmIns::AN6: AN6(m_ACC, m_registers); break;
-    case +AsmIns::AN7: AN7(m_ACC, m_registers); break;
-    case +AsmIns::DB0: DB0(m_currentROMBank); break;
-    case +AsmIns::DB1: DB1(m_currentROMBank); break;
-    case +AsmIns::SB0: SB0(m_currentRegisterBank); m_registers = m_registers_bank0; break;
-    case +AsmIns::SB1: SB1(m_currentRegisterBank); m_registers = m_registers_bank1; break;
-    case +AsmIns::EIN: EIN(m_interruptEnabled); break;
-    case +AsmIns::DIN: DIN(m_interruptEnabled); break;
-    case +AsmIns::RPM: RPM(m_ACC, m_rom, getPC()); break;
-    case +AsmIns::WRM: WRM(m_ram, m_ACC); break;
-    case +AsmIns::WMP: WMP(m_ram, m_ACC); break;
-    case +AsmIns::WRR: WRR(m_rom, m_ACC); break;
-    case +AsmIns::WR0: WR0(m_ram, m_ACC); break;
-    case +AsmIns::WR1: WR1(m_ram, m_ACC); break;
-    case +AsmIns::WR2: WR2(m_ram, m_ACC); break;
-    case +AsmIns::WR3: WR3(m_ram, m_ACC); break;
-    case +AsmIns::SBM: SBM(m_ACC, m_ram); break;
-    case +AsmIns::RDM: RDM(m_ACC, m_ram); break;
-    case +AsmIns::RDR: RDR(m_ACC, m_rom); break;
-    case +AsmIns::ADM: ADM(m_ACC, m_ram); break;
-    case +AsmIns::RD0: RD0(m_ACC, m_ram); break;
-    case +AsmIns::RD1: RD1(m_ACC, m_ram); break;
-    case +AsmIns::RD2: RD2(m_ACC, m_ram); break;
-    case +AsmIns::RD3: RD3(m_ACC, m_ram); break;
-    case +AsmIns::CLB: CLB(m_ACC); break;
-    case +AsmIns::CLC: CLC(m_ACC); break;
-    case +AsmIns::IAC: IAC(m_ACC); break;
-    case +AsmIns::CMC: CMC(m_ACC); break;
-    case +AsmIns::CMA: CMA(m_ACC); break;
-    case +AsmIns::RAL: RAL(m_ACC); break;
-    case +AsmIns::RAR: RAR(m_ACC); break;
-    case +AsmIns::TCC: TCC(m_ACC); break;
-    case +AsmIns::DAC: DAC(m_ACC); break;
-    case +AsmIns::TCS: TCS(m_ACC); break;
-    case +AsmIns::STC: STC(m_ACC); break;
-    case +AsmIns::DAA: DAA(m_ACC); break;
-    case +AsmIns::KBP: KBP(m_ACC); break;
-    case +AsmIns::DCL: DCL(m_ram, m_ACC); break;
-    case +AsmIns::JCN: JCN(m_stack, m_SP, m_IR, m_ACC, m_test, m_rom); break;
-    case +AsmIns::FIM: FIM(m_stack, m_SP, m_registers, m_IR, m_rom); break;
-    case +AsmIns::SRC: SRC(m_ram, m_rom, m_registers, m_IR); break;
-    case +AsmIns::FIN: FIN(m_registers, getPC(), m_IR, m_rom); break;
-    case +AsmIns::JIN: JIN(m_stack, m_SP, m_registers, m_IR); break;
-    case +AsmIns::JUN: JUN(m_stack, m_SP, m_IR, m_rom); break;
-    case +AsmIns::JMS: JMS(m_stack, m_SP, m_IR, m_rom, STACK_SIZE); break;
-    case +AsmIns::WPM: WPM(); break;
-    case +AsmIns::INC: INC(m_registers, m_IR); break;
-    case +AsmIns::ISZ: ISZ(m_stack, m_SP, m_registers, m_IR, m_rom); break;
-    case +AsmIns::ADD: ADD(m_ACC, m_registers, m_IR); break;
-    case +AsmIns::SUB: SUB(m_ACC, m_registers, m_IR); break;
-    case +AsmIns::LD:  LD(m_ACC, m_registers, m_IR);  break;
-    case +AsmIns::XCH: XCH(m_ACC, m_registers, m_IR); break;
-    case +AsmIns::BBL: BBL(m_stack, m_SP, m_ACC, m_registers, m_IR); break;
-    case +AsmIns::LDM: LDM(m_ACC, m_IR); break;
+    case +AsmIns::HLT: cycles = 1u; HLT(m_halted); break;
+    case +AsmIns::BBS: cycles = 1u; BBS(m_stack, m_SP, m_ram, m_rom, m_srcBackup, m_interruptEnabled, STACK_SIZE); m_srcRegister = m_srcBackup; break;
+    case +AsmIns::LCR: cycles = 1u; LCR(m_ACC, m_commandRegister); break;
+    case +AsmIns::OR4: cycles = 1u; OR4(m_ACC, m_registers); break;
+    case +AsmIns::OR5: cycles = 1u; OR5(m_ACC, m_registers); break;
+    case +AsmIns::AN6: cycles = 1u; AN6(m_ACC, m_registers); break;
+    case +AsmIns::AN7: cycles = 1u; AN7(m_ACC, m_registers); break;
+    case +AsmIns::DB0: cycles = 1u; DB0(m_currentROMBank); break;
+    case +AsmIns::DB1: cycles = 1u; DB1(m_currentROMBank); break;
+    case +AsmIns::SB0: cycles = 1u; SB0(m_currentRegisterBank); m_registers = m_registers_bank0; break;
+    case +AsmIns::SB1: cycles = 1u; SB1(m_currentRegisterBank); m_registers = m_registers_bank1; break;
+    case +AsmIns::EIN: cycles = 1u; EIN(m_interruptEnabled); break;
+    case +AsmIns::DIN: cycles = 1u; DIN(m_interruptEnabled); break;
+    case +AsmIns::RPM: cycles = 1u; RPM(m_ACC, m_rom, getPC()); break;
+    case +AsmIns::WRM: cycles = 1u; WRM(m_ram, m_ACC); break;
+    case +AsmIns::WMP: cycles = 1u; WMP(m_ram, m_ACC); break;
+    case +AsmIns::WRR: cycles = 1u; WRR(m_rom, m_ACC); break;
+    case +AsmIns::WR0: cycles = 1u; WR0(m_ram, m_ACC); break;
+    case +AsmIns::WR1: cycles = 1u; WR1(m_ram, m_ACC); break;
+    case +AsmIns::WR2: cycles = 1u; WR2(m_ram, m_ACC); break;
+    case +AsmIns::WR3: cycles = 1u; WR3(m_ram, m_ACC); break;
+    case +AsmIns::SBM: cycles = 1u; SBM(m_ACC, m_ram); break;
+    case +AsmIns::RDM: cycles = 1u; RDM(m_ACC, m_ram); break;
+    case +AsmIns::RDR: cycles = 1u; RDR(m_ACC, m_rom); break;
+    case +AsmIns::ADM: cycles = 1u; ADM(m_ACC, m_ram); break;
+    case +AsmIns::RD0: cycles = 1u; RD0(m_ACC, m_ram); break;
+    case +AsmIns::RD1: cycles = 1u; RD1(m_ACC, m_ram); break;
+    case +AsmIns::RD2: cycles = 1u; RD2(m_ACC, m_ram); break;
+    case +AsmIns::RD3: cycles = 1u; RD3(m_ACC, m_ram); break;
+    case +AsmIns::CLB: cycles = 1u; CLB(m_ACC); break;
+    case +AsmIns::CLC: cycles = 1u; CLC(m_ACC); break;
+    case +AsmIns::IAC: cycles = 1u; IAC(m_ACC); break;
+    case +AsmIns::CMC: cycles = 1u; CMC(m_ACC); break;
+    case +AsmIns::CMA: cycles = 1u; CMA(m_ACC); break;
+    case +AsmIns::RAL: cycles = 1u; RAL(m_ACC); break;
+    case +AsmIns::RAR: cycles = 1u; RAR(m_ACC); break;
+    case +AsmIns::TCC: cycles = 1u; TCC(m_ACC); break;
+    case +AsmIns::DAC: cycles = 1u; DAC(m_ACC); break;
+    case +AsmIns::TCS: cycles = 1u; TCS(m_ACC); break;
+    case +AsmIns::STC: cycles = 1u; STC(m_ACC); break;
+    case +AsmIns::DAA: cycles = 1u; DAA(m_ACC); break;
+    case +AsmIns::KBP: cycles = 1u; KBP(m_ACC); break;
+    case +AsmIns::DCL: cycles = 1u; DCL(m_ram, m_ACC); writeCommandRegister(m_ACC); break;
+    case +AsmIns::JCN: cycles = 2u; JCN(m_stack, m_SP, m_IR, m_ACC, m_test, m_rom); break;
+    case +AsmIns::FIM: cycles = 2u; FIM(m_stack, m_SP, m_registers, m_IR, m_rom); break;
+    case +AsmIns::SRC: cycles = 1u; SRC(m_ram, m_rom, m_registers, m_IR); m_srcRegister = m_registers[(m_IR & 0x0Fu) >> 1]; break;
+    case +AsmIns::FIN: cycles = 2u; FIN(m_registers, getPC(), m_IR, m_rom); break;
+    case +AsmIns::JIN: cycles = 1u; JIN(m_stack, m_SP, m_registers, m_IR); break;
+    case +AsmIns::JUN: cycles = 2u; JUN(m_stack, m_SP, m_IR, m_rom); break;
+    case +AsmIns::JMS: cycles = 2u; callSubroutine(); break;
+    case +AsmIns::WPM: cycles = 1u; WPM(m_rom, m_ACC); break;
+    case +AsmIns::INC: cycles = 1u; INC(m_registers, m_IR); break;
+    case +AsmIns::ISZ: cycles = 2u; ISZ(m_stack, m_SP, m_registers, m_IR, m_rom); break;
+    case +AsmIns::ADD: cycles = 1u; ADD(m_ACC, m_registers, m_IR); break;
+    case +AsmIns::SUB: cycles = 1u; SUB(m_ACC, m_registers, m_IR); break;
+    case +AsmIns::LD:  cycles = 1u; LD(m_ACC, m_registers, m_IR);  break;
+    case +AsmIns::XCH: cycles = 1u; XCH(m_ACC, m_registers, m_IR); break;
+    case +AsmIns::BBL: cycles = 1u; popStack(m_stack, m_SP, STACK_SIZE); LDM(m_ACC, m_IR); break;
+    case +AsmIns::LDM: cycles = 1u; LDM(m_ACC, m_IR); break;
     }
+
+    advanceTime(cycles);
+
+    return cycles;
+}
+
+uint64_t K4040::runUntil(uint64_t cycle)
+{
+    uint64_t startCycle = m_cycleCount;
+
+    while (m_cycleCount < cycle) {
+        if (isWaitingForInterrupt()) {
+            // Clock keeps running while halted, skip to whatever comes first
+            uint64_t wakeCycle = cycle;
+            if (m_scheduler != nullptr && m_scheduler->hasPendingEvents())
+                wakeCycle = std::clamp(m_scheduler->getNextEventCycle(), m_cycleCount, cycle);
+            idleUntil(wakeCycle);
+            continue;
+        }
+        step();
+    }
+
+    return m_cycleCount - startCycle;
+}
+
+void K4040::requestInterrupt()
+{
+    {
+        std::lock_guard<std::mutex> lock(m_wakeMutex);
+        m_interruptPending = true;
+    }
+    m_wakeCondition.notify_all();
+}
+
+bool K4040::waitWhileHalted(std::chrono::steady_clock::time_point deadline)
+{
+    std::unique_lock<std::mutex> lock(m_wakeMutex);
+    return m_wakeCondition.wait_until(lock, deadline, [this] { return !isWaitingForInterrupt(); });
+}
+
+uint64_t K4040::scheduleInterrupt(uint64_t cycle)
+{
+    if (m_scheduler == nullptr)
+        return EventScheduler::INVALID_EVENT;
+
+    return m_scheduler->schedule(cycle, [this](uint64_t) { requestInterrupt(); });
+}
+
+void K4040::acknowledgeInterrupt()
+{
+    // Save SRC for BBS, push the address of the next instruction and vector to
+    // page 0 location 3 of the current bank. Interrupts stay off until BBS.
+    m_srcBackup = m_srcRegister;
+    pushStack(m_stack, m_SP, INTERRUPT_VECTOR, STACK_SIZE);
+    m_interruptEnabled = false;
+    m_interruptPending = false;
+}
+
+void K4040::callSubroutine()
+{
+    // JMS: the current level keeps the return address, the pushed level holds the target
+    uint16_t address = (m_IR & 0x0Fu) << 8;
+    address |= m_rom.readByte(getPC() | (m_currentROMBank << 12));
+    incStack();
+    pushStack(m_stack, m_SP, address, STACK_SIZE);
+}
+
+void K4040::advanceTime(uint64_t cycles)
+{
+    m_cycleCount += cycles;
+    if (m_scheduler != nullptr)
+        m_scheduler->advanceTo(m_cycleCount);
+}
+
+void K4040::idleUntil(uint64_t cycle)
+{
+    uint64_t cycles = cycle - m_cycleCount;
+    m_haltedCycles += cycles;
+    advanceTime(cycles);
+}
+
+void K4040::writeCommandRegister(uint8_t value)
+{
+    // DCL latches the three low accumulator bits (CM-RAM line selection)
+    uint8_t oldValue = m_commandRegister;
+    m_commandRegister = value & 0x07u;
+    m_commandNotifier.notify(0u, oldValue, m_commandRegister);
 }
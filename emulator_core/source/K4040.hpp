@@ -1,18 +1,36 @@
 #pragma once
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
 #include <cstdint>
+#include <mutex>
 
+#include "emulator_core/source/io_port_events.hpp"
+
+class EventScheduler;
 class ROM;
 class RAM;
 
 class K4040 {
 public:
     static constexpr uint8_t REGISTERS_SIZE = 12u;
-    static constexpr uint8_t STACK_SIZE = 7u;  // Intel 4040 has 7-level stack
+    static constexpr uint8_t STACK_SIZE = 8u;  // PC + 7-level return stack, circular
+    static constexpr uint16_t INTERRUPT_VECTOR = 0x003u;  // Page 0 location 3 of the current ROM bank
+    static constexpr uint8_t INTERRUPT_CYCLES = 2u;       // Forced JMS to the vector
 
     K4040(ROM& rom, RAM& ram);
+    ~K4040();
 
     void reset();
-    void step();
+
+    // Execute one instruction (or acknowledge a pending interrupt) and return its cycles.
+    // While halted nothing is executed and 0 is returned; with a scheduler attached the
+    // cycle count fast-forwards to the next scheduled event instead.
+    uint8_t step();
+
+    // Run until the cycle count reaches cycle, fast-forwarding halted stretches to the
+    // next scheduled event (or straight to cycle). Returns the cycles elapsed.
+    uint64_t runUntil(uint64_t cycle);
 
     const uint16_t* getStack() const { return m_stack; }
     const uint8_t* getRegisters() const { return m_registers; }
@@ -28,10 +46,46 @@ public:
     uint8_t getROMBank() const { return m_currentROMBank; }
     bool isInterruptEnabled() const { return m_interruptEnabled; }
     bool isHalted() const { return m_halted; }
+    bool isInterruptPending() const { return m_interruptPending; }
+    bool isWaitingForInterrupt() const { return m_halted && !(m_interruptPending && m_interruptEnabled); }
+    uint8_t getSrcRegister() const { return m_srcRegister; }
+    uint8_t getSrcBackup() const { return m_srcBackup; }
+
+    // INT pin: the request stays latched until acknowledged at an instruction boundary
+    // with interrupts enabled. Acknowledge saves SRC, pushes the PC, vectors to 0x003
+    // and disables interrupts until BBS. A pending interrupt also wakes the CPU from HLT.
+    // requestInterrupt() may be called from any thread and wakes waitWhileHalted().
     void setInterruptPending(bool pending) { m_interruptPending = pending; }
+    void requestInterrupt();
+
+    // Real-time hosts: block the calling thread while halted until an interrupt is
+    // requested or the wall-clock deadline (usually that of the next scheduled event)
+    // passes. Returns true when woken by an interrupt request.
+    bool waitWhileHalted(std::chrono::steady_clock::time_point deadline);
+
+    // Interrupt sources (timers, serial RX, keyboard) post their requests on this timeline.
+    // The scheduler is advanced to the CPU cycle count after every step.
+    void setScheduler(EventScheduler* scheduler) { m_scheduler = scheduler; }
+    EventScheduler* getScheduler() const { return m_scheduler; }
+    uint64_t scheduleInterrupt(uint64_t cycle);
+
+    // Command register (written by DCL, read back by LCR)
+    uint8_t getCommandRegister() const { return m_commandRegister; }
+    void addCommandRegisterListener(IOPortListener listener) { m_commandNotifier.addListener(std::move(listener)); }
+    void clearCommandRegisterListeners() { m_commandNotifier.clearListeners(); }
+
+    // Cycle-accurate timing support
+    uint64_t getCycleCount() const { return m_cycleCount; }
+    void resetCycleCount() { m_cycleCount = 0; }
+    uint64_t getHaltedCycles() const { return m_haltedCycles; }  // Cycles skipped in HLT
 
 private:
     void incStack() { m_stack[m_SP] = ++m_stack[m_SP] & 0x0FFFu; }  // 12-bit PC base (13-bit with bank)
+    void writeCommandRegister(uint8_t value);
+    void acknowledgeInterrupt();
+    void callSubroutine();
+    void advanceTime(uint64_t cycles);
+    void idleUntil(uint64_t cycle);
 
     // Register banks (4040 has 2 banks of 12 register pairs = 24 total registers)
     uint8_t m_registers_bank0[REGISTERS_SIZE];
@@ -49,10 +103,18 @@ private:
     // 4040-specific hardware state
     uint8_t m_currentROMBank;       // 0 or 1 (for 13-bit addressing, 8KB ROM)
     uint8_t m_commandRegister;      // Command register for LCR instruction
+    uint8_t m_srcRegister;          // Last address sent by SRC
     uint8_t m_srcBackup;            // SRC backup for BBS instruction
     bool m_interruptEnabled;        // Interrupt enable flag (EIN/DIN)
     bool m_halted;                  // Halt state (HLT instruction)
-    bool m_interruptPending;        // INT pin state
+    std::atomic<bool> m_interruptPending;  // INT pin state
+    IOPortNotifier m_commandNotifier;
+
+    uint64_t m_cycleCount;          // Total instruction cycles executed
+    uint64_t m_haltedCycles;        // Cycles spent halted
+    EventScheduler* m_scheduler;    // Optional cycle timeline (not owned)
+    std::mutex m_wakeMutex;
+    std::condition_variable m_wakeCondition;
 
     // Memory references
     ROM& m_rom;
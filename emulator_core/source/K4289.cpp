@@ -1,4 +1,5 @@
 #include "emulator_core/source/K4289.hpp"
+#include "emulator_core/source/K4101.hpp"
 
 K4289::K4289() :
     m_address12bit(0u),
@@ -7,7 +8,12 @@ K4289::K4289() :
     m_ioMask(0u),
     m_readMode(true),
     m_chipEnabled(true),
-    m_programMemoryMode(false)
+    m_programMemoryMode(false),
+    m_highNibbles{},
+    m_lowNibbles{},
+    m_lowNibbleNext(false),
+    m_writeEnabled(false),
+    m_readLatch(0u)
 {
 }
 
@@ -19,7 +25,10 @@ void K4289::reset()
     m_ioMask = 0u;
     m_readMode = true;
     m_chipEnabled = true;
-    m_programMemoryMode = false;
+    m_lowNibbleNext = false;
+    m_writeEnabled = false;
+    m_readLatch = 0u;
+    setProgramMemoryMode(false);
 }
 
 void K4289::setAddress(uint16_t address)
@@ -67,3 +76,90 @@ uint8_t K4289::readIOPort() const
     // Return the current I/O port value
     return m_ioPort & 0x0Fu;
 }
+
+void K4289::setProgramMemoryMode(bool enable)
+{
+    if (enable == m_programMemoryMode)
+        return;
+
+    m_programMemoryMode = enable;
+    for (uint8_t page = 0u; page < 16u; ++page) {
+        if (isProgramRAMPage(page))
+            notifyProgramChange(page << 8, 256u);
+    }
+}
+
+void K4289::mapProgramRAM(uint8_t page, K4101& highNibbles, K4101& lowNibbles)
+{
+    page &= 0x0Fu;
+    m_highNibbles[page] = &highNibbles;
+    m_lowNibbles[page] = &lowNibbles;
+    notifyProgramChange(page << 8, 256u);
+}
+
+void K4289::unmapProgramRAM(uint8_t page)
+{
+    page &= 0x0Fu;
+    m_highNibbles[page] = nullptr;
+    m_lowNibbles[page] = nullptr;
+    notifyProgramChange(page << 8, 256u);
+}
+
+uint8_t K4289::readProgramByte(uint16_t address) const
+{
+    uint8_t page = (address >> 8) & 0x0Fu;
+    if (!isProgramRAMPage(page))
+        return 0u;
+
+    uint8_t offset = address & 0xFFu;
+    return static_cast<uint8_t>((m_highNibbles[page]->read(offset) << 4) | m_lowNibbles[page]->read(offset));
+}
+
+void K4289::selectProgramAddress(uint8_t address)
+{
+    m_address12bit = (m_address12bit & 0x0F00u) | address;
+    m_lowNibbleNext = false;
+}
+
+void K4289::writePort(uint8_t port, uint8_t value)
+{
+    if (port == PAGE_PORT)
+        m_address12bit = static_cast<uint16_t>(((value & 0x0Fu) << 8) | (m_address12bit & 0xFFu));
+    else if (port == CONTROL_PORT)
+        m_writeEnabled = (value & CONTROL_WRITE_ENABLE) != 0u;
+}
+
+void K4289::writeProgramNibble(uint8_t nibble)
+{
+    if (!m_writeEnabled) {
+        m_readLatch = readProgramNibble();
+        return;
+    }
+
+    uint8_t page = getChipSelect();
+    bool lowNibble = m_lowNibbleNext;
+    m_lowNibbleNext = !m_lowNibbleNext;
+    if (!m_programMemoryMode || !isProgramRAMPage(page))
+        return;
+
+    uint8_t offset = getAddress8bit();
+    K4101* chip = lowNibble ? m_lowNibbles[page] : m_highNibbles[page];
+    uint8_t old = chip->read(offset);
+    chip->write(offset, nibble);
+    if (chip->read(offset) != old)
+        notifyProgramChange(m_address12bit, 1u);
+}
+
+uint8_t K4289::readProgramNibble()
+{
+    uint8_t value = readProgramByte(m_address12bit);
+    bool lowNibble = m_lowNibbleNext;
+    m_lowNibbleNext = !m_lowNibbleNext;
+    return lowNibble ? (value & 0x0Fu) : (value >> 4);
+}
+
+void K4289::notifyProgramChange(uint16_t address, uint16_t length)
+{
+    if (m_programChangeListener)
+        m_programChangeListener(address, length);
+}
@@ -1,6 +1,9 @@
 #pragma once
 #include <cstdint>
 #include <cstddef>
+#include <functional>
+
+class K4101;
 
 // Intel 4289 - Standard Memory Interface
 // Package: 24-pin DIP
@@ -23,6 +26,16 @@
 // - Interface with 4101 (256×4 SRAM)
 // - Interface with 4308 (1K×8 ROM)
 // - Mixed ROM/RAM systems up to 8KB
+//
+// Program RAM:
+// - A page of 256 bytes is a pair of 4101s, one for the high nibbles (OPR)
+//   and one for the low nibbles (OPA)
+// - SRC latches address bits 0-7, WRR to ROM port 14 the page (bits 8-11),
+//   WRR to ROM port 15 bit 0 enables writes
+// - WPM writes ACC to the high nibble, the next WPM to the low nibble. With
+//   writes disabled WPM latches the nibble instead, RDR on port 14 returns it
+// - While program memory mode is on, mapped pages replace the ROM contents
+//   seen by instruction fetch (ROM::attachProgramMemory)
 
 class K4289
 {
@@ -58,9 +71,32 @@ public:
     bool isChipEnabled() const { return m_chipEnabled; }
 
     // Program memory mode (RAM as ROM)
-    void setProgramMemoryMode(bool enable) { m_programMemoryMode = enable; }
+    void setProgramMemoryMode(bool enable);
     bool isProgramMemoryMode() const { return m_programMemoryMode; }
 
+    static constexpr uint8_t PAGE_PORT = 14u;
+    static constexpr uint8_t CONTROL_PORT = 15u;
+    static constexpr uint8_t CONTROL_WRITE_ENABLE = 0b0001u;
+
+    // Program RAM pages, the 4101s are not owned
+    void mapProgramRAM(uint8_t page, K4101& highNibbles, K4101& lowNibbles);
+    void unmapProgramRAM(uint8_t page);
+    bool isProgramRAMPage(uint8_t page) const { return m_highNibbles[page & 0x0Fu] != nullptr; }
+    uint8_t readProgramByte(uint16_t address) const;
+
+    // CPU side: SRC, WRR to PAGE_PORT/CONTROL_PORT, WPM and RPM (4040)
+    void selectProgramAddress(uint8_t address);
+    void writePort(uint8_t port, uint8_t value);
+    void writeProgramNibble(uint8_t nibble);
+    uint8_t readProgramNibble();
+    uint8_t getReadLatch() const { return m_readLatch; }
+    bool isWriteEnabled() const { return m_writeEnabled; }
+
+    // Called with the first address and length of program bytes a fetch may now
+    // see differently (writes, mapping and mode changes)
+    using ProgramChangeListener = std::function<void(uint16_t address, uint16_t length)>;
+    void setProgramChangeListener(ProgramChangeListener listener) { m_programChangeListener = std::move(listener); }
+
     K4289(const K4289&) = delete;
     K4289& operator=(const K4289&) = delete;
 
@@ -77,4 +113,14 @@ private:
     bool m_readMode;                // true=read, false=write
     bool m_chipEnabled;             // Chip enable state
     bool m_programMemoryMode;       // RAM as program memory mode
+
+    // Program RAM
+    void notifyProgramChange(uint16_t address, uint16_t length);
+
+    K4101* m_highNibbles[16];       // Per page, nullptr when not mapped
+    K4101* m_lowNibbles[16];
+    bool m_lowNibbleNext;           // WPM/RPM half flip-flop, reset by SRC
+    bool m_writeEnabled;
+    uint8_t m_readLatch;
+    ProgramChangeListener m_programChangeListener;
 };
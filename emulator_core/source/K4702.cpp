@@ -25,6 +25,9 @@ void K4702::erase()
     std::memset(m_eprom, ERASED_VALUE, EPROM_SIZE);
     m_eraseCount++;
     m_programCount = 0u;
+
+    if (m_programListener)
+        m_programListener(0u, EPROM_SIZE);
 }
 
 bool K4702::program(uint8_t address, uint8_t data)
@@ -53,6 +56,9 @@ bool K4702::program(uint8_t address, uint8_t data)
     m_eprom[address] &= data;
     m_programCount++;
 
+    if (m_programListener && m_eprom[address] != currentValue)
+        m_programListener(address, 1u);
+
     return true;
 }
 
@@ -1,6 +1,7 @@
 #pragma once
 #include <cstdint>
 #include <cstddef>
+#include <functional>
 
 // Intel 4702 - 2K EPROM (256×8)
 // Package: 24-pin DIP (ceramic with UV-erasable window)
@@ -71,6 +72,10 @@ public:
     uint16_t getProgramCount() const { return m_programCount; }
     uint16_t getEraseCount() const { return m_eraseCount; }
 
+    // Called with the first address and length of bytes programming or erasing changed
+    using ProgramListener = std::function<void(uint8_t address, uint16_t length)>;
+    void setProgramListener(ProgramListener listener) { m_programListener = std::move(listener); }
+
     K4702(const K4702&) = delete;
     K4702& operator=(const K4702&) = delete;
 
@@ -79,4 +84,5 @@ private:
     bool m_programMode;             // Programming mode enabled
     uint16_t m_programCount;        // Number of bytes programmed
     uint16_t m_eraseCount;          // Number of erase cycles
+    ProgramListener m_programListener;
 };
@@ -0,0 +1,228 @@
+#include "emulator_core/source/busicom_calculator.hpp"
+#include "emulator_core/source/ascii_hex_parser.hpp"
+#include "emulator_core/source/busicom_hle.hpp"
+
+#include <cctype>
+#include <cstring>
+#include <type_traits>
+
+namespace {
+
+struct KeyName {
+    std::string_view name;
+    uint8_t scanCode;
+};
+
+// Scan codes from the Busicom 141-PF disassembly keyboard table ($081-$0a0)
+constexpr KeyName KEY_NAMES[] = {
+    { "0", 0x9c }, { "1", 0x9b }, { "2", 0x97 }, { "3", 0x93 }, { "4", 0x9a },
+    { "5", 0x96 }, { "6", 0x92 }, { "7", 0x99 }, { "8", 0x95 }, { "9", 0x91 },
+    { ".", 0x94 }, { "00", 0x98 }, { "000", 0x90 },
+    { "+", 0x8e }, { "-", 0x8d }, { "*", 0x8b }, { "x", 0x8b }, { "/", 0x8a }, { "=", 0x8c },
+    { "%", 0x86 }, { "SQRT", 0x85 }, { "<>", 0x89 },
+    { "C", 0xa0 }, { "CE", 0x9f }, { "S", 0x9d }, { "EX", 0x9e },
+    { "CM", 0x81 }, { "RM", 0x82 }, { "M-", 0x83 }, { "M+", 0x84 },
+    { "M=-", 0x87 }, { "M=+", 0x88 },
+};
+
+// Keyboard buffer register KR (bank 0, chip 0, register 0) status characters
+constexpr uint16_t KR_BUFFER_POINTER = 0u;  // KR.S0, 0 when the buffer is empty
+constexpr uint16_t KR_KEY_HELD = 3u;        // KR.S3, 15 while a key is held down
+
+static_assert(std::is_trivially_copyable_v<BusicomCalculator::Snapshot>);
+
+} // namespace
+
+BusicomCalculator::BusicomCalculator() :
+    m_cpu(m_rom, m_ram),
+    m_tape(DEFAULT_TAPE_LINES),
+    m_drum(m_scheduler, CYCLES_PER_SECOND)
+{
+    configurePorts();
+    m_peripherals.connect(m_rom, m_ram);
+    m_peripherals.addPrinterSink(m_tape);
+    m_cpu.setScheduler(&m_scheduler);
+    BusicomHLE::installHooks(m_hooks);
+    m_cpu.setHooks(&m_hooks);
+    m_drum.setListener([this](const PrinterDrum::Signals& signals) { applyDrumSignals(signals); });
+    reset();
+}
+
+bool BusicomCalculator::loadROM(const uint8_t* objectCode, size_t objectCodeLength)
+{
+    if (!m_rom.load(objectCode, objectCodeLength))
+        return false;
+
+    configurePorts();
+    reset();
+    return true;
+}
+
+bool BusicomCalculator::loadROMFile(const std::string& filename)
+{
+    std::vector<uint8_t> objectCode = parseAsciiHexFile(filename);
+    return loadROM(objectCode.data(), objectCode.size());
+}
+
+void BusicomCalculator::configurePorts()
+{
+    // The Busicom object file has no metal mask section
+    m_rom.setIOPortMask(0u, 0b0000u);  // ROM0: shifter outputs
+    m_rom.setIOPortMask(1u, 0b1111u);  // ROM1: keyboard rows
+    m_rom.setIOPortMask(2u, 0b1011u);  // ROM2: drum index (bit0), paper advance button (bit3)
+}
+
+void BusicomCalculator::reset()
+{
+    m_cpu.reset();
+    m_peripherals.reset();
+    m_tape.clear();
+    m_scheduler.reset();
+    m_drum.start(0u);
+}
+
+bool BusicomCalculator::boot(uint64_t maxCycles)
+{
+    reset();
+    runSectors(BusicomPeripherals::NUM_DRUM_SECTORS);
+    return runUntilIdle(maxCycles);
+}
+
+void BusicomCalculator::saveSnapshot(Snapshot& snapshot) const
+{
+    snapshot.magic = SNAPSHOT_MAGIC;
+    m_rom.saveState(snapshot.rom);
+    m_ram.saveState(snapshot.ram);
+    m_cpu.saveState(snapshot.cpu);
+    m_peripherals.saveState(snapshot.peripherals);
+    m_drum.saveState(snapshot.drum);
+}
+
+bool BusicomCalculator::loadSnapshot(const Snapshot& snapshot)
+{
+    if (snapshot.magic != SNAPSHOT_MAGIC)
+        return false;
+
+    m_rom.loadState(snapshot.rom);
+    m_ram.loadState(snapshot.ram);
+    m_cpu.loadState(snapshot.cpu);
+    m_peripherals.clearPrinterOutput();
+    m_peripherals.loadState(snapshot.peripherals);
+    m_tape.clear();
+
+    // Drum edges are re-posted on a fresh timeline starting at the restored cycle
+    m_scheduler.reset();
+    m_scheduler.advanceTo(m_cpu.getCycleCount());
+    m_drum.loadState(snapshot.drum);
+    return true;
+}
+
+bool BusicomCalculator::loadSnapshot(const uint8_t* data, size_t size)
+{
+    if (data == nullptr || size != sizeof(Snapshot))
+        return false;
+
+    Snapshot snapshot;
+    std::memcpy(&snapshot, data, sizeof(Snapshot));
+    return loadSnapshot(snapshot);
+}
+
+void BusicomCalculator::applyDrumSignals(const PrinterDrum::Signals& signals)
+{
+    // Sector signal is active low on TEST, index is raised on ROM2 bit0 ahead of
+    // the first row. Not the other way round: the ROM waits for sectors with
+    // JCN on TEST and reads the index with RDR on ROM2 (busicom_141-PF.disasm).
+    m_cpu.setTest(signals.sectorActive ? 0u : 1u);
+    m_rom.setExternalIOPort(2u, signals.index ? 0b0001u : 0b0000u);
+    m_peripherals.setPrinterSector(signals.sector);
+}
+
+void BusicomCalculator::runUntil(uint64_t cycle)
+{
+    m_cpu.runUntil(cycle);
+}
+
+bool BusicomCalculator::isIdle() const
+{
+    const uint8_t* status = m_ram.getStatusContents();
+    return m_cpu.getPC() == MAIN_LOOP_WAIT_PC &&
+        !m_peripherals.isKeyPressed() &&
+        status[KR_BUFFER_POINTER] == 0u &&
+        status[KR_KEY_HELD] == 0u;
+}
+
+bool BusicomCalculator::runUntilIdle(uint64_t maxCycles)
+{
+    uint64_t deadline = m_cpu.getCycleCount() + maxCycles;
+    while (!isIdle()) {
+        if (m_cpu.getCycleCount() >= deadline)
+            return false;
+
+        if (m_cpu.skipTestWait(deadline) == 0u)
+            m_cpu.clock();
+    }
+    return true;
+}
+
+bool BusicomCalculator::typeKey(uint8_t scanCode, uint64_t maxCycles)
+{
+    m_peripherals.pressKey(scanCode);
+    runSectors(KEY_HOLD_SECTORS);
+    m_peripherals.releaseKey();
+    return runUntilIdle(maxCycles);
+}
+
+bool BusicomCalculator::typeKeys(std::string_view script, uint64_t maxCycles)
+{
+    std::vector<uint8_t> scanCodes;
+    if (!parseKeys(script, scanCodes))
+        return false;
+
+    for (uint8_t scanCode : scanCodes) {
+        if (!typeKey(scanCode, maxCycles))
+            return false;
+    }
+    return true;
+}
+
+bool BusicomCalculator::getScanCode(std::string_view keyName, uint8_t& scanCode)
+{
+    for (const KeyName& key : KEY_NAMES) {
+        if (key.name == keyName) {
+            scanCode = key.scanCode;
+            return true;
+        }
+    }
+    return false;
+}
+
+bool BusicomCalculator::parseKeys(std::string_view script, std::vector<uint8_t>& scanCodes)
+{
+    size_t i = 0u;
+    while (i < script.size()) {
+        if (std::isspace(static_cast<unsigned char>(script[i]))) {
+            ++i;
+            continue;
+        }
+
+        size_t end = i;
+        while (end < script.size() && !std::isspace(static_cast<unsigned char>(script[end])))
+            ++end;
+        std::string_view token = script.substr(i, end - i);
+        i = end;
+
+        uint8_t scanCode;
+        if (getScanCode(token, scanCode)) {
+            scanCodes.push_back(scanCode);
+            continue;
+        }
+
+        // Not a key name, type it one character key at a time ("12.5", "2+3=")
+        for (size_t c = 0u; c < token.size(); ++c) {
+            if (!getScanCode(token.substr(c, 1u), scanCode))
+                return false;
+            scanCodes.push_back(scanCode);
+        }
+    }
+    return true;
+}
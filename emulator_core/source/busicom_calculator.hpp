@@ -0,0 +1,127 @@
+#pragma once
+#include "emulator_core/source/K4004.hpp"
+#include "emulator_core/source/busicom_peripherals.hpp"
+#include "emulator_core/source/busicom_printer_drum.hpp"
+#include "emulator_core/source/event_scheduler.hpp"
+#include "emulator_core/source/hle_hooks.hpp"
+#include "emulator_core/source/ram.hpp"
+#include "emulator_core/source/rom.hpp"
+
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <string_view>
+#include <vector>
+
+// Headless Busicom 141-PF calculator
+//
+// Wires a 4004, the ROM/RAM banks and BusicomPeripherals together and drives
+// the printer drum signals the ROM synchronises to: the sector signal on TEST
+// (active low) and the index signal on ROM2 bit0 before the first row. Drum
+// edges are scheduled events, so the ROM's TEST wait loops are skipped instead
+// of stepped. Keys are typed by holding them for a few drum sectors and
+// waiting until the main loop is idle again, results are read back from the
+// printed lines. The number register routines in busicom_hle.hpp can run
+// natively (off by default).
+
+class BusicomCalculator
+{
+public:
+    static constexpr size_t DEFAULT_TAPE_LINES = 256u;
+
+    static constexpr uint64_t CYCLES_PER_SECOND = 92589u;  // K4201A default 5.185 MHz / 7 / 8
+    static constexpr uint32_t KEY_HOLD_SECTORS = 2u;       // The ROM scans the keyboard once per sector
+    static constexpr uint64_t DEFAULT_KEY_TIMEOUT = CYCLES_PER_SECOND * 15u;  // 15 s of emulated time
+
+    // Complete machine state. Trivially copyable, so a snapshot taken after
+    // boot() can be embedded as bytes and restored with a memcpy.
+    struct Snapshot {
+        uint32_t magic;
+        ROM::State rom;
+        RAM::State ram;
+        K4004::State cpu;
+        BusicomPeripherals::State peripherals;
+        PrinterDrum::State drum;
+    };
+    static constexpr uint32_t SNAPSHOT_MAGIC = 0x32'4E'53'42u;  // "BSN2", bump when the layout changes
+
+    BusicomCalculator();
+
+    // Load the calculator program (ROM loader format) and power on
+    bool loadROM(const uint8_t* objectCode, size_t objectCodeLength);
+    bool loadROMFile(const std::string& filename);  // ASCII hex object file
+
+    // Power-on reset, the drum restarts at sector 0
+    void reset();
+
+    // Power on and run one drum revolution so the ROM has seen the index pulse
+    // and waits in its idle loop, false if it never gets there
+    bool boot(uint64_t maxCycles = DEFAULT_KEY_TIMEOUT);
+
+    // Printed lines are not part of a snapshot, loading one clears them
+    void saveSnapshot(Snapshot& snapshot) const;
+    bool loadSnapshot(const Snapshot& snapshot);
+    bool loadSnapshot(const uint8_t* data, size_t size);  // Bytes of a Snapshot from this build
+
+    // Run whole instructions until the cycle count reaches cycle
+    void runUntil(uint64_t cycle);
+    void runSectors(uint32_t sectors) { runUntil(getCycleCount() + sectors * m_drum.getSectorCycles()); }
+
+    // Run until the main loop waits for the drum with an empty keyboard buffer
+    // and no key held, false if that does not happen within maxCycles
+    bool runUntilIdle(uint64_t maxCycles = DEFAULT_KEY_TIMEOUT);
+    bool isIdle() const;
+
+    // Press and release one key (scan code 0x81-0xa0), then wait until idle
+    bool typeKey(uint8_t scanCode, uint64_t maxCycles = DEFAULT_KEY_TIMEOUT);
+
+    // Type a whitespace separated key script such as "12.5 * 4 =", false on a
+    // parse error or when the calculator stops responding
+    bool typeKeys(std::string_view script, uint64_t maxCycles = DEFAULT_KEY_TIMEOUT);
+
+    // Translate a script into scan codes. Numbers are typed digit by digit,
+    // other tokens are key names (+ - * / = . C CE S EX % SQRT 00 000 <>
+    // CM RM M+ M- M=+ M=-)
+    static bool parseKeys(std::string_view script, std::vector<uint8_t>& scanCodes);
+    static bool getScanCode(std::string_view keyName, uint8_t& scanCode);
+
+    // The most recent DEFAULT_TAPE_LINES printed lines. More sinks can be
+    // added through getPeripherals().addPrinterSink().
+    const PrinterRingSink& getPrintedLines() const { return m_tape; }
+    void clearPrintedLines() { m_tape.clear(); }
+
+    uint64_t getCycleCount() const { return m_cpu.getCycleCount(); }
+    uint8_t getDrumSector() const { return m_peripherals.getPrinterSector(); }
+
+    // Drum speed, 164.8 RPM (~28 ms per sector) by default
+    void setDrumRPM(double rpm) { m_drum.setRPM(rpm); }
+    const PrinterDrum& getDrum() const { return m_drum; }
+
+    // Native number register routines, Validate steps them too and counts differences
+    void setHLEMode(HLEHookTable::Mode mode) { m_hooks.setMode(mode); }
+    HLEHookTable& getHooks() { return m_hooks; }
+
+    K4004& getCPU() { return m_cpu; }
+    ROM& getROM() { return m_rom; }
+    RAM& getRAM() { return m_ram; }
+    BusicomPeripherals& getPeripherals() { return m_peripherals; }
+    const BusicomPeripherals& getPeripherals() const { return m_peripherals; }
+
+    BusicomCalculator(const BusicomCalculator&) = delete;
+    BusicomCalculator& operator=(const BusicomCalculator&) = delete;
+
+private:
+    static constexpr uint16_t MAIN_LOOP_WAIT_PC = 0x001u;  // jcn TZ $001
+
+    void configurePorts();
+    void applyDrumSignals(const PrinterDrum::Signals& signals);
+
+    ROM m_rom;
+    RAM m_ram;
+    K4004 m_cpu;
+    BusicomPeripherals m_peripherals;
+    PrinterRingSink m_tape;
+    EventScheduler m_scheduler;
+    PrinterDrum m_drum;
+    HLEHookTable m_hooks;
+};
@@ -0,0 +1,78 @@
+#include "emulator_core/source/busicom_hle.hpp"
+#include "emulator_core/source/instructions.hpp"
+#include "emulator_core/source/ram.hpp"
+#include "emulator_core/source/rom.hpp"
+
+namespace {
+
+constexpr uint8_t NUMBER_PAIR = 4u;  // R8 = number register, R9 = digit
+constexpr uint8_t R8 = 8u;
+constexpr uint8_t R9 = 9u;
+constexpr uint8_t R13 = 13u;
+
+void selectDigit(K4004::State& state, RAM& ram, ROM& rom)
+{
+    uint8_t address = state.registers[NUMBER_PAIR];
+    rom.writeSrcAddress(address);
+    ram.writeSrcAddress(address);
+}
+
+// inc 8 (incs times), then src 4< / wrm / isz 9 for the remaining digits, wr0, wr1, bbl 0
+bool clearNumber(K4004::State& state, RAM& ram, ROM& rom, uint8_t incs)
+{
+    setRegisterValue(state.registers, R8, getRegisterValue(state.registers, R8) + incs);
+    state.cycleCount += incs;
+
+    uint8_t value = state.ACC & 0x0Fu;
+    do {
+        selectDigit(state, ram, rom);
+        ram.writeRAM(value);
+        setRegisterValue(state.registers, R9, getRegisterValue(state.registers, R9) + 1u);
+        state.cycleCount += 4u;
+    } while (getRegisterValue(state.registers, R9) != 0u);
+
+    ram.writeStatus(value, 0u);
+    ram.writeStatus(value, 1u);
+    state.cycleCount += 2u;
+
+    HLEHookTable::returnFromRoutine(state, 0u);
+    return true;
+}
+
+// xch 13, ld 9, then dac / clc / xch 9 / src 4< / rdm / xch 13 / wrm / ld 9 / jcn AN
+// until R9 is 0: ACC enters the top digit, the bottom digit ends in R13
+bool shiftRight(K4004::State& state, RAM& ram, ROM& rom)
+{
+    uint8_t carried = state.ACC & 0x0Fu;
+    state.cycleCount += 2u;
+
+    uint8_t digit = getRegisterValue(state.registers, R9);
+    do {
+        digit = (digit - 1u) & 0x0Fu;
+        setRegisterValue(state.registers, R9, digit);
+        selectDigit(state, ram, rom);
+        uint8_t shiftedOut = ram.readRAM();
+        ram.writeRAM(carried);
+        carried = shiftedOut;
+        state.cycleCount += 10u;
+    } while (digit != 0u);
+
+    setRegisterValue(state.registers, R13, carried);
+    state.ACC = 0u;  // ld 9 after clc
+    HLEHookTable::returnFromRoutine(state, 0u);
+    return true;
+}
+
+} // namespace
+
+namespace BusicomHLE {
+
+void installHooks(HLEHookTable& table)
+{
+    table.setHook(CLEAR_SR, [](K4004::State& state, RAM& ram, ROM& rom) { return clearNumber(state, ram, rom, 4u); });
+    table.setHook(CLEAR_TR, [](K4004::State& state, RAM& ram, ROM& rom) { return clearNumber(state, ram, rom, 1u); });
+    table.setHook(CLEAR_NUMBER, [](K4004::State& state, RAM& ram, ROM& rom) { return clearNumber(state, ram, rom, 0u); });
+    table.setHook(SHIFT_RIGHT, shiftRight);
+}
+
+} // namespace BusicomHLE
@@ -0,0 +1,30 @@
+#pragma once
+#include "emulator_core/source/hle_hooks.hpp"
+
+// Native versions of the Busicom 141-PF number register routines
+//
+// The routines below are called with JMS and only touch the CPU and RAM
+// characters, so they can be replaced without changing anything the ROM or
+// the peripherals observe (see busicom_141-PF.disasm):
+//
+//   $146  CLR SR  (inc 8 x4, then $14a)
+//   $149  CLR TR  (inc 8, then $14a)
+//   $14a  NR(R8).M(R9..15) = ACC, NR(R8).S0-1 = ACC
+//   $15f  one digit right shift of NR(R8).M(R9-1..0) through R13
+//
+// They are not where a calculation spends its time. Most stepped cycles go to
+// the keyboard scan and printer shifting done once per drum sector, which
+// touch I/O ports, and the arithmetic runs as pseudo-code through the $100
+// interpreter rather than as JMS targets. Native mode saves only a few
+// percent, the hooks are there to check native routines against the ROM.
+
+namespace BusicomHLE {
+
+constexpr uint16_t CLEAR_SR = 0x146u;
+constexpr uint16_t CLEAR_TR = 0x149u;
+constexpr uint16_t CLEAR_NUMBER = 0x14au;
+constexpr uint16_t SHIFT_RIGHT = 0x15fu;
+
+void installHooks(HLEHookTable& table);
+
+} // namespace BusicomHLE
@@ -1,4 +1,11 @@
 #include "emulator_core/source/busicom_peripherals.hpp"
+#include "emulator_core/source/ram.hpp"
+#include "emulator_core/source/rom.hpp"
+
+#include <algorithm>
+#include <bit>
+#include <iterator>
+#include <string_view>
 #include <sstream>
 #include <iomanip>
 
@@ -37,11 +44,22 @@ const uint8_t BusicomPeripherals::KEYBOARD_MATRIX[10][4] = {
     {0x00, 0x00, 0x00, 0x00}   // Not scanned for keys
 };
 
+// Printer drum rows (from Busicom disassembly, chapter 3.3), column 16 is empty
+const char BusicomPeripherals::DRUM_DIGITS[NUM_DRUM_SECTORS + 1] = "0123456789..-";
+
+const char* const BusicomPeripherals::DRUM_COLUMN17[NUM_DRUM_SECTORS] = {
+    "<>", "+", "-", "X", "/", "M+", "M-", "^", "=", "SQRT", "%", "C", "R"
+};
+
+const char* const BusicomPeripherals::DRUM_COLUMN18[NUM_DRUM_SECTORS] = {
+    "#", "*", "I", "II", "III", "M+", "M-", "T", "K", "E", "Ex", "C", "M"
+};
+
 BusicomPeripherals::BusicomPeripherals()
     : m_pressedKey(0)
     , m_keyActive(false)
     , m_keyboardShifter(0x000)  // Start empty, will be loaded by shifter initialization
-    , m_shiftColumn(0)
+    , m_shiftColumn(NO_COLUMN)
     , m_lastRom0Output(0)
     , m_printerShifter(0)
     , m_memoryLamp(false)
@@ -51,21 +69,114 @@ BusicomPeripherals::BusicomPeripherals()
     , m_printerColor(false)
     , m_printerFire(false)
     , m_paperAdvance(false)
+    , m_rom(nullptr)
 {
-    m_printerOutput.hasDecimalPoint = false;
-    m_printerOutput.decimalPosition = 0;
+    reset();
+}
+
+void BusicomPeripherals::reset()
+{
+    m_pressedKey = 0;
+    m_keyActive = false;
+    m_keyboardShifter = 0x000;
+    m_shiftColumn = NO_COLUMN;
+    m_lastRom0Output = m_rom ? m_rom->getIOPort(0u) : 0;
+    m_printerShifter = 0;
+    m_memoryLamp = false;
+    m_overflowLamp = false;
+    m_minusLamp = false;
+    m_roundLamp = false;
+    m_printerColor = false;
+    m_printerFire = false;
+    m_paperAdvance = false;
+    m_printerSector = 0;
+    clearPrinterOutput();
+    refreshKeyboardRows();
+}
+
+void BusicomPeripherals::saveState(State& state) const
+{
+    state.keyboardShifter = m_keyboardShifter;
+    state.printerShifter = m_printerShifter;
+    state.pressedKey = m_pressedKey;
+    state.keyActive = m_keyActive;
+    state.shiftColumn = m_shiftColumn;
+    state.lastRom0Output = m_lastRom0Output;
+    state.printerSector = m_printerSector;
+    std::copy(std::begin(m_lineSectors), std::end(m_lineSectors), state.lineSectors);
+    state.lineRed = m_lineRed;
+    state.memoryLamp = m_memoryLamp;
+    state.overflowLamp = m_overflowLamp;
+    state.minusLamp = m_minusLamp;
+    state.roundLamp = m_roundLamp;
+    state.printerColor = m_printerColor;
+    state.printerFire = m_printerFire;
+    state.paperAdvance = m_paperAdvance;
+}
+
+void BusicomPeripherals::loadState(const State& state)
+{
+    m_keyboardShifter = state.keyboardShifter;
+    m_printerShifter = state.printerShifter;
+    m_pressedKey = state.pressedKey;
+    m_keyActive = state.keyActive;
+    m_shiftColumn = state.shiftColumn;
+    m_lastRom0Output = state.lastRom0Output;
+    m_printerSector = state.printerSector % NUM_DRUM_SECTORS;
+    std::copy(std::begin(state.lineSectors), std::end(state.lineSectors), m_lineSectors);
+    m_lineRed = state.lineRed;
+    m_memoryLamp = state.memoryLamp;
+    m_overflowLamp = state.overflowLamp;
+    m_minusLamp = state.minusLamp;
+    m_roundLamp = state.roundLamp;
+    m_printerColor = state.printerColor;
+    m_printerFire = state.printerFire;
+    m_paperAdvance = state.paperAdvance;
+    refreshKeyboardRows();
+}
+
+void BusicomPeripherals::connect(ROM& rom, RAM& ram)
+{
+    m_rom = &rom;
+    rom.setIOPortMask(1u, 0b1111u);  // ROM1: keyboard matrix rows are inputs
+
+    rom.addIOPortListener([this](const IOPortChange& change) {
+        // ROM0 drives the keyboard and printer shifters
+        if (change.port == 0u) {
+            updateShiftRegister(change.newValue);
+            refreshKeyboardRows();
+        }
+    });
+
+    ram.addOutputPortListener([this](const IOPortChange& change) {
+        // RAM0 controls the printer, RAM1 the status lamps
+        if (change.port == 0u)
+            updatePrinterControl(change.newValue);
+        else if (change.port == 1u)
+            updateStatusLamps(change.newValue);
+    });
+
+    refreshKeyboardRows();
 }
 
 void BusicomPeripherals::pressKey(uint8_t scanCode)
 {
     m_pressedKey = scanCode;
     m_keyActive = true;
+    refreshKeyboardRows();
 }
 
 void BusicomPeripherals::releaseKey()
 {
     m_keyActive = false;
     m_pressedKey = 0;
+    refreshKeyboardRows();
+}
+
+void BusicomPeripherals::refreshKeyboardRows()
+{
+    if (m_rom)
+        m_rom->setExternalIOPort(1u, getKeyboardRows());
 }
 
 bool BusicomPeripherals::isKeyPressed() const
@@ -99,15 +210,15 @@ void BusicomPeripherals::updateShiftRegister(uint8_t rom0Output)
         }
         // If data=0, bit 0 stays 0 (already cleared by mask)
 
-        // Update current column (find which bit is set)
-        // Scan from MSB to LSB to find the active column
-        m_shiftColumn = 0;
-        for (uint8_t col = 0; col < 10; col++) {
-            if (m_keyboardShifter & (1 << col)) {
-                m_shiftColumn = col;
-                // Don't break - find the highest set bit
-            }
-        }
+        // Update current column. The ROM selects a column by shifting a single
+        // low bit through a register of highs (active-low), a lone high bit in
+        // an otherwise clear register selects it too. Anything else selects none.
+        m_shiftColumn = NO_COLUMN;
+        uint32_t lowBits = ~m_keyboardShifter & 0x3FF;
+        if (std::popcount(m_keyboardShifter) == 1)
+            m_shiftColumn = static_cast<uint8_t>(std::countr_zero(m_keyboardShifter));
+        else if (std::popcount(lowBits) == 1)
+            m_shiftColumn = static_cast<uint8_t>(std::countr_zero(lowBits));
     }
 
     // Detect rising edge on printer clock
@@ -131,7 +242,7 @@ uint8_t BusicomPeripherals::getKeyboardRows() const
     // If a key is pressed and we're scanning its column, activate the corresponding row
 
     if (!m_keyActive || m_shiftColumn >= 8) {
-        // No key pressed, or scanning switch columns
+        // No key pressed, no column selected, or scanning switch columns
         return 0x00;
     }
 
@@ -149,10 +260,9 @@ uint8_t BusicomPeripherals::getKeyboardRows() const
 
 void BusicomPeripherals::clearPrinterOutput()
 {
-    m_printerOutput.digits.clear();
-    m_printerOutput.symbols.clear();
-    m_printerOutput.hasDecimalPoint = false;
-    m_printerOutput.decimalPosition = 0;
+    m_printerOutput = PrinterCapture{ {}, {}, {}, false, 0, false };
+    std::fill(std::begin(m_lineSectors), std::end(m_lineSectors), NO_SECTOR);
+    m_lineRed = false;
 }
 
 void BusicomPeripherals::updateStatusLamps(uint8_t ram1Output)
@@ -177,9 +287,9 @@ void BusicomPeripherals::updatePrinterControl(uint8_t ram0Output)
     // bit2 = not used
     // bit3 = advance paper
 
-    m_printerColor = (ram0Output & 0x01) != 0;
+    bool color = (ram0Output & 0x01) != 0;
     bool fire = (ram0Output & 0x02) != 0;
-    m_paperAdvance = (ram0Output & 0x08) != 0;
+    bool advance = (ram0Output & 0x08) != 0;
 
     // Capture printer output when hammers fire
     if (fire && !m_printerFire) {
@@ -187,7 +297,17 @@ void BusicomPeripherals::updatePrinterControl(uint8_t ram0Output)
         decodeAndCapturePrinter();
     }
 
+    // The ROM only pulses the ribbon shift, the line stays red until the paper advances
+    if (color && !m_printerColor)
+        m_lineRed = true;
+
+    // Advancing the paper completes the line
+    if (advance && !m_paperAdvance)
+        finishPrinterLine();
+
+    m_printerColor = color;
     m_printerFire = fire;
+    m_paperAdvance = advance;
 }
 
 void BusicomPeripherals::decodeAndCapturePrinter()
@@ -197,25 +317,90 @@ void BusicomPeripherals::decodeAndCapturePrinter()
     // bit02: unused
     // bit03-17: columns 1-15 (digits and decimal points)
     // bit18-19: unused
+    //
+    // Each fired hammer prints the character of the current drum sector
 
-    // For now, just capture the pattern as a hex string
-    // Full character decoding would require drum sector timing
-    // which we can implement when needed for display
+    for (uint8_t bit = 0; bit < 18; bit++) {
+        if (bit == 2 || !(m_printerShifter & (1u << bit)))
+            continue;
 
-    std::stringstream ss;
-    ss << std::hex << std::setw(5) << std::setfill('0') << m_printerShifter;
-
-    // Simple digit extraction: if bit 3-17 are set, likely printing a digit
-    if (m_printerShifter & 0x0003FFF8) {
-        // Extract which columns are active
-        for (int col = 3; col <= 17; col++) {
-            if (m_printerShifter & (1 << col)) {
-                m_printerOutput.digits += 'X';  // Placeholder for actual digit
-            }
-        }
+        uint8_t column = bit < 2 ? 16 + bit : bit - 3;  // 0-based column index
+        m_lineSectors[column] = m_printerSector;
     }
 }
 
+void BusicomPeripherals::finishPrinterLine()
+{
+    bool hasInk = std::any_of(std::begin(m_lineSectors), std::end(m_lineSectors),
+        [](uint8_t sector) { return sector != NO_SECTOR; });
+    if (!hasInk)
+        return;  // Paper feed only
+
+    PrinterLine line{};
+    line.red = m_lineRed;
+
+    for (uint8_t column = 0; column < 15; column++) {
+        uint8_t sector = m_lineSectors[column];
+        char c = sector == NO_SECTOR ? ' ' : DRUM_DIGITS[sector];
+        line.text[line.textLength++] = c;
+        if (c == ' ')
+            continue;
+
+        line.digits[line.digitCount++] = c;
+        if (c == '.' && !line.hasDecimalPoint)
+            line.hasDecimalPoint = true;
+        else if (line.hasDecimalPoint)
+            line.decimalPosition++;
+    }
+
+    std::string_view column17 = m_lineSectors[16] == NO_SECTOR ? "" : DRUM_COLUMN17[m_lineSectors[16]];
+    std::string_view column18 = m_lineSectors[17] == NO_SECTOR ? "" : DRUM_COLUMN18[m_lineSectors[17]];
+
+    // Columns 16 and 17 are separated by a gap, column 17 is 4 characters wide
+    auto appendText = [&line](std::string_view part) {
+        for (char c : part)
+            line.text[line.textLength++] = c;
+    };
+    appendText("  ");
+    appendText(column17);
+    appendText(std::string_view("    ").substr(column17.size()));
+    appendText(" ");
+    appendText(column18);
+    while (line.textLength > 0 && line.text[line.textLength - 1] == ' ')
+        line.textLength--;
+
+    for (char c : column17)
+        line.symbols[line.symbolsLength++] = c;
+    if (!column17.empty() && !column18.empty())
+        line.symbols[line.symbolsLength++] = ' ';
+    for (char c : column18)
+        line.symbols[line.symbolsLength++] = c;
+
+    m_printerOutput.text.assign(line.getText());
+    m_printerOutput.digits.assign(line.getDigits());
+    m_printerOutput.symbols.assign(line.getSymbols());
+    m_printerOutput.hasDecimalPoint = line.hasDecimalPoint;
+    m_printerOutput.decimalPosition = line.decimalPosition;
+    m_printerOutput.red = line.red;
+
+    for (PrinterSink* sink : m_printerSinks)
+        sink->onLine(line);
+
+    std::fill(std::begin(m_lineSectors), std::end(m_lineSectors), NO_SECTOR);
+    m_lineRed = false;
+}
+
+void BusicomPeripherals::addPrinterSink(PrinterSink& sink)
+{
+    if (std::find(m_printerSinks.begin(), m_printerSinks.end(), &sink) == m_printerSinks.end())
+        m_printerSinks.push_back(&sink);
+}
+
+void BusicomPeripherals::removePrinterSink(PrinterSink& sink)
+{
+    m_printerSinks.erase(std::remove(m_printerSinks.begin(), m_printerSinks.end(), &sink), m_printerSinks.end());
+}
+
 std::string BusicomPeripherals::getKeyboardState() const
 {
     std::stringstream ss;
@@ -4,6 +4,11 @@
 #include <vector>
 #include <queue>
 
+#include "emulator_core/source/busicom_printer_sink.hpp"
+
+class ROM;
+class RAM;
+
 // Minimal Busicom 141-PF Peripheral Simulation
 //
 // This class provides just enough peripheral simulation to enable
@@ -11,7 +16,7 @@
 //
 // Architecture:
 // - Keyboard: Inject scan codes when shift register scans active column
-// - Printer: Capture shift register output patterns
+// - Printer: Decode hammer patterns against the drum sector into printed lines
 // - Status Lamps: Monitor RAM1 output port
 //
 // Based on Busicom 141-PF disassembly analysis:
@@ -25,8 +30,43 @@
 class BusicomPeripherals
 {
 public:
+    static constexpr uint8_t NUM_DRUM_SECTORS = 13u;
+    static constexpr uint8_t NUM_PRINT_COLUMNS = 18u;
+
+    // Keyboard, shifter, lamp and printer mechanism state, plain data for
+    // snapshots. Printed lines are not part of it.
+    struct State {
+        uint32_t keyboardShifter;
+        uint32_t printerShifter;
+        uint8_t pressedKey;
+        bool keyActive;
+        uint8_t shiftColumn;
+        uint8_t lastRom0Output;
+        uint8_t printerSector;
+        uint8_t lineSectors[NUM_PRINT_COLUMNS];
+        bool lineRed;
+        bool memoryLamp;
+        bool overflowLamp;
+        bool minusLamp;
+        bool roundLamp;
+        bool printerColor;
+        bool printerFire;
+        bool paperAdvance;
+    };
+
     BusicomPeripherals();
 
+    // Clear keyboard, shifter, lamp and printer state (connections are kept)
+    void reset();
+
+    // Restoring a state drives the keyboard rows into the connected ROM
+    void saveState(State& state) const;
+    void loadState(const State& state);
+
+    // Subscribe to ROM0/RAM0/RAM1 port changes and drive the ROM1 keyboard rows,
+    // replacing per-step port polling. The peripherals must outlive both chips.
+    void connect(ROM& rom, RAM& ram);
+
     // Keyboard interface
     void pressKey(uint8_t scanCode);        // Press key (scan codes 0x81-0xa0)
     void releaseKey();                       // Release currently pressed key
@@ -38,17 +78,29 @@ public:
     // Get keyboard matrix row status for ROM1 input
     uint8_t getKeyboardRows() const;
 
-    // Printer output capture
+    // Last printed line
     struct PrinterCapture {
-        std::string digits;       // Captured numeric digits
-        std::string symbols;      // Captured symbols (+, -, ×, /, =, etc.)
+        std::string text;         // Line as printed, columns 1-15, 17 and 18
+        std::string digits;       // Captured numeric digits (columns 1-15 without blanks)
+        std::string symbols;      // Captured symbols (+, -, X, /, =, etc.)
         bool hasDecimalPoint;
-        int decimalPosition;
+        int decimalPosition;      // Digits after the decimal point
+        bool red;                 // Printed with the red half of the ribbon (negative)
     };
 
     const PrinterCapture& getPrinterOutput() const { return m_printerOutput; }
     void clearPrinterOutput();
 
+    // Completed lines are decoded once and passed to every sink (not owned,
+    // they must stay alive until removed)
+    void addPrinterSink(PrinterSink& sink);
+    void removePrinterSink(PrinterSink& sink);
+    void clearPrinterSinks() { m_printerSinks.clear(); }
+
+    // Drum row currently under the hammers (driven by the drum sector signal)
+    void setPrinterSector(uint8_t sector) { m_printerSector = sector % NUM_DRUM_SECTORS; }
+    uint8_t getPrinterSector() const { return m_printerSector; }
+
     // Status lamps (from RAM1)
     void updateStatusLamps(uint8_t ram1Output);
     bool isMemoryLampOn() const { return m_memoryLamp; }
@@ -79,9 +131,20 @@ private:
     // Keyboard matrix mapping (10 columns × 4 rows)
     // Based on Busicom disassembly scan code table
     static const uint8_t KEYBOARD_MATRIX[10][4];
+    static constexpr uint8_t NO_COLUMN = 0xFFu;
+
+    // Printer drum characters per sector (columns 1-15, column 17, column 18)
+    static const char DRUM_DIGITS[NUM_DRUM_SECTORS + 1];
+    static const char* const DRUM_COLUMN17[NUM_DRUM_SECTORS];
+    static const char* const DRUM_COLUMN18[NUM_DRUM_SECTORS];
+    static constexpr uint8_t NO_SECTOR = 0xFFu;
 
     // Printer output
     PrinterCapture m_printerOutput;
+    std::vector<PrinterSink*> m_printerSinks;
+    uint8_t m_printerSector;
+    uint8_t m_lineSectors[NUM_PRINT_COLUMNS];  // Sector printed per column, NO_SECTOR if blank
+    bool m_lineRed;
 
     // Status lamps
     bool m_memoryLamp;
@@ -94,7 +157,12 @@ private:
     bool m_printerFire;        // Fire hammers
     bool m_paperAdvance;       // Advance paper
 
+    // Connected ROM (keyboard rows are driven into ROM1 inputs)
+    ROM* m_rom;
+
     // Helper methods
+    void refreshKeyboardRows();
     void shiftKeyboardColumn();
     void decodeAndCapturePrinter();
+    void finishPrinterLine();
 };
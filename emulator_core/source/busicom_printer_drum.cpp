@@ -0,0 +1,123 @@
+#include "emulator_core/source/busicom_printer_drum.hpp"
+
+#include <cmath>
+
+PrinterDrum::PrinterDrum(EventScheduler& scheduler, uint64_t cyclesPerSecond) :
+    m_scheduler(scheduler),
+    m_cyclesPerSecond(cyclesPerSecond),
+    m_sectorCycles(0u),
+    m_originCycle(0u),
+    m_originSector(0u),
+    m_running(false),
+    m_inactiveEdge(EventScheduler::INVALID_EVENT),
+    m_activeEdge(EventScheduler::INVALID_EVENT)
+{
+    setRPM(DEFAULT_RPM);
+}
+
+PrinterDrum::~PrinterDrum()
+{
+    cancelEdges();
+}
+
+void PrinterDrum::setRPM(double rpm)
+{
+    if (!(rpm > 0.0))
+        return;
+
+    // cycles per sector = cycles per minute / sectors per minute, at least 2 for both halves
+    double cycles = std::round(m_cyclesPerSecond * 60.0 / (rpm * NUM_SECTORS));
+    uint64_t sectorCycles = cycles < 2.0 ? 2u : static_cast<uint64_t>(cycles);
+    if (sectorCycles == m_sectorCycles)
+        return;
+
+    if (!m_running) {
+        m_sectorCycles = sectorCycles;
+        return;
+    }
+
+    // Keep the sector currently under the hammers, continue at the new speed from its start
+    uint64_t cycle = m_scheduler.getCurrentCycle();
+    uint8_t sector = getSignalsAt(cycle).sector;
+    uint64_t sectorStart = cycle < m_originCycle ? m_originCycle : cycle - (cycle - m_originCycle) % m_sectorCycles;
+    m_sectorCycles = sectorCycles;
+    start(sectorStart, sector);
+}
+
+double PrinterDrum::getRPM() const
+{
+    return m_cyclesPerSecond * 60.0 / (static_cast<double>(m_sectorCycles) * NUM_SECTORS);
+}
+
+void PrinterDrum::start(uint64_t originCycle, uint8_t originSector)
+{
+    cancelEdges();
+    m_originCycle = originCycle;
+    m_originSector = originSector % NUM_SECTORS;
+    m_running = true;
+    scheduleEdges();
+    notify(m_scheduler.getCurrentCycle());
+}
+
+void PrinterDrum::stop()
+{
+    cancelEdges();
+    m_running = false;
+}
+
+PrinterDrum::Signals PrinterDrum::getSignalsAt(uint64_t cycle) const
+{
+    if (!m_running || cycle < m_originCycle)
+        return Signals{ m_originSector, false, false };
+
+    uint64_t position = cycle - m_originCycle;
+    uint8_t sector = static_cast<uint8_t>((m_originSector + position / m_sectorCycles) % NUM_SECTORS);
+    bool active = position % m_sectorCycles >= m_sectorCycles / 2u;
+    return Signals{ sector, active, !active && sector == 0u };
+}
+
+void PrinterDrum::saveState(State& state) const
+{
+    state.originCycle = m_originCycle;
+    state.sectorCycles = m_sectorCycles;
+    state.originSector = m_originSector;
+    state.running = m_running;
+}
+
+void PrinterDrum::loadState(const State& state)
+{
+    m_sectorCycles = state.sectorCycles < 2u ? 2u : state.sectorCycles;
+    if (state.running)
+        start(state.originCycle, state.originSector);
+    else
+        stop();
+}
+
+void PrinterDrum::scheduleEdges()
+{
+    // First edges after the current cycle, aligned to the origin
+    uint64_t now = m_scheduler.getCurrentCycle();
+    uint64_t half = m_sectorCycles / 2u;
+    uint64_t sectorStart = now < m_originCycle ? m_originCycle : now - (now - m_originCycle) % m_sectorCycles;
+
+    uint64_t nextInactive = sectorStart > now ? sectorStart : sectorStart + m_sectorCycles;
+    uint64_t nextActive = sectorStart + half > now ? sectorStart + half : sectorStart + m_sectorCycles + half;
+
+    auto onEdge = [this](uint64_t cycle) { notify(cycle); };
+    m_inactiveEdge = m_scheduler.schedulePeriodic(nextInactive, m_sectorCycles, onEdge);
+    m_activeEdge = m_scheduler.schedulePeriodic(nextActive, m_sectorCycles, onEdge);
+}
+
+void PrinterDrum::cancelEdges()
+{
+    m_scheduler.cancel(m_inactiveEdge);
+    m_scheduler.cancel(m_activeEdge);
+    m_inactiveEdge = EventScheduler::INVALID_EVENT;
+    m_activeEdge = EventScheduler::INVALID_EVENT;
+}
+
+void PrinterDrum::notify(uint64_t cycle)
+{
+    if (m_listener)
+        m_listener(getSignalsAt(cycle));
+}
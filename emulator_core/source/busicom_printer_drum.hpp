@@ -0,0 +1,84 @@
+#pragma once
+#include <cstdint>
+#include <functional>
+
+#include "emulator_core/source/event_scheduler.hpp"
+
+// Busicom 141-PF printer drum timing
+//
+// The drum carries 13 character rows (sectors) and turns continuously. A
+// magnetic pickup produces the sector signal: inactive for the first half of
+// each sector while the next row approaches, active for the second half while
+// the row passes the hammers. A second pickup raises the index signal during
+// the inactive half of sector 0. On the 141-PF the sector signal goes to the
+// 4004 TEST pin and the index signal to ROM2 bit0.
+//
+// Both edges are posted on an EventScheduler as periodic events, so the CPU
+// only sees signal changes at the cycles they happen and wait loops on TEST
+// can be skipped up to the next edge.
+
+class PrinterDrum
+{
+public:
+    static constexpr uint8_t NUM_SECTORS = 13u;
+    static constexpr double DEFAULT_RPM = 164.8;  // ~28 ms per sector
+
+    struct Signals {
+        uint8_t sector;      // Row under the hammers
+        bool sectorActive;   // Row passing the hammers (drives TEST low)
+        bool index;          // Index pickup, inactive half of sector 0 only
+    };
+
+    // Called on every edge and when the drum is (re)started
+    using Listener = std::function<void(const Signals& signals)>;
+
+    // Drum phase and speed, plain data for snapshots
+    struct State {
+        uint64_t originCycle;   // Cycle at which originSector started
+        uint64_t sectorCycles;
+        uint8_t originSector;
+        bool running;
+    };
+
+    PrinterDrum(EventScheduler& scheduler, uint64_t cyclesPerSecond);
+    ~PrinterDrum();
+
+    void setListener(Listener listener) { m_listener = std::move(listener); }
+
+    // Speed in revolutions per minute, converted to whole CPU cycles per sector.
+    // Changing it while running keeps the current sector boundary as new origin.
+    void setRPM(double rpm);
+    double getRPM() const;
+    uint64_t getSectorCycles() const { return m_sectorCycles; }
+
+    // Start with originSector beginning at originCycle (may be in the past),
+    // the listener is called at once with the signals of the current cycle
+    void start(uint64_t originCycle, uint8_t originSector = 0u);
+    void stop();
+    bool isRunning() const { return m_running; }
+
+    Signals getSignals() const { return getSignalsAt(m_scheduler.getCurrentCycle()); }
+    Signals getSignalsAt(uint64_t cycle) const;
+
+    // Restoring a state restarts the edge events from the scheduler's current cycle
+    void saveState(State& state) const;
+    void loadState(const State& state);
+
+    PrinterDrum(const PrinterDrum&) = delete;
+    PrinterDrum& operator=(const PrinterDrum&) = delete;
+
+private:
+    void scheduleEdges();
+    void cancelEdges();
+    void notify(uint64_t cycle);
+
+    EventScheduler& m_scheduler;
+    uint64_t m_cyclesPerSecond;
+    uint64_t m_sectorCycles;
+    uint64_t m_originCycle;
+    uint8_t m_originSector;
+    bool m_running;
+    EventScheduler::EventId m_inactiveEdge;
+    EventScheduler::EventId m_activeEdge;
+    Listener m_listener;
+};
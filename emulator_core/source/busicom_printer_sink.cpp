@@ -0,0 +1,94 @@
+#include "emulator_core/source/busicom_printer_sink.hpp"
+
+#include <algorithm>
+#include <cstring>
+
+size_t formatPrinterLine(const PrinterLine& line, char* buffer, size_t size)
+{
+    if (size == 0u)
+        return 0u;
+
+    size_t length = 0u;
+    auto append = [&](std::string_view part) {
+        size_t count = std::min(part.size(), size - 1u - length);
+        std::memcpy(buffer + length, part.data(), count);
+        length += count;
+    };
+
+    if (line.red)
+        append("-");
+    append(line.getDigits());
+    if (line.symbolsLength > 0u) {
+        if (line.digitCount > 0u || line.red)
+            append(" ");
+        append(line.getSymbols());
+    }
+
+    buffer[length] = '\0';
+    return length;
+}
+
+PrinterRingSink::PrinterRingSink(size_t capacity) :
+    m_lines(std::max<size_t>(capacity, 1u)),
+    m_head(0u),
+    m_size(0u),
+    m_totalLines(0u)
+{
+}
+
+void PrinterRingSink::onLine(const PrinterLine& line)
+{
+    // Overwrite the oldest line once full
+    size_t tail = (m_head + m_size) % m_lines.size();
+    m_lines[tail] = line;
+    if (m_size < m_lines.size())
+        ++m_size;
+    else
+        m_head = (m_head + 1u) % m_lines.size();
+    ++m_totalLines;
+}
+
+void PrinterRingSink::clear()
+{
+    m_head = 0u;
+    m_size = 0u;
+    m_totalLines = 0u;
+}
+
+PrinterFileSink::PrinterFileSink(const std::string& filename, size_t bufferSize) :
+    m_file(std::fopen(filename.c_str(), "w")),
+    m_buffer(std::max(bufferSize, PrinterLine::MAX_TEXT + 1u)),
+    m_used(0u)
+{
+}
+
+PrinterFileSink::~PrinterFileSink()
+{
+    flush();
+    if (m_file != nullptr)
+        std::fclose(m_file);
+}
+
+void PrinterFileSink::onLine(const PrinterLine& line)
+{
+    if (m_file == nullptr)
+        return;
+
+    // One formatted line plus newline always fits an emptied buffer
+    if (m_buffer.size() - m_used < PrinterLine::MAX_TEXT + 1u)
+        flush();
+
+    m_used += formatPrinterLine(line, m_buffer.data() + m_used, m_buffer.size() - m_used);
+    m_buffer[m_used++] = '\n';
+}
+
+void PrinterFileSink::flush()
+{
+    if (m_file == nullptr)
+        return;
+
+    if (m_used > 0u)
+        std::fwrite(m_buffer.data(), 1u, m_used, m_file);
+    std::fflush(m_file);
+    m_used = 0u;
+}
@@ -0,0 +1,110 @@
+#pragma once
+#include <cstddef>
+#include <cstdint>
+#include <cstdio>
+#include <functional>
+#include <string>
+#include <string_view>
+#include <vector>
+
+// Busicom printer output
+//
+// Every completed line is decoded once into a fixed-size PrinterLine and
+// handed to the registered PrinterSink objects. Lines never allocate, sinks
+// decide what to keep: the last N lines in memory, a buffered file, or a
+// callback forwarding them elsewhere.
+
+struct PrinterLine {
+    static constexpr size_t MAX_TEXT = 32u;      // 15 digit columns, gap, column 17 and 18
+    static constexpr size_t MAX_DIGITS = 16u;
+    static constexpr size_t MAX_SYMBOLS = 12u;
+
+    char text[MAX_TEXT];          // Line as printed, right-trimmed, NUL terminated
+    char digits[MAX_DIGITS];      // Columns 1-15 without blanks, NUL terminated
+    char symbols[MAX_SYMBOLS];    // Column 17 and 18 separated by a space, NUL terminated
+    uint8_t textLength;
+    uint8_t digitCount;
+    uint8_t symbolsLength;
+    bool hasDecimalPoint;
+    uint8_t decimalPosition;      // Digits after the decimal point
+    bool red;                     // Printed with the red half of the ribbon (negative)
+
+    std::string_view getText() const { return { text, textLength }; }
+    std::string_view getDigits() const { return { digits, digitCount }; }
+    std::string_view getSymbols() const { return { symbols, symbolsLength }; }
+};
+
+// Compact form "[-]digits[ symbols]" with '-' for red lines, returns the length
+// written (truncated to size - 1, always NUL terminated when size > 0)
+size_t formatPrinterLine(const PrinterLine& line, char* buffer, size_t size);
+
+class PrinterSink
+{
+public:
+    virtual ~PrinterSink() = default;
+
+    virtual void onLine(const PrinterLine& line) = 0;
+    virtual void flush() {}
+};
+
+// Keeps the most recent lines in a preallocated ring, oldest first
+class PrinterRingSink : public PrinterSink
+{
+public:
+    explicit PrinterRingSink(size_t capacity);
+
+    void onLine(const PrinterLine& line) override;
+
+    size_t size() const { return m_size; }
+    bool empty() const { return m_size == 0u; }
+    size_t capacity() const { return m_lines.size(); }
+    const PrinterLine& operator[](size_t index) const { return m_lines[(m_head + index) % m_lines.size()]; }
+    const PrinterLine& back() const { return (*this)[m_size - 1u]; }
+    void clear();
+
+    uint64_t getTotalLines() const { return m_totalLines; }
+    uint64_t getDroppedLines() const { return m_totalLines - m_size; }
+
+private:
+    std::vector<PrinterLine> m_lines;
+    size_t m_head;
+    size_t m_size;
+    uint64_t m_totalLines;
+};
+
+// Appends formatted lines to a file through a fixed buffer, written when full,
+// on flush() and on destruction
+class PrinterFileSink : public PrinterSink
+{
+public:
+    static constexpr size_t DEFAULT_BUFFER_SIZE = 64u * 1024u;
+
+    explicit PrinterFileSink(const std::string& filename, size_t bufferSize = DEFAULT_BUFFER_SIZE);
+    ~PrinterFileSink() override;
+
+    bool isOpen() const { return m_file != nullptr; }
+    void onLine(const PrinterLine& line) override;
+    void flush() override;
+
+    PrinterFileSink(const PrinterFileSink&) = delete;
+    PrinterFileSink& operator=(const PrinterFileSink&) = delete;
+
+private:
+    std::FILE* m_file;
+    std::vector<char> m_buffer;
+    size_t m_used;
+};
+
+// Forwards every line to a function
+class PrinterCallbackSink : public PrinterSink
+{
+public:
+    using Callback = std::function<void(const PrinterLine& line)>;
+
+    explicit PrinterCallbackSink(Callback callback) : m_callback(std::move(callback)) {}
+
+    void onLine(const PrinterLine& line) override { if (m_callback) m_callback(line); }
+
+private:
+    Callback m_callback;
+};
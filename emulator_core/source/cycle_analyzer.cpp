@@ -0,0 +1,582 @@
+#include "emulator_core/source/cycle_analyzer.hpp"
+
+#include "shared/source/assembly.hpp"
+
+#include <algorithm>
+#include <fstream>
+#include <functional>
+#include <queue>
+#include <sstream>
+
+namespace {
+
+constexpr size_t NO_NODE = ~size_t(0u);
+constexpr size_t ROM_SIZE = 4096u;
+constexpr uint8_t NOT_DONE = 0u, IN_PROGRESS = 1u, DONE = 2u;
+
+uint64_t add(uint64_t a, uint64_t b)
+{
+    return a >= CycleAnalyzer::UNBOUNDED - b ? CycleAnalyzer::UNBOUNDED : a + b;
+}
+
+uint64_t multiply(uint64_t a, uint64_t b)
+{
+    return b != 0u && a >= CycleAnalyzer::UNBOUNDED / b ? CycleAnalyzer::UNBOUNDED : a * b;
+}
+
+std::string hex(uint16_t address)
+{
+    static const char digits[] = "0123456789ABCDEF";
+    return { '$', digits[(address >> 8) & 0x0Fu], digits[(address >> 4) & 0x0Fu], digits[address & 0x0Fu] };
+}
+
+bool parseAddress(const std::string& text, uint16_t& value)
+{
+    size_t start = 0u;
+    int base = 10;
+    if (text.rfind("$", 0u) == 0u)
+        start = 1u, base = 16;
+    else if (text.rfind("0x", 0u) == 0u || text.rfind("0X", 0u) == 0u)
+        start = 2u, base = 16;
+    if (start == text.size())
+        return false;
+
+    size_t end = 0u;
+    unsigned long number;
+    try {
+        number = std::stoul(text.substr(start), &end, base);
+    }
+    catch (...) {
+        return false;
+    }
+    if (start + end != text.size() || number >= ROM_SIZE)
+        return false;
+    value = static_cast<uint16_t>(number);
+    return true;
+}
+
+} // namespace
+
+bool CycleAnalyzer::loadLoopBounds(const char* filename, std::string& error)
+{
+    std::ifstream file(filename);
+    if (!file) {
+        error = std::string("cannot open ") + filename;
+        return false;
+    }
+
+    std::string line;
+    for (size_t number = 1u; std::getline(file, line); ++number) {
+        std::istringstream fields(line);
+        std::string address, iterations, rest;
+        if (!(fields >> address) || address[0] == ';')
+            continue;
+
+        uint16_t header;
+        unsigned long bound = 0u;
+        bool ok = parseAddress(address, header) && (fields >> iterations) && !(fields >> rest);
+        if (ok) {
+            try {
+                size_t end = 0u;
+                bound = std::stoul(iterations, &end);
+                ok = end == iterations.size() && bound > 0u && bound <= 0xFFFFFFFFu;
+            }
+            catch (...) {
+                ok = false;
+            }
+        }
+        if (!ok) {
+            error = "line " + std::to_string(number) + ": expected address and iterations";
+            return false;
+        }
+        setLoopBound(header, static_cast<uint32_t>(bound));
+    }
+    return true;
+}
+
+void CycleAnalyzer::clear()
+{
+    m_entries.clear();
+    m_loopBounds.clear();
+    m_routines.clear();
+    m_graphs.clear();
+    m_routineAt.clear();
+    m_state.clear();
+}
+
+const CycleAnalyzer::Routine* CycleAnalyzer::findRoutine(uint16_t entry) const
+{
+    auto routine = std::lower_bound(m_routines.begin(), m_routines.end(), entry,
+                                    [](const Routine& r, uint16_t address) { return r.entry < address; });
+    return routine != m_routines.end() && routine->entry == entry ? &*routine : nullptr;
+}
+
+void CycleAnalyzer::analyze(const uint8_t* image, size_t size)
+{
+    m_routines.clear();
+    m_graphs.clear();
+    m_routineAt.clear();
+
+    // Every routine reachable by JMS from the entries, in entry address order
+    std::vector<uint16_t> pending = m_entries.empty() ? std::vector<uint16_t>{ 0u } : m_entries;
+    std::vector<uint16_t> entries;
+    std::vector<Graph> graphs;
+    std::vector<bool> found(ROM_SIZE, false);
+    while (!pending.empty()) {
+        uint16_t entry = pending.back() & 0x0FFFu;
+        pending.pop_back();
+        if (found[entry])
+            continue;
+        found[entry] = true;
+
+        entries.push_back(entry);
+        graphs.push_back(buildGraph(image, size, entry));
+        for (const Node& node : graphs.back().nodes)
+            if (node.callee != NO_CALLEE)
+                pending.push_back(node.callee);
+    }
+
+    std::vector<size_t> order(entries.size());
+    for (size_t i = 0u; i < order.size(); ++i)
+        order[i] = i;
+    std::sort(order.begin(), order.end(), [&](size_t a, size_t b) { return entries[a] < entries[b]; });
+    for (size_t index : order) {
+        m_routineAt[entries[index]] = m_routines.size();
+        m_routines.push_back({ entries[index], UNBOUNDED, UNBOUNDED, {}, {}, {} });
+        m_graphs.push_back(std::move(graphs[index]));
+    }
+
+    m_state.assign(m_routines.size(), NOT_DONE);
+    for (size_t routine = 0u; routine < m_routines.size(); ++routine)
+        analyzeRoutine(routine);
+    m_graphs.clear();
+    m_state.clear();
+}
+
+CycleAnalyzer::Graph CycleAnalyzer::buildGraph(const uint8_t* image, size_t size, uint16_t entry) const
+{
+    Graph graph;
+    std::vector<size_t> nodeAt(ROM_SIZE, NO_NODE);
+    auto nodeFor = [&](uint16_t address) {
+        address &= 0x0FFFu;
+        if (nodeAt[address] == NO_NODE) {
+            nodeAt[address] = graph.nodes.size();
+            graph.nodes.push_back({ address, 0u, 0u, false, false, false, 0u, NO_CALLEE, {} });
+        }
+        return nodeAt[address];
+    };
+    auto lost = [&](size_t index, const std::string& problem) {
+        graph.nodes[index].unknown = true;
+        if (graph.problem.empty())
+            graph.problem = problem;
+    };
+
+    nodeFor(entry);
+    for (size_t index = 0u; index < graph.nodes.size(); ++index) {
+        uint16_t address = graph.nodes[index].address;
+        if (address >= size) {
+            lost(index, "runs past the end of the image at " + hex(address));
+            continue;
+        }
+
+        uint8_t byte = image[address];
+        const AsmInsDesc* desc = findAsmInstruction(getOpcodeFromByte(byte));
+        bool twoByte = desc != nullptr && desc->type == AsmInsType::TwoByte;
+        if (desc == nullptr || (twoByte && address + 1u >= size)) {
+            lost(index, "no instruction at " + hex(address));
+            continue;
+        }
+
+        uint8_t operand = twoByte ? image[address + 1u] : 0u;
+        uint16_t next = static_cast<uint16_t>((address + (twoByte ? 2u : 1u)) & 0x0FFFu);
+        uint16_t far = static_cast<uint16_t>(((byte & 0x0Fu) << 8) | operand);
+        uint16_t near = static_cast<uint16_t>((next & 0x0F00u) | operand);
+        uint8_t reg = byte & 0x0Fu;
+        std::vector<uint16_t> targets;
+        graph.nodes[index].byte = byte;
+        graph.nodes[index].cycles = desc->cycles;
+
+        switch (desc->byte) {
+        case +AsmIns::BBL:
+        case +AsmIns::BBS:
+            graph.nodes[index].exit = true;
+            break;
+        case +AsmIns::HLT:
+            // Goes on after the interrupt that wakes it, which may never come
+            if (graph.problem.empty())
+                graph.problem = "halt at " + hex(address) + " waits without a bound";
+            targets = { next };
+            break;
+        case +AsmIns::JIN:
+            lost(index, "indirect jump at " + hex(address));
+            break;
+        case +AsmIns::JUN:
+            targets = { far };
+            break;
+        case +AsmIns::JMS:
+            graph.nodes[index].callee = far;
+            graph.nodes[index].opaque = true;
+            targets = { next };
+            break;
+        case +AsmIns::JCN:
+            targets = { next, near };
+            break;
+        case +AsmIns::ISZ:
+            graph.nodes[index].writes = static_cast<uint16_t>(1u << reg);
+            targets = { next, near };
+            break;
+        case +AsmIns::INC:
+        case +AsmIns::XCH:
+            graph.nodes[index].writes = static_cast<uint16_t>(1u << reg);
+            targets = { next };
+            break;
+        case +AsmIns::FIM:
+        case +AsmIns::FIN:
+            graph.nodes[index].writes = static_cast<uint16_t>(3u << (reg & 0x0Eu));
+            targets = { next };
+            break;
+        case +AsmIns::SB0:
+        case +AsmIns::SB1:
+            graph.nodes[index].opaque = true;
+            targets = { next };
+            break;
+        default:
+            targets = { next };
+            break;
+        }
+
+        for (uint16_t target : targets) {
+            size_t successor = nodeFor(target);
+            std::vector<size_t>& successors = graph.nodes[index].successors;
+            if (std::find(successors.begin(), successors.end(), successor) == successors.end())
+                successors.push_back(successor);
+        }
+    }
+    return graph;
+}
+
+void CycleAnalyzer::analyzeRoutine(size_t index)
+{
+    if (m_state[index] != NOT_DONE)
+        return;
+    m_state[index] = IN_PROGRESS;
+
+    const Graph& graph = m_graphs[index];
+    std::vector<uint64_t> best(graph.nodes.size()), worst(graph.nodes.size());
+    std::string problem = graph.problem;
+    std::vector<uint16_t> callees;
+    for (size_t i = 0u; i < graph.nodes.size(); ++i) {
+        const Node& node = graph.nodes[i];
+        best[i] = worst[i] = node.cycles;
+        if (node.callee == NO_CALLEE)
+            continue;
+
+        size_t callee = m_routineAt.at(node.callee);
+        analyzeRoutine(callee);
+        callees.push_back(node.callee);
+        if (m_state[callee] == IN_PROGRESS) {
+            // Recursion, the callee takes at least no time
+            worst[i] = UNBOUNDED;
+            if (problem.empty())
+                problem = "recursive call to " + hex(node.callee) + " at " + hex(node.address);
+            continue;
+        }
+
+        const Routine& routine = m_routines[callee];
+        best[i] = add(best[i], routine.best);
+        worst[i] = add(worst[i], routine.worst);
+        if (routine.best != UNBOUNDED && routine.worst == UNBOUNDED && problem.empty())
+            problem = "call to " + hex(node.callee) + " without a bound at " + hex(node.address);
+    }
+
+    Routine& routine = m_routines[index];
+    std::sort(callees.begin(), callees.end());
+    callees.erase(std::unique(callees.begin(), callees.end()), callees.end());
+    routine.callees = std::move(callees);
+    findBestCase(graph, routine, best);
+    if (routine.best == UNBOUNDED && problem.empty())
+        problem = "never returns";
+    if (problem.empty())
+        findWorstCase(graph, routine, worst);
+    else
+        routine.problem = problem;
+    m_state[index] = DONE;
+}
+
+void CycleAnalyzer::findBestCase(const Graph& graph, Routine& routine, const std::vector<uint64_t>& best) const
+{
+    // Shortest paths, a node's distance includes its own cycles. A JMS to a
+    // routine that never returns ends its paths.
+    std::vector<uint64_t> distance(graph.nodes.size(), UNBOUNDED);
+    using Entry = std::pair<uint64_t, size_t>;
+    std::priority_queue<Entry, std::vector<Entry>, std::greater<Entry>> queue;
+    distance[0] = best[0];
+    queue.push({ best[0], 0u });
+    while (!queue.empty()) {
+        auto [cost, index] = queue.top();
+        queue.pop();
+        if (cost != distance[index] || cost == UNBOUNDED)
+            continue;
+        for (size_t successor : graph.nodes[index].successors) {
+            uint64_t next = add(cost, best[successor]);
+            if (next < distance[successor]) {
+                distance[successor] = next;
+                queue.push({ next, successor });
+            }
+        }
+    }
+
+    // Where paths are lost they could still return right away
+    routine.best = UNBOUNDED;
+    for (size_t i = 0u; i < graph.nodes.size(); ++i) {
+        const Node& node = graph.nodes[i];
+        if (node.exit && distance[i] != UNBOUNDED)
+            routine.exits.push_back({ node.address, distance[i], UNBOUNDED });
+        if (node.exit || node.unknown)
+            routine.best = std::min(routine.best, distance[i]);
+    }
+    std::sort(routine.exits.begin(), routine.exits.end(), [](const Exit& a, const Exit& b) { return a.address < b.address; });
+}
+
+bool CycleAnalyzer::findWorstCase(const Graph& graph, Routine& routine, const std::vector<uint64_t>& worst) const
+{
+    const std::vector<Node>& nodes = graph.nodes;
+    size_t count = nodes.size();
+    auto fail = [&](const std::string& problem) {
+        routine.problem = problem;
+        routine.worst = UNBOUNDED;
+        return false;
+    };
+
+    // A JMS to a routine that never returns ends its paths
+    std::vector<std::vector<size_t>> successors(count), predecessors(count);
+    for (size_t i = 0u; i < count; ++i) {
+        if (worst[i] == UNBOUNDED)
+            continue;
+        successors[i] = nodes[i].successors;
+        for (size_t successor : successors[i])
+            predecessors[successor].push_back(i);
+    }
+
+    // Reverse postorder and dominators (Cooper, Harvey and Kennedy)
+    std::vector<size_t> postorder, orderOf(count, NO_NODE);
+    std::vector<std::pair<size_t, size_t>> stack{ { 0u, 0u } };
+    std::vector<bool> visited(count, false);
+    visited[0] = true;
+    while (!stack.empty()) {
+        auto& [node, edge] = stack.back();
+        if (edge < successors[node].size()) {
+            size_t successor = successors[node][edge++];
+            if (!visited[successor]) {
+                visited[successor] = true;
+                stack.push_back({ successor, 0u });
+            }
+            continue;
+        }
+        orderOf[node] = postorder.size();
+        postorder.push_back(node);
+        stack.pop_back();
+    }
+
+    std::vector<size_t> idom(count, NO_NODE);
+    idom[0] = 0u;
+    for (bool changed = true; changed;) {
+        changed = false;
+        for (auto it = postorder.rbegin(); it != postorder.rend(); ++it) {
+            size_t node = *it, dominator = NO_NODE;
+            if (node == 0u)
+                continue;
+            for (size_t predecessor : predecessors[node]) {
+                if (idom[predecessor] == NO_NODE)
+                    continue;
+                if (dominator == NO_NODE) {
+                    dominator = predecessor;
+                    continue;
+                }
+                size_t a = predecessor, b = dominator;
+                while (a != b) {
+                    while (orderOf[a] < orderOf[b])
+                        a = idom[a];
+                    while (orderOf[b] < orderOf[a])
+                        b = idom[b];
+                }
+                dominator = a;
+            }
+            if (dominator != idom[node]) {
+                idom[node] = dominator;
+                changed = true;
+            }
+        }
+    }
+    auto dominates = [&](size_t a, size_t b) {
+        for (; b != 0u; b = idom[b])
+            if (a == b)
+                return true;
+        return a == 0u;
+    };
+
+    // Loops are the back edges to a header dominating their source. Without
+    // them what is left must be acyclic, else a loop has two entries.
+    std::vector<std::vector<size_t>> latches(count);
+    std::vector<size_t> indegree(count, 0u);
+    for (size_t node : postorder) {
+        for (size_t successor : successors[node]) {
+            if (dominates(successor, node))
+                latches[successor].push_back(node);
+            else
+                ++indegree[successor];
+        }
+    }
+    std::vector<size_t> ready{ 0u };
+    size_t ordered = 0u;
+    while (!ready.empty()) {
+        size_t node = ready.back();
+        ready.pop_back();
+        ++ordered;
+        for (size_t successor : successors[node])
+            if (!dominates(successor, node) && --indegree[successor] == 0u)
+                ready.push_back(successor);
+    }
+    if (ordered != postorder.size())
+        return fail("loop entered at more than one place");
+
+    // Bodies and bounds of the loops
+    struct Loop {
+        size_t header;
+        std::vector<bool> body;
+        size_t size;
+        uint64_t bound;
+    };
+    std::vector<Loop> loops;
+    for (size_t header = 0u; header < count; ++header) {
+        if (latches[header].empty())
+            continue;
+
+        Loop loop{ header, std::vector<bool>(count, false), 1u, 0u };
+        loop.body[header] = true;
+        std::vector<size_t> pending = latches[header];
+        while (!pending.empty()) {
+            size_t node = pending.back();
+            pending.pop_back();
+            if (loop.body[node])
+                continue;
+            loop.body[node] = true;
+            ++loop.size;
+            for (size_t predecessor : predecessors[node])
+                pending.push_back(predecessor);
+        }
+
+        auto bound = m_loopBounds.find(nodes[header].address);
+        if (bound != m_loopBounds.end()) {
+            loop.bound = bound->second;
+        }
+        else if (latches[header].size() == 1u && getOpcodeFromByte(nodes[latches[header][0]].byte) == +AsmIns::ISZ) {
+            // Counts its register up to 0 unless something else changes it
+            size_t latch = latches[header][0];
+            uint16_t counter = static_cast<uint16_t>(1u << (nodes[latch].byte & 0x0Fu));
+            bool untouched = true;
+            for (size_t node = 0u; node < count; ++node)
+                if (loop.body[node] && node != latch && (nodes[node].opaque || (nodes[node].writes & counter) != 0u))
+                    untouched = false;
+            if (untouched)
+                loop.bound = ISZ_LOOP_BOUND;
+        }
+        if (loop.bound == 0u)
+            return fail("loop at " + hex(nodes[header].address) + " without a bound");
+        loops.push_back(std::move(loop));
+    }
+    std::sort(loops.begin(), loops.end(), [](const Loop& a, const Loop& b) { return a.size < b.size; });
+
+    // Longest paths through the acyclic graph left from start, inner loops
+    // taken as one step to each of their exits. Costs are those of every
+    // node run before arriving.
+    std::vector<std::vector<std::pair<size_t, uint64_t>>> summaries(count), summaryReturns(count);
+    std::vector<bool> summarized(count, false);
+    auto forEachEdge = [&](size_t node, const auto& visit) {
+        if (summarized[node]) {
+            for (const auto& [target, cost] : summaries[node])
+                visit(target, cost);
+        }
+        else {
+            for (size_t successor : successors[node])
+                visit(successor, worst[node]);
+        }
+    };
+
+    struct Paths {
+        uint64_t iteration = 0u;                          // Back to the header
+        std::vector<std::pair<size_t, uint64_t>> exits;   // Out of the region
+        std::vector<uint64_t> returns;                    // Per node, after an exit node ran
+    };
+    auto longest = [&](size_t start, const std::vector<bool>* region, size_t header) {
+        auto inRegion = [&](size_t node) { return region == nullptr || (*region)[node]; };
+        std::vector<size_t> reachable{ start }, incoming(count, 0u);
+        std::vector<bool> seen(count, false);
+        seen[start] = true;
+        for (size_t i = 0u; i < reachable.size(); ++i) {
+            forEachEdge(reachable[i], [&](size_t target, uint64_t) {
+                if (target == header || !inRegion(target))
+                    return;
+                ++incoming[target];
+                if (!seen[target]) {
+                    seen[target] = true;
+                    reachable.push_back(target);
+                }
+            });
+        }
+
+        Paths paths;
+        paths.returns.assign(count, 0u);
+        std::vector<uint64_t> arrival(count, 0u);
+        std::vector<size_t> ready{ start };
+        while (!ready.empty()) {
+            size_t node = ready.back();
+            ready.pop_back();
+            if (nodes[node].exit)
+                paths.returns[node] = std::max(paths.returns[node], add(arrival[node], worst[node]));
+            if (summarized[node])
+                for (const auto& [exit, cost] : summaryReturns[node])
+                    paths.returns[exit] = std::max(paths.returns[exit], add(arrival[node], cost));
+            forEachEdge(node, [&](size_t target, uint64_t cost) {
+                uint64_t value = add(arrival[node], cost);
+                if (target == header) {
+                    paths.iteration = std::max(paths.iteration, value);
+                }
+                else if (!inRegion(target)) {
+                    auto exit = std::find_if(paths.exits.begin(), paths.exits.end(), [&](const auto& e) { return e.first == target; });
+                    if (exit == paths.exits.end())
+                        paths.exits.push_back({ target, value });
+                    else
+                        exit->second = std::max(exit->second, value);
+                }
+                else {
+                    arrival[target] = std::max(arrival[target], value);
+                    if (--incoming[target] == 0u)
+                        ready.push_back(target);
+                }
+            });
+        }
+        return paths;
+    };
+
+    // Innermost first: bound - 1 whole iterations, then the way out
+    for (const Loop& loop : loops) {
+        Paths paths = longest(loop.header, &loop.body, loop.header);
+        for (const auto& [target, cost] : paths.exits)
+            summaries[loop.header].push_back({ target, add(multiply(loop.bound - 1u, paths.iteration), cost) });
+        for (size_t node = 0u; node < count; ++node)
+            if (loop.body[node] && nodes[node].exit)
+                summaryReturns[loop.header].push_back({ node, add(multiply(loop.bound - 1u, paths.iteration), paths.returns[node]) });
+        summarized[loop.header] = true;
+    }
+
+    Paths paths = longest(0u, nullptr, NO_NODE);
+    routine.worst = 0u;
+    for (Exit& exit : routine.exits) {
+        for (size_t node = 0u; node < count; ++node)
+            if (nodes[node].address == exit.address)
+                exit.worst = paths.returns[node];
+        routine.worst = std::max(routine.worst, exit.worst);
+    }
+    return true;
+}
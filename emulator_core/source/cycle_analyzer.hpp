@@ -0,0 +1,92 @@
+#pragma once
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+// Best and worst case cycle counts of the routines of a ROM image, proven
+// from the code alone instead of sampled by running it.
+//
+// The entries given (address 0 when there are none) and every JMS target are
+// routines. A routine's control-flow graph follows JUN, JCN and ISZ (both
+// ways, JCN/ISZ within the page they jump in) until BBL, or BBS on the 4040,
+// returns. A JMS costs its own cycles plus the callee's, so callees are
+// analyzed first and recursion has no bound. Instruction cycles are the ones
+// K4004::clock counts, from the shared instruction table.
+//
+// Every loop needs a bound, the most times its header runs each time the loop
+// is entered, given by setLoopBound(). A loop closed by an ISZ on a register
+// nothing else in it writes (no JMS either) runs at most 16 times without one.
+// Worst cases run every loop to its bound along the longest path, best cases
+// are shortest paths and hold whatever the bounds are. A JIN, an address
+// without an instruction or code running past the image leaves the worst case
+// unproven. So does a 4040 HLT, which goes on with the next instruction once
+// an interrupt wakes it; the best case counts no wait.
+class CycleAnalyzer
+{
+public:
+    static constexpr uint64_t UNBOUNDED = ~uint64_t(0u);
+    static constexpr uint32_t ISZ_LOOP_BOUND = 16u;
+
+    // Cycles from the routine entry until this return has run
+    struct Exit {
+        uint16_t address;
+        uint64_t best;
+        uint64_t worst;
+    };
+
+    struct Routine {
+        uint16_t entry;
+        uint64_t best;                 // UNBOUNDED when it never returns
+        uint64_t worst;                // UNBOUNDED unless proven
+        std::vector<Exit> exits;       // In address order
+        std::vector<uint16_t> callees; // In address order
+        std::string problem;           // Why worst is UNBOUNDED, empty when it is not
+    };
+
+    void addEntry(uint16_t address) { m_entries.push_back(address); }
+    void setLoopBound(uint16_t header, uint32_t iterations) { m_loopBounds[header] = iterations; }
+    // "address iterations" per line, the address as $hex, 0xhex or decimal.
+    // Lines starting with ';' are comments. Errors are "line N: message".
+    bool loadLoopBounds(const char* filename, std::string& error);
+    void clear();
+
+    // image holds the program from address 0, without the metal mask header
+    void analyze(const uint8_t* image, size_t size);
+
+    // Of the last analyze(), in entry address order
+    const std::vector<Routine>& getRoutines() const { return m_routines; }
+    const Routine* findRoutine(uint16_t entry) const;
+private:
+    struct Node {
+        uint16_t address;
+        uint8_t byte;
+        uint8_t cycles;
+        bool exit;          // BBL or BBS
+        bool unknown;       // JIN, no instruction or past the image, where paths are lost
+        bool opaque;        // JMS or register bank switch, may write any register
+        uint16_t writes;    // Registers written, one bit each
+        uint16_t callee;    // JMS target, NO_CALLEE otherwise
+        std::vector<size_t> successors;
+    };
+
+    struct Graph {
+        std::vector<Node> nodes;  // The entry first
+        std::string problem;
+    };
+
+    static constexpr uint16_t NO_CALLEE = 0xFFFFu;
+
+    Graph buildGraph(const uint8_t* image, size_t size, uint16_t entry) const;
+    void analyzeRoutine(size_t routine);
+    void findBestCase(const Graph& graph, Routine& routine, const std::vector<uint64_t>& best) const;
+    bool findWorstCase(const Graph& graph, Routine& routine, const std::vector<uint64_t>& worst) const;
+
+    std::vector<uint16_t> m_entries;
+    std::unordered_map<uint16_t, uint32_t> m_loopBounds;
+    std::vector<Routine> m_routines;
+    std::vector<Graph> m_graphs;                        // Per routine
+    std::unordered_map<uint16_t, size_t> m_routineAt;   // By entry
+    std::vector<uint8_t> m_state;                       // Per routine: not done, in progress, done
+};
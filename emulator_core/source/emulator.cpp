@@ -11,11 +11,24 @@ Emulator::Emulator() :
 bool Emulator::loadProgramFromSource(const char* filename)
 {
     Assembler assembler;
-    std::vector<uint8_t> bytecode;
-    bool ret = assembler.assemble(filename, bytecode);
+    bool ret = assembler.assemble(filename, m_bytecode);
+    m_assemblerError = assembler.getError();
+
+    if (ret) {
+        ret = m_rom.load(m_bytecode.data(), m_bytecode.size());
+    }
+
+    return ret;
+}
+
+bool Emulator::loadProgramFromSourceText(std::string_view source)
+{
+    Assembler assembler;
+    bool ret = assembler.assemble(source, m_bytecode);
+    m_assemblerError = assembler.getError();
 
     if (ret) {
-        ret = m_rom.load(bytecode.data(), bytecode.size());
+        ret = m_rom.load(m_bytecode.data(), m_bytecode.size());
     }
 
     return ret;
@@ -1,5 +1,8 @@
 #pragma once
 #include <cstddef>
+#include <string>
+#include <string_view>
+#include <vector>
 #include "emulator_core/source/K4004.hpp"
 #include "emulator_core/source/ram.hpp"
 #include "emulator_core/source/rom.hpp"
@@ -10,6 +13,8 @@ public:
     Emulator();
     // TODO: add load from binary
     bool loadProgramFromSource(const char* filename);
+    // Assembles and loads source held in memory, no files are touched
+    bool loadProgramFromSourceText(std::string_view source);
     bool loadProgramFromObjectCode(const char* filename);
     bool loadProgramFromMemory(const uint8_t* bytecode, size_t codeSize);
     void step(size_t times = 1u);
@@ -18,8 +23,12 @@ public:
     const RAM& getRAM() const { return m_ram; }
     const ROM& getROM() const { return m_rom; }
     const K4004& getCPU() const { return m_cpu; }
+    // Why the last loadProgramFromSource(Text) failed to assemble, empty if it did not
+    const std::string& getAssemblerError() const { return m_assemblerError; }
 private:
     RAM m_ram;
     ROM m_rom;
     K4004 m_cpu;
+    std::vector<uint8_t> m_bytecode;  // Reused between loads from source
+    std::string m_assemblerError;
 };
@@ -0,0 +1,95 @@
+#include "emulator_core/source/event_scheduler.hpp"
+
+#include <utility>
+
+EventScheduler::EventScheduler()
+{
+    reset();
+}
+
+void EventScheduler::reset()
+{
+    m_queue = {};
+    m_callbacks.clear();
+    m_currentCycle = 0u;
+    m_nextSequence = 0u;
+    m_nextId = INVALID_EVENT + 1u;
+}
+
+EventScheduler::EventId EventScheduler::schedule(uint64_t cycle, Callback callback)
+{
+    if (!callback)
+        return INVALID_EVENT;
+
+    EventId id = m_nextId++;
+    m_callbacks.emplace(id, Pending{ std::move(callback), 0u });
+    push(cycle, id);
+    return id;
+}
+
+EventScheduler::EventId EventScheduler::schedulePeriodic(uint64_t firstCycle, uint64_t period, Callback callback)
+{
+    // A zero period would fire forever within a single advance
+    if (!callback || period == 0u)
+        return INVALID_EVENT;
+
+    EventId id = m_nextId++;
+    m_callbacks.emplace(id, Pending{ std::move(callback), period });
+    push(firstCycle, id);
+    return id;
+}
+
+bool EventScheduler::cancel(EventId id)
+{
+    return m_callbacks.erase(id) != 0u;
+}
+
+void EventScheduler::advanceTo(uint64_t cycle)
+{
+    while (true) {
+        dropCancelled();
+        if (m_queue.empty() || m_queue.top().cycle > cycle)
+            break;
+
+        Entry entry = m_queue.top();
+        m_queue.pop();
+
+        auto it = m_callbacks.find(entry.id);
+        uint64_t period = it->second.period;
+
+        // Time never runs backwards for callbacks scheduling relative events
+        if (entry.cycle > m_currentCycle)
+            m_currentCycle = entry.cycle;
+
+        if (period != 0u) {
+            // Re-arm before firing so the callback can cancel its own event
+            push(entry.cycle + period, entry.id);
+            Callback callback = it->second.callback;
+            callback(entry.cycle);
+        } else {
+            Callback callback = std::move(it->second.callback);
+            m_callbacks.erase(it);
+            callback(entry.cycle);
+        }
+    }
+
+    if (cycle > m_currentCycle)
+        m_currentCycle = cycle;
+}
+
+uint64_t EventScheduler::getNextEventCycle() const
+{
+    dropCancelled();
+    return m_queue.empty() ? NO_EVENT : m_queue.top().cycle;
+}
+
+void EventScheduler::push(uint64_t cycle, EventId id)
+{
+    m_queue.push(Entry{ cycle, m_nextSequence++, id });
+}
+
+void EventScheduler::dropCancelled() const
+{
+    while (!m_queue.empty() && m_callbacks.find(m_queue.top().id) == m_callbacks.end())
+        m_queue.pop();
+}
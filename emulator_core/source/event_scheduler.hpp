@@ -0,0 +1,83 @@
+#pragma once
+#include <cstdint>
+#include <functional>
+#include <queue>
+#include <unordered_map>
+#include <vector>
+
+// Cycle timeline event scheduler
+//
+// Peripherals (timers, serial receivers, keyboard scanners, printer drum)
+// post callbacks at an absolute CPU instruction cycle instead of being polled
+// after every instruction. The CPU advances the scheduler once per executed
+// instruction; events due at or before the new cycle count fire in cycle
+// order, events posted for the same cycle fire in posting order.
+//
+// Callbacks receive the cycle they were scheduled for and may schedule or
+// cancel other events (including rescheduling themselves).
+
+class EventScheduler
+{
+public:
+    using EventId = uint64_t;
+    using Callback = std::function<void(uint64_t cycle)>;
+
+    static constexpr EventId INVALID_EVENT = 0u;
+    static constexpr uint64_t NO_EVENT = UINT64_MAX;
+
+    EventScheduler();
+
+    void reset();
+
+    // Schedule a one-shot event at an absolute cycle (past cycles fire on the next advance)
+    EventId schedule(uint64_t cycle, Callback callback);
+
+    // Schedule a one-shot event relative to the current cycle
+    EventId scheduleIn(uint64_t delay, Callback callback) { return schedule(m_currentCycle + delay, std::move(callback)); }
+
+    // Schedule an event firing at firstCycle and then every period cycles until cancelled
+    EventId schedulePeriodic(uint64_t firstCycle, uint64_t period, Callback callback);
+
+    // Remove a pending event, returns false if it already fired or does not exist
+    bool cancel(EventId id);
+
+    // Fire every event due at or before cycle, then make cycle the current cycle
+    void advanceTo(uint64_t cycle);
+
+    bool hasPendingEvents() const { return !m_callbacks.empty(); }
+    size_t getPendingEventCount() const { return m_callbacks.size(); }
+    uint64_t getCurrentCycle() const { return m_currentCycle; }
+
+    // Cycle of the earliest pending event, NO_EVENT when the timeline is empty
+    uint64_t getNextEventCycle() const;
+
+    EventScheduler(const EventScheduler&) = delete;
+    EventScheduler& operator=(const EventScheduler&) = delete;
+
+private:
+    struct Entry {
+        uint64_t cycle;
+        uint64_t sequence;  // Tie breaker keeping same-cycle events in posting order
+        EventId id;
+
+        bool operator>(const Entry& other) const
+        {
+            return cycle != other.cycle ? cycle > other.cycle : sequence > other.sequence;
+        }
+    };
+
+    struct Pending {
+        Callback callback;
+        uint64_t period;  // 0 for one-shot events
+    };
+
+    void push(uint64_t cycle, EventId id);
+    void dropCancelled() const;
+
+    // Cancelled entries stay in the heap and are skipped lazily
+    mutable std::priority_queue<Entry, std::vector<Entry>, std::greater<Entry>> m_queue;
+    std::unordered_map<EventId, Pending> m_callbacks;
+    uint64_t m_currentCycle;
+    uint64_t m_nextSequence;
+    EventId m_nextId;
+};
@@ -0,0 +1,66 @@
+#include "emulator_core/source/hle_hooks.hpp"
+
+HLEHookTable::HLEHookTable() :
+    m_mode(Mode::Off),
+    m_nativeCalls(0u),
+    m_validatedCalls(0u),
+    m_mismatches(0u)
+{
+}
+
+void HLEHookTable::setHook(uint16_t address, Hook hook)
+{
+    address &= 0x0FFFu;
+    if (!hook) {
+        removeHook(address);
+        return;
+    }
+
+    m_hooks[address] = std::move(hook);
+    m_hooked.set(address);
+}
+
+void HLEHookTable::removeHook(uint16_t address)
+{
+    address &= 0x0FFFu;
+    m_hooks.erase(address);
+    m_hooked.reset(address);
+}
+
+void HLEHookTable::clear()
+{
+    m_hooks.clear();
+    m_hooked.reset();
+}
+
+const HLEHookTable::Hook* HLEHookTable::findHook(uint16_t address) const
+{
+    if (!hasHook(address))
+        return nullptr;
+
+    auto it = m_hooks.find(address & 0x0FFFu);
+    return it != m_hooks.end() ? &it->second : nullptr;
+}
+
+void HLEHookTable::returnFromRoutine(K4004::State& state, uint8_t value)
+{
+    value &= 0x0Fu;
+    state.IR = static_cast<uint8_t>(0xC0u | value);
+    state.ACC = static_cast<uint8_t>((state.ACC & 0x10u) | value);
+    state.stack[(state.SP + 1u) % K4004::STACK_SIZE] = 0u;
+    state.cycleCount += 1u;
+}
+
+void HLEHookTable::reportMismatch(const Mismatch& mismatch)
+{
+    ++m_mismatches;
+    if (m_mismatchListener)
+        m_mismatchListener(mismatch);
+}
+
+void HLEHookTable::resetCounters()
+{
+    m_nativeCalls = 0u;
+    m_validatedCalls = 0u;
+    m_mismatches = 0u;
+}
@@ -0,0 +1,88 @@
+#pragma once
+#include "emulator_core/source/K4004.hpp"
+
+#include <bitset>
+#include <cstdint>
+#include <functional>
+#include <string>
+#include <unordered_map>
+
+class RAM;
+class ROM;
+
+// High-level emulation of ROM subroutines
+//
+// A hook replaces the routine a JMS calls with native code. It receives the
+// CPU state right after the JMS was fetched (PC is the return address, the
+// cycle count does not include the JMS itself) and must leave registers,
+// ACC/CY, RAM and the SRC address exactly as the routine would after its
+// BBL, adding the routine's cycles including the BBL. The K4004 then
+// continues at the return address as if the call had been stepped.
+//
+// Hooks run between two scheduler advances, so routines that poll TEST or
+// touch I/O ports should not be replaced.
+//
+// In Validate mode every hooked call runs the native code on a copy of the
+// CPU state, but on the live RAM and ROM SRC address, which are saved before
+// and restored afterwards. The real routine is then stepped from the same
+// state and any difference is reported. The machine keeps the result of the
+// real routine.
+
+class HLEHookTable
+{
+public:
+    enum class Mode {
+        Off,       // Every routine is stepped
+        Native,    // Hooked routines run natively
+        Validate,  // Both run, the real routine wins, differences are reported
+    };
+
+    // Return false to fall back to the real routine (the state must be untouched then,
+    // Validate mode restores RAM and the ROM SRC a declining hook wrote)
+    using Hook = std::function<bool(K4004::State& state, RAM& ram, ROM& rom)>;
+
+    struct Mismatch {
+        uint16_t address;     // Hooked routine
+        uint64_t cycle;       // Cycle count at the JMS
+        std::string details;  // First differing field, "native != real"
+    };
+    using MismatchListener = std::function<void(const Mismatch& mismatch)>;
+
+    static constexpr uint64_t VALIDATE_CYCLE_LIMIT = 1u << 20;  // Real routine must return within this
+
+    HLEHookTable();
+
+    void setHook(uint16_t address, Hook hook);
+    void removeHook(uint16_t address);
+    void clear();
+    bool hasHook(uint16_t address) const { return m_hooked[address & 0x0FFFu]; }
+    const Hook* findHook(uint16_t address) const;
+
+    // Effects of the routine's final BBL value: one cycle, ACC = value keeping CY,
+    // IR = the BBL opcode and the level the JMS pushed is cleared
+    static void returnFromRoutine(K4004::State& state, uint8_t value);
+
+    void setMode(Mode mode) { m_mode = mode; }
+    Mode getMode() const { return m_mode; }
+
+    void setMismatchListener(MismatchListener listener) { m_mismatchListener = std::move(listener); }
+
+    // Called by the K4004
+    void reportMismatch(const Mismatch& mismatch);
+    void countNativeCall() { ++m_nativeCalls; }
+    void countValidatedCall() { ++m_validatedCalls; }
+
+    uint64_t getNativeCalls() const { return m_nativeCalls; }
+    uint64_t getValidatedCalls() const { return m_validatedCalls; }
+    uint64_t getMismatches() const { return m_mismatches; }
+    void resetCounters();
+
+private:
+    std::bitset<4096> m_hooked;
+    std::unordered_map<uint16_t, Hook> m_hooks;
+    Mode m_mode;
+    MismatchListener m_mismatchListener;
+    uint64_t m_nativeCalls;
+    uint64_t m_validatedCalls;
+    uint64_t m_mismatches;
+};
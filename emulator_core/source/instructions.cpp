@@ -28,18 +28,16 @@ void JCN(uint16_t* stack, uint8_t SP, uint8_t IR, uint8_t ACC, uint8_t test, con
     uint8_t address = rom.readByte(stack[SP]);
     stack[SP] = ++stack[SP] & 0x0FFFu;  // 12-bit PC
 
-    bool shouldJump = false;
-    switch (con) {
-    case +AsmCon::AEZ: shouldJump = (ACC & 0x0Fu) == 0u; break;
-    case +AsmCon::ANZ: shouldJump = (ACC & 0x0Fu) != 0u; break;
-    case +AsmCon::CEZ: shouldJump = !(ACC & 0x10u); break;
-    case +AsmCon::CNZ: shouldJump = ACC & 0x10u; break;
-    case +AsmCon::TEZ: shouldJump = test == 0u; break;
-    case +AsmCon::TNZ: shouldJump = test != 0u; break;
-    }
-
+    // Condition bits: 1000 invert, 0100 ACC == 0, 0010 CY == 1, 0001 TEST == 0
+    bool shouldJump = ((con & 0b0100u) && (ACC & 0x0Fu) == 0u) ||
+                      ((con & 0b0010u) && (ACC & 0x10u)) ||
+                      ((con & 0b0001u) && test == 0u);
+    if (con & 0b1000u)
+        shouldJump = !shouldJump;
+
+    // PC already points past the operand, so a JCN on the last bytes of a page
+    // jumps within the next page as on real hardware
     if (shouldJump) {
-        if ((stack[SP] & 0x00FFu) == 0xFE) stack[SP] += 2;
         stack[SP] &= 0x0F00u;  // Keep upper 4 bits (page)
         stack[SP] |= address;
     }
@@ -63,8 +61,8 @@ void SRC(RAM& ram, ROM& rom, const uint8_t* registers, uint8_t IR)
 void FIN(uint8_t* registers, uint16_t PC, uint8_t IR, const ROM& rom)
 {
     uint8_t reg = (IR & 0x0Fu) >> 1;
-    uint8_t addr = registers[0];
-    if ((PC & 0x00FFu) == 0xFF) addr += ROM::PAGE_SIZE;
+    // Fetch from the page of the next instruction (the next page when FIN is at xFF)
+    uint16_t addr = (PC & 0x0F00u) | registers[0];
     registers[reg] = rom.readByte(addr);
 }
 
@@ -72,7 +70,6 @@ void JIN(uint16_t* stack, uint8_t SP, const uint8_t* registers, uint8_t IR)
 {
     uint8_t reg = (IR & 0x0Fu) >> 1;
     uint8_t addr = registers[reg];
-    if ((stack[SP] & 0x00FFu) == 0xFFu) ++stack[SP];
     stack[SP] &= 0x0F00u;  // Keep upper 4 bits (page)
     stack[SP] |= addr;
 }
@@ -83,28 +80,19 @@ void JUN(uint16_t* stack, uint8_t SP, uint8_t IR, const ROM& rom)
     stack[SP] = address | rom.readByte(stack[SP]);
 }
 
-void JMS(uint16_t* stack, uint8_t& SP, uint8_t IR, const ROM& rom, uint8_t stackSize)
+void pushStack(uint16_t* stack, uint8_t& SP, uint16_t address, uint8_t stackSize)
 {
-    // Compute jump address from instruction
-    uint16_t address = (IR & 0x0Fu) << 8;
-    address |= rom.readByte(stack[SP]);
-
-    // Save return address (current PC + 2) for when subroutine returns
-    uint16_t returnAddr = (stack[SP] + 2) & 0x0FFFu;  // 12-bit PC
-
-    // Increment SP with wraparound on overflow (documented 4004 behavior)
-    // 4004: 3-level stack (0-2), 4th call keeps SP=2 (overwrites stack[2])
-    // 4040: 7-level stack (0-6), 8th call keeps SP=6 (overwrites stack[6])
-    if (SP < stackSize - 1) {
-        ++SP;
-    }
-    // else: SP stays at max level (overflow), overwrites top of stack
-
-    // Save return address at current stack level
-    stack[SP] = returnAddr;
+    // The current level keeps the (already incremented) return address and the
+    // next level becomes the PC. The address stack is circular, on overflow the
+    // oldest return address is overwritten.
+    SP = (SP + 1u) % stackSize;
+    stack[SP] = address & 0x0FFFu;  // 12-bit PC
+}
 
-    // NOTE: In real hardware, PC is updated to 'address' automatically.
-    // In this test framework, caller must update stack[SP] to jump address.
+void popStack(uint16_t* stack, uint8_t& SP, uint8_t stackSize)
+{
+    stack[SP] = 0u;
+    SP = (SP + stackSize - 1u) % stackSize;
 }
 
 void INC(uint8_t* registers, uint8_t IR)
@@ -123,7 +111,6 @@ void ISZ(uint16_t* stack, uint8_t SP, uint8_t* registers, uint8_t IR, const ROM&
     stack[SP] = ++stack[SP] & 0x0FFFu;  // 12-bit PC
 
     if (((value + 1) & 0x0Fu) != 0u) {
-        if ((stack[SP] & 0x00FFu) == 0xFEu) stack[SP] += 2u;
         stack[SP] &= 0x0F00u;  // Keep upper 4 bits (page)
         stack[SP] |= addr;
     }
@@ -139,9 +126,10 @@ void ADD(uint8_t& ACC, const uint8_t* registers, uint8_t IR)
 
 void SUB(uint8_t& ACC, const uint8_t* registers, uint8_t IR)
 {
-    uint8_t CY = (ACC >> 4) & 1;  // Fixed: Use carry directly (inverted semantics are in the algorithm)
+    // ACC = ACC + (15 - reg) + (1 - CY), CY set when there was no borrow
+    uint8_t borrow = (ACC >> 4) & 1;
     uint8_t temp = IR & 0x0Fu;
-    temp = (~getRegisterValue(registers, temp) & 0x0Fu) + CY;
+    temp = (~getRegisterValue(registers, temp) & 0x0Fu) + (borrow ^ 1u);
     ACC = (ACC & 0x0Fu) + temp;
 }
 
@@ -159,19 +147,6 @@ void XCH(uint8_t& ACC, uint8_t* registers, uint8_t IR)
     setRegisterValue(registers, reg, temp);
 }
 
-void BBL(uint16_t* stack, uint8_t& SP, uint8_t& ACC, const uint8_t* registers, uint8_t IR)
-{
-    // Stack bounds check - prevent underflow
-    if (SP > 0) {
-        stack[SP] = 0u;
-        --SP;
-    }
-    // If SP == 0, we're already at the bottom - stay there
-
-    // Load immediate data (lower 4 bits of IR) directly to accumulator
-    ACC = (IR & 0x0Fu) | (ACC & 0x10u);  // Preserve carry flag
-}
-
 void LDM(uint8_t& ACC, uint8_t IR)
 {
     ACC = (IR & 0x0Fu) | (ACC & 0x10u);
@@ -214,8 +189,9 @@ void WR3(RAM& ram, uint8_t ACC)
 
 void SBM(uint8_t& ACC, const RAM& ram)
 {
-    uint8_t CY = (ACC >> 4) & 1;  // Fixed: Use carry directly (inverted semantics are in the algorithm)
-    uint8_t temp = (~ram.readRAM() & 0x0Fu) + CY;
+    // ACC = ACC + (15 - mem) + (1 - CY), CY set when there was no borrow
+    uint8_t borrow = (ACC >> 4) & 1;
+    uint8_t temp = (~ram.readRAM() & 0x0Fu) + (borrow ^ 1u);
     ACC = (ACC & 0x0Fu) + temp;
 }
 
@@ -316,7 +292,7 @@ void DAC(uint8_t& ACC)
 
 void TCS(uint8_t& ACC)
 {
-    ACC = ACC >> 4 ? 9u : 10u;  // Fixed: Returns 10-CY (CY=1→9, CY=0→10)
+    ACC = ACC >> 4 ? 10u : 9u;  // ACC = 9 + CY, carry cleared
 }
 
 void STC(uint8_t& ACC)
@@ -326,30 +302,31 @@ void STC(uint8_t& ACC)
 
 void DAA(uint8_t& ACC)
 {
-    if (ACC > 9u) {
-        ACC += 6u;
+    // Add 6 when ACC > 9 or CY is set, the carry is set on overflow and never cleared
+    uint8_t temp = ACC & 0x0Fu;
+    if (temp > 9u || (ACC & 0x10u)) {
+        temp += 6u;
+        ACC = (ACC & 0x10u) | (temp & 0x0Fu) | (temp > 0x0Fu ? 0x10u : 0u);
     }
 }
 
 void KBP(uint8_t& ACC)
 {
+    // Keyboard process: 0000 -> 0, single bit -> its position (1-4), anything
+    // else -> 15. Carry is not affected (the Busicom keyboard scan relies on 0->0)
     uint8_t temp = ACC & 0x0Fu;
+    uint8_t carry = ACC & 0x10u;
 
-    // Special case: ACC=0 examines carry flag (undocumented feature for keyboard scanning)
-    // Returns 9 or 10 to distinguish "no key pressed" from "key 0 pressed"
-    if (temp == 0b0000u) {
-        ACC = (ACC >> 4) ? 10u : 9u;  // CY=1→10, CY=0→9
-        return;
+    switch (temp) {
+    case 0b0000u: temp = 0u; break;
+    case 0b0001u: temp = 1u; break;
+    case 0b0010u: temp = 2u; break;
+    case 0b0100u: temp = 3u; break;
+    case 0b1000u: temp = 4u; break;
+    default:      temp = 0b1111u; break;
     }
 
-    // Single bit patterns return bit position (1-4)
-    if (temp == 0b0001u) { ACC = 1u; return; }
-    if (temp == 0b0010u) { ACC = 2u; return; }
-    if (temp == 0b0100u) { ACC = 3u; return; }
-    if (temp == 0b1000u) { ACC = 4u; return; }
-
-    // Multiple bits or invalid patterns return 15
-    ACC = 0b1111u;
+    ACC = carry | temp;
 }
 
 void DCL(RAM& ram, uint8_t ACC)
@@ -382,7 +359,7 @@ void HLT(bool& halted)
 }
 
 // BBS - Branch Back from interrupt, restore SRC
-void BBS(uint16_t* stack, uint8_t& SP, RAM& ram, ROM& rom, uint8_t srcBackup, bool& interruptEnabled)
+void BBS(uint16_t* stack, uint8_t& SP, RAM& ram, ROM& rom, uint8_t srcBackup, bool& interruptEnabled, uint8_t stackSize)
 {
     // Restore SRC register from backup
     ram.writeSrcAddress(srcBackup);
@@ -391,11 +368,8 @@ void BBS(uint16_t* stack, uint8_t& SP, RAM& ram, ROM& rom, uint8_t srcBackup, bo
     // Re-enable interrupts
     interruptEnabled = true;
 
-    // Return from interrupt (pop stack)
-    if (SP > 0) {
-        stack[SP] = 0u;
-        --SP;
-    }
+    // Return from interrupt, the stack wraps like BBL
+    popStack(stack, SP, stackSize);
 }
 
 // LCR - Load Command Register to accumulator
@@ -469,17 +443,16 @@ void DIN(bool& interruptEnabled)
 }
 
 // RPM - Read Program Memory to accumulator
-void RPM(uint8_t& ACC, const ROM& rom, uint16_t PC)
+void RPM(uint8_t& ACC, ROM& rom, uint16_t PC)
 {
-    // Read the byte at current PC from program memory
-    uint8_t value = rom.readByte(PC);
+    // Next half of the program RAM byte selected through the 4289, without one
+    // the byte at the current PC
+    uint8_t value = rom.hasProgramMemory() ? rom.readProgramMemory() : rom.readByte(PC);
     ACC = (value & 0x0Fu) | (ACC & 0x10u);
 }
 
-// WPM - Write Program Memory (stub - ROM is read-only in most systems)
-void WPM()
+// WPM - Write Program Memory, one nibble per instruction through a 4289
+void WPM(ROM& rom, uint8_t ACC)
 {
-    // This instruction is typically not implemented in emulators
-    // as program memory (ROM) is read-only
-    // In real hardware with EPROM, this would program the ROM
+    rom.writeProgramMemory(ACC & 0x0Fu);
 }
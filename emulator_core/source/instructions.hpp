@@ -6,12 +6,14 @@ class ROM;
 
 uint8_t getRegisterValue(const uint8_t* registers, uint8_t reg);
 void setRegisterValue(uint8_t* registers, uint8_t reg, uint8_t value);
+void pushStack(uint16_t* stack, uint8_t& SP, uint16_t address, uint8_t stackSize);
+void popStack(uint16_t* stack, uint8_t& SP, uint8_t stackSize);
 
 void NOP();
 
 // Intel 4040 new instructions
 void HLT(bool& halted);
-void BBS(uint16_t* stack, uint8_t& SP, RAM& ram, ROM& rom, uint8_t srcBackup, bool& interruptEnabled);
+void BBS(uint16_t* stack, uint8_t& SP, RAM& ram, ROM& rom, uint8_t srcBackup, bool& interruptEnabled, uint8_t stackSize);
 void LCR(uint8_t& ACC, uint8_t commandRegister);
 void OR4(uint8_t& ACC, const uint8_t* registers);
 void OR5(uint8_t& ACC, const uint8_t* registers);
@@ -23,26 +25,24 @@ void SB0(uint8_t& registerBank);
 void SB1(uint8_t& registerBank);
 void EIN(bool& interruptEnabled);
 void DIN(bool& interruptEnabled);
-void RPM(uint8_t& ACC, const ROM& rom, uint16_t PC);
+void RPM(uint8_t& ACC, ROM& rom, uint16_t PC);
 void JCN(uint16_t* stack, uint8_t SP, uint8_t IR, uint8_t ACC, uint8_t test, const ROM& rom);
 void FIM(uint16_t* stack, uint8_t SP, uint8_t* registers, uint8_t IR, const ROM& rom);
 void SRC(RAM& ram, ROM& rom, const uint8_t* registers, uint8_t IR);
 void FIN(uint8_t* registers, uint16_t PC, uint8_t IR, const ROM& rom);
 void JIN(uint16_t* stack, uint8_t SP, const uint8_t* registers, uint8_t IR);
 void JUN(uint16_t* stack, uint8_t SP, uint8_t IR, const ROM& rom);
-void JMS(uint16_t* stack, uint8_t& SP, uint8_t IR, const ROM& rom, uint8_t stackSize);
 void INC(uint8_t* registers, uint8_t IR);
 void ISZ(uint16_t* stack, uint8_t SP, uint8_t* registers, uint8_t IR, const ROM& rom);
 void ADD(uint8_t& ACC, const uint8_t* registers, uint8_t IR);
 void SUB(uint8_t& ACC, const uint8_t* registers, uint8_t IR);
 void LD(uint8_t& ACC, const uint8_t* registers, uint8_t IR);
 void XCH(uint8_t& ACC, uint8_t* registers, uint8_t IR);
-void BBL(uint16_t* stack, uint8_t& SP, uint8_t& ACC, const uint8_t* registers, uint8_t IR);
 void LDM(uint8_t& ACC, uint8_t IR);
 void WRM(RAM& ram, uint8_t ACC);
 void WMP(RAM& ram, uint8_t ACC);
 void WRR(ROM& rom, uint8_t ACC);
-void WPM();
+void WPM(ROM& rom, uint8_t ACC);
 void WR0(RAM& ram, uint8_t ACC);
 void WR1(RAM& ram, uint8_t ACC);
 void WR2(RAM& ram, uint8_t ACC);
@@ -0,0 +1,47 @@
+#pragma once
+#include <cstdint>
+#include <functional>
+#include <utility>
+#include <vector>
+
+// Edge-triggered I/O port change notification
+//
+// ROM (4001) I/O ports, RAM (4002) output ports and the 4040 command register
+// report every CPU write that actually changes the latched value to the
+// registered sinks. Peripherals subscribe once instead of polling the ports
+// after each instruction, and observe the change on the cycle it was written.
+
+struct IOPortChange {
+    uint8_t port;       // ROM: chip 0-15, RAM: bank * 4 + chip, 4040 command register: 0
+    uint8_t oldValue;
+    uint8_t newValue;
+    uint64_t cycle;     // CPU cycle count at the start of the writing instruction
+};
+
+using IOPortListener = std::function<void(const IOPortChange&)>;
+
+class IOPortNotifier
+{
+public:
+    void addListener(IOPortListener listener) { m_listeners.push_back(std::move(listener)); }
+    void clearListeners() { m_listeners.clear(); }
+    bool hasListeners() const { return !m_listeners.empty(); }
+
+    // Cycle counter used to stamp changes (owned by the CPU, nullptr stamps cycle 0)
+    void setCycleCounter(const uint64_t* cycleCounter) { m_cycleCounter = cycleCounter; }
+    const uint64_t* getCycleCounter() const { return m_cycleCounter; }
+
+    void notify(uint8_t port, uint8_t oldValue, uint8_t newValue) const
+    {
+        if (oldValue == newValue || m_listeners.empty())
+            return;
+
+        const IOPortChange change{ port, oldValue, newValue, m_cycleCounter ? *m_cycleCounter : 0u };
+        for (const auto& listener : m_listeners)
+            listener(change);
+    }
+
+private:
+    std::vector<IOPortListener> m_listeners;
+    const uint64_t* m_cycleCounter = nullptr;
+};
@@ -15,6 +15,22 @@ void RAM::reset()
     std::memset(m_oPorts, 0, OUTPUT_SIZE);
 }
 
+void RAM::saveState(State& state) const
+{
+    state.srcAddress = m_srcAddress;
+    std::memcpy(state.ram, m_ram, RAM_SIZE);
+    std::memcpy(state.status, m_status, STATUS_SIZE);
+    std::memcpy(state.oPorts, m_oPorts, OUTPUT_SIZE);
+}
+
+void RAM::loadState(const State& state)
+{
+    m_srcAddress = state.srcAddress;
+    std::memcpy(m_ram, state.ram, RAM_SIZE);
+    std::memcpy(m_status, state.status, STATUS_SIZE);
+    std::memcpy(m_oPorts, state.oPorts, OUTPUT_SIZE);
+}
+
 void RAM::writeRAM(uint8_t character)
 {
     m_ram[m_srcAddress] = character & 0x0Fu;
@@ -35,7 +51,9 @@ uint8_t RAM::readStatus(uint8_t index) const
 void RAM::writeOutputPort(uint8_t character)
 {
     uint8_t addr = m_srcAddress >> 6;
+    uint8_t oldValue = m_oPorts[addr];
     m_oPorts[addr] = character & 0x0Fu;
+    m_outputNotifier.notify(addr, oldValue, m_oPorts[addr]);
 }
 
 uint8_t RAM::readOutputPort() const
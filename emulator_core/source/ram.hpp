@@ -1,6 +1,8 @@
 #pragma once
 #include <cstdint>
 
+#include "emulator_core/source/io_port_events.hpp"
+
 class RAM
 {
 public:
@@ -13,9 +15,21 @@ public:
     static constexpr uint16_t STATUS_SIZE = NUM_RAM_BANKS * NUM_RAM_CHIPS * NUM_RAM_REGS * NUM_STAUS_CHARS;
     static constexpr uint16_t OUTPUT_SIZE = NUM_RAM_BANKS * NUM_RAM_CHIPS;
 
+    // Memory and output port contents, plain data for snapshots
+    struct State {
+        uint16_t srcAddress;
+        uint8_t ram[RAM_SIZE];
+        uint8_t status[STATUS_SIZE];
+        uint8_t oPorts[OUTPUT_SIZE];
+    };
+
     RAM();
 
     void reset();
+
+    // Restoring a state does not notify output port listeners
+    void saveState(State& state) const;
+    void loadState(const State& state);
     void writeRAM(uint8_t character);
     uint8_t readRAM() const { return m_ram[m_srcAddress] & 0x0F; }
     void writeStatus(uint8_t character, uint8_t index);
@@ -29,6 +43,12 @@ public:
     const uint8_t* getStatusContents() const { return m_status; }
     const uint8_t* getOutputContents() const { return m_oPorts; }
     uint16_t getSrcAddress() const { return m_srcAddress & 0x3FFu; }
+
+    // Edge-triggered notification of CPU writes changing an output port (port = bank * 4 + chip)
+    void addOutputPortListener(IOPortListener listener) { m_outputNotifier.addListener(std::move(listener)); }
+    void clearOutputPortListeners() { m_outputNotifier.clearListeners(); }
+    void setCycleCounter(const uint64_t* cycleCounter) { m_outputNotifier.setCycleCounter(cycleCounter); }
+    const uint64_t* getCycleCounter() const { return m_outputNotifier.getCycleCounter(); }
     
     RAM(const RAM&) = delete;
     RAM& operator=(const RAM&) = delete;
@@ -37,4 +57,5 @@ private:
     uint8_t m_ram[RAM_SIZE];
     uint8_t m_status[STATUS_SIZE];
     uint8_t m_oPorts[OUTPUT_SIZE];
+    IOPortNotifier m_outputNotifier;
 };
@@ -0,0 +1,120 @@
+#include "emulator_core/source/realtime_pacer.hpp"
+#include "emulator_core/source/K4201A.hpp"
+
+#include <algorithm>
+#include <thread>
+
+RealTimePacer::RealTimePacer(const K4201A& clock) :
+    m_clockFrequency(clock.getOutputFrequency()),
+    m_sliceDuration(std::chrono::milliseconds(1)),
+    m_maxCatchUp(std::chrono::milliseconds(100)),
+    m_sleep([](Clock::time_point deadline) { std::this_thread::sleep_until(deadline); }),
+    m_started(false),
+    m_originCycle(0u),
+    m_sliceIndex(0u),
+    m_currentCycle(0u)
+{
+}
+
+void RealTimePacer::setClock(const K4201A& clock)
+{
+    setClockFrequency(clock.getOutputFrequency());
+}
+
+void RealTimePacer::setClockFrequency(uint32_t frequency)
+{
+    m_clockFrequency = frequency;
+    m_started = false;
+}
+
+void RealTimePacer::setSliceDuration(std::chrono::nanoseconds duration)
+{
+    if (duration.count() > 0) {
+        m_sliceDuration = duration;
+        m_started = false;
+    }
+}
+
+void RealTimePacer::start(uint64_t startCycle)
+{
+    m_started = true;
+    m_originTime = Clock::now();
+    m_originCycle = startCycle;
+    m_currentCycle = startCycle;
+    m_sliceIndex = 0u;
+}
+
+void RealTimePacer::runSlice(const RunFunction& runTo)
+{
+    if (!m_started)
+        start(m_currentCycle);
+
+    if (!isPaced()) {
+        uint64_t reachedCycle = std::max(runTo(m_currentCycle + UNPACED_SLICE_CYCLES), m_currentCycle);
+        m_stats.emulatedCycles += reachedCycle - m_currentCycle;
+        m_currentCycle = reachedCycle;
+        ++m_stats.slices;
+        return;
+    }
+
+    // Slice targets are derived from the origin so rounding never accumulates
+    ++m_sliceIndex;
+    uint64_t targetCycle = m_originCycle + cyclesForDuration(m_sliceDuration * m_sliceIndex);
+    uint64_t reachedCycle = std::max(runTo(targetCycle), m_currentCycle);
+
+    m_stats.emulatedCycles += reachedCycle - m_currentCycle;
+    m_currentCycle = reachedCycle;
+    ++m_stats.slices;
+
+    Clock::time_point deadline = getDeadlineForCycle(reachedCycle);
+    Clock::time_point now = Clock::now();
+    int64_t drift = std::chrono::duration_cast<std::chrono::nanoseconds>(now - deadline).count();
+
+    m_stats.currentDriftNs = drift;
+    m_stats.maxDriftNs = std::max(m_stats.maxDriftNs, drift);
+    m_stats.totalDriftNs += drift;
+
+    if (drift > 0) {
+        // Behind real time: skip the sleep and let the next slices catch up
+        ++m_stats.lateSlices;
+        if (drift > m_maxCatchUp.count()) {
+            ++m_stats.resyncs;
+            start(reachedCycle);
+        }
+        return;
+    }
+
+    m_sleep(deadline);
+    m_stats.sleepTime += Clock::now() - now;
+}
+
+void RealTimePacer::run(const RunFunction& runTo, const std::function<bool()>& keepRunning)
+{
+    while (keepRunning())
+        runSlice(runTo);
+}
+
+RealTimePacer::Clock::time_point RealTimePacer::getDeadlineForCycle(uint64_t cycle) const
+{
+    uint64_t cycles = cycle > m_originCycle ? cycle - m_originCycle : 0u;
+    return m_originTime + std::chrono::duration_cast<Clock::duration>(durationForCycles(cycles));
+}
+
+uint64_t RealTimePacer::cyclesForDuration(std::chrono::nanoseconds duration) const
+{
+    // cycles = ns * frequency / (8 * 1e9), split to stay within 64 bits
+    constexpr uint64_t divisor = CLOCKS_PER_CYCLE * NS_PER_SECOND;
+    uint64_t ns = static_cast<uint64_t>(std::max<int64_t>(duration.count(), 0));
+    return (ns / divisor) * m_clockFrequency + (ns % divisor) * m_clockFrequency / divisor;
+}
+
+std::chrono::nanoseconds RealTimePacer::durationForCycles(uint64_t cycles) const
+{
+    if (m_clockFrequency == 0u)
+        return std::chrono::nanoseconds(0);
+
+    // ns = cycles * 8 * 1e9 / frequency, split to stay within 64 bits
+    constexpr uint64_t multiplier = CLOCKS_PER_CYCLE * NS_PER_SECOND;
+    uint64_t ns = (cycles / m_clockFrequency) * multiplier + (cycles % m_clockFrequency) * multiplier / m_clockFrequency;
+    return std::chrono::nanoseconds(ns);
+}
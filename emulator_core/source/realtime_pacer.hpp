@@ -0,0 +1,97 @@
+#pragma once
+#include <chrono>
+#include <cstdint>
+#include <functional>
+
+class K4201A;
+
+// Real-time pacing of emulated instruction cycles
+//
+// Runs the emulator in short emulated-time slices (1 ms by default) at the
+// instruction rate implied by the K4201A clock configuration (8 clock periods
+// per instruction cycle, 92.6k cycles/s at 740 kHz) and sleeps the host thread
+// until each slice's wall-clock deadline. When the host stalls, following slices
+// run back to back until emulated time catches up; stalls longer than the
+// catch-up limit resynchronise the timeline instead of bursting.
+//
+// A clock frequency of 0 Hz has no instruction rate to follow: the pacer then
+// runs unpaced, in back to back slices of UNPACED_SLICE_CYCLES without sleeping.
+
+class RealTimePacer
+{
+public:
+    using Clock = std::chrono::steady_clock;
+
+    // Advances the emulator to at least targetCycle, returns the cycle count reached
+    using RunFunction = std::function<uint64_t(uint64_t targetCycle)>;
+
+    // Blocks the host until the wall-clock deadline (e.g. K4040::waitWhileHalted)
+    using SleepFunction = std::function<void(Clock::time_point deadline)>;
+
+    struct Stats {
+        uint64_t slices = 0u;
+        uint64_t emulatedCycles = 0u;
+        uint64_t lateSlices = 0u;        // Slices finishing after their deadline
+        uint64_t resyncs = 0u;           // Timeline resets after exceeding the catch-up limit
+        int64_t currentDriftNs = 0;      // Wall clock minus emulated time, positive = behind
+        int64_t maxDriftNs = 0;
+        int64_t totalDriftNs = 0;        // Sum over slices, see getAverageDriftNs()
+        Clock::duration sleepTime{};
+
+        int64_t getAverageDriftNs() const { return slices ? totalDriftNs / static_cast<int64_t>(slices) : 0; }
+    };
+
+    explicit RealTimePacer(const K4201A& clock);
+
+    // Re-read the clock configuration, restarts the timeline
+    void setClock(const K4201A& clock);
+    void setClockFrequency(uint32_t frequency);  // CPU clock in Hz, 0 runs unpaced
+    void setSliceDuration(std::chrono::nanoseconds duration);
+    void setMaxCatchUp(std::chrono::nanoseconds limit) { m_maxCatchUp = limit; }
+    void setSleepFunction(SleepFunction sleep) { m_sleep = std::move(sleep); }
+
+    static constexpr uint64_t UNPACED_SLICE_CYCLES = 1024u;
+
+    uint32_t getClockFrequency() const { return m_clockFrequency; }
+    bool isPaced() const { return m_clockFrequency != 0u; }
+    uint64_t getCyclesPerSecond() const { return m_clockFrequency / CLOCKS_PER_CYCLE; }
+    std::chrono::nanoseconds getSliceDuration() const { return m_sliceDuration; }
+
+    // Anchor emulated cycle startCycle to the current wall-clock time
+    void start(uint64_t startCycle);
+
+    // Run one slice and sleep until its deadline, starts the timeline on first use
+    void runSlice(const RunFunction& runTo);
+
+    // Run slices until keepRunning returns false
+    void run(const RunFunction& runTo, const std::function<bool()>& keepRunning);
+
+    // Wall-clock time at which the emulated cycle is due
+    Clock::time_point getDeadlineForCycle(uint64_t cycle) const;
+
+    uint64_t cyclesForDuration(std::chrono::nanoseconds duration) const;
+    std::chrono::nanoseconds durationForCycles(uint64_t cycles) const;
+
+    const Stats& getStats() const { return m_stats; }
+    void resetStats() { m_stats = {}; }
+
+    RealTimePacer(const RealTimePacer&) = delete;
+    RealTimePacer& operator=(const RealTimePacer&) = delete;
+
+private:
+    static constexpr uint64_t CLOCKS_PER_CYCLE = 8u;
+    static constexpr uint64_t NS_PER_SECOND = 1000000000u;
+
+    uint32_t m_clockFrequency;
+    std::chrono::nanoseconds m_sliceDuration;
+    std::chrono::nanoseconds m_maxCatchUp;
+    SleepFunction m_sleep;
+
+    bool m_started;
+    Clock::time_point m_originTime;
+    uint64_t m_originCycle;
+    uint64_t m_sliceIndex;      // Slices since the origin
+    uint64_t m_currentCycle;
+
+    Stats m_stats;
+};
@@ -1,12 +1,27 @@
 #include "emulator_core/source/rom.hpp"
+#include "emulator_core/source/K4289.hpp"
+#include "emulator_core/source/K4702.hpp"
 
 #include <cstring>
 
-ROM::ROM()
+ROM::ROM() :
+    m_rom{},
+    m_programMemory(nullptr),
+    m_eproms{},
+    m_codeWrites(0u),
+    m_pageWriteStamps{},
+    m_blockWriteStamps{}
 {
     reset();
 }
 
+ROM::~ROM()
+{
+    attachProgramMemory(nullptr);
+    for (uint8_t page = 0u; page < NUM_ROM_CHIPS; ++page)
+        mapEPROM(page, nullptr);
+}
+
 bool ROM::load(const uint8_t* objectCode, size_t objectCodeLength)
 {   
     if (objectCode == nullptr || objectCodeLength == 0)
@@ -38,18 +53,114 @@ bool ROM::load(const uint8_t* objectCode, size_t objectCodeLength)
     if (objectCodeLength - i > ROM_SIZE)
         return false;
 
-    for (size_t j = 0; i < objectCodeLength; ++i, ++j)
-        m_rom[j] = objectCode[i];
+    std::memcpy(m_loadedProgram, objectCode + i, objectCodeLength - i);
+    refreshProgramBytes(0u, ROM_SIZE);
+    return true;
+}
+
+bool ROM::loadPage(uint8_t page, const uint8_t* program, size_t programLength)
+{
+    if (program == nullptr || page >= NUM_ROM_CHIPS || programLength > PAGE_SIZE)
+        return false;
 
+    std::memcpy(m_loadedProgram + page * PAGE_SIZE, program, programLength);
+    refreshProgramBytes(page * PAGE_SIZE, PAGE_SIZE);
     return true;
 }
 
 void ROM::reset()
 {
     m_srcAddress = 0u;
-    std::memset(m_rom, 0, ROM_SIZE);
+    std::memset(m_loadedProgram, 0, ROM_SIZE);
     std::memset(m_ioPorts, 0, NUM_ROM_CHIPS);
     std::memset(m_ioPortsMasks, 0, NUM_ROM_CHIPS);
+    refreshProgramBytes(0u, ROM_SIZE);
+}
+
+void ROM::saveState(State& state) const
+{
+    state.srcAddress = m_srcAddress;
+    std::memcpy(state.rom, m_loadedProgram, ROM_SIZE);
+    std::memcpy(state.ioPorts, m_ioPorts, NUM_ROM_CHIPS);
+    std::memcpy(state.ioPortsMasks, m_ioPortsMasks, NUM_ROM_CHIPS);
+}
+
+void ROM::loadState(const State& state)
+{
+    // Restoring the same program (snapshots of one machine) keeps decoded copies valid
+    if (std::memcmp(m_loadedProgram, state.rom, ROM_SIZE) != 0) {
+        std::memcpy(m_loadedProgram, state.rom, ROM_SIZE);
+        refreshProgramBytes(0u, ROM_SIZE);
+    }
+    m_srcAddress = state.srcAddress;
+    std::memcpy(m_ioPorts, state.ioPorts, NUM_ROM_CHIPS);
+    std::memcpy(m_ioPortsMasks, state.ioPortsMasks, NUM_ROM_CHIPS);
+}
+
+void ROM::writeSrcAddress(uint8_t address)
+{
+    m_srcAddress = address >> 4;
+    if (m_programMemory != nullptr)
+        m_programMemory->selectProgramAddress(address);
+}
+
+void ROM::attachProgramMemory(K4289* programMemory)
+{
+    if (m_programMemory != nullptr)
+        m_programMemory->setProgramChangeListener(nullptr);
+
+    m_programMemory = programMemory;
+    if (m_programMemory != nullptr)
+        m_programMemory->setProgramChangeListener([this](uint16_t address, uint16_t length) { refreshProgramBytes(address, length); });
+    refreshProgramBytes(0u, ROM_SIZE);
+}
+
+void ROM::mapEPROM(uint8_t page, K4702* eprom)
+{
+    page &= 0x0Fu;
+    if (m_eproms[page] != nullptr)
+        m_eproms[page]->setProgramListener(nullptr);
+
+    m_eproms[page] = eprom;
+    if (eprom != nullptr) {
+        uint16_t base = page * PAGE_SIZE;
+        eprom->setProgramListener([this, base](uint8_t address, uint16_t length) { refreshProgramBytes(base + address, length); });
+    }
+    refreshProgramBytes(page * PAGE_SIZE, PAGE_SIZE);
+}
+
+void ROM::writeProgramMemory(uint8_t nibble)
+{
+    if (m_programMemory != nullptr)
+        m_programMemory->writeProgramNibble(nibble & 0x0Fu);
+}
+
+uint8_t ROM::readProgramMemory()
+{
+    return m_programMemory != nullptr ? m_programMemory->readProgramNibble() : 0u;
+}
+
+void ROM::refreshProgramBytes(uint16_t address, uint16_t length)
+{
+    // Fetches see program RAM on mapped pages while program memory mode is on,
+    // else the page's EPROM, else the loaded bytes
+    bool programRAM = m_programMemory != nullptr && m_programMemory->isProgramMemoryMode();
+    for (uint16_t i = 0u; i < length; ++i) {
+        uint16_t byteAddress = (address + i) & (ROM_SIZE - 1u);
+        uint8_t page = static_cast<uint8_t>(byteAddress / PAGE_SIZE);
+        uint8_t value = m_loadedProgram[byteAddress];
+        if (programRAM && m_programMemory->isProgramRAMPage(page))
+            value = m_programMemory->readProgramByte(byteAddress);
+        else if (m_eproms[page] != nullptr)
+            value = m_eproms[page]->readByte(byteAddress & 0xFFu);
+
+        if (m_rom[byteAddress] != value) {
+            m_rom[byteAddress] = value;
+            ++m_codeWrites;
+            m_pageWriteStamps[page] = m_codeWrites;
+            m_blockWriteStamps[byteAddress / CODE_BLOCK_SIZE] = m_codeWrites;
+        }
+    }
 }
 
 void ROM::writeIOPort(uint8_t value)
@@ -59,6 +170,12 @@ void ROM::writeIOPort(uint8_t value)
     // - Mask bit = 0: Output (CPU can write)
     // - Mask bit = 1: Input (value preserved, CPU cannot write)
 
+    // The 4289 answers on its page and control ports
+    if (m_programMemory != nullptr && (m_srcAddress == K4289::PAGE_PORT || m_srcAddress == K4289::CONTROL_PORT)) {
+        m_programMemory->writePort(m_srcAddress, value & 0x0Fu);
+        return;
+    }
+
     uint8_t oldValue = m_ioPorts[m_srcAddress];
     uint8_t mask = m_ioPortsMasks[m_srcAddress];
     uint8_t newValue = 0u;
@@ -73,6 +190,7 @@ void ROM::writeIOPort(uint8_t value)
     }
 
     m_ioPorts[m_srcAddress] = newValue & 0x0Fu;
+    m_ioNotifier.notify(m_srcAddress, oldValue, m_ioPorts[m_srcAddress]);
 }
 
 uint8_t ROM::readIOPort() const
@@ -82,6 +200,8 @@ uint8_t ROM::readIOPort() const
     // - Mask bit = 1: Input (read from external device)
     // Simply return the current port value (external devices update via setExternalIOPort)
 
+    if (m_programMemory != nullptr && m_srcAddress == K4289::PAGE_PORT)
+        return m_programMemory->getReadLatch();
     return m_ioPorts[m_srcAddress] & 0x0Fu;
 }
 
@@ -2,23 +2,70 @@
 #include <cstdint>
 #include <cstddef>
 
-// Emulates bank of 16 4001 chips
+#include "emulator_core/source/io_port_events.hpp"
+
+class K4289;
+class K4702;
+
+// Emulates bank of 16 4001 chips, optionally with 4702 EPROMs in place of
+// some of them and 4289 program RAM pages overlaying them
 class ROM
 {
 public:
     static constexpr uint16_t PAGE_SIZE = 256u;
     static constexpr uint16_t NUM_ROM_CHIPS = 16u;
     static constexpr uint16_t ROM_SIZE = PAGE_SIZE * NUM_ROM_CHIPS;
+    static constexpr uint16_t CODE_BLOCK_SIZE = 16u;
+    static constexpr uint16_t NUM_CODE_BLOCKS = ROM_SIZE / CODE_BLOCK_SIZE;
+
+    // Program as loaded (without program RAM), I/O ports and masks, plain data for snapshots
+    struct State {
+        uint8_t srcAddress;
+        uint8_t rom[ROM_SIZE];
+        uint8_t ioPorts[NUM_ROM_CHIPS];
+        uint8_t ioPortsMasks[NUM_ROM_CHIPS];
+    };
 
     ROM();
+    ~ROM();
 
     bool load(const uint8_t* objectCode, size_t objectCodeLength);
+    // Replace one 4001 page with raw program bytes (no I/O mask header), the rest stays
+    bool loadPage(uint8_t page, const uint8_t* program, size_t programLength);
     void reset();
 
+    // Restoring a state does not notify I/O port listeners
+    void saveState(State& state) const;
+    void loadState(const State& state);
+
     uint8_t readByte(uint16_t address) const { return m_rom[address]; }
     void writeIOPort(uint8_t value);
     uint8_t readIOPort() const;
-    void writeSrcAddress(uint8_t address) { m_srcAddress = address >> 4; }
+    void writeSrcAddress(uint8_t address);
+
+    // Program RAM behind a 4289 (see K4289.hpp): SRC, WRR/RDR on its ports and
+    // WPM/RPM reach it, its mapped pages replace the loaded bytes for fetches
+    // while program memory mode is on. The 4289 must outlive the
+    // ROM or be detached (nullptr).
+    void attachProgramMemory(K4289* programMemory);
+    bool hasProgramMemory() const { return m_programMemory != nullptr; }
+    void writeProgramMemory(uint8_t nibble);  // WPM
+    uint8_t readProgramMemory();              // RPM
+
+    // A 4702 answering for a page instead of the loaded bytes, programming and
+    // erasing it are seen by fetches at once. Not owned, must outlive the ROM
+    // or be unmapped (nullptr).
+    void mapEPROM(uint8_t page, K4702* eprom);
+
+    // Code write tracking for decoded copies of the program. Every change of a
+    // fetched byte, by load, loadPage, reset, loadState, WPM, program RAM
+    // mapping or EPROM programming, counts one write and stamps its 16-byte
+    // block and 256-byte page with the count. A cache remembers the count it
+    // last saw and rebuilds only the pages and blocks stamped later; writing
+    // a byte with its current value stamps nothing.
+    uint64_t getCodeWriteCount() const { return m_codeWrites; }
+    uint64_t getPageWriteStamp(uint8_t page) const { return m_pageWriteStamps[page]; }
+    uint64_t getBlockWriteStamp(uint16_t block) const { return m_blockWriteStamps[block]; }
 
     // Allow external devices to set I/O port input pins
     void setExternalIOPort(uint8_t chipIndex, uint8_t value);
@@ -26,7 +73,14 @@ public:
     // Configure I/O port masks programmatically (for systems without mask data in ROM file)
     void setIOPortMask(uint8_t chipIndex, uint8_t mask);
 
+    // Edge-triggered notification of CPU writes changing an I/O port (port = chip index)
+    void addIOPortListener(IOPortListener listener) { m_ioNotifier.addListener(std::move(listener)); }
+    void clearIOPortListeners() { m_ioNotifier.clearListeners(); }
+    void setCycleCounter(const uint64_t* cycleCounter) { m_ioNotifier.setCycleCounter(cycleCounter); }
+    const uint64_t* getCycleCounter() const { return m_ioNotifier.getCycleCounter(); }
+
     const uint8_t* getRomContents() const { return m_rom; }
+
     uint8_t getIOPort(uint8_t idx) const { return m_ioPorts[idx]; }
     uint8_t getIOPortMask(uint8_t idx) const { return m_ioPortsMasks[idx]; }
     uint8_t getSrcAddress() const { return m_srcAddress; }
@@ -38,4 +92,14 @@ private:
     uint8_t m_rom[ROM_SIZE];
     uint8_t m_ioPorts[NUM_ROM_CHIPS];
     uint8_t m_ioPortsMasks[NUM_ROM_CHIPS];
+    IOPortNotifier m_ioNotifier;
+
+    void refreshProgramBytes(uint16_t address, uint16_t length);
+
+    uint8_t m_loadedProgram[ROM_SIZE];  // 4001 contents under program RAM pages
+    K4289* m_programMemory;             // Not owned
+    K4702* m_eproms[NUM_ROM_CHIPS];     // Per page, not owned
+    uint64_t m_codeWrites;
+    uint64_t m_pageWriteStamps[NUM_ROM_CHIPS];
+    uint64_t m_blockWriteStamps[NUM_CODE_BLOCKS];
 };
@@ -0,0 +1,134 @@
+#include <gtest/gtest.h>
+#include "emulator_core/source/busicom_calculator.hpp"
+
+#include <memory>
+#include <string>
+#include <vector>
+
+class BusicomCalculatorTest : public ::testing::Test {
+protected:
+    void SetUp() override {
+        ASSERT_TRUE(calculator.loadROMFile("../programs/busicom/busicom_141-PF.obj"));
+        ASSERT_TRUE(calculator.runUntilIdle());
+    }
+
+    const PrinterLine& lastLine() {
+        return calculator.getPrintedLines().back();
+    }
+
+    BusicomCalculator calculator;
+};
+
+// Test key scripts translate to scan codes, numbers digit by digit
+TEST(BusicomCalculatorKeysTest, ParseKeys) {
+    std::vector<uint8_t> scanCodes;
+    ASSERT_TRUE(BusicomCalculator::parseKeys("12.5 * 4 =", scanCodes));
+    EXPECT_EQ(scanCodes, (std::vector<uint8_t>{ 0x9b, 0x97, 0x94, 0x96, 0x8b, 0x9a, 0x8c }));
+
+    scanCodes.clear();
+    ASSERT_TRUE(BusicomCalculator::parseKeys("  2+3+=  SQRT 000 M=+\n", scanCodes));
+    EXPECT_EQ(scanCodes, (std::vector<uint8_t>{ 0x97, 0x8e, 0x93, 0x8e, 0x8c, 0x85, 0x90, 0x88 }));
+
+    scanCodes.clear();
+    EXPECT_FALSE(BusicomCalculator::parseKeys("2 ^ 3", scanCodes));
+}
+
+// Test the ROM boots into the idle main loop with a clean tape
+TEST_F(BusicomCalculatorTest, BootsIdle) {
+    EXPECT_TRUE(calculator.isIdle());
+    EXPECT_TRUE(calculator.getPrintedLines().empty());
+}
+
+// Test the adding machine prints each entry and the total
+TEST_F(BusicomCalculatorTest, Addition) {
+    ASSERT_TRUE(calculator.typeKeys("2 + 3 + ="));
+    const auto& lines = calculator.getPrintedLines();
+    ASSERT_EQ(lines.size(), 3u);
+    EXPECT_EQ(lines[0].getDigits(), "2");
+    EXPECT_EQ(lines[0].getSymbols(), "+");
+    EXPECT_EQ(lines[1].getDigits(), "3");
+    EXPECT_EQ(lines[2].getDigits(), "5");
+    EXPECT_EQ(lines[2].getSymbols(), "*");
+    EXPECT_FALSE(lines[2].red);
+}
+
+// Test negative totals are printed in red
+TEST_F(BusicomCalculatorTest, NegativeTotalIsRed) {
+    ASSERT_TRUE(calculator.typeKeys("3 + 5 - ="));
+    EXPECT_EQ(lastLine().getDigits(), "2");
+    EXPECT_TRUE(lastLine().red);
+}
+
+// Test multiplication keeps the decimal point
+TEST_F(BusicomCalculatorTest, DecimalMultiplication) {
+    ASSERT_TRUE(calculator.typeKeys("12.5 * 4 ="));
+    EXPECT_EQ(lastLine().getDigits(), "50.0");
+    EXPECT_TRUE(lastLine().hasDecimalPoint);
+    EXPECT_EQ(lastLine().decimalPosition, 1u);
+}
+
+// Test division and square root use the full 15 digit register
+TEST_F(BusicomCalculatorTest, DivisionAndSquareRoot) {
+    ASSERT_TRUE(calculator.typeKeys("7 / 3 ="));
+    EXPECT_EQ(lastLine().getDigits(), "2.3333333333333");
+
+    calculator.reset();
+    calculator.clearPrintedLines();
+    ASSERT_TRUE(calculator.runUntilIdle());
+    ASSERT_TRUE(calculator.typeKeys("2 SQRT"));
+    EXPECT_EQ(lastLine().getDigits(), "1.4142135623730");
+    EXPECT_EQ(lastLine().getSymbols(), "SQRT");
+}
+
+// Test a reset calculator repeats a calculation cycle for cycle
+TEST_F(BusicomCalculatorTest, ResetIsDeterministic) {
+    ASSERT_TRUE(calculator.typeKeys("9 * 9 ="));
+    uint64_t cycles = calculator.getCycleCount();
+    std::string text(lastLine().getText());
+
+    calculator.reset();
+    ASSERT_TRUE(calculator.runUntilIdle());
+    ASSERT_TRUE(calculator.typeKeys("9 * 9 ="));
+    EXPECT_EQ(calculator.getCycleCount(), cycles);
+    EXPECT_EQ(lastLine().getText(), text);
+    EXPECT_EQ(lastLine().getDigits(), "81");
+}
+
+// Test a snapshot restores the machine so a calculation continues identically
+TEST_F(BusicomCalculatorTest, SnapshotRoundTrip) {
+    ASSERT_TRUE(calculator.boot());
+    auto snapshot = std::make_unique<BusicomCalculator::Snapshot>();
+    calculator.saveSnapshot(*snapshot);
+    EXPECT_EQ(snapshot->magic, BusicomCalculator::SNAPSHOT_MAGIC);
+    ASSERT_TRUE(calculator.typeKeys("12.5 * 4 ="));
+    uint64_t cycles = calculator.getCycleCount();
+
+    // A calculator without a ROM, started from the raw snapshot bytes
+    auto restored = std::make_unique<BusicomCalculator>();
+    ASSERT_TRUE(restored->loadSnapshot(reinterpret_cast<const uint8_t*>(snapshot.get()), sizeof(*snapshot)));
+    EXPECT_TRUE(restored->isIdle());
+    EXPECT_TRUE(restored->getPrintedLines().empty());
+    ASSERT_TRUE(restored->typeKeys("12.5 * 4 ="));
+    EXPECT_EQ(restored->getCycleCount(), cycles);
+    EXPECT_EQ(restored->getPrintedLines().back().getText(), lastLine().getText());
+
+    // Restoring over a used calculator drops its tape and state
+    ASSERT_TRUE(calculator.loadSnapshot(*snapshot));
+    EXPECT_TRUE(calculator.getPrintedLines().empty());
+    ASSERT_TRUE(calculator.typeKeys("2 + 3 + ="));
+    EXPECT_EQ(lastLine().getDigits(), "5");
+}
+
+// Test snapshots of another size or layout version are rejected
+TEST_F(BusicomCalculatorTest, SnapshotRejectsMismatch) {
+    auto snapshot = std::make_unique<BusicomCalculator::Snapshot>();
+    calculator.saveSnapshot(*snapshot);
+    const uint8_t* bytes = reinterpret_cast<const uint8_t*>(snapshot.get());
+
+    EXPECT_FALSE(calculator.loadSnapshot(nullptr, sizeof(*snapshot)));
+    EXPECT_FALSE(calculator.loadSnapshot(bytes, sizeof(*snapshot) - 1u));
+
+    snapshot->magic ^= 1u;
+    EXPECT_FALSE(calculator.loadSnapshot(*snapshot));
+    EXPECT_TRUE(calculator.isIdle());
+}
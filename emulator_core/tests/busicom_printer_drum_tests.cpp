@@ -0,0 +1,158 @@
+#include <gtest/gtest.h>
+#include "emulator_core/source/K4004.hpp"
+#include "emulator_core/source/busicom_printer_drum.hpp"
+#include "emulator_core/source/event_scheduler.hpp"
+#include "emulator_core/source/ram.hpp"
+#include "emulator_core/source/rom.hpp"
+
+#include <vector>
+
+class PrinterDrumTest : public ::testing::Test {
+protected:
+    void SetUp() override {
+        drum.setListener([this](const PrinterDrum::Signals& signals) {
+            edges.push_back({ scheduler.getCurrentCycle(), signals });
+        });
+    }
+
+    struct Edge {
+        uint64_t cycle;
+        PrinterDrum::Signals signals;
+    };
+
+    EventScheduler scheduler;
+    PrinterDrum drum{ scheduler, 92589u };
+    std::vector<Edge> edges;
+};
+
+// Test the default speed gives ~28 ms sectors and RPM converts to whole cycles
+TEST_F(PrinterDrumTest, SectorCyclesFromRPM) {
+    EXPECT_EQ(drum.getSectorCycles(), 2593u);
+    EXPECT_NEAR(drum.getRPM(), PrinterDrum::DEFAULT_RPM, 0.1);
+
+    drum.setRPM(60.0);  // One revolution per second
+    EXPECT_EQ(drum.getSectorCycles(), 7122u);
+
+    drum.setRPM(0.0);
+    drum.setRPM(-5.0);
+    EXPECT_EQ(drum.getSectorCycles(), 7122u);
+}
+
+// Test each sector is an inactive half followed by an active half, index only before row 0
+TEST_F(PrinterDrumTest, EdgesAreScheduledEvents) {
+    drum.setRPM(92589.0 * 60.0 / (100.0 * PrinterDrum::NUM_SECTORS));  // 100 cycles per sector
+    ASSERT_EQ(drum.getSectorCycles(), 100u);
+    drum.start(0u);
+
+    ASSERT_EQ(edges.size(), 1u);  // Signals of the start cycle
+    EXPECT_EQ(edges[0].signals.sector, 0u);
+    EXPECT_FALSE(edges[0].signals.sectorActive);
+    EXPECT_TRUE(edges[0].signals.index);
+    EXPECT_EQ(scheduler.getNextEventCycle(), 50u);
+
+    scheduler.advanceTo(100u * PrinterDrum::NUM_SECTORS + 50u);
+    ASSERT_EQ(edges.size(), 1u + 2u * PrinterDrum::NUM_SECTORS + 1u);
+    for (size_t i = 1u; i < edges.size(); ++i) {
+        const Edge& edge = edges[i];
+        EXPECT_EQ(edge.cycle, i * 50u);
+        EXPECT_EQ(edge.signals.sector, (i / 2u) % PrinterDrum::NUM_SECTORS);
+        EXPECT_EQ(edge.signals.sectorActive, i % 2u == 1u);
+        EXPECT_EQ(edge.signals.index, edge.signals.sector == 0u && !edge.signals.sectorActive);
+    }
+
+    drum.stop();
+    EXPECT_FALSE(scheduler.hasPendingEvents());
+}
+
+// Test a speed change keeps the current sector and continues from its start
+TEST_F(PrinterDrumTest, SpeedChangeKeepsSector) {
+    drum.start(0u);
+    scheduler.advanceTo(3u * 2593u + 100u);
+    EXPECT_EQ(drum.getSignals().sector, 3u);
+
+    drum.setRPM(PrinterDrum::DEFAULT_RPM / 2.0);
+    EXPECT_EQ(drum.getSectorCycles(), 5186u);
+    EXPECT_EQ(drum.getSignals().sector, 3u);
+    EXPECT_EQ(scheduler.getNextEventCycle(), 3u * 2593u + 2593u);
+    EXPECT_EQ(drum.getSignalsAt(3u * 2593u + 5186u).sector, 4u);
+}
+
+// Test a restored state continues the same rotation from the current cycle
+TEST_F(PrinterDrumTest, StateRoundTrip) {
+    drum.start(1000u, 5u);
+    PrinterDrum::State state;
+    drum.saveState(state);
+
+    EventScheduler otherScheduler;
+    otherScheduler.advanceTo(1000u + 2u * 2593u + 1500u);
+    PrinterDrum other(otherScheduler, 92589u);
+    other.loadState(state);
+
+    EXPECT_EQ(other.getSignals().sector, 7u);
+    EXPECT_TRUE(other.getSignals().sectorActive);
+    EXPECT_EQ(otherScheduler.getNextEventCycle(), 1000u + 3u * 2593u);
+}
+
+class TestWaitLoopTest : public ::testing::Test {
+protected:
+    void SetUp() override {
+        // 000: jcn TZ $000 (wait while TEST is high), 002: jun $002
+        const uint8_t objectCode[] = { 0xFE, 0xFF, 0x19, 0x00, 0x40, 0x02 };
+        ASSERT_TRUE(rom.load(objectCode, sizeof(objectCode)));
+        cpu.setScheduler(&scheduler);
+        cpu.setTest(1u);
+    }
+
+    ROM rom;
+    RAM ram;
+    K4004 cpu{ rom, ram };
+    EventScheduler scheduler;
+};
+
+// Test a TEST wait loop is fast-forwarded to the event that changes TEST
+TEST_F(TestWaitLoopTest, SkipsToNextEvent) {
+    EXPECT_TRUE(cpu.isWaitingForTest());
+    scheduler.schedule(1001u, [this](uint64_t) { cpu.setTest(0u); });
+
+    EXPECT_EQ(cpu.skipTestWait(UINT64_MAX), 1002u);  // 501 whole JCN iterations
+    EXPECT_EQ(cpu.getCycleCount(), 1002u);
+    EXPECT_EQ(cpu.getPC(), 0x000u);
+    EXPECT_FALSE(cpu.isWaitingForTest());
+
+    cpu.clock();
+    EXPECT_EQ(cpu.getPC(), 0x002u);
+    EXPECT_EQ(cpu.getSkippedCycles(), 1002u);
+}
+
+// Test skipping gives the same result as stepping every iteration
+TEST_F(TestWaitLoopTest, MatchesStepping) {
+    ROM steppedRom;
+    RAM steppedRam;
+    const uint8_t objectCode[] = { 0xFE, 0xFF, 0x19, 0x00, 0x40, 0x02 };
+    ASSERT_TRUE(steppedRom.load(objectCode, sizeof(objectCode)));
+    K4004 stepped(steppedRom, steppedRam);
+    stepped.setTest(1u);
+
+    scheduler.schedule(777u, [this](uint64_t) { cpu.setTest(0u); });
+    cpu.runUntil(2000u);
+    while (stepped.getCycleCount() < 2000u) {
+        stepped.clock();
+        if (stepped.getCycleCount() >= 777u)
+            stepped.setTest(0u);
+    }
+
+    EXPECT_EQ(cpu.getCycleCount(), stepped.getCycleCount());
+    EXPECT_EQ(cpu.getPC(), stepped.getPC());
+    EXPECT_GT(cpu.getSkippedCycles(), 0u);
+}
+
+// Test nothing is skipped without a pending event or outside a wait loop
+TEST_F(TestWaitLoopTest, OnlySkipsRealWaits) {
+    EXPECT_EQ(cpu.skipTestWait(UINT64_MAX), 0u);
+    EXPECT_EQ(cpu.skipTestWait(100u), 100u);  // Bounded by the limit instead
+
+    cpu.setTest(0u);
+    EXPECT_FALSE(cpu.isWaitingForTest());
+    scheduler.schedule(5000u, [](uint64_t) {});
+    EXPECT_EQ(cpu.skipTestWait(UINT64_MAX), 0u);
+}
@@ -0,0 +1,134 @@
+#include <gtest/gtest.h>
+#include "emulator_core/source/busicom_peripherals.hpp"
+#include "emulator_core/source/busicom_printer_sink.hpp"
+
+#include <cstdio>
+#include <fstream>
+#include <iterator>
+#include <string>
+#include <vector>
+
+namespace {
+
+PrinterLine makeLine(std::string_view digits, std::string_view symbols, bool red = false)
+{
+    PrinterLine line{};
+    for (char c : digits)
+        line.digits[line.digitCount++] = c;
+    for (char c : symbols)
+        line.symbols[line.symbolsLength++] = c;
+    line.red = red;
+    return line;
+}
+
+std::string readFile(const std::string& filename)
+{
+    std::ifstream fin(filename);
+    return std::string(std::istreambuf_iterator<char>(fin), std::istreambuf_iterator<char>());
+}
+
+} // namespace
+
+// Test the compact form used by files and busicom_batch
+TEST(PrinterSinkTest, FormatLine) {
+    char text[PrinterLine::MAX_TEXT];
+    EXPECT_EQ(formatPrinterLine(makeLine("12.5", "X"), text, sizeof(text)), 6u);
+    EXPECT_STREQ(text, "12.5 X");
+
+    formatPrinterLine(makeLine("2", "*", true), text, sizeof(text));
+    EXPECT_STREQ(text, "-2 *");
+
+    formatPrinterLine(makeLine("", "C"), text, sizeof(text));
+    EXPECT_STREQ(text, "C");
+
+    EXPECT_EQ(formatPrinterLine(makeLine("12345", ""), text, 4u), 3u);
+    EXPECT_STREQ(text, "123");
+}
+
+// Test the ring keeps the newest lines in order and counts what it dropped
+TEST(PrinterSinkTest, RingKeepsNewestLines) {
+    PrinterRingSink ring(3u);
+    EXPECT_TRUE(ring.empty());
+
+    for (char digit = '1'; digit <= '5'; ++digit)
+        ring.onLine(makeLine(std::string(1, digit), "+"));
+
+    ASSERT_EQ(ring.size(), 3u);
+    EXPECT_EQ(ring[0].getDigits(), "3");
+    EXPECT_EQ(ring[1].getDigits(), "4");
+    EXPECT_EQ(ring.back().getDigits(), "5");
+    EXPECT_EQ(ring.getTotalLines(), 5u);
+    EXPECT_EQ(ring.getDroppedLines(), 2u);
+
+    ring.clear();
+    EXPECT_TRUE(ring.empty());
+    ring.onLine(makeLine("7", ""));
+    EXPECT_EQ(ring.back().getDigits(), "7");
+}
+
+// Test the file sink writes only when its buffer fills or on flush
+TEST(PrinterSinkTest, FileSinkBuffers) {
+    std::string filename = ::testing::TempDir() + "printer_sink_test.txt";
+    {
+        PrinterFileSink sink(filename, 40u);
+        ASSERT_TRUE(sink.isOpen());
+
+        sink.onLine(makeLine("2", "+"));
+        EXPECT_EQ(readFile(filename), "");
+
+        sink.onLine(makeLine("3", "+"));
+        sink.onLine(makeLine("5", "*", true));
+        EXPECT_EQ(readFile(filename), "2 +\n3 +\n");  // Less than a full line was left for the third
+
+        sink.flush();
+        EXPECT_EQ(readFile(filename), "2 +\n3 +\n-5 *\n");
+        sink.onLine(makeLine("9", "="));
+    }
+    EXPECT_EQ(readFile(filename), "2 +\n3 +\n-5 *\n9 =\n");
+    std::remove(filename.c_str());
+
+    PrinterFileSink missing(::testing::TempDir() + "no/such/dir/out.txt");
+    EXPECT_FALSE(missing.isOpen());
+    missing.onLine(makeLine("1", ""));
+}
+
+// Test the peripherals decode a fired line once and hand it to every sink
+TEST(PrinterSinkTest, PeripheralsEmitToSinks) {
+    BusicomPeripherals peripherals;
+    PrinterRingSink ring(4u);
+    std::vector<std::string> forwarded;
+    PrinterCallbackSink callback([&forwarded](const PrinterLine& line) { forwarded.emplace_back(line.getText()); });
+    peripherals.addPrinterSink(ring);
+    peripherals.addPrinterSink(callback);
+    peripherals.addPrinterSink(ring);  // Registered once only
+
+    // Hammer for the rightmost digit column (shifter bit 17) fires while row 7 passes
+    auto shiftBit = [&peripherals](bool bit) {
+        uint8_t data = bit ? 0b0010u : 0u;
+        peripherals.updateShiftRegister(data);
+        peripherals.updateShiftRegister(data | 0b0100u);
+    };
+    shiftBit(true);
+    for (int i = 0; i < 17; ++i)
+        shiftBit(false);
+    peripherals.setPrinterSector(7u);
+    peripherals.updatePrinterControl(0b0001u);  // Red ribbon
+    peripherals.updatePrinterControl(0b0010u);  // Fire
+    peripherals.updatePrinterControl(0b0000u);
+    peripherals.updatePrinterControl(0b1000u);  // Advance paper
+
+    ASSERT_EQ(ring.size(), 1u);
+    EXPECT_EQ(ring[0].getDigits(), "7");
+    EXPECT_EQ(ring[0].getText(), "              7");
+    EXPECT_TRUE(ring[0].red);
+    ASSERT_EQ(forwarded.size(), 1u);
+    EXPECT_EQ(forwarded[0], "              7");
+    EXPECT_EQ(peripherals.getPrinterOutput().digits, "7");
+
+    peripherals.removePrinterSink(callback);
+    peripherals.updatePrinterControl(0b0000u);
+    peripherals.updatePrinterControl(0b0010u);
+    peripherals.updatePrinterControl(0b1000u);
+    EXPECT_EQ(ring.size(), 2u);
+    EXPECT_EQ(forwarded.size(), 1u);
+}
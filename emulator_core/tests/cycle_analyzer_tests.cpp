@@ -0,0 +1,176 @@
+#include <gtest/gtest.h>
+#include "emulator_core/source/cycle_analyzer.hpp"
+#include "emulator_core/source/emulator.hpp"
+#include "emulator_core/source/instructions.hpp"
+#include "assembler/source/assembler.hpp"
+
+#include <string>
+#include <vector>
+
+// Static Cycle Analysis Tests
+// Routines are assembled from source and analyzed without the metal mask header
+
+class CycleAnalyzerTest : public ::testing::Test {
+protected:
+    void analyze(const std::string& source) {
+        Assembler assembler;
+        bytecode.clear();
+        ASSERT_TRUE(assembler.assemble(std::string_view(source), bytecode)) << assembler.getError();
+        bytecode.erase(bytecode.begin(), bytecode.begin() + 2);
+        analyzer.analyze(bytecode.data(), bytecode.size());
+    }
+
+    const CycleAnalyzer::Routine& routine(uint16_t entry) {
+        const CycleAnalyzer::Routine* found = analyzer.findRoutine(entry);
+        EXPECT_NE(found, nullptr) << entry;
+        static const CycleAnalyzer::Routine none{};
+        return found != nullptr ? *found : none;
+    }
+
+    CycleAnalyzer analyzer;
+    std::vector<uint8_t> bytecode;
+};
+
+TEST_F(CycleAnalyzerTest, BranchesGiveBestAndWorstExits) {
+    analyze("      LDM 3\n"         // $00  1
+            "      JCN %0100, ZERO\n" // $01  2
+            "      FIM P0, $12\n"   // $03  2
+            "      BBL 1\n"         // $05  1
+            "ZERO  BBL 0\n");       // $06  1
+
+    const CycleAnalyzer::Routine& main = routine(0x000u);
+    EXPECT_TRUE(main.problem.empty()) << main.problem;
+    EXPECT_EQ(main.best, 4u);
+    EXPECT_EQ(main.worst, 6u);
+    ASSERT_EQ(main.exits.size(), 2u);
+    EXPECT_EQ(main.exits[0].address, 0x005u);
+    EXPECT_EQ(main.exits[0].best, 6u);
+    EXPECT_EQ(main.exits[0].worst, 6u);
+    EXPECT_EQ(main.exits[1].address, 0x006u);
+    EXPECT_EQ(main.exits[1].worst, 4u);
+}
+
+TEST_F(CycleAnalyzerTest, CallsAddTheCalleeCycles) {
+    analyze("      JMS WORK\n"      // $00  2
+            "      JMS WORK\n"      // $02  2
+            "      BBL 0\n"         // $04  1
+            "WORK  JCN %0010, DONE\n" // $05  2
+            "      IAC\n"           // $07  1
+            "DONE  BBL 0\n");       // $08  1
+
+    ASSERT_EQ(analyzer.getRoutines().size(), 2u);
+    const CycleAnalyzer::Routine& work = routine(0x005u);
+    EXPECT_EQ(work.best, 3u);
+    EXPECT_EQ(work.worst, 4u);
+
+    const CycleAnalyzer::Routine& main = routine(0x000u);
+    EXPECT_EQ(main.callees, std::vector<uint16_t>{ 0x005u });
+    EXPECT_EQ(main.best, 2u + 3u + 2u + 3u + 1u);
+    EXPECT_EQ(main.worst, 2u + 4u + 2u + 4u + 1u);
+}
+
+TEST_F(CycleAnalyzerTest, LoopsRunToTheirBounds) {
+    const std::string source = "      FIM P0, $0C\n"  // $00  2
+                               "LOOP  LD R1\n"        // $02  1
+                               "      ADD R2\n"       // $03  1
+                               "      XCH R2\n"       // $04  1
+                               "      ISZ R1, LOOP\n" // $05  2
+                               "      BBL 0\n";       // $07  1
+    analyze(source);
+
+    // Counted by ISZ on a register only it writes: up to 16 times
+    const CycleAnalyzer::Routine& counted = routine(0x000u);
+    EXPECT_TRUE(counted.problem.empty()) << counted.problem;
+    EXPECT_EQ(counted.best, 2u + 5u + 1u);
+    EXPECT_EQ(counted.worst, 2u + 16u * 5u + 1u);
+
+    // The annotation knows better
+    analyzer.setLoopBound(0x002u, 4u);
+    analyze(source);
+    EXPECT_EQ(routine(0x000u).worst, 2u + 4u * 5u + 1u);
+
+    // Without one a loop counting on a register it also writes has no bound
+    analyzer.clear();
+    analyze("LOOP  INC R1\n"
+            "      ISZ R1, LOOP\n"
+            "      BBL 0\n");
+    const CycleAnalyzer::Routine& unknown = routine(0x000u);
+    EXPECT_EQ(unknown.worst, CycleAnalyzer::UNBOUNDED);
+    EXPECT_EQ(unknown.problem, "loop at $000 without a bound");
+    EXPECT_EQ(unknown.best, 4u);
+}
+
+TEST_F(CycleAnalyzerTest, NestedLoopsMultiply) {
+    analyzer.setLoopBound(0x000u, 3u);
+    analyze("OUTER FIM P0, $E0\n"   // $00  2
+            "INNER ISZ R0, INNER\n" // $02  2, twice
+            "      IAC\n"           // $04  1
+            "      JCN %0001, OUTER\n" // $05  2
+            "      BBL 0\n");       // $07  1
+
+    const CycleAnalyzer::Routine& main = routine(0x000u);
+    EXPECT_TRUE(main.problem.empty()) << main.problem;
+    // Inner bound 16 holds however many times it really runs
+    EXPECT_EQ(main.worst, 3u * (2u + 16u * 2u + 1u + 2u) + 1u);
+    EXPECT_EQ(main.best, 2u + 2u + 1u + 2u + 1u);
+}
+
+TEST_F(CycleAnalyzerTest, UnprovenRoutinesSayWhy) {
+    analyze("      JMS SELF\n"
+            "      BBL 0\n"
+            "SELF  JCN %0010, DONE\n"
+            "      JMS SELF\n"
+            "DONE  BBL 0\n");
+    EXPECT_EQ(routine(0x003u).problem, "recursive call to $003 at $005");
+    EXPECT_EQ(routine(0x003u).best, 3u);
+    EXPECT_EQ(routine(0x000u).problem, "call to $003 without a bound at $000");
+
+    analyzer.clear();
+    analyze("      FIM P0, $00\n"
+            "      JIN P0\n");
+    EXPECT_EQ(routine(0x000u).problem, "indirect jump at $002");
+
+    analyze("LOOP  JUN LOOP\n");
+    EXPECT_EQ(routine(0x000u).problem, "never returns");
+    EXPECT_EQ(routine(0x000u).best, CycleAnalyzer::UNBOUNDED);
+
+    analyzer.clear();
+    analyze("      HLT\n"      // $00  1, then on after the interrupt
+            "      BBL 0\n");  // $01  1
+    EXPECT_EQ(routine(0x000u).problem, "halt at $000 waits without a bound");
+    EXPECT_EQ(routine(0x000u).best, 2u);
+    EXPECT_EQ(routine(0x000u).worst, CycleAnalyzer::UNBOUNDED);
+}
+
+// A run takes its path, it must be within what every path can take
+TEST_F(CycleAnalyzerTest, RunsFallBetweenBestAndWorst) {
+    const std::string routines = "*=$80\n"
+                                 "SUM   FIM P1, $00\n"
+                                 "LOOP  LD R1\n"
+                                 "      JCN %0100, SKIP\n"
+                                 "      ADD R2\n"
+                                 "      XCH R2\n"
+                                 "SKIP  ISZ R1, LOOP\n"
+                                 "      BBL 0\n";
+    analyze("      JMS SUM\n"
+            "DONE  JUN DONE\n" + routines);
+    const CycleAnalyzer::Routine& sum = routine(0x080u);
+    ASSERT_TRUE(sum.problem.empty()) << sum.problem;
+
+    for (unsigned start = 0u; start < 16u; start += 5u) {
+        std::string source = "      FIM P0, " + std::to_string(start * 17u) + "\n"
+                             "      JMS SUM\n"
+                             "DONE  JUN DONE\n" + routines;
+        Emulator emulator;
+        ASSERT_TRUE(emulator.loadProgramFromSourceText(source)) << emulator.getAssemblerError();
+        emulator.reset();
+        while (emulator.getCPU().getPC() != 0x080u)
+            emulator.step();
+        uint64_t cycles = emulator.getCPU().getCycleCount();
+        while (emulator.getCPU().getPC() != 0x004u)
+            emulator.step();
+        cycles = emulator.getCPU().getCycleCount() - cycles;
+        EXPECT_GE(cycles, sum.best) << start;
+        EXPECT_LE(cycles, sum.worst) << start;
+    }
+}
@@ -1,6 +1,10 @@
 #include <gtest/gtest.h>
 #include <cstring>
+#include <vector>
 #include "emulator_core/source/K4004.hpp"
+#include "emulator_core/source/K4040.hpp"
+#include "emulator_core/source/event_scheduler.hpp"
+#include "emulator_core/source/instructions.hpp"
 #include "emulator_core/source/ram.hpp"
 #include "emulator_core/source/rom.hpp"
 #include "shared/source/assembly.hpp"
@@ -260,3 +264,303 @@ TEST_F(CycleTimingTest, MixedSingleAndDouble_Cycles) {
 
     EXPECT_EQ(getCycles(), 6u);  // 1+2+1+2 = 6 cycles
 }
+
+// Static analysis (CycleAnalyzer) and the assembler take cycles from the table
+TEST_F(CycleTimingTest, InstructionTable_MatchesClock) {
+    for (const AsmInsDesc& desc : ASM_INSTRUCTIONS) {
+        program[0] = desc.byte;
+        SetUp();
+        if (desc.byte >= 0x10u || desc.byte == +AsmIns::NOP) {
+            executeSingleInstruction();
+            EXPECT_EQ(getCycles(), desc.cycles) << desc.name;
+        }
+
+        K4040 cpu4040(rom, ram);
+        EXPECT_EQ(cpu4040.step(), desc.cycles) << desc.name;
+    }
+}
+
+// ============================================================================
+// Closed-Form Counter Loops
+// ============================================================================
+
+namespace {
+
+// 000: fim 0< $03, 002: nop, nop, isz 1 $002 (13 x 4 cycles), 006: isz 0 $006 (16 x 2 cycles), 008: jun $008
+const uint8_t COUNTER_LOOPS[] = { 0xFE, 0xFF, 0x20, 0x03, 0x00, 0x00, 0x71, 0x02, 0x70, 0x06, 0x40, 0x08 };
+
+struct CounterLoopRun {
+    uint64_t cycles;
+    uint16_t pc;
+    uint8_t pair0;
+    uint64_t eventCycle;  // CPU cycle count when the event at cycle 21 fired
+    uint64_t skipped;
+};
+
+CounterLoopRun runCounterLoops(uint64_t cycle, bool fastForward)
+{
+    ROM rom;
+    RAM ram;
+    rom.load(COUNTER_LOOPS, sizeof(COUNTER_LOOPS));
+    K4004 cpu(rom, ram);
+    EventScheduler scheduler;
+    cpu.setScheduler(&scheduler);
+
+    CounterLoopRun run{};
+    scheduler.schedule(21u, [&](uint64_t) { run.eventCycle = cpu.getCycleCount(); });
+    if (fastForward) {
+        cpu.runUntil(cycle);
+    }
+    else {
+        while (cpu.getCycleCount() < cycle)
+            cpu.clock();
+    }
+
+    run.cycles = cpu.getCycleCount();
+    run.pc = cpu.getPC();
+    run.pair0 = cpu.getRegisters()[0];
+    run.skipped = cpu.getSkippedCycles();
+    return run;
+}
+
+} // namespace
+
+TEST(CounterLoopTest, MatchesStepping) {
+    for (uint64_t cycle : { 1u, 10u, 21u, 40u, 54u, 70u, 86u, 100u }) {
+        CounterLoopRun stepped = runCounterLoops(cycle, false);
+        CounterLoopRun skipped = runCounterLoops(cycle, true);
+        EXPECT_EQ(skipped.cycles, stepped.cycles) << cycle;
+        EXPECT_EQ(skipped.pc, stepped.pc) << cycle;
+        EXPECT_EQ(skipped.pair0, stepped.pair0) << cycle;
+        EXPECT_EQ(skipped.eventCycle, stepped.eventCycle) << cycle;
+    }
+
+    CounterLoopRun done = runCounterLoops(100u, true);
+    EXPECT_EQ(done.pc, 0x008u);
+    EXPECT_EQ(done.pair0, 0x00u);
+    EXPECT_EQ(done.cycles, 2u + 13u * 4u + 16u * 2u + 2u * 7u);
+    EXPECT_GT(done.skipped, 60u);
+}
+
+TEST(CounterLoopTest, OnlyPureCounterLoops) {
+    // 000: nop, iac, isz 0 $000 (body changes ACC), 004: isz 1 $000 (jumps elsewhere)
+    const uint8_t objectCode[] = { 0xFE, 0xFF, 0x00, 0xF2, 0x70, 0x00, 0x71, 0x00 };
+    ROM rom;
+    RAM ram;
+    ASSERT_TRUE(rom.load(objectCode, sizeof(objectCode)));
+    K4004 cpu(rom, ram);
+
+    EXPECT_FALSE(cpu.isCounterLoop());
+    EXPECT_EQ(cpu.skipCounterLoop(UINT64_MAX), 0u);
+    cpu.clock();
+    cpu.clock();
+    EXPECT_EQ(cpu.getPC(), 0x002u);
+    EXPECT_FALSE(cpu.isCounterLoop());
+
+    // A loop is left alone once its limit is reached
+    const uint8_t selfLoop[] = { 0xFE, 0xFF, 0x70, 0x00 };
+    ASSERT_TRUE(rom.load(selfLoop, sizeof(selfLoop)));
+    cpu.reset();
+    EXPECT_TRUE(cpu.isCounterLoop());
+    EXPECT_EQ(cpu.skipCounterLoop(7u), 6u);
+    EXPECT_EQ(cpu.getRegisters()[0], 0x30u);
+    EXPECT_EQ(cpu.skipCounterLoop(7u), 0u);
+    EXPECT_EQ(cpu.skipCounterLoop(UINT64_MAX), 26u);
+    EXPECT_EQ(cpu.getPC(), 0x002u);
+}
+
+// ============================================================================
+// Macro-Op Fusion
+// ============================================================================
+
+namespace {
+
+// 000: fim 1< $25, 002: src 1<, rdm, iac, wrm, ld 2, add 5, xch 0, xch 1, clb, xch 3, 00c: jun $002
+// The loop jumps back into the second instruction of the FIM/SRC pair
+const uint8_t FUSABLE_PAIRS[] = {
+    0xFE, 0xFF, 0x22, 0x25, 0x23, 0xE9, 0xF2, 0xE0, 0xA2, 0x85, 0xB0, 0xB1, 0xF0, 0xB3, 0x40, 0x02,
+};
+
+struct FusedRun {
+    uint64_t cycles;
+    uint16_t pc;
+    uint8_t acc;
+    uint8_t registers[K4004::REGISTERS_SIZE];
+    uint8_t ram[RAM::RAM_SIZE];
+    uint64_t eventCycle;  // CPU cycle count when the event fired
+    uint64_t fusedPairs;
+};
+
+FusedRun runFusablePairs(uint64_t cycle, uint64_t eventCycle, bool fused)
+{
+    ROM rom;
+    RAM ram;
+    rom.load(FUSABLE_PAIRS, sizeof(FUSABLE_PAIRS));
+    K4004 cpu(rom, ram);
+    EventScheduler scheduler;
+    cpu.setScheduler(&scheduler);
+
+    FusedRun run{};
+    scheduler.schedule(eventCycle, [&](uint64_t) { run.eventCycle = cpu.getCycleCount(); });
+    if (fused) {
+        cpu.runUntil(cycle);
+    }
+    else {
+        while (cpu.getCycleCount() < cycle)
+            cpu.clock();
+    }
+
+    run.cycles = cpu.getCycleCount();
+    run.pc = cpu.getPC();
+    run.acc = cpu.getACC();
+    std::memcpy(run.registers, cpu.getRegisters(), K4004::REGISTERS_SIZE);
+    std::memcpy(run.ram, ram.getRamContents(), RAM::RAM_SIZE);
+    run.fusedPairs = cpu.getFusedPairs();
+    return run;
+}
+
+} // namespace
+
+TEST(MacroOpFusionTest, MatchesStepping) {
+    for (uint64_t eventCycle = 1u; eventCycle <= 20u; ++eventCycle) {
+        for (uint64_t cycle : { 1u, 3u, 7u, 15u, 300u }) {
+            FusedRun stepped = runFusablePairs(cycle, eventCycle, false);
+            FusedRun fused = runFusablePairs(cycle, eventCycle, true);
+            EXPECT_EQ(fused.cycles, stepped.cycles) << cycle;
+            EXPECT_EQ(fused.pc, stepped.pc) << cycle;
+            EXPECT_EQ(fused.acc, stepped.acc) << cycle;
+            EXPECT_EQ(std::memcmp(fused.registers, stepped.registers, K4004::REGISTERS_SIZE), 0) << cycle;
+            EXPECT_EQ(std::memcmp(fused.ram, stepped.ram, RAM::RAM_SIZE), 0) << cycle;
+            EXPECT_EQ(fused.eventCycle, stepped.eventCycle) << eventCycle << " " << cycle;
+        }
+    }
+
+    // FIM/SRC once, then SRC/RDM, LD/ADD, XCH/XCH and CLB/XCH every iteration
+    FusedRun fused = runFusablePairs(300u, 1u, true);
+    EXPECT_GT(fused.fusedPairs, 4u * 300u / 14u);
+    EXPECT_EQ(runFusablePairs(300u, 1u, false).fusedPairs, 0u);
+}
+
+TEST(MacroOpFusionTest, RebuildsAfterLoad) {
+    ROM rom;
+    RAM ram;
+    ASSERT_TRUE(rom.load(FUSABLE_PAIRS, sizeof(FUSABLE_PAIRS)));
+    K4004 cpu(rom, ram);
+
+    EXPECT_EQ(cpu.clockFused(UINT64_MAX), 3u);  // FIM + SRC
+    EXPECT_EQ(cpu.getPC(), 0x003u);
+    EXPECT_EQ(cpu.getIR(), 0x23u);
+
+    // Same address, now ld 2 / nop: nothing to fuse
+    const uint8_t objectCode[] = { 0xFE, 0xFF, 0xA2, 0x00 };
+    ASSERT_TRUE(rom.load(objectCode, sizeof(objectCode)));
+    cpu.reset();
+    EXPECT_EQ(cpu.clockFused(UINT64_MAX), 1u);
+    EXPECT_EQ(cpu.getFusedPairs(), 0u);
+}
+
+// ============================================================================
+// Superblock Traces
+// ============================================================================
+
+namespace {
+
+// 000: fim 0< $00, 002: jms $010, isz 1 $002, iac, jun $002
+// 010: ld 1, jcn AZ $015, add 0, xch 0, 015: bbl 0
+// The hot path through the subroutine leaves at the JCN once every 16 calls
+const uint8_t CALL_LOOP[] = {
+    0xFE, 0xFF, 0x20, 0x00, 0x50, 0x10, 0x71, 0x02, 0xF2, 0x40, 0x02, 0x00,
+    0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0xA1, 0x14, 0x15, 0x80, 0xB0, 0xC0,
+};
+
+struct TracedRun {
+    uint64_t cycles;
+    uint16_t pc;
+    uint8_t acc;
+    uint8_t registers[K4004::REGISTERS_SIZE];
+    std::vector<uint64_t> eventCycles;  // CPU cycle count whenever the periodic event fired
+    size_t traces;
+    uint64_t tracedInstructions;
+};
+
+TracedRun runCallLoop(uint64_t cycle, bool traced)
+{
+    ROM rom;
+    RAM ram;
+    rom.load(CALL_LOOP, sizeof(CALL_LOOP));
+    K4004 cpu(rom, ram);
+    EventScheduler scheduler;
+    cpu.setScheduler(&scheduler);
+
+    TracedRun run{};
+    scheduler.schedulePeriodic(37u, 37u, [&](uint64_t) { run.eventCycles.push_back(cpu.getCycleCount()); });
+    if (traced) {
+        cpu.runUntil(cycle);
+    }
+    else {
+        while (cpu.getCycleCount() < cycle)
+            cpu.clock();
+    }
+
+    run.cycles = cpu.getCycleCount();
+    run.pc = cpu.getPC();
+    run.acc = cpu.getACC();
+    std::memcpy(run.registers, cpu.getRegisters(), K4004::REGISTERS_SIZE);
+    run.traces = cpu.getTraceCount();
+    run.tracedInstructions = cpu.getTracedInstructions();
+    return run;
+}
+
+} // namespace
+
+TEST(SuperblockTraceTest, MatchesStepping) {
+    for (uint64_t cycle : { 100u, 1001u, 5000u, 5003u }) {
+        TracedRun stepped = runCallLoop(cycle, false);
+        TracedRun traced = runCallLoop(cycle, true);
+        EXPECT_EQ(traced.cycles, stepped.cycles) << cycle;
+        EXPECT_EQ(traced.pc, stepped.pc) << cycle;
+        EXPECT_EQ(traced.acc, stepped.acc) << cycle;
+        EXPECT_EQ(std::memcmp(traced.registers, stepped.registers, K4004::REGISTERS_SIZE), 0) << cycle;
+        EXPECT_EQ(traced.eventCycles, stepped.eventCycles) << cycle;
+    }
+
+    TracedRun traced = runCallLoop(5000u, true);
+    EXPECT_GT(traced.traces, 0u);
+    EXPECT_GT(traced.tracedInstructions, 1000u);
+}
+
+TEST(SuperblockTraceTest, FollowsCallsAndDropsOnLoad) {
+    ROM rom;
+    RAM ram;
+    ASSERT_TRUE(rom.load(CALL_LOOP, sizeof(CALL_LOOP)));
+    K4004 cpu(rom, ram);
+
+    cpu.runUntil(2000u);
+    ASSERT_GT(cpu.getTraceCount(), 0u);
+    uint64_t runs = cpu.getTraceRuns();
+    EXPECT_GT(runs, 0u);
+
+    // jms, ld, jcn, add, xch, bbl, isz in one run
+    while (cpu.getPC() != 0x002u || getRegisterValue(cpu.getRegisters(), 1u) == 0u)
+        cpu.clock();
+    uint64_t instructions = cpu.getTracedInstructions();
+    cpu.runTrace(UINT64_MAX);
+    EXPECT_EQ(cpu.getTracedInstructions() - instructions, 7u);
+    EXPECT_EQ(cpu.getTraceRuns(), runs + 1u);
+
+    // Reloading the same bytes or another page keeps them, rewriting their page drops them
+    size_t traces = cpu.getTraceCount();
+    ASSERT_TRUE(rom.load(CALL_LOOP, sizeof(CALL_LOOP)));
+    const uint8_t otherPage[] = { 0x40, 0x00 };
+    ASSERT_TRUE(rom.loadPage(1u, otherPage, sizeof(otherPage)));
+    cpu.runTrace(cpu.getCycleCount());
+    EXPECT_EQ(cpu.getTraceCount(), traces);
+
+    std::vector<uint8_t> page(CALL_LOOP + 2u, CALL_LOOP + sizeof(CALL_LOOP));
+    page.back() = 0xC1u;  // bbl 1
+    ASSERT_TRUE(rom.loadPage(0u, page.data(), page.size()));
+    runs = cpu.getTraceRuns();
+    cpu.runTrace(UINT64_MAX);
+    EXPECT_EQ(cpu.getTraceRuns(), runs);  // Recorded again instead of replayed
+    EXPECT_EQ(cpu.getTraceCount(), 1u);
+}
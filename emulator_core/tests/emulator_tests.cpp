@@ -0,0 +1,78 @@
+#include <gtest/gtest.h>
+#include "emulator_core/source/emulator.hpp"
+#include "emulator_core/source/instructions.hpp"
+#include "assembler/source/assembler.hpp"
+
+#include <algorithm>
+#include <string>
+
+// Test generated source is assembled, loaded and run without touching files
+TEST(EmulatorTest, LoadsProgramFromSourceText) {
+    Emulator emulator;
+    for (unsigned value = 1u; value < 16u; value += 7u) {
+        std::string source = "      LDM " + std::to_string(value) + "\n"
+                             "      XCH R3\n"
+                             "DONE  JUN DONE\n";
+        ASSERT_TRUE(emulator.loadProgramFromSourceText(source)) << emulator.getAssemblerError();
+
+        emulator.reset();
+        emulator.step(3u);
+        EXPECT_EQ(getRegisterValue(emulator.getCPU().getRegisters(), 3u), value);
+        EXPECT_EQ(emulator.getCPU().getPC(), 0x002u);
+    }
+
+    EXPECT_FALSE(emulator.loadProgramFromSourceText("  JUN NOWHERE\n"));
+    EXPECT_EQ(emulator.getAssemblerError(), "line 1: undefined symbol 'NOWHERE'");
+}
+
+// Every peephole rule must leave registers, ACC and CY as the original code does
+TEST(EmulatorTest, OptimizedSequencesRunLikeTheOriginal) {
+    const char* sequences[][2] = {
+        { "LDM 5\n XCH R2\n LDM 9\n XCH R3\n LD R2\n", "" },
+        { "LDM 5\n XCH R7\n LDM 9\n XCH R6\n LDM 1\n", "" },
+        { "LD R4\n XCH R4\n", "" },
+        { "XCH R5\n XCH R5\n", "" },
+        { "IAC\n CLB\n", "" },
+        { "RAL\n CLB\n", "" },
+        { "DAA\n CLB\n", "" },
+        { "TCS\n CLB\n", "" },
+        { "LDM 3\n LD R1\n", "" },
+        { "JMS OUTER\n", "OUTER JMS INNER\n BBL 2\nINNER LDM 4\n JCN %0010, TWO\n BBL 2\nTWO BBL 2\n" },
+    };
+
+    Emulator emulator;
+    for (const auto& sequence : sequences) {
+        for (unsigned state = 0u; state < 32u; state += 5u) {
+            std::string source;
+            for (unsigned pair = 0u; pair < 8u; ++pair)
+                source += "  FIM P" + std::to_string(pair) + ", " + std::to_string((pair * 37u + state * 11u) & 0xFFu) + "\n";
+            source += "  LDM " + std::to_string(state & 0x0Fu) + (state & 0x10u ? "\n  STC\n" : "\n  CLC\n");
+            source += std::string("SEQ ") + sequence[0] + "  JUN DONE\n" + sequence[1] + "*=$80\nDONE JUN DONE\n";
+
+            uint8_t registers[2][16];
+            uint8_t acc[2];
+            uint64_t cycles[2];
+            for (int optimize = 0; optimize < 2; ++optimize) {
+                Assembler assembler;
+                assembler.setOptimization(optimize != 0);
+                std::vector<uint8_t> bytecode;
+                ASSERT_TRUE(assembler.assemble(std::string_view(source), bytecode)) << assembler.getError();
+                EXPECT_EQ(assembler.getOptimizations().empty(), optimize == 0) << sequence[0];
+                ASSERT_TRUE(emulator.loadProgramFromMemory(bytecode.data(), bytecode.size()));
+
+                emulator.reset();
+                for (int i = 0; i < 100 && emulator.getCPU().getPC() != 0x80u; ++i)
+                    emulator.step();
+                ASSERT_EQ(emulator.getCPU().getPC(), 0x80u) << sequence[0];
+                for (uint8_t reg = 0u; reg < 16u; ++reg)
+                    registers[optimize][reg] = getRegisterValue(emulator.getCPU().getRegisters(), reg);
+                acc[optimize] = emulator.getCPU().getACC();
+                cycles[optimize] = emulator.getCPU().getCycleCount();
+            }
+
+            EXPECT_TRUE(std::equal(registers[0], registers[0] + 16, registers[1])) << sequence[0];
+            EXPECT_EQ(acc[0], acc[1]) << sequence[0];
+            EXPECT_LT(cycles[1], cycles[0]) << sequence[0];
+        }
+    }
+}
@@ -0,0 +1,116 @@
+#include <gtest/gtest.h>
+#include "emulator_core/source/event_scheduler.hpp"
+
+#include <vector>
+
+class EventSchedulerTest : public ::testing::Test {
+protected:
+    EventScheduler scheduler;
+    std::vector<uint64_t> fired;
+};
+
+// Test basic construction and initialization
+TEST_F(EventSchedulerTest, Construction) {
+    EXPECT_FALSE(scheduler.hasPendingEvents());
+    EXPECT_EQ(scheduler.getCurrentCycle(), 0u);
+    EXPECT_EQ(scheduler.getNextEventCycle(), EventScheduler::NO_EVENT);
+}
+
+// Test events fire in cycle order, not posting order
+TEST_F(EventSchedulerTest, FiresInCycleOrder) {
+    scheduler.schedule(30, [this](uint64_t cycle) { fired.push_back(cycle); });
+    scheduler.schedule(10, [this](uint64_t cycle) { fired.push_back(cycle); });
+    scheduler.schedule(20, [this](uint64_t cycle) { fired.push_back(cycle); });
+    EXPECT_EQ(scheduler.getNextEventCycle(), 10u);
+
+    scheduler.advanceTo(25);
+
+    ASSERT_EQ(fired.size(), 2u);
+    EXPECT_EQ(fired[0], 10u);
+    EXPECT_EQ(fired[1], 20u);
+    EXPECT_EQ(scheduler.getCurrentCycle(), 25u);
+    EXPECT_EQ(scheduler.getNextEventCycle(), 30u);
+}
+
+// Test same-cycle events keep posting order
+TEST_F(EventSchedulerTest, SameCycleFifo) {
+    scheduler.schedule(5, [this](uint64_t) { fired.push_back(1); });
+    scheduler.schedule(5, [this](uint64_t) { fired.push_back(2); });
+    scheduler.schedule(5, [this](uint64_t) { fired.push_back(3); });
+
+    scheduler.advanceTo(5);
+
+    EXPECT_EQ(fired, (std::vector<uint64_t>{ 1, 2, 3 }));
+    EXPECT_FALSE(scheduler.hasPendingEvents());
+}
+
+// Test cancelled events never fire
+TEST_F(EventSchedulerTest, Cancel) {
+    auto id = scheduler.schedule(10, [this](uint64_t cycle) { fired.push_back(cycle); });
+    EXPECT_TRUE(scheduler.cancel(id));
+    EXPECT_FALSE(scheduler.cancel(id));
+    EXPECT_EQ(scheduler.getNextEventCycle(), EventScheduler::NO_EVENT);
+
+    scheduler.advanceTo(100);
+    EXPECT_TRUE(fired.empty());
+}
+
+// Test periodic events re-arm until cancelled
+TEST_F(EventSchedulerTest, Periodic) {
+    auto id = scheduler.schedulePeriodic(4, 10, [this](uint64_t cycle) { fired.push_back(cycle); });
+
+    scheduler.advanceTo(35);
+    EXPECT_EQ(fired, (std::vector<uint64_t>{ 4, 14, 24, 34 }));
+    EXPECT_EQ(scheduler.getNextEventCycle(), 44u);
+
+    EXPECT_TRUE(scheduler.cancel(id));
+    scheduler.advanceTo(100);
+    EXPECT_EQ(fired.size(), 4u);
+}
+
+// Test zero period and empty callbacks are rejected
+TEST_F(EventSchedulerTest, RejectsInvalidEvents) {
+    EXPECT_EQ(scheduler.schedulePeriodic(0, 0, [](uint64_t) {}), EventScheduler::INVALID_EVENT);
+    EXPECT_EQ(scheduler.schedule(0, nullptr), EventScheduler::INVALID_EVENT);
+    EXPECT_FALSE(scheduler.hasPendingEvents());
+}
+
+// Test callbacks may schedule relative to the firing cycle
+TEST_F(EventSchedulerTest, CallbackSchedulesFollowUp) {
+    scheduler.schedule(10, [this](uint64_t cycle) {
+        fired.push_back(cycle);
+        scheduler.scheduleIn(5, [this](uint64_t next) { fired.push_back(next); });
+    });
+
+    scheduler.advanceTo(100);
+
+    EXPECT_EQ(fired, (std::vector<uint64_t>{ 10, 15 }));
+}
+
+// Test periodic callbacks may cancel themselves
+TEST_F(EventSchedulerTest, PeriodicSelfCancel) {
+    EventScheduler::EventId id = EventScheduler::INVALID_EVENT;
+    id = scheduler.schedulePeriodic(1, 1, [this, &id](uint64_t cycle) {
+        fired.push_back(cycle);
+        if (fired.size() == 3u)
+            scheduler.cancel(id);
+    });
+
+    scheduler.advanceTo(10);
+
+    EXPECT_EQ(fired.size(), 3u);
+    EXPECT_FALSE(scheduler.hasPendingEvents());
+}
+
+// Test reset drops all events and rewinds the timeline
+TEST_F(EventSchedulerTest, Reset) {
+    scheduler.schedule(10, [this](uint64_t cycle) { fired.push_back(cycle); });
+    scheduler.advanceTo(5);
+
+    scheduler.reset();
+
+    EXPECT_EQ(scheduler.getCurrentCycle(), 0u);
+    EXPECT_FALSE(scheduler.hasPendingEvents());
+    scheduler.advanceTo(20);
+    EXPECT_TRUE(fired.empty());
+}
@@ -0,0 +1,190 @@
+#include <gtest/gtest.h>
+#include "emulator_core/source/K4004.hpp"
+#include "emulator_core/source/busicom_calculator.hpp"
+#include "emulator_core/source/busicom_hle.hpp"
+#include "emulator_core/source/hle_hooks.hpp"
+#include "emulator_core/source/instructions.hpp"
+#include "emulator_core/source/ram.hpp"
+#include "emulator_core/source/rom.hpp"
+
+#include <algorithm>
+#include <string>
+#include <vector>
+
+namespace {
+
+// 000: fim 0< $25, 002: jms $010, 004: jun $004
+// 010: ld 0, add 1, xch 2, bbl 3 (R2 = R0 + R1)
+const uint8_t ADD_PROGRAM[] = {
+    0xFE, 0xFF,  // No I/O masks
+    0x20, 0x25, 0x50, 0x10, 0x40, 0x04, 0x00, 0x00,
+    0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00,
+    0xA0, 0x81, 0xB2, 0xC3,
+};
+
+// Native version of $010, cyclesOff makes it wrong on purpose
+HLEHookTable::Hook addHook(uint64_t cyclesOff = 0u)
+{
+    return [cyclesOff](K4004::State& state, RAM&, ROM&) {
+        uint8_t sum = getRegisterValue(state.registers, 0u) + getRegisterValue(state.registers, 1u) + (state.ACC >> 4);
+        state.ACC = static_cast<uint8_t>((sum & 0x10u) | getRegisterValue(state.registers, 2u));
+        setRegisterValue(state.registers, 2u, sum & 0x0Fu);
+        state.cycleCount += 3u + cyclesOff;
+        HLEHookTable::returnFromRoutine(state, 3u);
+        return true;
+    };
+}
+
+} // namespace
+
+class HLEHooksTest : public ::testing::Test {
+protected:
+    void SetUp() override {
+        ASSERT_TRUE(rom.load(ADD_PROGRAM, sizeof(ADD_PROGRAM)));
+        cpu.setHooks(&hooks);
+    }
+
+    ROM rom;
+    RAM ram;
+    K4004 cpu{ rom, ram };
+    HLEHookTable hooks;
+};
+
+// Test a hooked JMS returns at once with the routine's registers, ACC, cycles and stack
+TEST_F(HLEHooksTest, NativeReplacesRoutine) {
+    hooks.setHook(0x010u, addHook());
+    hooks.setMode(HLEHookTable::Mode::Native);
+
+    cpu.clock();
+    EXPECT_EQ(cpu.clock(), 2u);
+    EXPECT_EQ(cpu.getPC(), 0x004u);
+    EXPECT_EQ(getRegisterValue(cpu.getRegisters(), 2u), 7u);
+    EXPECT_EQ(cpu.getACC(), 3u);
+    EXPECT_EQ(cpu.getIR(), 0xC3u);
+    EXPECT_EQ(cpu.getCycleCount(), 8u);
+    EXPECT_EQ(cpu.getStack()[1], 0u);
+    EXPECT_EQ(hooks.getNativeCalls(), 1u);
+}
+
+// Test hooks are ignored when off or missing and a declining hook runs the routine
+TEST_F(HLEHooksTest, FallsBackToRoutine) {
+    hooks.setHook(0x010u, addHook());
+    cpu.clock();
+    cpu.clock();
+    EXPECT_EQ(cpu.getPC(), 0x010u);  // Mode::Off
+
+    cpu.reset();
+    hooks.setMode(HLEHookTable::Mode::Native);
+    hooks.setHook(0x010u, [](K4004::State&, RAM&, ROM&) { return false; });
+    cpu.clock();
+    cpu.clock();
+    EXPECT_EQ(cpu.getPC(), 0x010u);
+
+    cpu.reset();
+    hooks.removeHook(0x010u);
+    EXPECT_FALSE(hooks.hasHook(0x010u));
+    cpu.clock();
+    cpu.clock();
+    EXPECT_EQ(cpu.getPC(), 0x010u);
+    EXPECT_EQ(hooks.getNativeCalls(), 0u);
+}
+
+// Test validation steps the real routine and accepts a matching hook
+TEST_F(HLEHooksTest, ValidateMatchesRoutine) {
+    hooks.setHook(0x010u, addHook());
+    hooks.setMode(HLEHookTable::Mode::Validate);
+
+    cpu.clock();
+    cpu.clock();
+    EXPECT_EQ(cpu.getPC(), 0x004u);
+    EXPECT_EQ(getRegisterValue(cpu.getRegisters(), 2u), 7u);
+    EXPECT_EQ(cpu.getACC(), 3u);
+    EXPECT_EQ(cpu.getCycleCount(), 8u);
+    EXPECT_EQ(hooks.getValidatedCalls(), 1u);
+    EXPECT_EQ(hooks.getMismatches(), 0u);
+}
+
+// Test validation reports the first difference and keeps the real result
+TEST_F(HLEHooksTest, ValidateReportsDifference) {
+    std::vector<HLEHookTable::Mismatch> mismatches;
+    hooks.setMismatchListener([&mismatches](const HLEHookTable::Mismatch& mismatch) { mismatches.push_back(mismatch); });
+    hooks.setHook(0x010u, addHook(1u));
+    hooks.setMode(HLEHookTable::Mode::Validate);
+
+    cpu.clock();
+    cpu.clock();
+    EXPECT_EQ(cpu.getCycleCount(), 8u);
+    ASSERT_EQ(mismatches.size(), 1u);
+    EXPECT_EQ(mismatches[0].address, 0x010u);
+    EXPECT_EQ(mismatches[0].cycle, 2u);
+    EXPECT_EQ(mismatches[0].details, "cycles 7 != 6");  // Without the JMS itself
+    EXPECT_EQ(hooks.getMismatches(), 1u);
+}
+
+// Test validation undoes the memory writes of a hook that then declines
+TEST_F(HLEHooksTest, ValidateRestoresDecliningHook) {
+    hooks.setHook(0x010u, [](K4004::State&, RAM& ram, ROM& rom) {
+        ram.writeSrcAddress(0x25u);
+        ram.writeRAM(0x9u);
+        rom.writeSrcAddress(0x30u);
+        return false;
+    });
+    hooks.setMode(HLEHookTable::Mode::Validate);
+
+    cpu.clock();
+    cpu.clock();
+    EXPECT_EQ(cpu.getPC(), 0x010u);
+    EXPECT_EQ(hooks.getValidatedCalls(), 0u);
+    EXPECT_EQ(ram.getSrcAddress(), 0u);
+    EXPECT_EQ(rom.getSrcAddress(), 0u);
+    const uint8_t* contents = ram.getRamContents();
+    EXPECT_TRUE(std::all_of(contents, contents + RAM::RAM_SIZE, [](uint8_t character) { return character == 0u; }));
+}
+
+class BusicomHLETest : public ::testing::Test {
+protected:
+    void SetUp() override {
+        ASSERT_TRUE(calculator.loadROMFile("../programs/busicom/busicom_141-PF.obj"));
+        ASSERT_TRUE(calculator.runUntilIdle());
+    }
+
+    std::vector<std::string> type(std::string_view script) {
+        calculator.clearPrintedLines();
+        EXPECT_TRUE(calculator.typeKeys(script));
+        std::vector<std::string> lines;
+        const PrinterRingSink& tape = calculator.getPrintedLines();
+        for (size_t i = 0u; i < tape.size(); ++i)
+            lines.emplace_back(tape[i].getText());
+        return lines;
+    }
+
+    BusicomCalculator calculator;
+};
+
+// Test the native number register routines match the ROM call for call
+TEST_F(BusicomHLETest, ValidateCalculations) {
+    std::string details;
+    calculator.getHooks().setMismatchListener([&details](const HLEHookTable::Mismatch& mismatch) {
+        details = mismatch.details;
+    });
+    calculator.setHLEMode(HLEHookTable::Mode::Validate);
+
+    type("12.5 * 4 =");
+    type("7 / 3 =");
+    type("3 + 5 - = C");
+    EXPECT_GT(calculator.getHooks().getValidatedCalls(), 0u);
+    EXPECT_EQ(calculator.getHooks().getMismatches(), 0u) << details;
+}
+
+// Test native routines print the same lines in the same number of cycles
+TEST_F(BusicomHLETest, NativeMatchesStepping) {
+    std::vector<std::string> stepped = type("123 + 45.6 - = 99 / 7 =");
+    uint64_t steppedCycles = calculator.getCycleCount();
+
+    ASSERT_TRUE(calculator.loadROMFile("../programs/busicom/busicom_141-PF.obj"));
+    ASSERT_TRUE(calculator.runUntilIdle());
+    calculator.setHLEMode(HLEHookTable::Mode::Native);
+    EXPECT_EQ(type("123 + 45.6 - = 99 / 7 ="), stepped);
+    EXPECT_EQ(calculator.getCycleCount(), steppedCycles);
+    EXPECT_GT(calculator.getHooks().getNativeCalls(), 0u);
+}
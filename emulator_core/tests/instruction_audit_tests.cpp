@@ -6,8 +6,8 @@
  * the granular instruction-level audit, including:
  * - Inverted carry logic in subtraction (DAC, SUB, SBM, TCS)
  * - DAA add-6 algorithm (not subtract-10)
- * - KBP carry dependency for ACC=0
- * - Stack overflow behavior
+ * - KBP no-key result and carry preservation
+ * - Stack overflow behavior (circular address stack on 4004 and 4040)
  * - INC vs IAC carry behavior
  * - Edge cases and boundary conditions
  *
@@ -15,10 +15,14 @@
  */
 
 #include <gtest/gtest.h>
+#include "emulator_core/source/K4004.hpp"
+#include "emulator_core/source/K4040.hpp"
 #include "emulator_core/source/instructions.hpp"
 #include "emulator_core/source/ram.hpp"
 #include "emulator_core/source/rom.hpp"
 
+#include <vector>
+
 // Helper macros for ACC manipulation
 #define ACC_VALUE(acc) ((acc) & 0x0F)
 #define ACC_CARRY(acc) (((acc) >> 4) & 1)
@@ -80,17 +84,17 @@ TEST(InvertedCarryAudit, DAC_FromMax) {
 /**
  * SUB Rr (Subtract Register) - 0x9R
  *
- * CRITICAL: Inverted carry semantics + input carry means borrow
- * - Input CY = 0: Previous digit borrowed, subtract 1 extra
- * - Input CY = 1: No previous borrow
- * - Output CY = 0: Borrow occurred
+ * ACC = ACC + (15 - reg) + (1 - CY), input carry is the borrow
+ * - Input CY = 1: Previous digit borrowed, subtract 1 extra
+ * - Input CY = 0: No previous borrow
+ * - Output CY = 0: Borrow occurred (INVERTED)
  * - Output CY = 1: No borrow
  */
 TEST(InvertedCarryAudit, SUB_NoBorrow_NoPreviousBorrow) {
     // Test: 7 - 3 (no previous borrow) = 4, no borrow, CY should be 1
     uint8_t registers[8] = {0};
     setRegisterValue(registers, 3, 3);  // R3 = 3
-    uint8_t acc = MAKE_ACC(0x7, 1);   // ACC=7, CY=1 (no previous borrow)
+    uint8_t acc = MAKE_ACC(0x7, 0);   // ACC=7, CY=0 (no previous borrow)
 
     SUB(acc, registers, 0x93);  // SUB R3
 
@@ -102,7 +106,7 @@ TEST(InvertedCarryAudit, SUB_WithBorrow_NoPreviousBorrow) {
     // Test: 3 - 7 (no previous borrow) = C (wrap), borrow, CY should be 0
     uint8_t registers[8] = {0};
     registers[5 / 2] = (5 << 4) | 7;  // R5 = 7
-    uint8_t acc = MAKE_ACC(0x3, 1);   // ACC=3, CY=1 (no previous borrow)
+    uint8_t acc = MAKE_ACC(0x3, 0);   // ACC=3, CY=0 (no previous borrow)
 
     SUB(acc, registers, 0x95);  // SUB R5
 
@@ -112,14 +116,14 @@ TEST(InvertedCarryAudit, SUB_WithBorrow_NoPreviousBorrow) {
 }
 
 TEST(InvertedCarryAudit, SUB_WithPreviousBorrow) {
-    // Test: 5 - 5 with previous borrow (CY=0) = F, borrow, CY should be 0
+    // Test: 5 - 5 with previous borrow (CY=1) = F, borrow, CY should be 0
     uint8_t registers[8] = {0};
     registers[7 / 2] = (7 << 4) | 5;  // R7 = 5
-    uint8_t acc = MAKE_ACC(0x5, 0);   // ACC=5, CY=0 (previous borrow: subtract 1 extra!)
+    uint8_t acc = MAKE_ACC(0x5, 1);   // ACC=5, CY=1 (previous borrow: subtract 1 extra!)
 
     SUB(acc, registers, 0x97);  // SUB R7
 
-    // 5 - 5 - 1 (from CY=0) = -1 = 15 = 0xF
+    // 5 - 5 - 1 (from CY=1) = -1 = 15 = 0xF
     EXPECT_EQ(ACC_VALUE(acc), 0xF) << "5 - 5 - 1 (borrow) = F";
     EXPECT_EQ(ACC_CARRY(acc), 0) << "Borrow with previous borrow: CY=0";
 }
@@ -128,7 +132,7 @@ TEST(InvertedCarryAudit, SUB_Zero) {
     // Test: 5 - 5 (no previous borrow) = 0, no borrow, CY should be 1
     uint8_t registers[8] = {0};
     setRegisterValue(registers, 2, 5);  // R2 = 5
-    uint8_t acc = MAKE_ACC(0x5, 1);   // ACC=5, CY=1 (no previous borrow)
+    uint8_t acc = MAKE_ACC(0x5, 0);   // ACC=5, CY=0 (no previous borrow)
 
     SUB(acc, registers, 0x92);  // SUB R2
 
@@ -147,7 +151,7 @@ TEST(InvertedCarryAudit, SBM_NoBorrow) {
     ram.writeSrcAddress(0x00);  // Chip 0, Reg 0, Char 0
     ram.writeRAM(0x3);          // RAM = 3
 
-    uint8_t acc = MAKE_ACC(0x8, 1);  // ACC=8, CY=1
+    uint8_t acc = MAKE_ACC(0x8, 0);  // ACC=8, CY=0
 
     SBM(acc, ram);
 
@@ -161,7 +165,7 @@ TEST(InvertedCarryAudit, SBM_WithBorrow) {
     ram.writeSrcAddress(0x00);
     ram.writeRAM(0x5);  // RAM = 5
 
-    uint8_t acc = MAKE_ACC(0x2, 1);  // ACC=2, CY=1 (no previous borrow)
+    uint8_t acc = MAKE_ACC(0x2, 0);  // ACC=2, CY=0 (no previous borrow)
 
     SBM(acc, ram);
 
@@ -172,27 +176,27 @@ TEST(InvertedCarryAudit, SBM_WithBorrow) {
 /**
  * TCS (Transfer Carry Subtract) - 0xF9
  *
- * Returns 10 - CY for BCD subtraction
- * - CY=0 (borrow) → ACC=10
- * - CY=1 (no borrow) → ACC=9
+ * Returns 9 + CY for BCD subtraction (the 10's complement of the next digit)
+ * - CY=0 (borrow) → ACC=9
+ * - CY=1 (no borrow) → ACC=10
  */
 TEST(InvertedCarryAudit, TCS_WithBorrow) {
-    // CY=0 means borrow occurred, should return 10
+    // CY=0 means borrow occurred, should return 9
     uint8_t acc = MAKE_ACC(0x5, 0);  // Previous value irrelevant, CY=0
 
     TCS(acc);
 
-    EXPECT_EQ(ACC_VALUE(acc), 10) << "TCS with CY=0 should return 10";
+    EXPECT_EQ(ACC_VALUE(acc), 9) << "TCS with CY=0 should return 9";
     EXPECT_EQ(ACC_CARRY(acc), 0) << "TCS clears carry";
 }
 
 TEST(InvertedCarryAudit, TCS_NoBorrow) {
-    // CY=1 means no borrow, should return 9
+    // CY=1 means no borrow, should return 10
     uint8_t acc = MAKE_ACC(0xA, 1);  // Previous value irrelevant, CY=1
 
     TCS(acc);
 
-    EXPECT_EQ(ACC_VALUE(acc), 9) << "TCS with CY=1 should return 9";
+    EXPECT_EQ(ACC_VALUE(acc), 10) << "TCS with CY=1 should return 10";
     EXPECT_EQ(ACC_CARRY(acc), 0) << "TCS clears carry";
 }
 
@@ -204,8 +208,8 @@ TEST(InvertedCarryAudit, TCS_NoBorrow) {
  * DAA (Decimal Adjust Accumulator) - 0xFB
  *
  * DISCOVERED ALGORITHM: Add 6 to adjust, not subtract 10!
- * - If ACC > 9: ACC = (ACC + 6) & 0xF, CY = 1
- * - If ACC <= 9: No change
+ * - If ACC > 9 or CY = 1: ACC = (ACC + 6) & 0xF, CY = 1 on overflow (never cleared)
+ * - Otherwise: No change
  */
 TEST(DAAAlgorithmAudit, DAA_ValidBCD_NoChange) {
     // Test: Valid BCD digits (0-9) should not change
@@ -324,37 +328,35 @@ TEST(DAAAlgorithmAudit, BCD_Addition_9_Plus_9) {
 }
 
 // ============================================================================
-// CRITICAL FINDING #3: KBP CARRY DEPENDENCY
+// CRITICAL FINDING #3: KBP NO-KEY RESULT
 // ============================================================================
 
 /**
  * KBP (Keyboard Process) - 0xFC
  *
- * DISCOVERED: Special handling for ACC=0 depends on input carry!
- * - ACC=0, CY=0 → Returns 9
- * - ACC=0, CY=1 → Returns 10
- * - This distinguishes "no key pressed" from "key 0"
+ * MCS-4 manual: ACC=0000 converts to 0000 ("no key"), the carry is not
+ * affected. The Busicom 141-PF keyboard scan relies on both ($0c1).
  */
 TEST(KBPCarryAudit, KBP_NoKey_CarryClear) {
-    // ACC=0, CY=0 should return 9 (no key pressed)
+    // ACC=0, CY=0 should return 0 (no key pressed)
     uint8_t acc = MAKE_ACC(0x0, 0);
 
     KBP(acc);
 
-    EXPECT_EQ(ACC_VALUE(acc), 9)
-        << "KBP with ACC=0, CY=0 should return 9 (no key)";
-    EXPECT_EQ(ACC_CARRY(acc), 0) << "KBP clears carry";
+    EXPECT_EQ(ACC_VALUE(acc), 0)
+        << "KBP with ACC=0, CY=0 should return 0 (no key)";
+    EXPECT_EQ(ACC_CARRY(acc), 0) << "KBP does not affect carry";
 }
 
 TEST(KBPCarryAudit, KBP_NoKey_CarrySet) {
-    // ACC=0, CY=1 should return 10 (alternative no-key value)
+    // ACC=0, CY=1 should return 0 as well, carry is independent
     uint8_t acc = MAKE_ACC(0x0, 1);
 
     KBP(acc);
 
-    EXPECT_EQ(ACC_VALUE(acc), 10)
-        << "KBP with ACC=0, CY=1 should return 10";
-    EXPECT_EQ(ACC_CARRY(acc), 0) << "KBP clears carry";
+    EXPECT_EQ(ACC_VALUE(acc), 0)
+        << "KBP with ACC=0, CY=1 should return 0";
+    EXPECT_EQ(ACC_CARRY(acc), 1) << "KBP does not affect carry";
 }
 
 TEST(KBPCarryAudit, KBP_SingleBit) {
@@ -447,40 +449,89 @@ TEST(INCvsIACAudit, INC_BasicIncrement) {
 // ============================================================================
 
 /**
- * 4004: 3-level stack, 4th JMS overwrites stack[2]
- * 4040: 7-level stack, 8th JMS overwrites stack[6]
+ * The address stack is circular: the PC and the return levels share one array
+ * indexed by SP, which wraps modulo the stack size.
+ * 4004: PC + 3 levels, the 4th nested JMS overwrites the oldest return address
+ * 4040: PC + 7 levels, the 8th nested JMS overwrites the oldest return address
  */
-TEST(StackOverflowAudit, Stack4004_ThreeLevels) {
+class StackOverflowAudit : public ::testing::Test {
+protected:
+    // Main program JMS $010, level n at $010 + 4n: JMS to the next level then
+    // BBL n, the innermost level is a lone BBL
+    void loadNestedCalls(uint8_t calls) {
+        std::vector<uint8_t> image = { 0xFE, 0xFF };
+        std::vector<uint8_t> body(0x100, 0x00);
+        body[0x000] = 0x50;  // JMS $010
+        body[0x001] = 0x10;
+        body[0x002] = 0xF2;  // IAC
+        for (uint8_t level = 0; level + 1u < calls; ++level) {
+            const uint16_t address = 0x010u + 4u * level;
+            body[address] = 0x50;  // JMS next level
+            body[address + 1u] = static_cast<uint8_t>(address + 4u);
+            body[address + 2u] = static_cast<uint8_t>(0xC1u + level);  // BBL level+1
+        }
+        body[0x010u + 4u * (calls - 1u)] = 0xC0;  // Innermost: BBL 0
+        image.insert(image.end(), body.begin(), body.end());
+        ASSERT_TRUE(rom.load(image.data(), image.size()));
+    }
+
+    // One instruction, the 4004 clocks and the 4040 steps
+    static void step(K4004& cpu) { cpu.clock(); }
+    static void step(K4040& cpu) { cpu.step(); }
+
+    template <typename CPU>
+    void expectOldestOverwritten(CPU& cpu, uint8_t calls) {
+        for (uint8_t i = 0; i < calls; ++i)
+            step(cpu);
+        const uint16_t innermost = 0x010u + 4u * (calls - 1u);
+        EXPECT_EQ(cpu.getPC(), innermost);
+        for (uint8_t i = 0; i < calls; ++i)
+            EXPECT_NE(cpu.getStack()[i], 0x002u) << "Return to main program overwritten";
+
+        // Every return but the oldest is intact
+        for (uint8_t i = 1; i < calls; ++i) {
+            step(cpu);
+            EXPECT_EQ(cpu.getPC(), innermost - 4u * i + 2u);
+        }
+
+        // The outermost BBL pops the wrapped level, which held the PC
+        step(cpu);
+        EXPECT_EQ(cpu.getPC(), 0x000u) << "Oldest return address lost";
+    }
+
     ROM rom;
-    uint16_t stack[3] = {0x100, 0, 0};  // Start at PC=0x100
-    uint8_t SP = 0;  // Stack pointer
+    RAM ram;
+};
 
-    // Fill stack with 3 calls
-    JMS(stack, SP, 0x52, rom, 3);  // JMS 0x200
-    EXPECT_EQ(SP, 1);
-    EXPECT_EQ(stack[1], 0x102);  // Return address (PC+2)
+TEST_F(StackOverflowAudit, Stack4004_ThreeLevels) {
+    loadNestedCalls(3);
+    K4004 cpu(rom, ram);
 
-    stack[SP] = 0x200;  // Simulate PC at new location
-    JMS(stack, SP, 0x53, rom, 3);  // JMS 0x300
-    EXPECT_EQ(SP, 2);
-    EXPECT_EQ(stack[2], 0x202);
+    for (int i = 0; i < 3; ++i)
+        step(cpu);
+    EXPECT_EQ(cpu.getPC(), 0x018u);
+    EXPECT_EQ(cpu.getStack()[0], 0x002u);
+    EXPECT_EQ(cpu.getStack()[1], 0x012u);
+    EXPECT_EQ(cpu.getStack()[2], 0x016u);
 
-    stack[SP] = 0x300;
-    JMS(stack, SP, 0x54, rom, 3);  // JMS 0x400 (fills stack)
-    EXPECT_EQ(SP, 2) << "Stack full, SP wraps to 2 (overflow)";
-    EXPECT_EQ(stack[2], 0x302) << "4th JMS overwrites stack[2]";
+    for (int i = 0; i < 3; ++i)
+        step(cpu);
+    EXPECT_EQ(cpu.getPC(), 0x002u) << "Three levels return to the caller";
+    EXPECT_EQ(ACC_VALUE(cpu.getACC()), 1);
 }
 
-TEST(StackOverflowAudit, BBL_Returns) {
-    uint16_t stack[3] = {0x100, 0x200, 0x300};
-    uint8_t SP = 2;  // Stack full
-    uint8_t acc = 0;
-    uint8_t registers[8] = {0};
+TEST_F(StackOverflowAudit, Stack4004_FourthCallWraps) {
+    loadNestedCalls(K4004::STACK_SIZE);
+    K4004 cpu(rom, ram);
+
+    expectOldestOverwritten(cpu, K4004::STACK_SIZE);
+}
 
-    BBL(stack, SP, acc, registers, 0xC5);  // BBL 5
+TEST_F(StackOverflowAudit, Stack4040_EighthCallWraps) {
+    loadNestedCalls(K4040::STACK_SIZE);
+    K4040 cpu(rom, ram);
 
-    EXPECT_EQ(SP, 1) << "BBL decrements SP";
-    EXPECT_EQ(ACC_VALUE(acc), 5) << "BBL loads immediate";
+    expectOldestOverwritten(cpu, K4040::STACK_SIZE);
 }
 
 // ============================================================================
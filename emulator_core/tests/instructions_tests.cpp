@@ -75,10 +75,10 @@ TEST(InstructionsTests, WR3Test) {
 }
 
 TEST(InstructionsTests, SBMTest) {
-    // Fixed to match correct inverted carry semantics
-    // CY=0 means previous borrow (subtract 1 extra), CY=1 means no previous borrow
+    // ACC = ACC + (15 - mem) + (1 - CY)
+    // CY=1 means previous borrow (subtract 1 extra), CY=0 means no previous borrow
 
-    uint8_t acc = 0x07u | 1u << 4;  // ACC=7, CY=1 (no previous borrow)
+    uint8_t acc = 0x07u;  // ACC=7, CY=0 (no previous borrow)
     RAM ram;
     ram.writeSrcAddress(0b00100111u); // chip 0 | reg 2 | char 7
     ram.writeRAM(0x02u);
@@ -87,14 +87,14 @@ TEST(InstructionsTests, SBMTest) {
 
     EXPECT_EQ(acc, (0x07u - 0x02u) | 1u << 4);  // 0x15: value=5, CY=1
 
-    acc &= 0x0Fu;  // ACC=5, CY=0 (previous borrow active)
+    acc = 0x05u | 1u << 4;  // ACC=5, CY=1 (previous borrow active)
     ram.writeRAM(0x0Fu);
 
     SBM(acc, ram);  // 5 - 15 - 1 = -11 → wraps to 5 in 4-bit, borrow
 
     EXPECT_EQ(acc, 0x05u);  // value=5, CY=0 (borrow occurred)
 
-    acc |= 1u << 4;  // ACC=5, CY=1 (clear previous borrow)
+    acc &= 0x0Fu;  // ACC=5, CY=0 (no previous borrow)
     ram.writeRAM(0x03u);
 
     SBM(acc, ram);  // 5 - 3 = 2, no borrow
@@ -306,20 +306,20 @@ TEST(InstructionsTests, DACTest) {
 }
 
 TEST(InstructionsTests, TCSTest) {
-    // Fixed to match correct TCS formula: returns 10 - CY
-    // CY=0 (borrow) → 10, CY=1 (no borrow) → 9
+    // TCS: ACC = 9 + CY, carry cleared
+    // CY=0 (borrow) → 9, CY=1 (no borrow) → 10
 
     uint8_t acc = 0x07u;  // CY=0 (borrow)
 
     TCS(acc);
 
-    EXPECT_EQ(acc, 0x0Au);  // 10 (since CY was 0)
+    EXPECT_EQ(acc, 0x09u);  // 9 (since CY was 0)
 
     acc = 0x19u;  // CY=1 (no borrow)
 
     TCS(acc);
 
-    EXPECT_EQ(acc, 0x09u);  // 9 (since CY was 1)
+    EXPECT_EQ(acc, 0x0Au);  // 10 (since CY was 1)
 }
 
 TEST(InstructionsTests, STCTest) {
@@ -351,14 +351,19 @@ TEST(InstructionsTests, DAATest) {
 }
 
 TEST(InstructionsTests, KBPTest) {
-    // Fixed to match correct KBP behavior with carry dependency
-    // ACC=0, CY=0 → 9 (no key), ACC=0, CY=1 → 10 (alternative no-key)
+    // ACC=0 means no key, it converts to 0 and the carry is kept
 
     uint8_t acc = 0u;  // ACC=0, CY=0
 
     KBP(acc);
 
-    EXPECT_EQ(acc, 9u);  // Returns 9 when ACC=0, CY=0
+    EXPECT_EQ(acc, 0u);
+
+    acc = 0x10u;  // ACC=0, CY=1
+
+    KBP(acc);
+
+    EXPECT_EQ(acc, 0x10u);
 
     acc = 0b0001u;
 
@@ -466,10 +471,10 @@ TEST(InstructionsTests, ADDTest) {
 }
 
 TEST(InstructionsTests, SUBTest) {
-    // Fixed to match correct inverted carry semantics
-    // CY=0 means previous borrow (subtract 1 extra), CY=1 means no previous borrow
+    // ACC = ACC + (15 - reg) + (1 - CY)
+    // CY=1 means previous borrow (subtract 1 extra), CY=0 means no previous borrow
 
-    uint8_t acc = 0x07u | 1u << 4;  // ACC=7, CY=1 (no previous borrow)
+    uint8_t acc = 0x07u;  // ACC=7, CY=0 (no previous borrow)
     uint8_t registers[8];
     registers[1] = 0x20u;  // R2=2
 
@@ -477,14 +482,14 @@ TEST(InstructionsTests, SUBTest) {
 
     EXPECT_EQ(acc, (0x07u - 0x02u) | 1u << 4);  // 0x15: value=5, CY=1 (no borrow)
 
-    acc &= 0x0Fu;  // ACC=5, CY=0 (previous borrow active)
+    acc = 0x05u | 1u << 4;  // ACC=5, CY=1 (previous borrow active)
     registers[1] = 0xF0u;  // R2=15
 
     SUB(acc, registers, 0x92u);  // SUB R2: 5 - 15 - 1 = -11 → wraps to 5 in 4-bit, borrow
 
     EXPECT_EQ(acc, 0x05u);  // value=5, CY=0 (borrow occurred)
 
-    acc |= 1u << 4;  // ACC=5, CY=1 (clear previous borrow)
+    acc &= 0x0Fu;  // ACC=5, CY=0 (no previous borrow)
     registers[1] = 0x30u;  // R2=3
 
     SUB(acc, registers, 0x92u);  // SUB R2: 5 - 3 = 2, no borrow
@@ -507,17 +512,18 @@ TEST(InstructionsTests, INCTest) {
 
 TEST(InstructionsTests, BBLTest) {
     uint8_t acc = 0u;
-    uint8_t registers[8];
     uint16_t stack[4];
     uint8_t sp = 1u;
-    registers[1] = 0x20u;
     stack[0] = 0x010u;
-    stack[sp] = 0u;
-    
-    BBL(stack, sp, acc, registers, 0xF2u);
+    stack[sp] = 0x123u;
+
+    // BBL is a stack pop followed by LDM of the immediate
+    popStack(stack, sp, 4u);
+    LDM(acc, 0xF2u);
 
     EXPECT_EQ(sp, 0u);
     EXPECT_EQ(stack[sp], 0x010u);
+    EXPECT_EQ(stack[1], 0u);
     EXPECT_EQ(acc, 0x02u);
 }
 
@@ -0,0 +1,148 @@
+#include <gtest/gtest.h>
+#include "emulator_core/source/K4004.hpp"
+#include "emulator_core/source/K4040.hpp"
+#include "emulator_core/source/busicom_peripherals.hpp"
+#include "emulator_core/source/ram.hpp"
+#include "emulator_core/source/rom.hpp"
+
+#include <vector>
+
+// I/O Port Change Notification Tests
+// Validates edge-triggered callbacks from ROM I/O ports, RAM output ports
+// and the 4040 command register, including cycle stamps.
+
+class IOPortListenerTest : public ::testing::Test {
+protected:
+    void loadProgram(const std::vector<uint8_t>& code) {
+        std::vector<uint8_t> image = { 0xFE, 0xFF };
+        image.insert(image.end(), code.begin(), code.end());
+        ASSERT_TRUE(rom.load(image.data(), image.size()));
+    }
+
+    ROM rom;
+    RAM ram;
+    std::vector<IOPortChange> changes;
+};
+
+TEST_F(IOPortListenerTest, ROMWriteFiresOnlyOnChange) {
+    rom.addIOPortListener([this](const IOPortChange& change) { changes.push_back(change); });
+
+    rom.writeSrcAddress(0x20);  // Select chip 2
+    rom.writeIOPort(0x5);
+    rom.writeIOPort(0x5);       // Same value, no notification
+    rom.writeIOPort(0xA);
+
+    ASSERT_EQ(changes.size(), 2u);
+    EXPECT_EQ(changes[0].port, 2u);
+    EXPECT_EQ(changes[0].oldValue, 0x0u);
+    EXPECT_EQ(changes[0].newValue, 0x5u);
+    EXPECT_EQ(changes[1].oldValue, 0x5u);
+    EXPECT_EQ(changes[1].newValue, 0xAu);
+}
+
+TEST_F(IOPortListenerTest, ROMInputBitsDoNotFire) {
+    rom.setIOPortMask(1, 0b1111);  // All inputs
+    rom.addIOPortListener([this](const IOPortChange& change) { changes.push_back(change); });
+
+    rom.writeSrcAddress(0x10);
+    rom.writeIOPort(0xF);
+
+    EXPECT_TRUE(changes.empty());
+}
+
+TEST_F(IOPortListenerTest, RAMOutputPortFiresOnlyOnChange) {
+    ram.addOutputPortListener([this](const IOPortChange& change) { changes.push_back(change); });
+
+    ram.setRAMBank(1u);
+    ram.writeSrcAddress(0x40);  // Chip 1
+    ram.writeOutputPort(0x9);
+    ram.writeOutputPort(0x9);
+
+    ASSERT_EQ(changes.size(), 1u);
+    EXPECT_EQ(changes[0].port, 5u);  // Bank 1, chip 1
+    EXPECT_EQ(changes[0].newValue, 0x9u);
+}
+
+TEST_F(IOPortListenerTest, K4004StampsWritingCycle) {
+    loadProgram({
+        0x20, 0x00,  // FIM P0, $00  (cycles 0-1)
+        0x21,        // SRC P0       (cycle 2)
+        0xD5,        // LDM 5        (cycle 3)
+        0xE2,        // WRR          (cycle 4)
+        0xE2,        // WRR          (cycle 5, unchanged)
+        0xD0,        // LDM 0        (cycle 6)
+        0xE2,        // WRR          (cycle 7)
+    });
+    K4004 cpu(rom, ram);
+    rom.addIOPortListener([this](const IOPortChange& change) { changes.push_back(change); });
+
+    for (int i = 0; i < 7; ++i)
+        cpu.clock();
+
+    ASSERT_EQ(changes.size(), 2u);
+    EXPECT_EQ(changes[0].cycle, 4u);
+    EXPECT_EQ(changes[0].newValue, 0x5u);
+    EXPECT_EQ(changes[1].cycle, 7u);
+    EXPECT_EQ(changes[1].newValue, 0x0u);
+}
+
+TEST_F(IOPortListenerTest, K4040CommandRegisterFiresOnDCL) {
+    loadProgram({
+        0xD3,        // LDM 3
+        0xFD,        // DCL          (cycle 1)
+        0xFD,        // DCL          (cycle 2, unchanged)
+        0x03,        // LCR
+    });
+    K4040 cpu(rom, ram);
+    cpu.addCommandRegisterListener([this](const IOPortChange& change) { changes.push_back(change); });
+
+    for (int i = 0; i < 4; ++i)
+        cpu.step();
+
+    ASSERT_EQ(changes.size(), 1u);
+    EXPECT_EQ(changes[0].oldValue, 0u);
+    EXPECT_EQ(changes[0].newValue, 3u);
+    EXPECT_EQ(changes[0].cycle, 1u);
+    EXPECT_EQ(cpu.getCommandRegister(), 3u);
+    EXPECT_EQ(cpu.getACC(), 3u);
+    EXPECT_EQ(cpu.getCycleCount(), 4u);
+}
+
+TEST_F(IOPortListenerTest, CycleCounterDetachedWithCPU) {
+    {
+        K4004 cpu(rom, ram);
+        EXPECT_NE(rom.getCycleCounter(), nullptr);
+        EXPECT_NE(ram.getCycleCounter(), nullptr);
+    }
+    EXPECT_EQ(rom.getCycleCounter(), nullptr);
+    EXPECT_EQ(ram.getCycleCounter(), nullptr);
+}
+
+TEST_F(IOPortListenerTest, BusicomPeripheralsReactWithoutPolling) {
+    loadProgram({
+        0x20, 0x00,  // FIM P0, $00
+        0x21,        // SRC P0       (select ROM0 / RAM0)
+        0xD3,        // LDM 3        (shifter data=1, clock=1)
+        0xE2,        // WRR
+        0xD0,        // LDM 0
+        0xE2,        // WRR          (column 0 selected)
+        0xD2,        // LDM 2
+        0xE1,        // WMP          (RAM0: fire hammers)
+        0x20, 0x10,  // FIM P0, $10
+        0x21,        // SRC P0       (select ROM1)
+        0xEA,        // RDR          (keyboard rows)
+    });
+    K4004 cpu(rom, ram);
+    BusicomPeripherals peripherals;
+    peripherals.connect(rom, ram);
+    peripherals.pressKey(0x81);  // CM: column 0, row 0
+
+    for (int i = 0; i < 11; ++i)
+        cpu.clock();
+
+    EXPECT_EQ(cpu.getACC(), 0x1u);
+    EXPECT_EQ(rom.getIOPort(1), 0x1u);
+
+    peripherals.releaseKey();
+    EXPECT_EQ(rom.getIOPort(1), 0x0u);
+}
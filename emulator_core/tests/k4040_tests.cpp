@@ -0,0 +1,341 @@
+#include <gtest/gtest.h>
+#include "emulator_core/source/K4040.hpp"
+#include "emulator_core/source/event_scheduler.hpp"
+#include "emulator_core/source/instructions.hpp"
+#include "emulator_core/source/ram.hpp"
+#include "emulator_core/source/rom.hpp"
+
+#include <chrono>
+#include <map>
+#include <thread>
+#include <vector>
+
+// Intel 4040 Interrupt Controller Tests
+// Validates INT acknowledge (SRC save, PC push, vector to 0x003), EIN/DIN
+// gating, BBS return, HLT wake-up and interrupt sources on the cycle timeline.
+
+class K4040Test : public ::testing::Test {
+protected:
+    // Program image as address -> bytes, unspecified locations are NOP
+    void loadProgram(const std::map<uint16_t, std::vector<uint8_t>>& code) {
+        std::vector<uint8_t> image = { 0xFE, 0xFF };
+        std::vector<uint8_t> body(0x100, 0x00);
+        for (const auto& [address, bytes] : code)
+            for (size_t i = 0; i < bytes.size(); ++i)
+                body[address + i] = bytes[i];
+        image.insert(image.end(), body.begin(), body.end());
+        ASSERT_TRUE(rom.load(image.data(), image.size()));
+    }
+
+    uint8_t getR7(const K4040& cpu) const { return getRegisterValue(cpu.getRegisters(), 7); }
+
+    ROM rom;
+    RAM ram;
+    EventScheduler scheduler;
+};
+
+// Test JMS transfers control and BBL returns past the two-byte instruction
+TEST_F(K4040Test, JMSAndBBL) {
+    loadProgram({
+        { 0x000, { 0x50, 0x05 } },  // JMS $005
+        { 0x002, { 0xF2 } },        // IAC
+        { 0x005, { 0xC3 } },        // BBL 3
+    });
+    K4040 cpu(rom, ram);
+
+    EXPECT_EQ(cpu.step(), 2u);
+    EXPECT_EQ(cpu.getPC(), 0x005u);
+    EXPECT_EQ(cpu.getStack()[0], 0x002u);
+
+    cpu.step();
+    EXPECT_EQ(cpu.getPC(), 0x002u);
+    EXPECT_EQ(cpu.getACC(), 3u);
+}
+
+// Test seven nested calls all return to their callers
+TEST_F(K4040Test, SevenLevelStack) {
+    // Level n at $010 + 4n: JMS to the next level, then BBL back
+    std::map<uint16_t, std::vector<uint8_t>> code;
+    code[0x000] = { 0x50, 0x10 };  // JMS $010
+    code[0x002] = { 0xF2 };        // IAC
+    for (uint8_t level = 0; level < 6; ++level)
+        code[0x010 + 4 * level] = { 0x50, static_cast<uint8_t>(0x14 + 4 * level), static_cast<uint8_t>(0xC1 + level) };
+    code[0x028] = { 0xC7 };        // Innermost: BBL 7
+    loadProgram(code);
+    K4040 cpu(rom, ram);
+
+    for (int i = 0; i < 7; ++i)
+        cpu.step();
+    EXPECT_EQ(cpu.getPC(), 0x028u);
+    EXPECT_EQ(cpu.getStack()[0], 0x002u);
+
+    for (int i = 0; i < 6; ++i) {
+        cpu.step();
+        EXPECT_EQ(cpu.getPC(), 0x026u - 4u * i);
+    }
+    cpu.step();
+    EXPECT_EQ(cpu.getPC(), 0x002u);
+    EXPECT_EQ(cpu.getACC(), 1u);
+
+    cpu.step();
+    EXPECT_EQ(cpu.getACC(), 2u);
+}
+
+// Test acknowledge saves SRC, pushes PC, vectors to 0x003 and BBS returns
+TEST_F(K4040Test, InterruptVectorsAndReturns) {
+    loadProgram({
+        { 0x000, { 0x40, 0x10 } },              // JUN $010
+        { 0x003, { 0x20, 0x00, 0x21, 0x67, 0x02 } },  // ISR: FIM P0,$00; SRC P0; INC R7; BBS
+        { 0x010, { 0x20, 0x42, 0x21, 0x0C } },  // FIM P0,$42; SRC P0; EIN
+        { 0x014, { 0xF2, 0xF2 } },              // IAC; IAC
+    });
+    K4040 cpu(rom, ram);
+
+    for (int i = 0; i < 4; ++i)
+        cpu.step();
+    EXPECT_TRUE(cpu.isInterruptEnabled());
+    EXPECT_EQ(cpu.getSrcRegister(), 0x42u);
+
+    cpu.requestInterrupt();
+    EXPECT_EQ(cpu.step(), K4040::INTERRUPT_CYCLES);
+    EXPECT_EQ(cpu.getPC(), K4040::INTERRUPT_VECTOR);
+    EXPECT_EQ(cpu.getStack()[0], 0x014u);
+    EXPECT_EQ(cpu.getSrcBackup(), 0x42u);
+    EXPECT_FALSE(cpu.isInterruptEnabled());
+    EXPECT_FALSE(cpu.isInterruptPending());
+
+    // ISR changes SRC, BBS restores it
+    for (int i = 0; i < 4; ++i)
+        cpu.step();
+    EXPECT_EQ(cpu.getPC(), 0x014u);
+    EXPECT_EQ(getR7(cpu), 1u);
+    EXPECT_EQ(cpu.getSrcRegister(), 0x42u);
+    EXPECT_EQ(rom.getSrcAddress(), 0x4u);
+    EXPECT_TRUE(cpu.isInterruptEnabled());
+
+    cpu.step();
+    EXPECT_EQ(cpu.getACC(), 1u);
+}
+
+// Test a request raised under DIN stays latched until EIN
+TEST_F(K4040Test, DisabledInterruptStaysPending) {
+    loadProgram({
+        { 0x000, { 0x40, 0x10 } },  // JUN $010
+        { 0x003, { 0x67, 0x02 } },  // ISR: INC R7; BBS
+        { 0x010, { 0x0D, 0xF2, 0x0C, 0xF2 } },  // DIN; IAC; EIN; IAC
+    });
+    K4040 cpu(rom, ram);
+
+    cpu.step();
+    cpu.step();  // DIN
+    cpu.requestInterrupt();
+    cpu.step();  // IAC runs, interrupt held off
+    EXPECT_EQ(cpu.getACC(), 1u);
+    EXPECT_TRUE(cpu.isInterruptPending());
+    EXPECT_EQ(cpu.getPC(), 0x012u);
+
+    cpu.step();  // EIN
+    cpu.step();  // Acknowledge
+    EXPECT_EQ(cpu.getPC(), K4040::INTERRUPT_VECTOR);
+    EXPECT_EQ(cpu.getStack()[0], 0x013u);
+}
+
+// Test the vector stays in the current ROM bank
+TEST_F(K4040Test, InterruptVectorUsesCurrentBank) {
+    loadProgram({
+        { 0x000, { 0x40, 0x10 } },  // JUN $010
+        { 0x010, { 0x0C, 0x0B } },  // EIN; SB1
+    });
+    K4040 cpu(rom, ram);
+
+    for (int i = 0; i < 3; ++i)
+        cpu.step();
+    cpu.requestInterrupt();
+    cpu.step();
+
+    EXPECT_EQ(cpu.getPC(), K4040::INTERRUPT_VECTOR);
+    EXPECT_EQ(cpu.getROMBank(), 0u);
+    EXPECT_EQ(cpu.getRegisterBank(), 1u);
+}
+
+// Test HLT without a timeline or enabled interrupt stays halted
+TEST_F(K4040Test, HaltWithoutSourcesStaysHalted) {
+    loadProgram({
+        { 0x000, { 0x01 } },  // HLT
+    });
+    K4040 cpu(rom, ram);
+
+    cpu.step();
+    EXPECT_TRUE(cpu.isHalted());
+    EXPECT_EQ(cpu.step(), 0u);
+    EXPECT_EQ(cpu.getCycleCount(), 1u);
+
+    // Interrupts are disabled after reset, a request does not wake the CPU
+    cpu.requestInterrupt();
+    EXPECT_EQ(cpu.step(), 0u);
+    EXPECT_TRUE(cpu.isHalted());
+}
+
+// Test a scheduled interrupt wakes the CPU from HLT on the cycle it fires
+TEST_F(K4040Test, ScheduledInterruptWakesHalt) {
+    loadProgram({
+        { 0x000, { 0x40, 0x10 } },  // JUN $010
+        { 0x003, { 0x67, 0x02 } },  // ISR: INC R7; BBS
+        { 0x010, { 0x0C, 0x01, 0xF2, 0x40, 0x11 } },  // EIN; HLT; IAC; JUN $011
+    });
+    K4040 cpu(rom, ram);
+    cpu.setScheduler(&scheduler);
+
+    for (int i = 0; i < 3; ++i)
+        cpu.step();
+    ASSERT_TRUE(cpu.isHalted());
+    EXPECT_EQ(cpu.getCycleCount(), 4u);
+
+    // Halted step fast-forwards straight to the scheduled event
+    cpu.scheduleInterrupt(1000u);
+    EXPECT_EQ(cpu.step(), 0u);
+    EXPECT_TRUE(cpu.isInterruptPending());
+    EXPECT_EQ(cpu.getCycleCount(), 1000u);
+    EXPECT_EQ(cpu.getHaltedCycles(), 996u);
+
+    cpu.step();
+    EXPECT_FALSE(cpu.isHalted());
+    EXPECT_EQ(cpu.getPC(), K4040::INTERRUPT_VECTOR);
+    EXPECT_EQ(cpu.getStack()[0], 0x012u);
+
+    cpu.step();  // INC R7
+    cpu.step();  // BBS
+    cpu.step();  // IAC
+    EXPECT_EQ(getR7(cpu), 1u);
+    EXPECT_EQ(cpu.getACC(), 1u);
+}
+
+// Test peripheral events that do not raise INT keep the CPU asleep
+TEST_F(K4040Test, HaltSkipsNonInterruptEvents) {
+    loadProgram({
+        { 0x000, { 0x0C, 0x01 } },  // EIN; HLT
+    });
+    K4040 cpu(rom, ram);
+    cpu.setScheduler(&scheduler);
+    int peripheralEvents = 0;
+    scheduler.schedule(50u, [&peripheralEvents](uint64_t) { ++peripheralEvents; });
+    cpu.scheduleInterrupt(80u);
+
+    cpu.step();
+    cpu.step();
+    EXPECT_EQ(cpu.step(), 0u);
+    EXPECT_EQ(cpu.getCycleCount(), 50u);
+    EXPECT_EQ(peripheralEvents, 1);
+    EXPECT_TRUE(cpu.isHalted());
+
+    EXPECT_EQ(cpu.step(), 0u);
+    EXPECT_EQ(cpu.getCycleCount(), 80u);
+    EXPECT_EQ(cpu.step(), K4040::INTERRUPT_CYCLES);
+    EXPECT_FALSE(cpu.isHalted());
+}
+
+// Test a halted CPU with nothing scheduled does not advance time on step
+TEST_F(K4040Test, HaltWithEmptyTimeline) {
+    loadProgram({
+        { 0x000, { 0x0C, 0x01 } },  // EIN; HLT
+    });
+    K4040 cpu(rom, ram);
+    cpu.setScheduler(&scheduler);
+
+    cpu.step();
+    cpu.step();
+    EXPECT_EQ(cpu.step(), 0u);
+    EXPECT_EQ(cpu.getCycleCount(), 2u);
+    EXPECT_TRUE(cpu.isWaitingForInterrupt());
+}
+
+// Test runUntil never fast-forwards past its target cycle
+TEST_F(K4040Test, RunUntilStopsAtTarget) {
+    loadProgram({
+        { 0x000, { 0x40, 0x10 } },  // JUN $010
+        { 0x003, { 0x67, 0x02 } },  // ISR: INC R7; BBS
+        { 0x010, { 0x0C, 0x01, 0xF2, 0x40, 0x11 } },  // EIN; HLT; IAC; JUN $011
+    });
+    K4040 cpu(rom, ram);
+    cpu.setScheduler(&scheduler);
+    cpu.scheduleInterrupt(1000u);
+
+    EXPECT_EQ(cpu.runUntil(500u), 500u);
+    EXPECT_TRUE(cpu.isHalted());
+    EXPECT_EQ(cpu.getHaltedCycles(), 496u);
+
+    cpu.runUntil(1010u);
+    EXPECT_EQ(getR7(cpu), 1u);
+    EXPECT_EQ(cpu.getACC(), 1u);
+    EXPECT_TRUE(cpu.isHalted());
+    EXPECT_EQ(cpu.getCycleCount(), 1010u);
+}
+
+// Test runUntil without a scheduler lets halted time pass
+TEST_F(K4040Test, RunUntilWithoutScheduler) {
+    loadProgram({
+        { 0x000, { 0x01 } },  // HLT
+    });
+    K4040 cpu(rom, ram);
+
+    EXPECT_EQ(cpu.runUntil(100u), 100u);
+    EXPECT_EQ(cpu.getHaltedCycles(), 99u);
+}
+
+// Test the host thread blocks until another thread raises INT
+TEST_F(K4040Test, WaitWhileHaltedWakesOnRequest) {
+    loadProgram({
+        { 0x000, { 0x0C, 0x01 } },  // EIN; HLT
+    });
+    K4040 cpu(rom, ram);
+    cpu.step();
+    cpu.step();
+
+    auto start = std::chrono::steady_clock::now();
+    EXPECT_FALSE(cpu.waitWhileHalted(start + std::chrono::milliseconds(5)));
+
+    std::thread source([&cpu] {
+        std::this_thread::sleep_for(std::chrono::milliseconds(10));
+        cpu.requestInterrupt();
+    });
+    EXPECT_TRUE(cpu.waitWhileHalted(std::chrono::steady_clock::now() + std::chrono::seconds(10)));
+    source.join();
+
+    EXPECT_LT(std::chrono::steady_clock::now() - start, std::chrono::seconds(5));
+    EXPECT_EQ(cpu.step(), K4040::INTERRUPT_CYCLES);
+}
+
+// Test a periodic timer source drives an interrupt-driven main loop
+TEST_F(K4040Test, PeriodicTimerInterrupts) {
+    loadProgram({
+        { 0x000, { 0x40, 0x10 } },  // JUN $010
+        { 0x003, { 0x67, 0x02 } },  // ISR: INC R7; BBS
+        { 0x010, { 0x0C, 0x01, 0x0C, 0x40, 0x11 } },  // EIN; HLT; EIN; JUN $011
+    });
+    K4040 cpu(rom, ram);
+    cpu.setScheduler(&scheduler);
+    scheduler.schedulePeriodic(20u, 20u, [&cpu](uint64_t) { cpu.requestInterrupt(); });
+
+    while (cpu.getCycleCount() < 205u)
+        cpu.step();
+
+    EXPECT_EQ(getR7(cpu), 10u);
+}
+
+// Test reset clears interrupt state
+TEST_F(K4040Test, ResetClearsInterruptState) {
+    loadProgram({
+        { 0x000, { 0x0C, 0x01 } },  // EIN; HLT
+    });
+    K4040 cpu(rom, ram);
+
+    cpu.step();
+    cpu.step();
+    cpu.requestInterrupt();
+    cpu.reset();
+
+    EXPECT_FALSE(cpu.isHalted());
+    EXPECT_FALSE(cpu.isInterruptEnabled());
+    EXPECT_FALSE(cpu.isInterruptPending());
+    EXPECT_EQ(cpu.getPC(), 0x000u);
+}
@@ -1,5 +1,10 @@
 #include <gtest/gtest.h>
+#include "emulator_core/source/K4004.hpp"
+#include "emulator_core/source/K4101.hpp"
 #include "emulator_core/source/K4289.hpp"
+#include "emulator_core/source/instructions.hpp"
+#include "emulator_core/source/ram.hpp"
+#include "emulator_core/source/rom.hpp"
 
 class K4289Test : public ::testing::Test {
 protected:
@@ -176,3 +181,121 @@ TEST_F(K4289Test, FullAddressSpace) {
         EXPECT_EQ(memInterface.getAddress8bit(), 0xFFu);
     }
 }
+
+namespace {
+
+// 000: fim 0< $E0, src 0<, ldm 1, wrr        page 1
+// 005: fim 0< $F0, src 0<, ldm 1, wrr        writes enabled
+// 00A: fim 0< $00, src 0<, ldm $D, wpm, ldm 9, wpm, jun $100
+// 020: jun $020
+const uint8_t WRITE_AND_RUN[] = {
+    0xFE, 0xFF,  // No I/O masks
+    0x20, 0xE0, 0x21, 0xD1, 0xE2,
+    0x20, 0xF0, 0x21, 0xD1, 0xE2,
+    0x20, 0x00, 0x21, 0xDD, 0xE3, 0xD9, 0xE3, 0x41, 0x00,
+    0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00,
+    0x40, 0x20,
+};
+
+// 000: jms $100, jun $000 with $100 in program RAM
+const uint8_t CALL_RAM[] = {
+    0xFE, 0xFF,
+    0x51, 0x00, 0x40, 0x00,
+};
+
+} // namespace
+
+class K4289ProgramRAMTest : public ::testing::Test {
+protected:
+    void SetUp() override {
+        rom.attachProgramMemory(&memInterface);
+        memInterface.mapProgramRAM(1u, highNibbles, lowNibbles);
+        memInterface.setProgramMemoryMode(true);
+    }
+
+    void writeByte(uint8_t offset, uint8_t value) {
+        memInterface.selectProgramAddress(offset);
+        memInterface.writeProgramNibble(value >> 4);
+        memInterface.writeProgramNibble(value & 0x0Fu);
+    }
+
+    K4101 highNibbles;
+    K4101 lowNibbles;
+    K4289 memInterface;
+    ROM rom;
+    RAM ram;
+};
+
+// Test the CPU writes code with SRC/WRR/WPM and then runs it from program RAM
+TEST_F(K4289ProgramRAMTest, WritesAndRunsCode) {
+    ASSERT_TRUE(rom.load(WRITE_AND_RUN, sizeof(WRITE_AND_RUN)));
+    // jun $020 after the written ldm 9
+    highNibbles.write(0x01u, 0x4u);
+    lowNibbles.write(0x01u, 0x0u);
+    highNibbles.write(0x02u, 0x2u);
+    lowNibbles.write(0x02u, 0x0u);
+    memInterface.setProgramMemoryMode(false);
+    memInterface.setProgramMemoryMode(true);
+
+    K4004 cpu(rom, ram);
+    cpu.runUntil(200u);
+    EXPECT_EQ(highNibbles.read(0x00u), 0xDu);
+    EXPECT_EQ(lowNibbles.read(0x00u), 0x9u);
+    EXPECT_EQ(rom.readByte(0x100u), 0xD9u);
+    EXPECT_EQ(cpu.getPC(), 0x020u);
+    EXPECT_EQ(cpu.getACC(), 9u);
+
+    // Without program memory mode fetches see the loaded (empty) page again
+    memInterface.setProgramMemoryMode(false);
+    EXPECT_EQ(rom.readByte(0x100u), 0x00u);
+}
+
+// Test writes are ignored unless enabled, and reads come back through RDR on port 14
+TEST_F(K4289ProgramRAMTest, ReadsThroughLatch) {
+    memInterface.writePort(K4289::CONTROL_PORT, K4289::CONTROL_WRITE_ENABLE);
+    memInterface.writePort(K4289::PAGE_PORT, 1u);
+    writeByte(0x42u, 0xA7u);
+    EXPECT_EQ(rom.readByte(0x142u), 0xA7u);
+
+    memInterface.writePort(K4289::CONTROL_PORT, 0u);
+    memInterface.selectProgramAddress(0x42u);
+    memInterface.writeProgramNibble(0x0u);  // Reads the high nibble
+    EXPECT_EQ(rom.readByte(0x142u), 0xA7u);
+    EXPECT_EQ(memInterface.getReadLatch(), 0xAu);
+
+    rom.writeSrcAddress(0xE0u);
+    EXPECT_EQ(rom.readIOPort(), 0xAu);
+
+    uint8_t acc = 0x10u;
+    rom.writeSrcAddress(0x42u);
+    RPM(acc, rom, 0x000u);
+    RPM(acc, rom, 0x000u);
+    EXPECT_EQ(acc, 0x17u);  // Low nibble, CY kept
+}
+
+// Test rewriting code drops only the traces through the written block
+TEST_F(K4289ProgramRAMTest, RewriteDropsTraces) {
+    ASSERT_TRUE(rom.load(CALL_RAM, sizeof(CALL_RAM)));
+    memInterface.writePort(K4289::CONTROL_PORT, K4289::CONTROL_WRITE_ENABLE);
+    memInterface.writePort(K4289::PAGE_PORT, 1u);
+    writeByte(0x00u, 0xD5u);  // ldm 5
+    writeByte(0x01u, 0xB2u);  // xch 2
+    writeByte(0x02u, 0xC0u);  // bbl 0
+
+    K4004 cpu(rom, ram);
+    cpu.runUntil(2000u);
+    ASSERT_GT(cpu.getTraceRuns(), 0u);
+    EXPECT_EQ(getRegisterValue(cpu.getRegisters(), 2u), 5u);
+
+    uint32_t writes = rom.getCodeWriteCount();
+    writeByte(0x00u, 0xD7u);  // ldm 7
+    EXPECT_EQ(rom.getCodeWriteCount(), writes + 1u);
+    EXPECT_EQ(rom.getBlockWriteStamp(0x10u), writes + 1u);
+    writeByte(0x00u, 0xD7u);  // Same byte, nothing changes
+    EXPECT_EQ(rom.getCodeWriteCount(), writes + 1u);
+
+    uint64_t runs = cpu.getTraceRuns();
+    cpu.runUntil(4000u);
+    EXPECT_EQ(getRegisterValue(cpu.getRegisters(), 2u), 7u);
+    EXPECT_GT(cpu.getTraceRuns(), runs);  // Recorded again from the new code
+}
@@ -0,0 +1,148 @@
+#include <gtest/gtest.h>
+#include "emulator_core/source/K4201A.hpp"
+#include "emulator_core/source/realtime_pacer.hpp"
+
+#include <chrono>
+#include <thread>
+#include <vector>
+
+using namespace std::chrono_literals;
+
+class RealTimePacerTest : public ::testing::Test {
+protected:
+    // Emulator stand-in reaching exactly the requested cycle
+    uint64_t runTo(uint64_t targetCycle) {
+        ++runCalls;
+        if (runCalls == stallOnCall)
+            std::this_thread::sleep_for(stall);
+        return targetCycle;
+    }
+
+    RealTimePacer::RunFunction runFunction() {
+        return [this](uint64_t target) { return runTo(target); };
+    }
+
+    K4201A clock;
+    int runCalls = 0;
+    int stallOnCall = -1;
+    std::chrono::milliseconds stall{ 0 };
+};
+
+// Test the instruction rate follows the K4201A configuration (8 clocks per cycle)
+TEST_F(RealTimePacerTest, CycleRateFromClock) {
+    RealTimePacer pacer(clock);
+    EXPECT_EQ(pacer.getClockFrequency(), clock.getOutputFrequency());
+    EXPECT_EQ(pacer.getCyclesPerSecond(), clock.getOutputFrequency() / 8u);
+    EXPECT_EQ(pacer.cyclesForDuration(1s), 92589u);  // 740714 Hz / 8
+    EXPECT_EQ(pacer.cyclesForDuration(1ms), 92u);
+
+    clock.setCrystalFrequency(5000000u);
+    clock.setDivideRatio(K4201A::DivideRatio::DIVIDE_8);
+    pacer.setClock(clock);
+    EXPECT_EQ(pacer.getCyclesPerSecond(), 78125u);
+    EXPECT_EQ(pacer.durationForCycles(78125u), std::chrono::nanoseconds(1s));
+    EXPECT_EQ(pacer.cyclesForDuration(std::chrono::hours(24 * 365)), 78125ull * 3600u * 24u * 365u);
+}
+
+// Test slice targets are derived from the origin so rounding does not drift
+TEST_F(RealTimePacerTest, SlicesDoNotAccumulateRounding) {
+    RealTimePacer pacer(clock);
+    std::vector<RealTimePacer::Clock::time_point> deadlines;
+    pacer.setSleepFunction([&deadlines](RealTimePacer::Clock::time_point deadline) { deadlines.push_back(deadline); });
+
+    for (int i = 0; i < 1000; ++i)
+        pacer.runSlice(runFunction());
+
+    EXPECT_EQ(pacer.getStats().slices, 1000u);
+    EXPECT_EQ(pacer.getStats().emulatedCycles, pacer.cyclesForDuration(1s));
+    ASSERT_EQ(deadlines.size(), 1000u);
+    auto span = std::chrono::duration_cast<std::chrono::microseconds>(deadlines.back() - deadlines.front());
+    EXPECT_NEAR(static_cast<double>(span.count()), 999000.0, 20.0);
+}
+
+// Test the host sleeps between slices instead of running flat out
+TEST_F(RealTimePacerTest, SleepsUntilSliceDeadline) {
+    RealTimePacer pacer(clock);
+    int slices = 0;
+
+    auto start = RealTimePacer::Clock::now();
+    pacer.run(runFunction(), [&slices] { return slices++ < 20; });
+    auto elapsed = RealTimePacer::Clock::now() - start;
+
+    EXPECT_GE(elapsed, 19ms);
+    EXPECT_EQ(pacer.getStats().slices, 20u);
+    EXPECT_GT(pacer.getStats().sleepTime, RealTimePacer::Clock::duration::zero());
+}
+
+// Test slices run back to back after a short stall until caught up
+TEST_F(RealTimePacerTest, CatchesUpAfterStall) {
+    RealTimePacer pacer(clock);
+    stallOnCall = 2;
+    stall = 20ms;
+
+    for (int i = 0; i < 60; ++i)
+        pacer.runSlice(runFunction());
+
+    const auto& stats = pacer.getStats();
+    EXPECT_GE(stats.lateSlices, 1u);
+    EXPECT_EQ(stats.resyncs, 0u);
+    EXPECT_GE(stats.maxDriftNs, std::chrono::nanoseconds(15ms).count());
+    EXPECT_LE(stats.currentDriftNs, 0);
+}
+
+// Test stalls beyond the catch-up limit restart the timeline
+TEST_F(RealTimePacerTest, ResyncsAfterLongStall) {
+    RealTimePacer pacer(clock);
+    pacer.setMaxCatchUp(5ms);
+    pacer.setSleepFunction([](RealTimePacer::Clock::time_point) {});
+    stallOnCall = 1;
+    stall = 20ms;
+
+    pacer.runSlice(runFunction());
+    EXPECT_EQ(pacer.getStats().resyncs, 1u);
+    EXPECT_EQ(pacer.getStats().lateSlices, 1u);
+
+    pacer.runSlice(runFunction());
+    EXPECT_EQ(pacer.getStats().lateSlices, 1u);
+    EXPECT_LE(pacer.getStats().currentDriftNs, 0);
+    EXPECT_EQ(pacer.getStats().emulatedCycles, 2u * 92u);
+}
+
+// Test the emulator may overshoot a target, the next slice continues from there
+TEST_F(RealTimePacerTest, OvershootCarriesOver) {
+    RealTimePacer pacer(clock);
+    pacer.setSleepFunction([](RealTimePacer::Clock::time_point) {});
+    std::vector<uint64_t> targets;
+
+    for (int i = 0; i < 3; ++i)
+        pacer.runSlice([&targets](uint64_t target) { targets.push_back(target); return target + 1u; });
+
+    ASSERT_EQ(targets.size(), 3u);
+    EXPECT_EQ(targets[0], 92u);
+    EXPECT_EQ(targets[1], 185u);
+    EXPECT_EQ(targets[2], 277u);
+    EXPECT_EQ(pacer.getStats().emulatedCycles, 278u);
+}
+
+// Test a 0 Hz clock runs unpaced instead of stalling on a zero cycle rate
+TEST_F(RealTimePacerTest, ZeroFrequencyRunsUnpaced) {
+    RealTimePacer pacer(clock);
+    pacer.setClockFrequency(0u);
+    EXPECT_FALSE(pacer.isPaced());
+    EXPECT_EQ(pacer.getCyclesPerSecond(), 0u);
+    bool slept = false;
+    pacer.setSleepFunction([&slept](RealTimePacer::Clock::time_point) { slept = true; });
+    std::vector<uint64_t> targets;
+
+    for (int i = 0; i < 3; ++i)
+        pacer.runSlice([&targets](uint64_t target) { targets.push_back(target); return target; });
+
+    ASSERT_EQ(targets.size(), 3u);
+    EXPECT_EQ(targets[0], RealTimePacer::UNPACED_SLICE_CYCLES);
+    EXPECT_EQ(targets[2], 3u * RealTimePacer::UNPACED_SLICE_CYCLES);
+    EXPECT_EQ(pacer.getStats().emulatedCycles, 3u * RealTimePacer::UNPACED_SLICE_CYCLES);
+    EXPECT_FALSE(slept);
+
+    pacer.setClock(clock);
+    EXPECT_TRUE(pacer.isPaced());
+}
@@ -1,4 +1,5 @@
 #include <gtest/gtest.h>
+#include "emulator_core/source/K4702.hpp"
 #include "emulator_core/source/rom.hpp"
 
 class RomIOTest : public ::testing::Test {
@@ -234,3 +235,49 @@ TEST_F(RomIOTest, LedOutputScenario) {
     rom.writeIOPort(0xF);
     EXPECT_EQ(rom.readIOPort(), 0xF);
 }
+
+// Test only changed bytes stamp their block and page
+TEST_F(RomIOTest, CodeWriteStamps) {
+    auto image = createRomImage({}, { 0xD1, 0xD2, 0xD3 });
+    ASSERT_TRUE(rom.load(image.data(), image.size()));
+    uint64_t writes = rom.getCodeWriteCount();
+    EXPECT_EQ(writes, 3u);
+    EXPECT_EQ(rom.getBlockWriteStamp(0u), 3u);
+    EXPECT_EQ(rom.getPageWriteStamp(0u), 3u);
+    EXPECT_EQ(rom.getPageWriteStamp(1u), 0u);
+
+    ASSERT_TRUE(rom.load(image.data(), image.size()));
+    EXPECT_EQ(rom.getCodeWriteCount(), writes);
+
+    const uint8_t page[] = { 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00,
+                             0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x40 };
+    ASSERT_TRUE(rom.loadPage(2u, page, sizeof(page)));
+    EXPECT_EQ(rom.readByte(0x210u), 0x40u);
+    EXPECT_EQ(rom.readByte(0x000u), 0xD1u);
+    EXPECT_EQ(rom.getCodeWriteCount(), writes + 1u);
+    EXPECT_EQ(rom.getBlockWriteStamp(0x21u), writes + 1u);
+    EXPECT_EQ(rom.getBlockWriteStamp(0x20u), 0u);
+    EXPECT_EQ(rom.getPageWriteStamp(2u), writes + 1u);
+    EXPECT_EQ(rom.getPageWriteStamp(0u), 3u);
+    EXPECT_FALSE(rom.loadPage(16u, page, sizeof(page)));
+}
+
+// Test a mapped EPROM replaces its page and programming it is seen by fetches
+TEST_F(RomIOTest, MappedEPROM) {
+    K4702 eprom;
+    rom.mapEPROM(3u, &eprom);
+    EXPECT_EQ(rom.readByte(0x300u), K4702::ERASED_VALUE);
+    EXPECT_EQ(rom.readByte(0x2FFu), 0x00u);
+
+    uint32_t writes = rom.getCodeWriteCount();
+    eprom.setProgramMode(true);
+    ASSERT_TRUE(eprom.program(0x45u, 0xD7u));
+    EXPECT_EQ(rom.readByte(0x345u), 0xD7u);
+    EXPECT_EQ(rom.getCodeWriteCount(), writes + 1u);
+    EXPECT_EQ(rom.getBlockWriteStamp(0x34u), writes + 1u);
+
+    rom.mapEPROM(3u, nullptr);
+    EXPECT_EQ(rom.readByte(0x345u), 0x00u);
+    eprom.erase();
+    EXPECT_EQ(rom.getPageWriteStamp(3u), rom.getCodeWriteCount());  // Unmapping changed the page, erasing did not
+}
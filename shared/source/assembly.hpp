@@ -1,67 +1,84 @@
 #pragma once
+#include <array>
 #include <cstdint>
+#include <iterator>
+#include <string_view>
+
+enum class AsmInsType : uint8_t {
+    Simple,   // Opcode only
+    Complex,  // Register, pair or 4-bit value in the low nibble
+    TwoByte   // Second byte with an address or data
+};
+
+// Every instruction once: mnemonic, opcode (low nibble clear when it takes an
+// operand), form and instruction cycles as K4004::dispatch counts them. AsmIns
+// and the mnemonic tables below are generated from it.
+#define ASM_INSTRUCTION_LIST(X) \
+    X(NOP, 0x00u, Simple,  1u) \
+    X(HLT, 0x01u, Simple,  1u) \
+    X(BBS, 0x02u, Simple,  1u) \
+    X(LCR, 0x03u, Simple,  1u) \
+    X(OR4, 0x04u, Simple,  1u) \
+    X(OR5, 0x05u, Simple,  1u) \
+    X(AN6, 0x06u, Simple,  1u) \
+    X(AN7, 0x07u, Simple,  1u) \
+    X(DB0, 0x08u, Simple,  1u) \
+    X(DB1, 0x09u, Simple,  1u) \
+    X(SB0, 0x0Au, Simple,  1u) \
+    X(SB1, 0x0Bu, Simple,  1u) \
+    X(EIN, 0x0Cu, Simple,  1u) \
+    X(DIN, 0x0Du, Simple,  1u) \
+    X(RPM, 0x0Eu, Simple,  1u) \
+    X(JCN, 0x10u, TwoByte, 2u) \
+    X(FIM, 0x20u, TwoByte, 2u) \
+    X(SRC, 0x21u, Complex, 1u) \
+    X(FIN, 0x30u, Complex, 2u) \
+    X(JIN, 0x31u, Complex, 1u) \
+    X(JUN, 0x40u, TwoByte, 2u) \
+    X(JMS, 0x50u, TwoByte, 2u) \
+    X(INC, 0x60u, Complex, 1u) \
+    X(ISZ, 0x70u, TwoByte, 2u) \
+    X(ADD, 0x80u, Complex, 1u) \
+    X(SUB, 0x90u, Complex, 1u) \
+    X(LD,  0xA0u, Complex, 1u) \
+    X(XCH, 0xB0u, Complex, 1u) \
+    X(BBL, 0xC0u, Complex, 1u) \
+    X(LDM, 0xD0u, Complex, 1u) \
+    X(WRM, 0xE0u, Simple,  1u) \
+    X(WMP, 0xE1u, Simple,  1u) \
+    X(WRR, 0xE2u, Simple,  1u) \
+    X(WPM, 0xE3u, Simple,  1u) \
+    X(WR0, 0xE4u, Simple,  1u) \
+    X(WR1, 0xE5u, Simple,  1u) \
+    X(WR2, 0xE6u, Simple,  1u) \
+    X(WR3, 0xE7u, Simple,  1u) \
+    X(SBM, 0xE8u, Simple,  1u) \
+    X(RDM, 0xE9u, Simple,  1u) \
+    X(RDR, 0xEAu, Simple,  1u) \
+    X(ADM, 0xEBu, Simple,  1u) \
+    X(RD0, 0xECu, Simple,  1u) \
+    X(RD1, 0xEDu, Simple,  1u) \
+    X(RD2, 0xEEu, Simple,  1u) \
+    X(RD3, 0xEFu, Simple,  1u) \
+    X(CLB, 0xF0u, Simple,  1u) \
+    X(CLC, 0xF1u, Simple,  1u) \
+    X(IAC, 0xF2u, Simple,  1u) \
+    X(CMC, 0xF3u, Simple,  1u) \
+    X(CMA, 0xF4u, Simple,  1u) \
+    X(RAL, 0xF5u, Simple,  1u) \
+    X(RAR, 0xF6u, Simple,  1u) \
+    X(TCC, 0xF7u, Simple,  1u) \
+    X(DAC, 0xF8u, Simple,  1u) \
+    X(TCS, 0xF9u, Simple,  1u) \
+    X(STC, 0xFAu, Simple,  1u) \
+    X(DAA, 0xFBu, Simple,  1u) \
+    X(KBP, 0xFCu, Simple,  1u) \
+    X(DCL, 0xFDu, Simple,  1u)
 
 enum class AsmIns : uint8_t {
-    NOP = 0x00u,
-    HLT = 0x01u,
-    BBS = 0x02u,
-    LCR = 0x03u,
-    OR4 = 0x04u,
-    OR5 = 0x05u,
-    AN6 = 0x06u,
-    AN7 = 0x07u,
-    DB0 = 0x08u,
-    DB1 = 0x09u,
-    SB0 = 0x0Au,
-    SB1 = 0x0Bu,
-    EIN = 0x0Cu,
-    DIN = 0x0Du,
-    RPM = 0x0Eu,
-    JCN = 0x10u, // Two-byte instruction
-    FIM = 0x20u, // Two-byte instruction
-    SRC = 0x21u, // Complex instruction
-    FIN = 0x30u, // Complex instruction
-    JIN = 0x31u, // Complex instruction
-    JUN = 0x40u, // Two-byte instruction
-    JMS = 0x50u, // Two-byte instruction
-    INC = 0x60u, // Complex instruction
-    ISZ = 0x70u, // Two-byte instruction
-    ADD = 0x80u, // Complex instruction
-    SUB = 0x90u, // Complex instruction
-    LD  = 0xA0u, // Complex instruction
-    XCH = 0xB0u, // Complex instruction
-    BBL = 0xC0u, // Complex instruction
-    LDM = 0xD0u, // Complex instruction
-    WRM = 0xE0u,
-    WMP = 0xE1u,
-    WRR = 0xE2u,
-    WPM = 0xE3u,
-    WR0 = 0xE4u,
-    WR1 = 0xE5u,
-    WR2 = 0xE6u,
-    WR3 = 0xE7u,
-    SBM = 0xE8u,
-    RDM = 0xE9u,
-    RDR = 0xEAu,
-    ADM = 0xEBu,
-    RD0 = 0xECu,
-    RD1 = 0xEDu,
-    RD2 = 0xEEu,
-    RD3 = 0xEFu,
-    CLB = 0xF0u,
-    CLC = 0xF1u,
-    IAC = 0xF2u,
-    CMC = 0xF3u,
-    CMA = 0xF4u,
-    RAL = 0xF5u,
-    RAR = 0xF6u,
-    TCC = 0xF7u,
-    DAC = 0xF8u,
-    TCS = 0xF9u,
-    STC = 0xFAu,
-    DAA = 0xFBu,
-    KBP = 0xFCu,
-    DCL = 0xFDu,
+#define ASM_INSTRUCTION_ENUM(name, byte, type, cycles) name = byte,
+    ASM_INSTRUCTION_LIST(ASM_INSTRUCTION_ENUM)
+#undef ASM_INSTRUCTION_ENUM
 
     Count = 60u
 };
@@ -113,3 +130,152 @@ enum class AsmCon : uint8_t {
 inline constexpr uint8_t operator+(const AsmCon val) { return static_cast<uint8_t>(val); }
 
 uint8_t getOpcodeFromByte(uint8_t byte);
+
+struct AsmInsDesc {
+    const char* name;
+    uint8_t byte;
+    AsmInsType type;
+    uint8_t cycles;
+};
+
+inline constexpr AsmInsDesc ASM_INSTRUCTIONS[] = {
+#define ASM_INSTRUCTION_DESC(name, byte, type, cycles) { #name, byte, AsmInsType::type, cycles },
+    ASM_INSTRUCTION_LIST(ASM_INSTRUCTION_DESC)
+#undef ASM_INSTRUCTION_DESC
+};
+static_assert(std::size(ASM_INSTRUCTIONS) == +AsmIns::Count);
+
+// Compile-time perfect hash of the mnemonics. A 2-3 letter name packs into
+// one 32-bit key (length and upper-cased letters), a multiplier found at
+// compile time maps every key to its own slot of a 256-entry table, and a
+// lookup is one multiply, one table load and one key compare.
+namespace AsmMnemonicHash {
+
+inline constexpr uint32_t HASH_BITS = 8u;
+inline constexpr uint8_t EMPTY_SLOT = 0xFFu;
+
+constexpr uint32_t pack(std::string_view text)
+{
+    if (text.size() < 2u || text.size() > 3u)
+        return 0u;
+
+    uint32_t key = static_cast<uint32_t>(text.size()) << 24;
+    for (size_t i = 0u; i < text.size(); ++i) {
+        char ch = text[i];
+        if (ch >= 'a' && ch <= 'z')
+            ch = static_cast<char>(ch - 'a' + 'A');
+        key |= static_cast<uint32_t>(static_cast<uint8_t>(ch)) << (16u - 8u * i);
+    }
+    return key;
+}
+
+constexpr uint32_t slot(uint32_t key, uint32_t multiplier)
+{
+    return (key * multiplier) >> (32u - HASH_BITS);
+}
+
+constexpr bool isPerfect(uint32_t multiplier)
+{
+    bool used[1u << HASH_BITS] = {};
+    for (const AsmInsDesc& desc : ASM_INSTRUCTIONS) {
+        uint32_t index = slot(pack(desc.name), multiplier);
+        if (used[index])
+            return false;
+        used[index] = true;
+    }
+    return true;
+}
+
+// Candidates tried before giving up (the current table needs a few hundred)
+inline constexpr uint32_t MAX_MULTIPLIER_TRIES = 1u << 16;
+
+constexpr uint32_t findMultiplier()
+{
+    // Odd multipliers from a fixed LCG, the first without collisions, 0 if none
+    uint32_t multiplier = 0x9E3779B9u;
+    for (uint32_t tries = 0u; tries < MAX_MULTIPLIER_TRIES; ++tries) {
+        if (isPerfect(multiplier | 1u))
+            return multiplier | 1u;
+        multiplier = multiplier * 1664525u + 1013904223u;
+    }
+    return 0u;
+}
+
+inline constexpr uint32_t MULTIPLIER = findMultiplier();
+static_assert(isPerfect(MULTIPLIER), "no collision-free multiplier found, raise HASH_BITS or MAX_MULTIPLIER_TRIES");
+
+constexpr std::array<uint8_t, 1u << HASH_BITS> makeSlots()
+{
+    std::array<uint8_t, 1u << HASH_BITS> slots{};
+    slots.fill(EMPTY_SLOT);
+    for (size_t i = 0u; i < std::size(ASM_INSTRUCTIONS); ++i)
+        slots[slot(pack(ASM_INSTRUCTIONS[i].name), MULTIPLIER)] = static_cast<uint8_t>(i);
+    return slots;
+}
+
+constexpr std::array<uint8_t, 256u> makeOpcodes()
+{
+    std::array<uint8_t, 256u> opcodes{};
+    opcodes.fill(EMPTY_SLOT);
+    for (size_t i = 0u; i < std::size(ASM_INSTRUCTIONS); ++i)
+        opcodes[ASM_INSTRUCTIONS[i].byte] = static_cast<uint8_t>(i);
+    return opcodes;
+}
+
+inline constexpr std::array<uint8_t, 1u << HASH_BITS> SLOTS = makeSlots();
+inline constexpr std::array<uint8_t, 256u> OPCODES = makeOpcodes();
+
+} // namespace AsmMnemonicHash
+
+// Instruction named text in any case, nullptr when it is not a mnemonic
+constexpr const AsmInsDesc* findAsmMnemonic(std::string_view text)
+{
+    uint32_t key = AsmMnemonicHash::pack(text);
+    uint8_t index = AsmMnemonicHash::SLOTS[AsmMnemonicHash::slot(key, AsmMnemonicHash::MULTIPLIER)];
+    if (key == 0u || index == AsmMnemonicHash::EMPTY_SLOT || AsmMnemonicHash::pack(ASM_INSTRUCTIONS[index].name) != key)
+        return nullptr;
+    return &ASM_INSTRUCTIONS[index];
+}
+
+// Instruction with this opcode (as returned by getOpcodeFromByte), nullptr when there is none
+constexpr const AsmInsDesc* findAsmInstruction(uint8_t opcode)
+{
+    uint8_t index = AsmMnemonicHash::OPCODES[opcode];
+    return index != AsmMnemonicHash::EMPTY_SLOT ? &ASM_INSTRUCTIONS[index] : nullptr;
+}
+
+// R0-R9, RA-RF, R10-R15 and P0-P7 in any case, value as in AsmReg
+constexpr bool findAsmRegister(std::string_view text, uint8_t& value, bool& isPair)
+{
+    if (text.size() < 2u || text.size() > 3u)
+        return false;
+
+    char kind = text[0] & ~0x20;  // Upper case
+    char digit = text[1];
+    isPair = kind == 'P';
+    if (isPair) {
+        if (text.size() != 2u || digit < '0' || digit > '7')
+            return false;
+        value = static_cast<uint8_t>(2 * (digit - '0'));
+        return true;
+    }
+    if (kind != 'R')
+        return false;
+
+    if (text.size() == 3u) {
+        if (digit != '1' || text[2] < '0' || text[2] > '5')
+            return false;
+        value = static_cast<uint8_t>(10 + (text[2] - '0'));
+        return true;
+    }
+    if (digit >= '0' && digit <= '9')
+        value = static_cast<uint8_t>(digit - '0');
+    else if ((digit & ~0x20) >= 'A' && (digit & ~0x20) <= 'F')
+        value = static_cast<uint8_t>((digit & ~0x20) - 'A' + 10);
+    else
+        return false;
+    return true;
+}
+
+static_assert(findAsmMnemonic("ld")->byte == +AsmIns::LD && findAsmMnemonic("LDX") == nullptr);
+